@@ -0,0 +1,460 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+#include "OHBenchmark.h"
+#include "OHPixelKernels.h"
+#include "OHRasterizer.h"
+#include "OHRenderStats.h"
+#include "OHShadowBlur.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+/***********************************************************************************/
+
+const double OHBenchmarkSizes[OH_BENCHMARK_SIZES_COUNT] = { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+
+void OHBenchmarkOptionsName(unsigned options, char* name)
+{
+    static const char* const kOptionNames[] = { "tint", "background", "shadow", "insets" };
+    name[0] = '\0';
+    for (size_t i = 0; i < sizeof(kOptionNames) / sizeof(kOptionNames[0]); ++i)
+    {
+        if (!(options & (1u << i))) continue;
+        if (name[0]) strcat(name, "+");
+        strcat(name, kOptionNames[i]);
+    }
+    if (!name[0]) strcpy(name, "none");
+}
+
+// MARK: - Corpus
+
+/* xorshift32, so that the corpus is the same on every platform */
+static uint32_t OHRandomNext(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static float OHRandomFloat(uint32_t* state, float min, float max)
+{
+    return min + (max - min) * (float)(OHRandomNext(state) >> 8) / (float)(1 << 24);
+}
+
+OHDisplayList* OHBenchmarkCreatePathCorpus(uint32_t seed, size_t pathCount, float width, float height)
+{
+    static const float kPi = 3.14159265358979323846f;
+    static const OHDisplayListOp kPaintOps[] = {
+        OHDisplayListOpFill, OHDisplayListOpEOFill, OHDisplayListOpStroke, OHDisplayListOpFillStroke
+    };
+    OHDisplayList* list = OHDisplayListCreate();
+    if (!list) return NULL;
+
+    uint32_t state = seed ? seed : 1;
+    float extent = width < height ? width : height;
+    int failed = 0;
+    for (size_t p = 0; p < pathCount && !failed; ++p)
+    {
+        const float fill[4] = {
+            OHRandomFloat(&state, 0, 1), OHRandomFloat(&state, 0, 1), OHRandomFloat(&state, 0, 1),
+            OHRandomFloat(&state, 0.25f, 1)
+        };
+        const float stroke[4] = { fill[2], fill[0], fill[1], 1 };
+        const float lineWidth = OHRandomFloat(&state, 0.002f, 0.02f) * extent;
+        failed |= OHDisplayListAppend(list, OHDisplayListOpSetFillColor, fill, 4);
+        failed |= OHDisplayListAppend(list, OHDisplayListOpSetStrokeColor, stroke, 4);
+        failed |= OHDisplayListAppend(list, OHDisplayListOpSetLineWidth, &lineWidth, 1);
+
+        // A star-like shape of 3 to 8 vertices around a random center, with straight or curved edges
+        const float cx = OHRandomFloat(&state, 0, width), cy = OHRandomFloat(&state, 0, height);
+        const float radius = OHRandomFloat(&state, 0.005f, 0.05f) * extent;
+        const unsigned vertexCount = 3 + OHRandomNext(&state) % 6;
+        float previous[2] = { 0, 0 };
+        for (unsigned v = 0; v <= vertexCount; ++v)
+        {
+            const float angle = 2 * kPi * (float)(v % vertexCount) / (float)vertexCount;
+            const float r = (v % vertexCount == 0) ? radius : radius * OHRandomFloat(&state, 0.3f, 1);
+            const float point[2] = { cx + r * cosf(angle), cy + r * sinf(angle) };
+            if (v == 0)
+            {
+                failed |= OHDisplayListAppend(list, OHDisplayListOpMoveTo, point, 2);
+            }
+            else if (OHRandomNext(&state) & 1)
+            {
+                const float curve[6] = {
+                    previous[0] + OHRandomFloat(&state, -radius, radius), previous[1] + OHRandomFloat(&state, -radius, radius),
+                    point[0] + OHRandomFloat(&state, -radius, radius), point[1] + OHRandomFloat(&state, -radius, radius),
+                    point[0], point[1]
+                };
+                failed |= OHDisplayListAppend(list, OHDisplayListOpCurveTo, curve, 6);
+            }
+            else
+            {
+                failed |= OHDisplayListAppend(list, OHDisplayListOpLineTo, point, 2);
+            }
+            previous[0] = point[0];
+            previous[1] = point[1];
+        }
+        failed |= OHDisplayListAppend(list, OHDisplayListOpClosePath, NULL, 0);
+        failed |= OHDisplayListAppend(list, kPaintOps[OHRandomNext(&state) % 4], NULL, 0);
+    }
+
+    if (failed)
+    {
+        OHDisplayListRelease(list);
+        return NULL;
+    }
+    return list;
+}
+
+// MARK: - Measuring
+
+static int OHCompareDurations(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted durations */
+static uint64_t OHSortedPercentile(const uint64_t* durations, size_t count, double percentile)
+{
+    size_t rank = (size_t)ceil(percentile / 100.0 * (double)count);
+    return durations[rank > 0 ? rank - 1 : 0];
+}
+
+int OHBenchmarkRun(OHBenchmarkFunction function, OHBenchmarkFunction setUp, void* info,
+                   OHBenchmarkLimits limits, OHBenchmarkResult* result)
+{
+    const size_t capacity = limits.maxIterations > 0 ? limits.maxIterations : 1;
+    uint64_t* durations = malloc(capacity * sizeof(uint64_t));
+    if (!durations) return -1;
+
+    const int wasEnabled = OHRenderStatsIsEnabled();
+    OHRenderStatsSetEnabled(1);
+    if (setUp) setUp(info);
+    function(info); // Warm-up
+
+    OHRenderStatsSnapshot before, after;
+    OHRenderStatsGetSnapshot(&before);
+    size_t count = 0;
+    uint64_t elapsed = 0;
+    while (count < capacity && (count < limits.minIterations || elapsed < limits.minNanoseconds))
+    {
+        if (setUp) setUp(info);
+        const uint64_t start = OHRenderStatsNow();
+        function(info);
+        durations[count] = OHRenderStatsNow() - start;
+        elapsed += durations[count++];
+    }
+    OHRenderStatsGetSnapshot(&after);
+    OHRenderStatsSetEnabled(wasEnabled);
+
+    qsort(durations, count, sizeof(uint64_t), OHCompareDurations);
+    result->iterations = count;
+    result->p50Nanoseconds = OHSortedPercentile(durations, count, 50);
+    result->p99Nanoseconds = count >= OH_BENCHMARK_MIN_P99_ITERATIONS ? OHSortedPercentile(durations, count, 99) : 0;
+    result->pixelsPerSecond = result->p50Nanoseconds > 0
+                            ? (double)result->pixels * 1e9 / (double)result->p50Nanoseconds : 0;
+    result->bytesAllocated = (after.bytesAllocated - before.bytesAllocated) / count;
+    result->peakResidentBytes = OHBenchmarkPeakResidentBytes();
+    free(durations);
+    return 0;
+}
+
+uint64_t OHBenchmarkPeakResidentBytes(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#if defined(__APPLE__)
+    return (uint64_t)usage.ru_maxrss; // bytes
+#else
+    return (uint64_t)usage.ru_maxrss * 1024; // kilobytes
+#endif
+}
+
+// MARK: - Reporting
+
+struct OHBenchmarkReport {
+    FILE* file;
+    size_t resultsCount;
+};
+
+static void OHWriteJSONString(FILE* file, const char* string)
+{
+    fputc('"', file);
+    for (const char* c = string ? string : ""; *c; ++c)
+    {
+        if (*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+        else if ((unsigned char)*c < 0x20) fprintf(file, "\\u%04x", (unsigned)*c);
+        else fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+OHBenchmarkReport* OHBenchmarkReportCreate(FILE* file, const char* platform)
+{
+    OHBenchmarkReport* report = calloc(1, sizeof(OHBenchmarkReport));
+    if (!report) return NULL;
+    report->file = file;
+
+    fprintf(file, "{\n  \"platform\": ");
+    OHWriteJSONString(file, platform);
+    fprintf(file, ",\n  \"pixelKernels\": ");
+    OHWriteJSONString(file, OHPixelKernelsImplementationName());
+    fprintf(file, ",\n  \"results\": [");
+    return report;
+}
+
+void OHBenchmarkReportAddResult(OHBenchmarkReport* report, const OHBenchmarkResult* result)
+{
+    FILE* file = report->file;
+    char options[64];
+    OHBenchmarkOptionsName(result->options, options);
+
+    fprintf(file, "%s\n    {\"name\": ", report->resultsCount++ ? "," : "");
+    OHWriteJSONString(file, result->name);
+    fprintf(file, ", \"input\": ");
+    OHWriteJSONString(file, result->input);
+    fprintf(file, ", \"size\": %g, \"options\": \"%s\", \"pixels\": %llu, \"iterations\": %lu"
+            ", \"p50Nanoseconds\": %llu, \"p99Nanoseconds\": ",
+            result->size, options, (unsigned long long)result->pixels, (unsigned long)result->iterations,
+            (unsigned long long)result->p50Nanoseconds);
+    if (result->iterations >= OH_BENCHMARK_MIN_P99_ITERATIONS)
+    {
+        fprintf(file, "%llu", (unsigned long long)result->p99Nanoseconds);
+    }
+    else
+    {
+        fprintf(file, "null");
+    }
+    fprintf(file, ", \"pixelsPerSecond\": %.0f, \"bytesAllocated\": %llu, \"peakResidentBytes\": %llu}",
+            result->pixelsPerSecond, (unsigned long long)result->bytesAllocated,
+            (unsigned long long)result->peakResidentBytes);
+    fflush(file);
+}
+
+void OHBenchmarkReportFinish(OHBenchmarkReport* report)
+{
+    fprintf(report->file, "\n  ],\n  \"peakResidentBytes\": %llu\n}\n",
+            (unsigned long long)OHBenchmarkPeakResidentBytes());
+    fflush(report->file);
+    free(report);
+}
+
+// MARK: - Rasterizer benchmarks
+
+typedef struct {
+    OHRasterPage page;
+    OHRasterOptions options;
+    OHRasterBuffer buffer;
+} OHRasterizerCase;
+
+static void OHRunRasterizerCase(void* info)
+{
+    OHRasterizerCase* rasterizerCase = info;
+    OHRasterRenderPage(&rasterizerCase->page, &rasterizerCase->options, rasterizerCase->buffer);
+}
+
+int OHBenchmarkRunRasterizer(OHBenchmarkReport* report, const char* input, const OHDisplayList* list,
+                             float width, float height, double maxSize, double screenScale,
+                             OHBenchmarkLimits limits)
+{
+    static const OHPixelColor kTint = { 255, 0, 0, 255 };
+    static const OHPixelColor kBackground = { 255, 255, 255, 255 };
+    static const OHPixelColor kShadow = { 0, 0, 0, 128 };
+    const OHRasterRect box = { 0, 0, width, height };
+
+    for (size_t s = 0; s < OH_BENCHMARK_SIZES_COUNT && OHBenchmarkSizes[s] <= maxSize; ++s)
+    {
+        OHRasterizerCase rasterizerCase = { .page = { list, box, box } };
+        rasterizerCase.options.width = rasterizerCase.options.height = OHBenchmarkSizes[s];
+        rasterizerCase.options.screenScale = screenScale;
+
+        size_t pixelWidth, pixelHeight;
+        if (OHRasterGetImageSize(&rasterizerCase.page, &rasterizerCase.options, &pixelWidth, &pixelHeight) != 0) continue;
+        OHRasterBuffer buffer = { malloc(pixelWidth * pixelHeight * 4), pixelWidth, pixelHeight,
+                                  pixelWidth * 4, OHRasterFormatRGBA8 };
+        if (!buffer.data) return -1;
+        rasterizerCase.buffer = buffer;
+
+        for (unsigned options = 0; options < OHBenchmarkOptionCombinationsCount; ++options)
+        {
+            // Insets, shadow offset and blur are in the unit of the page, like OHVectorImage's
+            OHRasterOptions* rasterOptions = &rasterizerCase.options;
+            rasterOptions->tintColor = (options & OHBenchmarkOptionTint) ? &kTint : NULL;
+            rasterOptions->backgroundColor = (options & OHBenchmarkOptionBackground) ? &kBackground : NULL;
+            rasterOptions->shadowColor = (options & OHBenchmarkOptionShadow) ? &kShadow : NULL;
+            rasterOptions->shadowOffsetX = 0.02 * width;
+            rasterOptions->shadowOffsetY = 0.02 * height;
+            rasterOptions->shadowBlurRadius = 0.03 * width;
+            const double inset = (options & OHBenchmarkOptionInsets) ? 0.1 : 0;
+            rasterOptions->insetTop = rasterOptions->insetBottom = inset * height;
+            rasterOptions->insetLeft = rasterOptions->insetRight = inset * width;
+
+            OHBenchmarkResult result = { .name = "rasterizer", .input = input, .size = OHBenchmarkSizes[s],
+                                         .options = options, .pixels = (uint64_t)pixelWidth * pixelHeight };
+            if (OHBenchmarkRun(OHRunRasterizerCase, NULL, &rasterizerCase, limits, &result) != 0)
+            {
+                free(buffer.data);
+                return -1;
+            }
+            OHBenchmarkReportAddResult(report, &result);
+        }
+        free(buffer.data);
+    }
+    return 0;
+}
+
+// MARK: - Kernel benchmarks
+
+typedef struct {
+    OHPixelBuffer buffer;
+    uint8_t* mask;
+    double blurRadius;
+    /* The initial content of the buffer and mask, restored before each iteration */
+    uint8_t* pattern;
+} OHKernelCase;
+
+static void OHSetUpKernelCase(void* info)
+{
+    OHKernelCase* kernelCase = info;
+    const size_t pixelCount = kernelCase->buffer.width * kernelCase->buffer.height;
+    memcpy(kernelCase->buffer.data, kernelCase->pattern, pixelCount * 4);
+    for (size_t i = 0; i < pixelCount; ++i) kernelCase->mask[i] = kernelCase->pattern[i * 4 + 3];
+}
+
+static void OHRunRecolor(void* info)
+{
+    OHKernelCase* kernelCase = info;
+    const OHPixelColor color = { 200, 0, 0, 255 };
+    OHPixelRecolor(kernelCase->buffer, color);
+}
+
+static void OHRunFillUnder(void* info)
+{
+    OHKernelCase* kernelCase = info;
+    const OHPixelColor color = { 255, 255, 255, 255 };
+    OHPixelFillUnder(kernelCase->buffer, color);
+}
+
+static void OHRunAlphaMaskExtract(void* info)
+{
+    OHKernelCase* kernelCase = info;
+    OHAlphaMaskExtract(kernelCase->buffer, kernelCase->mask);
+}
+
+static void OHRunAlphaMaskBlur(void* info)
+{
+    OHKernelCase* kernelCase = info;
+    OHAlphaMaskBlur(kernelCase->mask, kernelCase->buffer.width, kernelCase->buffer.height, kernelCase->blurRadius);
+}
+
+static void OHRunShadowUnder(void* info)
+{
+    OHKernelCase* kernelCase = info;
+    const OHPixelColor color = { 0, 0, 0, 128 };
+    OHPixelShadowUnder(kernelCase->buffer, kernelCase->mask, kernelCase->buffer.width, 4, 4, color);
+}
+
+static void OHRunBlendSpan(void* info)
+{
+    OHKernelCase* kernelCase = info;
+    const OHPixelColor color = { 0, 0, 128, 128 };
+    for (size_t y = 0; y < kernelCase->buffer.height; ++y)
+    {
+        OHPixelBlendSpan(kernelCase->buffer.data + y * kernelCase->buffer.bytesPerRow,
+                         kernelCase->mask + y * kernelCase->buffer.width, kernelCase->buffer.width, color);
+    }
+}
+
+static void OHRunDownsample(void* info)
+{
+    // From the pattern to 2/3 of its size, a typical ratio between a mipmap bucket and a requested size
+    OHKernelCase* kernelCase = info;
+    const size_t side = kernelCase->buffer.width;
+    OHPixelBuffer source = { kernelCase->pattern, side, side, side * 4 };
+    OHPixelBuffer destination = { kernelCase->buffer.data, (side * 2 + 2) / 3, (side * 2 + 2) / 3, side * 4 };
+    OHPixelDownsample(source, destination);
+}
+
+int OHBenchmarkRunKernels(OHBenchmarkReport* report, double maxSize, double screenScale,
+                          OHBenchmarkLimits limits)
+{
+    static const struct { const char* name; OHBenchmarkFunction function; } kKernels[] = {
+        { "recolor", OHRunRecolor },
+        { "fillUnder", OHRunFillUnder },
+        { "alphaMaskExtract", OHRunAlphaMaskExtract },
+        { "alphaMaskBlur", OHRunAlphaMaskBlur },
+        { "shadowUnder", OHRunShadowUnder },
+        { "blendSpan", OHRunBlendSpan },
+        { "downsample", OHRunDownsample },
+    };
+
+    int status = 0;
+    for (size_t s = 0; s < OH_BENCHMARK_SIZES_COUNT && OHBenchmarkSizes[s] <= maxSize && status == 0; ++s)
+    {
+        const size_t side = (size_t)ceil(OHBenchmarkSizes[s] * screenScale);
+        OHKernelCase kernelCase = { { malloc(side * side * 4), side, side, side * 4 }, malloc(side * side),
+                                    3 * screenScale, malloc(side * side * 4) };
+        if (!kernelCase.buffer.data || !kernelCase.mask || !kernelCase.pattern)
+        {
+            free(kernelCase.buffer.data);
+            free(kernelCase.mask);
+            free(kernelCase.pattern);
+            return -1;
+        }
+
+        // A premultiplied pattern with every level of alpha, like anti-aliased content
+        uint32_t state = 0x9E3779B9u;
+        for (size_t i = 0; i < side * side; ++i)
+        {
+            const uint8_t alpha = (uint8_t)(OHRandomNext(&state) >> 24);
+            uint8_t* pixel = kernelCase.pattern + i * 4;
+            pixel[0] = pixel[1] = pixel[2] = alpha / 2;
+            pixel[3] = alpha;
+        }
+
+        for (size_t k = 0; k < sizeof(kKernels) / sizeof(kKernels[0]); ++k)
+        {
+            OHBenchmarkResult result = { .name = kKernels[k].name, .input = "pattern",
+                                         .size = OHBenchmarkSizes[s], .pixels = (uint64_t)side * side };
+            if (OHBenchmarkRun(kKernels[k].function, OHSetUpKernelCase, &kernelCase, limits, &result) != 0)
+            {
+                status = -1;
+                break;
+            }
+            OHBenchmarkReportAddResult(report, &result);
+        }
+        free(kernelCase.buffer.data);
+        free(kernelCase.mask);
+        free(kernelCase.pattern);
+    }
+    return status;
+}
@@ -0,0 +1,223 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHPDFImage_OHBenchmark_h
+#define OHPDFImage_OHBenchmark_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "OHDisplayList.h"
+
+/***********************************************************************************/
+
+/*
+ *  The portable part of the OHPDFImage benchmark suite.
+ *
+ *  It generates reproducible path corpora, times the portable rendering
+ *  pieces (`OHRasterizer`, `OHPixelKernels`, `OHShadowBlur`) over a sweep of
+ *  sizes and option combinations, and reports p50/p99 latencies, throughput,
+ *  allocations and peak RSS as JSON. It is shared by the headless command line
+ *  benchmark (`OHBenchmarkMain.c`) and the iOS benchmarks of the UnitTests
+ *  target, which also time `-[OHVectorImage renderAtSize:]` on the demo PDFs.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MARK: - Sweep
+
+/**
+ *  The rendering options combined by the benchmarks, mirroring the
+ *  properties of `OHVectorImage`. Every combination of these flags is run.
+ */
+enum {
+    OHBenchmarkOptionTint       = 1 << 0,
+    OHBenchmarkOptionBackground = 1 << 1,
+    OHBenchmarkOptionShadow     = 1 << 2,
+    OHBenchmarkOptionInsets     = 1 << 3,
+    OHBenchmarkOptionCombinationsCount = 1 << 4
+};
+
+/**
+ *  The sizes of the sweep, in points, from 16pt to 2048pt.
+ */
+#define OH_BENCHMARK_SIZES_COUNT 8
+extern const double OHBenchmarkSizes[OH_BENCHMARK_SIZES_COUNT];
+
+/**
+ *  Writes a readable name of an option combination (e.g. "tint+shadow",
+ *  or "none") into a buffer of at least 64 bytes.
+ */
+void OHBenchmarkOptionsName(unsigned options, char* name);
+
+// MARK: - Corpus
+
+/**
+ *  Generates a display list of random filled and stroked paths (lines and
+ *  curves, with random colors and fill rules). The same seed always
+ *  generates the same display list.
+ *
+ *  @param seed      The seed of the pseudo-random generator (non-zero)
+ *  @param pathCount The number of paths to generate
+ *  @param width     The width of the page the paths are spread over
+ *  @param height    The height of the page the paths are spread over
+ *
+ *  @return The display list, to release with `OHDisplayListRelease`,
+ *          or NULL on allocation failure.
+ */
+OHDisplayList* OHBenchmarkCreatePathCorpus(uint32_t seed, size_t pathCount, float width, float height);
+
+// MARK: - Measuring
+
+/**
+ *  The measurements of one benchmark case.
+ */
+typedef struct {
+    /* What was measured (e.g. "renderAtSize", "rasterizer", "recolor") */
+    const char* name;
+    /* The input it was measured on (e.g. "check.pdf", "paths-1000") */
+    const char* input;
+    /* The requested size, in points, and the OHBenchmarkOption* flags used */
+    double size;
+    unsigned options;
+    /* The number of pixels produced by each iteration */
+    uint64_t pixels;
+    /* The number of timed iterations, and their 50th/99th percentile duration. The 99th
+       percentile is 0 (reported as null) under OH_BENCHMARK_MIN_P99_ITERATIONS iterations,
+       where it would only be the slowest iteration */
+    size_t iterations;
+    uint64_t p50Nanoseconds, p99Nanoseconds;
+    /* The number of pixels produced per second, from the median duration */
+    double pixelsPerSecond;
+    /* The bytes allocated per iteration, as reported to `OHRenderStats` */
+    uint64_t bytesAllocated;
+    /* The peak resident memory of the process after the case */
+    uint64_t peakResidentBytes;
+} OHBenchmarkResult;
+
+/**
+ *  The number of iterations needed to report a 99th percentile.
+ */
+#define OH_BENCHMARK_MIN_P99_ITERATIONS 100
+
+/**
+ *  A function running one iteration of a benchmark case.
+ */
+typedef void (*OHBenchmarkFunction)(void* info);
+
+/**
+ *  The number of iterations of each case, and the time spent on it.
+ *  Each case runs one untimed warm-up iteration, then at least `minIterations`
+ *  timed ones, and more until `minNanoseconds` elapsed or `maxIterations` ran.
+ */
+typedef struct {
+    size_t minIterations, maxIterations;
+    uint64_t minNanoseconds;
+} OHBenchmarkLimits;
+
+/**
+ *  Runs a benchmark case and fills the measurements of a result.
+ *  `OHRenderStats` is enabled while the case runs to count the allocations.
+ *
+ *  @param function The function to time
+ *  @param setUp    An optional function called before each iteration, untimed
+ *                  (e.g. to restore the input a function modifies in place)
+ *  @param info     The argument of the functions
+ *  @param limits   The number of iterations to run
+ *  @param result   The result to fill. Its `pixels` field must be set
+ *                  before the call to compute the throughput.
+ *
+ *  @return 0 on success, -1 on allocation failure.
+ */
+int OHBenchmarkRun(OHBenchmarkFunction function, OHBenchmarkFunction setUp, void* info,
+                   OHBenchmarkLimits limits, OHBenchmarkResult* result);
+
+/**
+ *  Returns the peak resident memory of the process, in bytes.
+ */
+uint64_t OHBenchmarkPeakResidentBytes(void);
+
+// MARK: - Reporting
+
+typedef struct OHBenchmarkReport OHBenchmarkReport;
+
+/**
+ *  Starts a JSON report of benchmark results.
+ *
+ *  @param file     The file to write the report to
+ *  @param platform A description of the platform, written in the report
+ *
+ *  @return The report, to finish with `OHBenchmarkReportFinish`, or NULL on allocation failure.
+ */
+OHBenchmarkReport* OHBenchmarkReportCreate(FILE* file, const char* platform);
+
+/**
+ *  Writes a result to a report.
+ */
+void OHBenchmarkReportAddResult(OHBenchmarkReport* report, const OHBenchmarkResult* result);
+
+/**
+ *  Writes the end of a report and releases it. The file is not closed.
+ */
+void OHBenchmarkReportFinish(OHBenchmarkReport* report);
+
+// MARK: - Portable benchmarks
+
+/**
+ *  Runs `OHRasterRenderPage` on a display list for every size of the sweep
+ *  and every option combination, and adds the results to a report.
+ *
+ *  @param report      The report to add the results to
+ *  @param input       The name of the display list, written in the results
+ *  @param list        The display list to render
+ *  @param width       The width of the page of the display list
+ *  @param height      The height of the page of the display list
+ *  @param maxSize     The largest size of the sweep to run, in points
+ *  @param screenScale The number of pixels per point
+ *  @param limits      The number of iterations of each case
+ *
+ *  @return 0 on success, -1 on allocation failure.
+ */
+int OHBenchmarkRunRasterizer(OHBenchmarkReport* report, const char* input, const OHDisplayList* list,
+                             float width, float height, double maxSize, double screenScale,
+                             OHBenchmarkLimits limits);
+
+/**
+ *  Runs the pixel kernels used to apply the options of a rendering (recolor,
+ *  fill under, shadow under, span blending, shadow blur and mipmap downsampling)
+ *  on buffers of every size of the sweep, and adds the results to a report.
+ *
+ *  @return 0 on success, -1 on allocation failure.
+ */
+int OHBenchmarkRunKernels(OHBenchmarkReport* report, double maxSize, double screenScale,
+                          OHBenchmarkLimits limits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
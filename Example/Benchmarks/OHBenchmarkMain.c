@@ -0,0 +1,135 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+/*
+ *  Headless benchmark of the portable rendering pieces of OHPDFImage
+ *  (OHRasterizer, OHPixelKernels and OHShadowBlur), writing its results as JSON
+ *  so that they can be compared across commits, e.g. on a Linux CI machine:
+ *
+ *      cc -std=c99 -O2 -I../../OHPDFImage -o OHBenchmark \
+ *         OHBenchmarkMain.c OHBenchmark.c ../../OHPDFImage/OHDisplayList.c \
+ *         ../../OHPDFImage/OHPixelKernels.c ../../OHPDFImage/OHShadowBlur.c \
+ *         ../../OHPDFImage/OHRasterizer.c ../../OHPDFImage/OHRenderStats.c -lm
+ *      ./OHBenchmark --output results.json
+ *
+ *  Options:
+ *      --output <file>    Write the JSON report to a file instead of stdout
+ *      --quick            Only sweep sizes up to 128pt, with fewer iterations
+ *      --max-size <pt>    Only sweep sizes up to this size (default 2048)
+ *      --scale <scale>    The number of pixels per point (default 1)
+ *      --seed <seed>      The seed of the generated path corpora (default 42)
+ *      --scalar           Use the scalar pixel kernels instead of the SIMD ones
+ *
+ *  Parsing PDF files needs CoreGraphics, so the demo PDFs are only benchmarked
+ *  by the iOS benchmarks of the UnitTests target (OHPDFImageBenchmarks.m).
+ *  This benchmark renders generated corpora of 100, 1000 and 10000 paths instead.
+ */
+
+#include "OHBenchmark.h"
+#include "OHPixelKernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+static const size_t kCorpusPathCounts[] = { 100, 1000, 10000 };
+static const float kCorpusPageSize = 100;
+
+static void OHPrintUsage(const char* program)
+{
+    fprintf(stderr, "usage: %s [--output <file>] [--quick] [--max-size <pt>] [--scale <scale>]"
+                    " [--seed <seed>] [--scalar]\n", program);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* outputPath = NULL;
+    double maxSize = 2048, screenScale = 1;
+    uint32_t seed = 42;
+    OHBenchmarkLimits limits = { 3, 1000, 100000000 };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const int hasValue = (i + 1 < argc);
+        if (!strcmp(argv[i], "--output") && hasValue) outputPath = argv[++i];
+        else if (!strcmp(argv[i], "--max-size") && hasValue) maxSize = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--scale") && hasValue) screenScale = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && hasValue) seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "--scalar")) OHPixelKernelsForceScalar(1);
+        else if (!strcmp(argv[i], "--quick"))
+        {
+            maxSize = 128;
+            limits = (OHBenchmarkLimits){ 3, 100, 10000000 };
+        }
+        else
+        {
+            OHPrintUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (screenScale <= 0)
+    {
+        OHPrintUsage(argv[0]);
+        return 2;
+    }
+
+    FILE* output = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!output)
+    {
+        perror(outputPath);
+        return 1;
+    }
+
+    int status = 0;
+    OHBenchmarkReport* report = OHBenchmarkReportCreate(output, "portable");
+    if (!report) status = -1;
+
+    for (size_t c = 0; c < sizeof(kCorpusPathCounts) / sizeof(kCorpusPathCounts[0]) && status == 0; ++c)
+    {
+        char input[32];
+        sprintf(input, "paths-%lu", (unsigned long)kCorpusPathCounts[c]);
+        fprintf(stderr, "Rendering %s…\n", input);
+        OHDisplayList* corpus = OHBenchmarkCreatePathCorpus(seed, kCorpusPathCounts[c], kCorpusPageSize, kCorpusPageSize);
+        if (!corpus)
+        {
+            status = -1;
+            break;
+        }
+        status = OHBenchmarkRunRasterizer(report, input, corpus, kCorpusPageSize, kCorpusPageSize,
+                                          maxSize, screenScale, limits);
+        OHDisplayListRelease(corpus);
+    }
+    if (status == 0)
+    {
+        fprintf(stderr, "Running the pixel kernels…\n");
+        status = OHBenchmarkRunKernels(report, maxSize, screenScale, limits);
+    }
+
+    if (report) OHBenchmarkReportFinish(report);
+    if (output != stdout) fclose(output);
+    if (status != 0) fprintf(stderr, "Out of memory\n");
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHDisplayList.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHPDFDisplayList.h
\ No newline at end of file
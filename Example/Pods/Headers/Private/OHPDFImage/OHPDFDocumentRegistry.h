@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHPDFDocumentRegistry.h
\ No newline at end of file
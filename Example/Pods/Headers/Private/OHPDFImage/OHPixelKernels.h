@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHPixelKernels.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHRasterizer.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHRenderCache.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHVectorPack.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHVectorPackFile.h
\ No newline at end of file
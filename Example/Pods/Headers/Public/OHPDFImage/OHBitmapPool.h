@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHBitmapPool.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHGlyphCache.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHPDFThumbnailAtlas.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHRenderQueue.h
\ No newline at end of file
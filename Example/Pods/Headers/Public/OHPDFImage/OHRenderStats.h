@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHRenderStats.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../../../../OHPDFImage/OHShadowBlur.h
\ No newline at end of file
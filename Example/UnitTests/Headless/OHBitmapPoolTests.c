@@ -0,0 +1,207 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+/*
+ *  Tests of OHBitmapPool: buffers are reused within their size class, come back
+ *  zeroed when asked to whatever was written to them before, and are freed
+ *  instead of pooled when the pool is over its budget.
+ */
+
+#include "OHHeadlessTests.h"
+#include "OHBitmapPool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+static const size_t kMegabyte = 1024 * 1024;
+
+/* Starts each test with an empty pool and its default budget */
+static void OHResetPool(void)
+{
+    OHBitmapPoolSetMaxRetainedBytes(16 * kMegabyte);
+    OHBitmapPoolTrim();
+    OHBitmapPoolResetStats();
+}
+
+static int OHIsZeroed(const uint8_t* bytes, size_t length, size_t* firstNonZero)
+{
+    for (size_t idx = 0; idx < length; ++idx)
+    {
+        if (bytes[idx] != 0)
+        {
+            *firstNonZero = idx;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// MARK: - Tests
+
+static void OHTestReuseBySizeClass(void)
+{
+    OHResetPool();
+    OHBitmapPoolStats stats;
+    
+    uint8_t* buffer = OHBitmapPoolAcquire(5000, 1);
+    if (!OHTestAssert(buffer != NULL, "Failed to acquire a buffer")) return;
+    OHTestAssert(((uintptr_t)buffer & 15) == 0, "Buffer not aligned on 16 bytes");
+    OHBitmapPoolRelease(buffer, 0, 5000);
+    OHBitmapPoolGetStats(&stats);
+    OHTestAssert(stats.retainedBuffers == 1 && stats.retainedBytes == 5120,
+                 "Released buffer not retained in its size class (%llu buffers, %llu bytes)",
+                 (unsigned long long)stats.retainedBuffers, (unsigned long long)stats.retainedBytes);
+    
+    // 5000 and 5100 bytes are both in the 5KB class
+    uint8_t* reused = OHBitmapPoolAcquire(5100, 1);
+    OHTestAssert(reused == buffer, "Buffer of the same size class not reused");
+    OHBitmapPoolGetStats(&stats);
+    OHTestAssert(stats.hits == 1 && stats.misses == 1 && stats.retainedBuffers == 0 && stats.retainedBytes == 0,
+                 "Wrong stats after reusing a buffer");
+    OHBitmapPoolRelease(reused, 0, 0);
+    
+    // 6000 bytes are in the 6KB class, and 1 byte in the smallest one
+    uint8_t* larger = OHBitmapPoolAcquire(6000, 1);
+    uint8_t* smaller = OHBitmapPoolAcquire(1, 1);
+    OHTestAssert(larger != buffer && smaller != buffer, "Buffer reused for another size class");
+    OHBitmapPoolGetStats(&stats);
+    OHTestAssert(stats.hits == 1 && stats.misses == 3, "Wrong stats after acquiring other size classes");
+    OHBitmapPoolRelease(larger, 0, 0);
+    OHBitmapPoolRelease(smaller, 0, 0);
+    
+    // The most recently released buffer of a class is reused first
+    uint8_t* first = OHBitmapPoolAcquire(6000, 0);
+    uint8_t* second = OHBitmapPoolAcquire(6000, 0);
+    OHBitmapPoolRelease(first, 0, 0);
+    OHBitmapPoolRelease(second, 0, 0);
+    OHTestAssert(OHBitmapPoolAcquire(6000, 0) == second, "Free list not reused in LIFO order");
+    OHBitmapPoolRelease(second, 0, 0);
+}
+
+static void OHTestZeroedReuse(void)
+{
+    OHResetPool();
+    const size_t size = 64 * 1024;
+    size_t firstNonZero = 0;
+    
+    // Only the dirty range was written to, and it is cleared when reused as a zeroed buffer
+    uint8_t* buffer = OHBitmapPoolAcquire(size, 1);
+    if (!OHTestAssert(buffer != NULL, "Failed to acquire a buffer")) return;
+    OHTestAssert(OHIsZeroed(buffer, size, &firstNonZero), "New buffer not zeroed (byte %zu)", firstNonZero);
+    memset(buffer + 1000, 0xAB, 3000);
+    OHBitmapPoolRelease(buffer, 1000, 3000);
+    buffer = OHBitmapPoolAcquire(size, 1);
+    OHTestAssert(OHIsZeroed(buffer, size, &firstNonZero), "Dirty range not cleared (byte %zu)", firstNonZero);
+    OHBitmapPoolRelease(buffer, 0, 0);
+    
+    // Dirty ranges of successive non-zeroed uses add up, inside and outside of each other
+    buffer = OHBitmapPoolAcquire(size, 0);
+    memset(buffer + 100, 0xCD, 200);
+    OHBitmapPoolRelease(buffer, 100, 200);
+    buffer = OHBitmapPoolAcquire(size, 0);
+    memset(buffer + 50000, 0xEF, 1000);
+    OHBitmapPoolRelease(buffer, 50000, 1000);
+    buffer = OHBitmapPoolAcquire(size, 0);
+    memset(buffer + 10, 0x12, 20);
+    OHBitmapPoolRelease(buffer, 10, 20);
+    buffer = OHBitmapPoolAcquire(size, 1);
+    OHTestAssert(OHIsZeroed(buffer, size, &firstNonZero), "Earlier dirty ranges not cleared (byte %zu)", firstNonZero);
+    
+    // A dirty length past the end of the buffer is clamped to it
+    memset(buffer, 0x34, size);
+    OHBitmapPoolRelease(buffer, 0, SIZE_MAX);
+    buffer = OHBitmapPoolAcquire(size, 1);
+    OHTestAssert(OHIsZeroed(buffer, size, &firstNonZero), "Whole buffer not cleared (byte %zu)", firstNonZero);
+    
+    // Bytes past the requested size, up to the capacity of the size class, are cleared too
+    OHBitmapPoolRelease(buffer, 0, 0);
+    buffer = OHBitmapPoolAcquire(size - 100, 0);
+    memset(buffer, 0x56, size);
+    OHBitmapPoolRelease(buffer, 0, size);
+    buffer = OHBitmapPoolAcquire(size - 50, 1);
+    OHTestAssert(OHIsZeroed(buffer, size, &firstNonZero), "Capacity not cleared (byte %zu)", firstNonZero);
+    OHBitmapPoolRelease(buffer, 0, 0);
+}
+
+static void OHTestBudget(void)
+{
+    OHResetPool();
+    OHBitmapPoolStats stats;
+    
+    // Over the budget, released buffers are freed instead of pooled
+    OHBitmapPoolSetMaxRetainedBytes(8192);
+    void* buffers[3];
+    for (int idx = 0; idx < 3; ++idx) buffers[idx] = OHBitmapPoolAcquire(4096, 0);
+    for (int idx = 0; idx < 3; ++idx) OHBitmapPoolRelease(buffers[idx], 0, 4096);
+    OHBitmapPoolGetStats(&stats);
+    OHTestAssert(stats.retainedBuffers == 2 && stats.retainedBytes == 8192 && stats.discardedBytes == 4096,
+                 "Budget not enforced (%llu buffers, %llu bytes retained, %llu discarded)",
+                 (unsigned long long)stats.retainedBuffers, (unsigned long long)stats.retainedBytes,
+                 (unsigned long long)stats.discardedBytes);
+    
+    // Lowering the budget trims the pool
+    OHBitmapPoolSetMaxRetainedBytes(4096);
+    OHBitmapPoolGetStats(&stats);
+    OHTestAssert(stats.retainedBuffers == 0 && stats.retainedBytes == 0 && stats.trimmedBytes == 8192,
+                 "Lowering the budget did not trim the pool");
+    
+    // A budget of 0 disables pooling
+    OHBitmapPoolSetMaxRetainedBytes(0);
+    OHBitmapPoolRelease(OHBitmapPoolAcquire(4096, 0), 0, 0);
+    OHBitmapPoolGetStats(&stats);
+    OHTestAssert(stats.retainedBuffers == 0 && stats.discardedBytes == 8192, "Buffer pooled with a budget of 0");
+    
+    // Buffers larger than the largest size class are never pooled
+    OHResetPool();
+    uint8_t* huge = OHBitmapPoolAcquire(17 * kMegabyte, 1);
+    if (OHTestAssert(huge != NULL, "Failed to acquire a huge buffer"))
+    {
+        size_t firstNonZero = 0;
+        OHTestAssert(OHIsZeroed(huge, 17 * kMegabyte, &firstNonZero), "Huge buffer not zeroed (byte %zu)", firstNonZero);
+        OHBitmapPoolRelease(huge, 0, 0);
+        OHBitmapPoolGetStats(&stats);
+        OHTestAssert(stats.retainedBuffers == 0 && stats.discardedBytes == 17 * kMegabyte, "Huge buffer pooled");
+    }
+    
+    // Trimming empties the pool, and the buffers acquired meanwhile can still be released
+    void* acquired = OHBitmapPoolAcquire(4096, 0);
+    OHBitmapPoolRelease(OHBitmapPoolAcquire(8192, 0), 0, 0);
+    OHBitmapPoolTrim();
+    OHBitmapPoolRelease(acquired, 0, 0);
+    OHBitmapPoolGetStats(&stats);
+    OHTestAssert(stats.retainedBuffers == 1 && stats.retainedBytes == 4096 && stats.trimmedBytes == 8192,
+                 "Wrong stats after trimming");
+    OHResetPool();
+}
+
+void OHBitmapPoolTestsRun(void)
+{
+    OHTestReuseBySizeClass();
+    OHTestZeroedReuse();
+    OHTestBudget();
+}
@@ -0,0 +1,231 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+/*
+ *  Tests of OHDisplayListBuilder: recorded content streams are fed to the builder
+ *  the way OHPDFDisplayList's scanner does, and the operations it emits are
+ *  compared with the expected ones, written as text.
+ */
+
+#include "OHHeadlessTests.h"
+#include "OHDisplayList.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+/**
+ *  Feeds a content stream to a builder: numbers are pushed as operands, names are
+ *  only used by `cs`/`CS` (for the device color spaces), and arrays only by `d`.
+ */
+static void OHApplyContentStream(OHDisplayListBuilder* builder, const char* stream)
+{
+    char* tokens = malloc(strlen(stream) + 1);
+    strcpy(tokens, stream);
+    
+    double operands[16], array[16];
+    size_t count = 0, arrayCount = 0;
+    int inArray = 0;
+    const char* name = NULL;
+    for (char* token = strtok(tokens, " \n"); token; token = strtok(NULL, " \n"))
+    {
+        char* end = NULL;
+        double number = strtod(token, &end);
+        if (end != token && *end == '\0')
+        {
+            if (inArray && arrayCount < 16) array[arrayCount++] = number;
+            else if (count < 16) operands[count++] = number;
+            continue;
+        }
+        if (token[0] == '/') { name = token + 1; continue; }
+        if (strcmp(token, "[") == 0) { inArray = 1; arrayCount = 0; continue; }
+        if (strcmp(token, "]") == 0) { inArray = 0; continue; }
+        
+        if (strcmp(token, "cs") == 0 || strcmp(token, "CS") == 0)
+        {
+            int components = !name ? 0
+                           : strcmp(name, "DeviceGray") == 0 ? 1
+                           : strcmp(name, "DeviceRGB") == 0 ? 3
+                           : strcmp(name, "DeviceCMYK") == 0 ? 4 : 0;
+            OHDisplayListBuilderSetColorSpace(builder, token[0] == 'C', components);
+        }
+        else if (strcmp(token, "d") == 0)
+        {
+            OHDisplayListBuilderSetDash(builder, array, arrayCount, count > 0 ? operands[0] : 0);
+        }
+        else
+        {
+            OHDisplayListBuilderApplyOperator(builder, token, operands, count);
+        }
+        count = 0;
+        name = NULL;
+    }
+    free(tokens);
+}
+
+typedef struct {
+    char text[4096];
+    size_t length;
+} OHOpsDescription;
+
+static void OHDescribeOp(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    OHOpsDescription* description = info;
+    size_t available = sizeof(description->text) - description->length;
+    int written = snprintf(description->text + description->length, available, "%s%s",
+                           description->length ? "; " : "", OHTestOpName(op));
+    for (size_t idx = 0; written > 0 && (size_t)written < available && idx < count; ++idx)
+    {
+        description->length += (size_t)written;
+        available -= (size_t)written;
+        written = snprintf(description->text + description->length, available, " %g", operands[idx]);
+    }
+    if (written > 0 && (size_t)written < available) description->length += (size_t)written;
+}
+
+/**
+ *  Compiles a content stream, and checks the emitted operations against `expected`,
+ *  or checks that the compilation fails if `expected` is NULL.
+ */
+static void OHAssertCompiles(const char* stream, const char* expected)
+{
+    OHDisplayListBuilder* builder = OHDisplayListBuilderCreate();
+    OHApplyContentStream(builder, stream);
+    OHDisplayList* list = OHDisplayListBuilderCopyDisplayList(builder);
+    OHDisplayListBuilderRelease(builder);
+    
+    if (!expected)
+    {
+        OHTestAssert(list == NULL, "\"%s\" should not compile", stream);
+    }
+    else if (OHTestAssert(list != NULL, "\"%s\" did not compile", stream))
+    {
+        OHOpsDescription description = { .length = 0 };
+        description.text[0] = '\0';
+        OHDisplayListApply(list, &description, OHDescribeOp);
+        OHTestAssert(strcmp(description.text, expected) == 0, "\"%s\"\n  compiled to: %s\n  expected:    %s",
+                     stream, description.text, expected);
+    }
+    OHDisplayListRelease(list);
+}
+
+// MARK: - Tests
+
+static void OHTestPaths(void)
+{
+    OHAssertCompiles("10 20 30 40 re f",
+                     "moveto 10 20; lineto 40 20; lineto 40 60; lineto 10 60; close; fill");
+    OHAssertCompiles("0 0 m 1 1 2 2 v 3 3 4 4 y 5 6 7 8 9 10 c h S",
+                     "moveto 0 0; curveto 0 0 1 1 2 2; curveto 3 3 4 4 4 4; curveto 5 6 7 8 9 10; close; stroke");
+    OHAssertCompiles("0 0 m 1 0 l 1 1 l b*",
+                     "moveto 0 0; lineto 1 0; lineto 1 1; close; eofillstroke");
+    OHAssertCompiles("0 0 m 1 0 l s 0 0 m 0 1 l B",
+                     "moveto 0 0; lineto 1 0; close; stroke; moveto 0 0; lineto 0 1; fillstroke");
+    // A path ended by n is not painted
+    OHAssertCompiles("0 0 m 1 0 l n 2 2 m 3 3 l f*", "moveto 2 2; lineto 3 3; eofill");
+}
+
+static void OHTestGraphicsState(void)
+{
+    OHAssertCompiles("q 2 0 0 2 5 5 cm 0 0 m 1 1 l S Q",
+                     "save; concat 2 0 0 2 5 5; moveto 0 0; lineto 1 1; stroke; restore");
+    OHAssertCompiles("2 w 1 J 2 j 4 M",
+                     "linewidth 2; linecap 1; linejoin 2; miterlimit 4");
+    // Unmatched q are balanced at the end, and extra Q are ignored
+    OHAssertCompiles("q q Q", "save; save; restore; restore");
+    OHAssertCompiles("Q q Q Q", "save; restore");
+    // Q restores the color space set within q
+    OHAssertCompiles("q 1 0 0 rg Q 0.5 sc", "save; fillcolor 1 0 0 1; restore; fillcolor 0.5 0.5 0.5 1");
+}
+
+static void OHTestClipping(void)
+{
+    // In PDF, W applies after the path is painted (or discarded by n)
+    OHAssertCompiles("0 0 10 10 re W n",
+                     "moveto 0 0; lineto 10 0; lineto 10 10; lineto 0 10; close; clip");
+    OHAssertCompiles("0 0 m 4 0 l 0 4 l W* f",
+                     "moveto 0 0; lineto 4 0; lineto 0 4; fill; moveto 0 0; lineto 4 0; lineto 0 4; eoclip");
+    OHAssertCompiles("q 0 0 m 1 1 l W n 0 0 m 2 2 l S Q",
+                     "save; moveto 0 0; lineto 1 1; clip; moveto 0 0; lineto 2 2; stroke; restore");
+}
+
+static void OHTestColors(void)
+{
+    OHAssertCompiles("0.5 g 0.25 G", "fillcolor 0.5 0.5 0.5 1; strokecolor 0.25 0.25 0.25 1");
+    OHAssertCompiles("1 0 0 rg 0 1 0 RG", "fillcolor 1 0 0 1; strokecolor 0 1 0 1");
+    OHAssertCompiles("0 0 0 0.5 k 1 0 0 0 K", "fillcolor 0.5 0.5 0.5 1; strokecolor 0 1 1 1");
+    // Selecting a color space resets the color to black
+    OHAssertCompiles("/DeviceRGB cs 0 0 1 sc /DeviceCMYK CS 0 1 1 0 SCN",
+                     "fillcolor 0 0 0 1; fillcolor 0 0 1 1; strokecolor 0 0 0 1; strokecolor 1 0 0 1");
+    OHAssertCompiles("/DeviceGray CS 0.75 SC", "strokecolor 0 0 0 1; strokecolor 0.75 0.75 0.75 1");
+    // The color operators set the color space used by sc/SC
+    OHAssertCompiles("/DeviceGray cs 1 0 0 rg 0 0 1 sc", "fillcolor 0 0 0 1; fillcolor 1 0 0 1; fillcolor 0 0 1 1");
+    OHAssertCompiles("1 0 0 RG 0 1 0 SC", "strokecolor 1 0 0 1; strokecolor 0 1 0 1");
+    OHAssertCompiles("0 0 0 1 k 0.5 0 0 0 sc", "fillcolor 0 0 0 1; fillcolor 0.5 1 1 1");
+    OHAssertCompiles("0 0 0 1 k 0.5 scn", NULL);
+    OHAssertCompiles("/Pattern cs 0.5 scn", NULL);
+    
+    // The constant alpha applies to the current and next colors
+    OHDisplayListBuilder* builder = OHDisplayListBuilderCreate();
+    OHApplyContentStream(builder, "1 0 0 rg");
+    OHDisplayListBuilderSetAlpha(builder, 0, 0.5);
+    OHApplyContentStream(builder, "0 0 1 rg");
+    OHDisplayList* list = OHDisplayListBuilderCopyDisplayList(builder);
+    OHDisplayListBuilderRelease(builder);
+    OHOpsDescription description = { .length = 0 };
+    description.text[0] = '\0';
+    if (list) OHDisplayListApply(list, &description, OHDescribeOp);
+    OHTestAssert(strcmp(description.text, "fillcolor 1 0 0 1; fillcolor 1 0 0 0.5; fillcolor 0 0 1 0.5") == 0,
+                 "constant alpha compiled to: %s", description.text);
+    OHDisplayListRelease(list);
+}
+
+static void OHTestDashes(void)
+{
+    OHAssertCompiles("[ 3 2 ] 1 d", "dash 2 1 3 2");
+    OHAssertCompiles("[ 1 2 3 ] 0.5 d [ ] 0 d", "dash 3 0.5 1 2 3; dash 0 0");
+}
+
+static void OHTestUnsupportedContent(void)
+{
+    OHAssertCompiles("BT ET", NULL);
+    OHAssertCompiles("1 0 rg", NULL);
+    OHAssertCompiles("0 0 m 1 1 l f /Im0 Do", NULL);
+}
+
+/***********************************************************************************/
+
+void OHDisplayListBuilderTestsRun(void)
+{
+    OHTestPaths();
+    OHTestGraphicsState();
+    OHTestClipping();
+    OHTestColors();
+    OHTestDashes();
+    OHTestUnsupportedContent();
+}
@@ -0,0 +1,162 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+/*
+ *  Headless tests of the portable rendering pieces of OHPDFImage, which need
+ *  no Apple framework and can run on any platform, e.g. on a Linux CI machine:
+ *
+ *      cc -std=c99 -O2 -I../../../OHPDFImage -o OHHeadlessTests \
+ *         OHHeadlessTests.c OHBitmapPoolTests.c OHDisplayListBuilderTests.c \
+ *         OHPixelKernelsTests.c OHRasterizerTests.c OHShadowBlurTests.c \
+ *         OHVectorPackFileTests.c ../../../OHPDFImage/OHBitmapPool.c \
+ *         ../../../OHPDFImage/OHDisplayList.c ../../../OHPDFImage/OHPixelKernels.c \
+ *         ../../../OHPDFImage/OHRasterizer.c ../../../OHPDFImage/OHRenderStats.c \
+ *         ../../../OHPDFImage/OHShadowBlur.c ../../../OHPDFImage/OHVectorPackFile.c -lm -lpthread
+ *      ./OHHeadlessTests
+ *
+ *  The process exits with a non-zero status if any test fails. The tests of
+ *  the renderings themselves (OHPDFImageTests.m) need CoreGraphics, and run
+ *  in the UnitTests target.
+ */
+
+#include "OHHeadlessTests.h"
+#include "OHPixelKernels.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+static unsigned sFailureCount = 0;
+
+int OHTestCheck(int passed, const char* file, int line, const char* format, ...)
+{
+    if (passed) return 1;
+    
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%s:%d: error: ", file, line);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+    ++sFailureCount;
+    return 0;
+}
+
+uint32_t OHTestRandom(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+void OHTestFillRandom(uint8_t* bytes, size_t count, uint32_t* state)
+{
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        bytes[idx] = (uint8_t)(OHTestRandom(state) >> 24);
+    }
+}
+
+static const char* const kOpNames[OHDisplayListOpCount] = {
+    "moveto", "lineto", "curveto", "close", "fill", "eofill", "stroke", "fillstroke", "eofillstroke",
+    "clip", "eoclip", "save", "restore", "concat", "fillcolor", "strokecolor",
+    "linewidth", "linecap", "linejoin", "miterlimit", "dash"
+};
+
+const char* OHTestOpName(OHDisplayListOp op)
+{
+    return op < OHDisplayListOpCount ? kOpNames[op] : "?";
+}
+
+OHDisplayList* OHTestCreateDisplayList(const char* description)
+{
+    char* tokens = malloc(strlen(description) + 1);
+    strcpy(tokens, description);
+    
+    OHDisplayList* list = OHDisplayListCreate();
+    float operands[32];
+    size_t count = 0;
+    int op = -1;
+    for (char* token = strtok(tokens, " ;"); ; token = strtok(NULL, " ;"))
+    {
+        char* end = NULL;
+        float number = token ? strtof(token, &end) : 0;
+        if (token && end != token && *end == '\0')
+        {
+            if (count < 32) operands[count++] = number;
+            continue;
+        }
+        if (op >= 0)
+        {
+            OHTestAssert(OHDisplayListAppend(list, (OHDisplayListOp)op, operands, count) == 0,
+                         "Invalid operands for %s in \"%s\"", kOpNames[op], description);
+        }
+        if (!token) break;
+        
+        op = -1;
+        count = 0;
+        for (int idx = 0; idx < OHDisplayListOpCount; ++idx)
+        {
+            if (strcmp(token, kOpNames[idx]) == 0) op = idx;
+        }
+        OHTestAssert(op >= 0, "Unknown operation %s in \"%s\"", token, description);
+    }
+    free(tokens);
+    return list;
+}
+
+/***********************************************************************************/
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} OHTestSuite;
+
+static const OHTestSuite kSuites[] = {
+    { "OHBitmapPool", OHBitmapPoolTestsRun },
+    { "OHDisplayListBuilder", OHDisplayListBuilderTestsRun },
+    { "OHPixelKernels", OHPixelKernelsTestsRun },
+    { "OHRasterizer", OHRasterizerTestsRun },
+    { "OHShadowBlur", OHShadowBlurTestsRun },
+    { "OHVectorPackFile", OHVectorPackFileTestsRun },
+};
+
+int main(void)
+{
+    printf("SIMD pixel kernels: %s\n", OHPixelKernelsImplementationName());
+    for (size_t idx = 0; idx < sizeof(kSuites) / sizeof(kSuites[0]); ++idx)
+    {
+        unsigned failuresBefore = sFailureCount;
+        kSuites[idx].run();
+        printf("%s: %s\n", kSuites[idx].name, sFailureCount == failuresBefore ? "passed" : "FAILED");
+    }
+    return sFailureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+#ifndef OHPDFImage_OHHeadlessTests_h
+#define OHPDFImage_OHHeadlessTests_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "OHDisplayList.h"
+
+/***********************************************************************************/
+
+/*
+ *  A minimal test harness for the portable (plain C) modules of OHPDFImage,
+ *  so that they can be tested on any platform, e.g. on a Linux CI machine.
+ *  See OHHeadlessTests.c for how to build and run the tests.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Records a failure, with a printf-style message, if `condition` is false.
+ */
+#define OHTestAssert(condition, ...) OHTestCheck((condition) != 0, __FILE__, __LINE__, __VA_ARGS__)
+
+/**
+ *  The implementation of `OHTestAssert`.
+ *
+ *  @return `passed`, so that a test can stop at its first failure.
+ */
+int OHTestCheck(int passed, const char* file, int line, const char* format, ...);
+
+/**
+ *  The next number of a xorshift32 generator, so that the test inputs
+ *  are the same on every platform.
+ */
+uint32_t OHTestRandom(uint32_t* state);
+
+/**
+ *  Fills a buffer with random bytes.
+ */
+void OHTestFillRandom(uint8_t* bytes, size_t count, uint32_t* state);
+
+/**
+ *  The name of a display list operation in the descriptions of display lists
+ *  (e.g. "moveto" or "fillcolor").
+ */
+const char* OHTestOpName(OHDisplayListOp op);
+
+/**
+ *  Creates a display list from its description, e.g. "moveto 0 0; lineto 1 1; stroke":
+ *  the operations, separated by semicolons, each followed by its operands.
+ */
+OHDisplayList* OHTestCreateDisplayList(const char* description);
+
+// MARK: - Test suites
+
+void OHBitmapPoolTestsRun(void);
+void OHDisplayListBuilderTestsRun(void);
+void OHPixelKernelsTestsRun(void);
+void OHRasterizerTestsRun(void);
+void OHShadowBlurTestsRun(void);
+void OHVectorPackFileTestsRun(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,366 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+/*
+ *  Tests of OHPixelKernels: every SIMD kernel must give bit-exact results with
+ *  its scalar implementation, whatever the width (so that the scalar tails of
+ *  the vector loops are exercised), the row padding and the alignment of the
+ *  buffers. A few known values also check the scalar implementation itself,
+ *  and the lookup tables of the scalar-only recoloring kernel.
+ */
+
+#include "OHHeadlessTests.h"
+#include "OHPixelKernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+/* Odd widths and widths around the 4, 8 and 16 pixels of the vector registers */
+static const size_t kWidths[] = { 1, 3, 4, 7, 8, 15, 16, 17, 31, 33, 63, 65, 100 };
+/* Extra bytes at the end of each row, which the kernels must leave untouched */
+static const size_t kRowPaddings[] = { 0, 4, 28 };
+static const size_t kHeight = 5;
+/* Offsets the pixels from the alignment of malloc, so that SIMD loads are unaligned */
+static const size_t kAlignmentOffset = 4;
+
+static const OHPixelColor kColor = { 200, 30, 99, 180 };
+
+/**
+ *  A buffer of random pixels, with random bytes in the padding of its rows.
+ */
+typedef struct {
+    uint8_t* allocation;
+    OHPixelBuffer buffer;
+    size_t length;
+} OHTestPixels;
+
+static OHTestPixels OHTestPixelsCreate(size_t width, size_t height, size_t rowPadding, uint32_t* state)
+{
+    OHTestPixels pixels = { .buffer = { .width = width, .height = height, .bytesPerRow = width * 4 + rowPadding } };
+    pixels.length = pixels.buffer.bytesPerRow * height;
+    pixels.allocation = malloc(pixels.length + kAlignmentOffset);
+    pixels.buffer.data = pixels.allocation + kAlignmentOffset;
+    OHTestFillRandom(pixels.buffer.data, pixels.length, state);
+    
+    // Make transparent and opaque pixels frequent, as they take shortcuts in some kernels
+    for (size_t y = 0; y < height; ++y)
+    {
+        uint8_t* px = pixels.buffer.data + y * pixels.buffer.bytesPerRow;
+        for (size_t x = 0; x < width; ++x, px += 4)
+        {
+            switch (OHTestRandom(state) % 4)
+            {
+                case 0: px[3] = 0; break;
+                case 1: px[3] = 255; break;
+                default: break;
+            }
+        }
+    }
+    return pixels;
+}
+
+static OHTestPixels OHTestPixelsCopy(OHTestPixels pixels)
+{
+    OHTestPixels copy = pixels;
+    copy.allocation = malloc(pixels.length + kAlignmentOffset);
+    copy.buffer.data = copy.allocation + kAlignmentOffset;
+    memcpy(copy.buffer.data, pixels.buffer.data, pixels.length);
+    return copy;
+}
+
+static void OHTestPixelsRelease(OHTestPixels pixels)
+{
+    free(pixels.allocation);
+}
+
+/**
+ *  Returns the index of the first byte that differs between two buffers
+ *  of the same geometry, or `pixels.length` if they are the same.
+ */
+static size_t OHTestPixelsFirstDifference(OHTestPixels pixels, OHTestPixels other)
+{
+    for (size_t idx = 0; idx < pixels.length; ++idx)
+    {
+        if (pixels.buffer.data[idx] != other.buffer.data[idx]) return idx;
+    }
+    return pixels.length;
+}
+
+// MARK: - Scalar vs. SIMD
+
+typedef void (*OHTestKernel)(OHPixelBuffer buffer, const void* info);
+
+/**
+ *  Runs a kernel on two copies of `input`, with the scalar and the SIMD implementations,
+ *  and checks that both give the same bytes and leave the padding of the rows untouched.
+ */
+static void OHAssertKernelMatchesScalar(const char* name, OHTestPixels input, OHTestKernel kernel, const void* info)
+{
+    OHTestPixels scalar = OHTestPixelsCopy(input);
+    OHTestPixels simd = OHTestPixelsCopy(input);
+    
+    OHPixelKernelsForceScalar(1);
+    kernel(scalar.buffer, info);
+    OHPixelKernelsForceScalar(0);
+    kernel(simd.buffer, info);
+    
+    const OHPixelBuffer buffer = input.buffer;
+    size_t difference = OHTestPixelsFirstDifference(scalar, simd);
+    OHTestAssert(difference == input.length,
+                 "%s: %s differs from scalar at byte %zu (width %zu, bytesPerRow %zu): %u != %u",
+                 name, OHPixelKernelsImplementationName(), difference, buffer.width, buffer.bytesPerRow,
+                 difference < input.length ? simd.buffer.data[difference] : 0,
+                 difference < input.length ? scalar.buffer.data[difference] : 0);
+    
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        size_t paddingStart = y * buffer.bytesPerRow + buffer.width * 4;
+        size_t paddingLength = buffer.bytesPerRow - buffer.width * 4;
+        if (!OHTestAssert(memcmp(simd.buffer.data + paddingStart, input.buffer.data + paddingStart, paddingLength) == 0,
+                          "%s: the padding of row %zu was overwritten (width %zu)", name, y, buffer.width)) break;
+    }
+    
+    OHTestPixelsRelease(scalar);
+    OHTestPixelsRelease(simd);
+}
+
+static void OHTestRecolor(OHPixelBuffer buffer, const void* info)
+{
+    OHPixelRecolor(buffer, *(const OHPixelColor*)info);
+}
+
+static void OHTestFillUnder(OHPixelBuffer buffer, const void* info)
+{
+    OHPixelFillUnder(buffer, *(const OHPixelColor*)info);
+}
+
+static void OHTestPremultiply(OHPixelBuffer buffer, const void* info)
+{
+    (void)info;
+    OHPixelPremultiply(buffer);
+}
+
+typedef struct {
+    const uint8_t* mask;
+    size_t maskBytesPerRow;
+    long offsetX, offsetY;
+    OHPixelColor color;
+} OHTestShadow;
+
+static void OHTestShadowUnder(OHPixelBuffer buffer, const void* info)
+{
+    const OHTestShadow* shadow = info;
+    OHPixelShadowUnder(buffer, shadow->mask, shadow->maskBytesPerRow, shadow->offsetX, shadow->offsetY, shadow->color);
+}
+
+static void OHTestBlendSpan(OHPixelBuffer buffer, const void* info)
+{
+    const uint8_t* coverage = info; // One coverage per pixel, buffer.width per row
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        OHPixelBlendSpan(buffer.data + y * buffer.bytesPerRow, coverage + y * buffer.width, buffer.width, kColor);
+    }
+}
+
+static void OHTestKernelsMatchScalar(void)
+{
+    uint32_t state = 42;
+    const OHPixelColor premultipliedColor = OHPixelColorPremultiply(kColor);
+    const OHPixelColor opaqueColor = { 12, 250, 128, 255 };
+    
+    for (size_t w = 0; w < sizeof(kWidths) / sizeof(kWidths[0]); ++w)
+    {
+        for (size_t p = 0; p < sizeof(kRowPaddings) / sizeof(kRowPaddings[0]); ++p)
+        {
+            const size_t width = kWidths[w];
+            OHTestPixels straight = OHTestPixelsCreate(width, kHeight, kRowPaddings[p], &state);
+            OHAssertKernelMatchesScalar("premultiply", straight, OHTestPremultiply, NULL);
+            
+            // The other kernels expect premultiplied pixels
+            OHTestPixels input = OHTestPixelsCopy(straight);
+            OHPixelKernelsForceScalar(1);
+            OHPixelPremultiply(input.buffer);
+            OHPixelKernelsForceScalar(0);
+            
+            OHAssertKernelMatchesScalar("recolor", input, OHTestRecolor, &premultipliedColor);
+            OHAssertKernelMatchesScalar("recolor (opaque)", input, OHTestRecolor, &opaqueColor);
+            OHAssertKernelMatchesScalar("fill under", input, OHTestFillUnder, &premultipliedColor);
+            OHAssertKernelMatchesScalar("fill under (opaque)", input, OHTestFillUnder, &opaqueColor);
+            
+            uint8_t* coverage = malloc(width * kHeight);
+            OHTestFillRandom(coverage, width * kHeight, &state);
+            for (size_t idx = 0; idx < width * kHeight; idx += 3) coverage[idx] = (idx % 2) ? 255 : 0;
+            OHAssertKernelMatchesScalar("blend span", input, OHTestBlendSpan, coverage);
+            free(coverage);
+            
+            // Shadows shifted in every direction, including entirely out of the buffer
+            const size_t maskBytesPerRow = width + kRowPaddings[p];
+            uint8_t* mask = malloc(maskBytesPerRow * kHeight);
+            OHTestFillRandom(mask, maskBytesPerRow * kHeight, &state);
+            const long offsets[] = { -(long)width - 1, -3, -1, 0, 1, 3, (long)width + 1 };
+            for (size_t ox = 0; ox < sizeof(offsets) / sizeof(offsets[0]); ++ox)
+            {
+                for (long oy = -2; oy <= 2; oy += 2)
+                {
+                    OHTestShadow shadow = { mask, maskBytesPerRow, offsets[ox], oy, premultipliedColor };
+                    OHAssertKernelMatchesScalar("shadow under", input, OHTestShadowUnder, &shadow);
+                }
+            }
+            free(mask);
+            
+            OHTestPixelsRelease(input);
+            OHTestPixelsRelease(straight);
+        }
+    }
+}
+
+static void OHTestDownsampleMatchesScalar(void)
+{
+    uint32_t state = 7;
+    const size_t sourceSizes[][2] = { { 1, 1 }, { 7, 5 }, { 17, 9 }, { 64, 64 }, { 101, 37 } };
+    // Destination sizes, as fractions of the source size: same size, integer and fractional factors
+    const double factors[][2] = { { 1, 1 }, { 0.5, 0.5 }, { 0.75, 0.4 }, { 0.33, 1 }, { 0, 0 } };
+    
+    for (size_t s = 0; s < sizeof(sourceSizes) / sizeof(sourceSizes[0]); ++s)
+    {
+        for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); ++f)
+        {
+            OHTestPixels source = OHTestPixelsCreate(sourceSizes[s][0], sourceSizes[s][1], 12, &state);
+            size_t width = (size_t)(sourceSizes[s][0] * factors[f][0]), height = (size_t)(sourceSizes[s][1] * factors[f][1]);
+            width = width ? width : 1;
+            height = height ? height : 1;
+            OHTestPixels scalar = OHTestPixelsCreate(width, height, 8, &state);
+            OHTestPixels simd = OHTestPixelsCopy(scalar);
+            
+            OHPixelKernelsForceScalar(1);
+            int scalarResult = OHPixelDownsample(source.buffer, scalar.buffer);
+            OHPixelKernelsForceScalar(0);
+            int simdResult = OHPixelDownsample(source.buffer, simd.buffer);
+            
+            OHTestAssert(scalarResult == 0 && simdResult == 0, "downsample: failed from %zux%zu to %zux%zu",
+                         source.buffer.width, source.buffer.height, width, height);
+            size_t difference = OHTestPixelsFirstDifference(scalar, simd);
+            OHTestAssert(difference == scalar.length, "downsample: %s differs from scalar at byte %zu (%zux%zu to %zux%zu)",
+                         OHPixelKernelsImplementationName(), difference,
+                         source.buffer.width, source.buffer.height, width, height);
+            
+            OHTestPixelsRelease(simd);
+            OHTestPixelsRelease(scalar);
+            OHTestPixelsRelease(source);
+        }
+    }
+}
+
+// MARK: - Known values
+
+static void OHTestKnownValues(void)
+{
+    const OHPixelColor color = OHPixelColorPremultiply(kColor);
+    OHTestAssert(color.r == 141 && color.g == 21 && color.b == 70 && color.a == 180,
+                 "premultiplied color: %u %u %u %u", color.r, color.g, color.b, color.a);
+    
+    // An opaque pixel, a transparent one and a half-transparent one
+    const uint8_t px[12] = { 10, 20, 30, 255,   0, 0, 0, 0,   64, 64, 64, 128 };
+    for (int forceScalar = 1; forceScalar >= 0; --forceScalar)
+    {
+        OHPixelKernelsForceScalar(forceScalar);
+        
+        uint8_t recolored[12];
+        memcpy(recolored, px, sizeof(px));
+        OHPixelRecolor((OHPixelBuffer){ recolored, 3, 1, sizeof(px) }, color);
+        OHTestAssert(memcmp(recolored, (uint8_t[]){ 141, 21, 70, 180,   0, 0, 0, 0,   71, 11, 35, 90 }, 12) == 0,
+                     "recolor (%s): %u %u %u %u", OHPixelKernelsImplementationName(),
+                     recolored[8], recolored[9], recolored[10], recolored[11]);
+        
+        uint8_t filled[12];
+        memcpy(filled, px, sizeof(px));
+        OHPixelFillUnder((OHPixelBuffer){ filled, 3, 1, sizeof(px) }, (OHPixelColor){ 255, 255, 255, 255 });
+        OHTestAssert(memcmp(filled, (uint8_t[]){ 10, 20, 30, 255,   255, 255, 255, 255,   191, 191, 191, 255 }, 12) == 0,
+                     "fill under (%s): %u %u %u %u", OHPixelKernelsImplementationName(),
+                     filled[8], filled[9], filled[10], filled[11]);
+        
+        uint8_t blended[12];
+        memcpy(blended, px, sizeof(px));
+        OHPixelBlendSpan(blended, (const uint8_t[]){ 0, 255, 255 }, 3, (OHPixelColor){ 0, 0, 255, 255 });
+        OHTestAssert(memcmp(blended, (uint8_t[]){ 10, 20, 30, 255,   0, 0, 255, 255,   0, 0, 255, 255 }, 12) == 0,
+                     "blend span (%s)", OHPixelKernelsImplementationName());
+    }
+    
+    // A uniform source must stay uniform whatever the downsampling factor
+    uint8_t source[9 * 7 * 4], destination[4 * 3 * 4];
+    for (size_t idx = 0; idx < sizeof(source); ++idx) source[idx] = (uint8_t)(idx % 4 == 3 ? 200 : 100 + idx % 4);
+    OHPixelDownsample((OHPixelBuffer){ source, 9, 7, 9 * 4 }, (OHPixelBuffer){ destination, 4, 3, 4 * 4 });
+    for (size_t idx = 0; idx < sizeof(destination); ++idx)
+    {
+        if (!OHTestAssert(destination[idx] == source[idx % 4], "downsample of a uniform buffer: byte %zu is %u",
+                          idx, destination[idx])) break;
+    }
+}
+
+// MARK: - Recoloring with a lookup table
+
+static void OHTestRecolorWithLookupTable(void)
+{
+    OHPixelColor table[OH_PIXEL_RECOLOR_TABLE_SIZE];
+    OHTestAssert(OHPixelLookupTableFromColorMap(NULL, NULL, 0, table) == -1, "empty color map");
+    OHTestAssert(OHPixelRecolorTableIndex((OHPixelColor){ 0, 0, 0, 255 }) == 0, "index of black");
+    OHTestAssert(OHPixelRecolorTableIndex((OHPixelColor){ 255, 255, 255, 0 }) == OH_PIXEL_RECOLOR_TABLE_SIZE - 1,
+                 "index of white");
+    
+    // Red and this gray have the same luminance, but must still take their own targets
+    const OHPixelColor sources[2] = { { 255, 0, 0, 255 }, { 77, 77, 77, 255 } };
+    const OHPixelColor targets[2] = { { 0, 0, 255, 255 }, { 255, 255, 0, 255 } };
+    OHTestAssert(OHPixelLookupTableFromColorMap(sources, targets, 2, table) == 0, "color map");
+    
+    // Opaque red, opaque gray, half-transparent red, transparent, and the blend of red and gray
+    uint8_t px[20] = { 255, 0, 0, 255,   77, 77, 77, 255,   128, 0, 0, 128,   0, 0, 0, 0,   166, 38, 38, 255 };
+    OHPixelRecolorWithLookupTable((OHPixelBuffer){ px, 5, 1, sizeof(px) }, table);
+    OHTestAssert(memcmp(px, (uint8_t[]){ 0, 0, 255, 255,   255, 255, 0, 255,   0, 0, 128, 128,   0, 0, 0, 0 }, 16) == 0,
+                 "recolor with lookup table: %u %u %u %u / %u %u %u %u", px[0], px[1], px[2], px[3], px[4], px[5], px[6], px[7]);
+    OHTestAssert(px[16] > 96 && px[16] < 160 && px[17] > 96 && px[17] < 160 && px[18] > 96 && px[18] < 160 && px[19] == 255,
+                 "edge between two sources: %u %u %u %u", px[16], px[17], px[18], px[19]);
+    
+    // A single source maps every color to its target, whose alpha scales the coverage
+    const OHPixelColor target = { 0, 255, 0, 128 };
+    OHPixelLookupTableFromColorMap(sources, &target, 1, table);
+    uint8_t white[4] = { 255, 255, 255, 255 };
+    OHPixelRecolorWithLookupTable((OHPixelBuffer){ white, 1, 1, 4 }, table);
+    OHTestAssert(memcmp(white, (uint8_t[]){ 0, 128, 0, 128 }, 4) == 0, "single source: %u %u %u %u",
+                 white[0], white[1], white[2], white[3]);
+}
+
+/***********************************************************************************/
+
+void OHPixelKernelsTestsRun(void)
+{
+    OHTestKnownValues();
+    OHTestRecolorWithLookupTable();
+    OHTestKernelsMatchScalar();
+    OHTestDownsampleMatchesScalar();
+    OHPixelKernelsForceScalar(0);
+}
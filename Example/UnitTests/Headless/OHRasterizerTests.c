@@ -0,0 +1,408 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+/*
+ *  Tests of OHRasterizer: fill rules, stroke caps, joins and dashes, clipping,
+ *  content bounds, and the tint, shadow, background and trimming of whole pages.
+ *  Display lists are written as text (see OHTestCreateDisplayList).
+ */
+
+#include "OHHeadlessTests.h"
+#include "OHRasterizer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+/* User space is the pixel space of the buffers (y pointing down), unless stated otherwise */
+static const double kIdentity[6] = { 1, 0, 0, 1, 0, 0 };
+
+typedef struct {
+    uint8_t data[32 * 32];
+    OHRasterBuffer buffer;
+} OHTestMask;
+
+/**
+ *  Rasterizes a display list into a cleared A8 buffer of `width` x `height` pixels (at most 32 x 32).
+ */
+static void OHDrawMask(OHTestMask* mask, size_t width, size_t height, const char* description,
+                       const OHRasterRect* clipRect)
+{
+    memset(mask->data, 0, sizeof(mask->data));
+    mask->buffer = (OHRasterBuffer){ mask->data, width, height, width, OHRasterFormatA8 };
+    OHDisplayList* list = OHTestCreateDisplayList(description);
+    OHTestAssert(OHRasterDrawDisplayList(mask->buffer, list, kIdentity, clipRect) == 0,
+                 "Failed to draw \"%s\"", description);
+    OHDisplayListRelease(list);
+}
+
+static uint8_t OHCoverage(const OHTestMask* mask, size_t x, size_t y)
+{
+    return mask->data[y * mask->buffer.bytesPerRow + x];
+}
+
+/* Antialiasing may round a full or empty coverage by a step or two */
+static int OHIsCovered(uint8_t coverage) { return coverage >= 253; }
+static int OHIsEmpty(uint8_t coverage) { return coverage <= 2; }
+static int OHIsPartial(uint8_t coverage) { return coverage > 16 && coverage < 239; }
+
+static void OHAssertBounds(const char* description, const OHRasterRect* clipRect, OHRasterRect expected)
+{
+    OHDisplayList* list = OHTestCreateDisplayList(description);
+    OHRasterRect bounds = { 0, 0, 0, 0 };
+    if (OHTestAssert(OHRasterGetContentBounds(list, clipRect, &bounds) == 1, "\"%s\" has no content", description))
+    {
+        // The bounds are outset by the flattening tolerance
+        static const float kTolerance = 0.01f;
+        OHTestAssert(fabsf(bounds.x - expected.x) < kTolerance && fabsf(bounds.y - expected.y) < kTolerance
+                     && fabsf(bounds.width - expected.width) < kTolerance
+                     && fabsf(bounds.height - expected.height) < kTolerance,
+                     "\"%s\" measured { %g, %g, %g, %g }, expected { %g, %g, %g, %g }", description,
+                     bounds.x, bounds.y, bounds.width, bounds.height,
+                     expected.x, expected.y, expected.width, expected.height);
+    }
+    OHDisplayListRelease(list);
+}
+
+// MARK: - Tests
+
+static void OHTestFillRules(void)
+{
+    // Two squares wound the same way: the inner one is filled with nonzero, a hole with even-odd
+    static const char* const kNested = "moveto 2 2; lineto 18 2; lineto 18 18; lineto 2 18; close; "
+                                       "moveto 6 6; lineto 14 6; lineto 14 14; lineto 6 14; close; ";
+    char description[256];
+    OHTestMask mask;
+    
+    snprintf(description, sizeof(description), "%sfill", kNested);
+    OHDrawMask(&mask, 20, 20, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 4, 4)), "Nonzero fill: ring not covered");
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 10, 10)), "Nonzero fill: inner square not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 0, 0)), "Nonzero fill: drew outside of the path");
+    
+    snprintf(description, sizeof(description), "%seofill", kNested);
+    OHDrawMask(&mask, 20, 20, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 4, 4)), "Even-odd fill: ring not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 10, 10)), "Even-odd fill: inner square not a hole");
+    
+    // Wound the other way, the inner square is a hole with both rules
+    OHDrawMask(&mask, 20, 20, "moveto 2 2; lineto 18 2; lineto 18 18; lineto 2 18; close; "
+                              "moveto 6 6; lineto 6 14; lineto 14 14; lineto 14 6; close; fill", NULL);
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 10, 10)), "Nonzero fill: reversed inner square not a hole");
+    
+    // The alpha of the fill color is the coverage of A8 buffers
+    OHDrawMask(&mask, 20, 20, "fillcolor 1 0 0 0.5; moveto 2 2; lineto 18 2; lineto 18 18; lineto 2 18; fill", NULL);
+    OHTestAssert(abs((int)OHCoverage(&mask, 10, 10) - 128) <= 1, "Half transparent fill: coverage %u",
+                 OHCoverage(&mask, 10, 10));
+}
+
+static void OHTestStrokeCaps(void)
+{
+    // A 4 pixels wide horizontal line from x = 5 to 15, covering y = 4 to 8
+    static const char* const kLine = "linewidth 4; moveto 5 6; lineto 15 6; stroke";
+    char description[128];
+    OHTestMask mask;
+    
+    snprintf(description, sizeof(description), "linecap 0; %s", kLine);
+    OHDrawMask(&mask, 20, 12, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 5, 5)) && OHIsCovered(OHCoverage(&mask, 14, 7)), "Butt cap: line not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 4, 5)) && OHIsEmpty(OHCoverage(&mask, 15, 5)), "Butt cap: drew past the ends");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 10, 3)) && OHIsEmpty(OHCoverage(&mask, 10, 8)), "Butt cap: line too wide");
+    
+    // Square caps extend the line by half its width
+    snprintf(description, sizeof(description), "linecap 2; %s", kLine);
+    OHDrawMask(&mask, 20, 12, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 3, 4)) && OHIsCovered(OHCoverage(&mask, 16, 7)), "Square cap: ends not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 2, 5)) && OHIsEmpty(OHCoverage(&mask, 17, 5)), "Square cap: drew past the cap");
+    
+    // Round caps are half circles of radius 2 around the ends
+    snprintf(description, sizeof(description), "linecap 1; %s", kLine);
+    OHDrawMask(&mask, 20, 12, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 4, 5)) && OHIsCovered(OHCoverage(&mask, 15, 6)), "Round cap: ends not covered");
+    OHTestAssert(OHIsPartial(OHCoverage(&mask, 3, 4)) && OHIsPartial(OHCoverage(&mask, 16, 7)),
+                 "Round cap: corners not partially covered (%u, %u)", OHCoverage(&mask, 3, 4), OHCoverage(&mask, 16, 7));
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 2, 5)), "Round cap: drew past the cap");
+}
+
+static void OHTestStrokeJoins(void)
+{
+    // A right angle whose outer corner is at (18, 18)
+    static const char* const kCorner = "linewidth 4; moveto 4 16; lineto 16 16; lineto 16 4; stroke";
+    char description[128];
+    OHTestMask mask;
+    
+    snprintf(description, sizeof(description), "linejoin 0; %s", kCorner);
+    OHDrawMask(&mask, 22, 22, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 17, 17)), "Miter join: corner not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 18, 18)), "Miter join: drew past the corner");
+    
+    // Below the miter limit, miter joins are drawn as bevels
+    snprintf(description, sizeof(description), "linejoin 0; miterlimit 1.2; %s", kCorner);
+    OHDrawMask(&mask, 22, 22, description, NULL);
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 17, 17)), "Miter join: miter limit not applied");
+    
+    // The bevel cuts the corner along x + y = 34
+    snprintf(description, sizeof(description), "linejoin 2; %s", kCorner);
+    OHDrawMask(&mask, 22, 22, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 16, 16)), "Bevel join: join not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 17, 17)), "Bevel join: corner covered");
+    OHTestAssert(OHIsPartial(OHCoverage(&mask, 17, 16)), "Bevel join: edge not antialiased (%u)", OHCoverage(&mask, 17, 16));
+    
+    // The round join is a circle of radius 2 around (16, 16)
+    snprintf(description, sizeof(description), "linejoin 1; %s", kCorner);
+    OHDrawMask(&mask, 22, 22, description, NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 16, 16)), "Round join: join not covered");
+    OHTestAssert(OHIsPartial(OHCoverage(&mask, 17, 17)), "Round join: corner not partially covered (%u)",
+                 OHCoverage(&mask, 17, 17));
+}
+
+static void OHTestStrokeDashes(void)
+{
+    // A 2 pixels wide line covering the rows 1 and 2, on for 4 pixels then off for 4
+    OHTestMask mask;
+    OHDrawMask(&mask, 24, 4, "linewidth 2; dash 1 0 4; moveto 0 2; lineto 24 2; stroke", NULL);
+    for (size_t x = 0; x < 24; ++x)
+    {
+        int on = (x / 4) % 2 == 0;
+        uint8_t coverage = OHCoverage(&mask, x, 1);
+        OHTestAssert(on ? OHIsCovered(coverage) : OHIsEmpty(coverage), "Dash [4]: pixel %zu is %u", x, coverage);
+    }
+    
+    // The phase shifts the pattern, and the lengths alternate between on and off
+    OHDrawMask(&mask, 24, 4, "linewidth 2; dash 2 2 4 2; moveto 0 2; lineto 24 2; stroke", NULL);
+    static const int kOn[24] = { 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 1 };
+    for (size_t x = 0; x < 24; ++x)
+    {
+        uint8_t coverage = OHCoverage(&mask, x, 2);
+        OHTestAssert(kOn[x] ? OHIsCovered(coverage) : OHIsEmpty(coverage), "Dash [4 2] 2: pixel %zu is %u", x, coverage);
+    }
+}
+
+static void OHTestClipping(void)
+{
+    static const char* const kFillAll = "moveto 0 0; lineto 20 0; lineto 20 20; lineto 0 20; fill";
+    OHTestMask mask;
+    
+    OHRasterRect clipRect = { 5, 5, 10, 10 };
+    OHDrawMask(&mask, 20, 20, kFillAll, &clipRect);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 5, 5)) && OHIsCovered(OHCoverage(&mask, 14, 14)), "Clip rect: inside not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 4, 10)) && OHIsEmpty(OHCoverage(&mask, 15, 10))
+                 && OHIsEmpty(OHCoverage(&mask, 10, 4)) && OHIsEmpty(OHCoverage(&mask, 10, 15)), "Clip rect: drew outside");
+    
+    // Clipping paths intersect with the clip rect, and end with their graphics state
+    OHDrawMask(&mask, 20, 20, "save; moveto 0 0; lineto 10 0; lineto 10 20; lineto 0 20; clip; "
+                              "moveto 0 0; lineto 20 0; lineto 20 20; lineto 0 20; fill; restore; "
+                              "moveto 0 0; lineto 20 0; lineto 20 2; lineto 0 2; fill", &clipRect);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 7, 7)), "Clip path: inside not covered");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 12, 7)), "Clip path: drew outside");
+    OHTestAssert(OHIsEmpty(OHCoverage(&mask, 7, 1)), "Clip path: clip rect not applied");
+    
+    // A clipping path made of several subpaths, with the even-odd rule
+    OHDrawMask(&mask, 20, 20, "moveto 0 0; lineto 20 0; lineto 20 20; lineto 0 20; close; "
+                              "moveto 5 5; lineto 15 5; lineto 15 15; lineto 5 15; close; eoclip; "
+                              "moveto 0 0; lineto 20 0; lineto 20 20; lineto 0 20; fill", NULL);
+    OHTestAssert(OHIsCovered(OHCoverage(&mask, 2, 2)) && OHIsEmpty(OHCoverage(&mask, 10, 10)), "Even-odd clip path: wrong coverage");
+}
+
+static void OHTestContentBounds(void)
+{
+    OHAssertBounds("moveto 2 3; lineto 12 3; lineto 12 8; lineto 2 8; fill", NULL, (OHRasterRect){ 2, 3, 10, 5 });
+    // Strokes include half their width, and their caps
+    OHAssertBounds("linewidth 2; moveto 0 0; lineto 10 0; stroke", NULL, (OHRasterRect){ 0, -1, 10, 2 });
+    OHAssertBounds("linewidth 2; linecap 2; moveto 0 0; lineto 10 0; stroke", NULL, (OHRasterRect){ -1, -1, 12, 2 });
+    // Only the painted dashes count
+    OHAssertBounds("linewidth 2; dash 2 0 3 100; moveto 0 0; lineto 10 0; stroke", NULL, (OHRasterRect){ 0, -1, 3, 2 });
+    // The content is clipped by the clip rect and the clipping paths
+    OHRasterRect clipRect = { 5, 5, 10, 10 };
+    OHAssertBounds("moveto 0 0; lineto 10 0; lineto 10 10; lineto 0 10; fill", &clipRect, (OHRasterRect){ 5, 5, 5, 5 });
+    OHAssertBounds("moveto 0 0; lineto 4 0; lineto 4 4; lineto 0 4; clip; "
+                   "moveto 2 2; lineto 10 2; lineto 10 10; lineto 2 10; fill", NULL, (OHRasterRect){ 2, 2, 2, 2 });
+    // Transparent paints are not content
+    OHAssertBounds("fillcolor 0 0 0 0; moveto 20 20; lineto 30 20; lineto 30 30; fill; "
+                   "fillcolor 0 0 0 1; moveto 0 0; lineto 1 0; lineto 1 1; fill", NULL, (OHRasterRect){ 0, 0, 1, 1 });
+    
+    static const char* const kEmptyLists[] = {
+        "",
+        "moveto 0 0; lineto 10 0; lineto 10 10",
+        "fillcolor 1 0 0 0; moveto 0 0; lineto 10 0; lineto 10 10; fill",
+        "moveto 0 0; lineto 10 0; lineto 10 10; fill; moveto 0 0; lineto 5 0; lineto 5 5; stroke",
+    };
+    clipRect = (OHRasterRect){ 20, 20, 10, 10 };
+    for (size_t idx = 0; idx < sizeof(kEmptyLists) / sizeof(kEmptyLists[0]); ++idx)
+    {
+        OHDisplayList* list = OHTestCreateDisplayList(kEmptyLists[idx]);
+        OHRasterRect bounds = { 1, 2, 3, 4 };
+        OHTestAssert(OHRasterGetContentBounds(list, idx == 3 ? &clipRect : NULL, &bounds) == 0,
+                     "\"%s\" should have no content", kEmptyLists[idx]);
+        OHTestAssert(bounds.x == 1 && bounds.y == 2 && bounds.width == 3 && bounds.height == 4,
+                     "\"%s\" changed the bounds", kEmptyLists[idx]);
+        OHDisplayListRelease(list);
+    }
+}
+
+// MARK: - Rendering pages
+
+typedef struct {
+    uint8_t data[32 * 32 * 4];
+    OHRasterBuffer buffer;
+} OHTestImage;
+
+/* A 20 x 20 page, with a red square in its middle (from 5 to 15 on both axes) */
+static const char* const kRedSquarePage = "fillcolor 1 0 0 1; moveto 5 5; lineto 15 5; lineto 15 15; lineto 5 15; fill";
+
+static void OHRenderRedSquarePage(OHTestImage* image, const OHRasterOptions* options, OHRasterFormat format)
+{
+    OHDisplayList* list = OHTestCreateDisplayList(kRedSquarePage);
+    OHRasterPage page = { list, { 0, 0, 20, 20 }, { 0, 0, 20, 20 } };
+    size_t width = 0, height = 0;
+    OHTestAssert(OHRasterGetImageSize(&page, options, &width, &height) == 0 && width <= 32 && height <= 32,
+                 "Unexpected image size %zu x %zu", width, height);
+    
+    size_t bytesPerPixel = format == OHRasterFormatRGBA8 ? 4 : 1;
+    memset(image->data, 0xAB, sizeof(image->data));
+    image->buffer = (OHRasterBuffer){ image->data, width, height, width * bytesPerPixel, format };
+    OHTestAssert(OHRasterRenderPage(&page, options, image->buffer) == 0, "Failed to render the page");
+    OHDisplayListRelease(list);
+}
+
+static int OHPixelEquals(const OHTestImage* image, size_t x, size_t y, OHPixelColor expected)
+{
+    const uint8_t* pixel = image->data + y * image->buffer.bytesPerRow + x * 4;
+    int passed = abs(pixel[0] - expected.r) <= 1 && abs(pixel[1] - expected.g) <= 1
+              && abs(pixel[2] - expected.b) <= 1 && abs(pixel[3] - expected.a) <= 1;
+    return OHTestAssert(passed, "Pixel (%zu, %zu) is { %u, %u, %u, %u }, expected { %u, %u, %u, %u }", x, y,
+                        pixel[0], pixel[1], pixel[2], pixel[3], expected.r, expected.g, expected.b, expected.a);
+}
+
+static void OHTestRenderPage(void)
+{
+    static const OHPixelColor kClear = { 0, 0, 0, 0 }, kRed = { 255, 0, 0, 255 }, kBlack = { 0, 0, 0, 255 };
+    OHTestImage image;
+    OHRasterOptions options = { .width = 20, .height = 20, .screenScale = 1 };
+    
+    // The page is flipped, so the square covers the same rows and columns, and the buffer is cleared
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatRGBA8);
+    OHTestAssert(image.buffer.width == 20 && image.buffer.height == 20, "Wrong image size");
+    OHPixelEquals(&image, 5, 5, kRed);
+    OHPixelEquals(&image, 14, 14, kRed);
+    OHPixelEquals(&image, 4, 10, kClear);
+    OHPixelEquals(&image, 19, 19, kClear);
+    
+    // The tint replaces the colors, keeping the alpha, and is premultiplied in the buffer
+    OHPixelColor tintColor = { 0, 0, 255, 128 };
+    options.tintColor = &tintColor;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatRGBA8);
+    OHPixelEquals(&image, 10, 10, (OHPixelColor){ 0, 0, 128, 128 });
+    OHPixelEquals(&image, 2, 2, kClear);
+    options.tintColor = NULL;
+    
+    // The shadow is drawn under the page, offset down and to the right
+    options.shadowColor = &kBlack;
+    options.shadowOffsetX = 3;
+    options.shadowOffsetY = 2;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatRGBA8);
+    OHPixelEquals(&image, 10, 10, kRed);
+    OHPixelEquals(&image, 16, 16, kBlack);
+    OHPixelEquals(&image, 17, 7, kBlack);
+    OHPixelEquals(&image, 17, 6, kClear);
+    OHPixelEquals(&image, 6, 16, kClear);
+    OHPixelEquals(&image, 18, 16, kClear);
+    OHPixelEquals(&image, 16, 17, kClear);
+    
+    // A blurred shadow fades out over its radius
+    options.shadowBlurRadius = 4;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatRGBA8);
+    const uint8_t* edge = image.data + 12 * image.buffer.bytesPerRow + 18 * 4;
+    OHTestAssert(edge[3] > 0 && edge[3] < 255 && edge[0] == 0, "Blurred shadow: edge pixel alpha %u", edge[3]);
+    options.shadowColor = NULL;
+    options.shadowBlurRadius = 0;
+    
+    // The background is drawn under everything
+    OHPixelColor backgroundColor = { 0, 255, 0, 255 };
+    options.backgroundColor = &backgroundColor;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatRGBA8);
+    OHPixelEquals(&image, 10, 10, kRed);
+    OHPixelEquals(&image, 2, 2, backgroundColor);
+    options.backgroundColor = NULL;
+    
+    // The insets are in the unit of the page, around it
+    options.insetLeft = options.insetRight = options.insetTop = options.insetBottom = 5;
+    options.width = options.height = 30;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatRGBA8);
+    OHTestAssert(image.buffer.width == 30 && image.buffer.height == 30, "Insets: wrong image size");
+    OHPixelEquals(&image, 9, 15, kClear);
+    OHPixelEquals(&image, 10, 10, kRed);
+    OHPixelEquals(&image, 19, 19, kRed);
+    OHPixelEquals(&image, 20, 15, kClear);
+    options.insetLeft = options.insetRight = options.insetTop = options.insetBottom = 0;
+    
+    // Trimmed to its content, the square fills the whole image
+    options.trimToContent = 1;
+    options.width = options.height = 8;
+    options.screenScale = 2;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatRGBA8);
+    OHTestAssert(image.buffer.width == 16 && image.buffer.height == 16, "Trimmed: wrong image size");
+    OHPixelEquals(&image, 0, 0, kRed);
+    OHPixelEquals(&image, 15, 15, kRed);
+}
+
+static void OHTestRenderPageA8(void)
+{
+    static const OHPixelColor kBlack = { 0, 0, 0, 255 };
+    OHTestImage image;
+    OHRasterOptions options = { .width = 20, .height = 20, .screenScale = 1 };
+    
+    // Only the alpha of the tint is used, and the background is ignored
+    OHPixelColor tintColor = { 0, 0, 255, 128 }, backgroundColor = { 0, 255, 0, 255 };
+    options.tintColor = &tintColor;
+    options.backgroundColor = &backgroundColor;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatA8);
+    OHTestAssert(image.data[10 * 20 + 10] == 128, "A8 tint: coverage %u", image.data[10 * 20 + 10]);
+    OHTestAssert(image.data[2 * 20 + 2] == 0, "A8 background: coverage %u", image.data[2 * 20 + 2]);
+    
+    // The shadow is tinted too
+    options.shadowColor = &kBlack;
+    options.shadowOffsetX = 3;
+    options.shadowOffsetY = 2;
+    OHRenderRedSquarePage(&image, &options, OHRasterFormatA8);
+    OHTestAssert(image.data[16 * 20 + 16] == 128, "A8 shadow: coverage %u", image.data[16 * 20 + 16]);
+    OHTestAssert(image.data[16 * 20 + 6] == 0, "A8 shadow: coverage %u", image.data[16 * 20 + 6]);
+}
+
+void OHRasterizerTestsRun(void)
+{
+    OHTestFillRules();
+    OHTestStrokeCaps();
+    OHTestStrokeJoins();
+    OHTestStrokeDashes();
+    OHTestClipping();
+    OHTestContentBounds();
+    OHTestRenderPage();
+    OHTestRenderPageA8();
+}
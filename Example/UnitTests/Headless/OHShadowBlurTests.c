@@ -0,0 +1,212 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+/*
+ *  Tests of OHShadowBlur: the three box blurs must stay close to the Gaussian
+ *  blur they approximate, including on masks smaller than the blur itself.
+ */
+
+#include "OHHeadlessTests.h"
+#include "OHShadowBlur.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+/**
+ *  Blurs a mask with a true Gaussian of standard deviation `blurRadius / 2`,
+ *  treating the pixels outside of the mask as transparent like OHAlphaMaskBlur.
+ */
+static double* OHCreateGaussianReference(const uint8_t* mask, size_t width, size_t height, double blurRadius)
+{
+    const double sigma = blurRadius / 2;
+    const long extent = (long)ceil(4 * sigma);
+    double* kernel = malloc((size_t)(2 * extent + 1) * sizeof(double));
+    double* rows = malloc(width * height * sizeof(double));
+    double* reference = malloc(width * height * sizeof(double));
+    
+    double total = 0;
+    for (long i = -extent; i <= extent; ++i) total += kernel[i + extent] = exp(-(double)(i * i) / (2 * sigma * sigma));
+    for (long i = -extent; i <= extent; ++i) kernel[i + extent] /= total;
+    
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            double sum = 0;
+            for (long i = -extent; i <= extent; ++i)
+            {
+                long sx = (long)x + i;
+                if (sx >= 0 && sx < (long)width) sum += kernel[i + extent] * mask[y * width + (size_t)sx];
+            }
+            rows[y * width + x] = sum;
+        }
+    }
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            double sum = 0;
+            for (long i = -extent; i <= extent; ++i)
+            {
+                long sy = (long)y + i;
+                if (sy >= 0 && sy < (long)height) sum += kernel[i + extent] * rows[(size_t)sy * width + x];
+            }
+            reference[y * width + x] = sum;
+        }
+    }
+    
+    free(kernel);
+    free(rows);
+    return reference;
+}
+
+/**
+ *  Blurs `mask` in place and checks it against the Gaussian reference,
+ *  with bounds on the errors in units of 1/255.
+ */
+static void OHAssertBlurMatchesGaussian(const char* name, uint8_t* mask, size_t width, size_t height, double blurRadius,
+                                        double maxErrorBound, double meanErrorBound)
+{
+    double* reference = OHCreateGaussianReference(mask, width, height, blurRadius);
+    int result = OHAlphaMaskBlur(mask, width, height, blurRadius);
+    OHTestAssert(result == 0, "%s: the blur failed", name);
+    
+    double maxError = 0, sum = 0;
+    for (size_t idx = 0; idx < width * height; ++idx)
+    {
+        double error = fabs(mask[idx] - reference[idx]);
+        if (error > maxError) maxError = error;
+        sum += error;
+    }
+    double meanError = sum / (double)(width * height);
+    OHTestAssert(maxError <= maxErrorBound, "%s: max error %.2f/255", name, maxError);
+    OHTestAssert(meanError <= meanErrorBound, "%s: mean error %.3f/255", name, meanError);
+    free(reference);
+}
+
+static uint8_t* OHCreateSquareMask(size_t width, size_t height, size_t x, size_t y, size_t side)
+{
+    uint8_t* mask = calloc(width * height, 1);
+    for (size_t row = y; row < y + side; ++row) memset(mask + row * width + x, 255, side);
+    return mask;
+}
+
+// MARK: - Tests
+
+static void OHTestBoxSizesMatchVariance(void)
+{
+    // Three boxes of width w have a total variance of 3 * (w² - 1) / 12, which must be sigma²
+    const double sigmas[] = { 0.5, 1, 2.5, 4, 10, 33 };
+    for (size_t idx = 0; idx < sizeof(sigmas) / sizeof(sigmas[0]); ++idx)
+    {
+        size_t sizes[3];
+        OHBoxBlurSizesForSigma(sigmas[idx], sizes);
+        double variance = 0;
+        for (size_t box = 0; box < 3; ++box)
+        {
+            OHTestAssert(sizes[box] % 2 == 1, "box sizes for sigma %g: %zu is even", sigmas[idx], sizes[box]);
+            variance += ((double)sizes[box] * sizes[box] - 1) / 12;
+        }
+        double sigma = sqrt(variance);
+        OHTestAssert(fabs(sigma - sigmas[idx]) <= 0.5, "box sizes for sigma %g: sigma %g", sigmas[idx], sigma);
+    }
+}
+
+static void OHTestSquare(void)
+{
+    // A 21x21 square, with enough room around it for the whole blur
+    const size_t width = 101, height = 101;
+    uint8_t* mask = OHCreateSquareMask(width, height, 40, 40, 21);
+    OHAssertBlurMatchesGaussian("21x21 square, radius 8", mask, width, height, 8, 5, 0.25);
+    free(mask);
+    
+    mask = OHCreateSquareMask(width, height, 40, 40, 21);
+    OHAssertBlurMatchesGaussian("21x21 square, radius 3", mask, width, height, 3, 5, 0.25);
+    free(mask);
+}
+
+static void OHTestZeroRadius(void)
+{
+    uint32_t state = 9;
+    uint8_t mask[7 * 5], original[7 * 5];
+    OHTestFillRandom(mask, sizeof(mask), &state);
+    memcpy(original, mask, sizeof(mask));
+    OHTestAssert(OHAlphaMaskBlur(mask, 7, 5, 0) == 0, "radius 0: the blur failed");
+    OHTestAssert(memcmp(mask, original, sizeof(mask)) == 0, "radius 0: the mask was modified");
+}
+
+static void OHTestOnePixelWideMasks(void)
+{
+    // A line in a 1-pixel-wide mask: the blur spreads most of it out of the mask
+    const size_t length = 40, wideWidth = 41;
+    uint8_t* column = calloc(length, 1);
+    memset(column + 10, 255, 20);
+    uint8_t* wide = calloc(wideWidth * length, 1);
+    for (size_t y = 0; y < length; ++y) wide[y * wideWidth + wideWidth/2] = column[y];
+    
+    OHAssertBlurMatchesGaussian("1-pixel-wide column, radius 4", column, 1, length, 4, 2, 0.5);
+    
+    // Nothing must be lost at the edges: the same line in the middle of a wider mask blurs the same
+    OHAlphaMaskBlur(wide, wideWidth, length, 4);
+    for (size_t y = 0; y < length; ++y)
+    {
+        if (!OHTestAssert(column[y] == wide[y * wideWidth + wideWidth/2],
+                          "1-pixel-wide column, radius 4: row %zu is %u instead of %u",
+                          y, column[y], wide[y * wideWidth + wideWidth/2])) break;
+    }
+    free(wide);
+    free(column);
+    
+    uint8_t* row = calloc(length, 1);
+    memset(row + 10, 255, 20);
+    OHAssertBlurMatchesGaussian("1-pixel-high row, radius 4", row, length, 1, 4, 2, 0.5);
+    free(row);
+}
+
+static void OHTestRadiusLargerThanMask(void)
+{
+    uint8_t* mask = OHCreateSquareMask(6, 4, 1, 1, 3);
+    OHAssertBlurMatchesGaussian("6x4 mask, radius 30", mask, 6, 4, 30, 1, 1);
+    free(mask);
+    
+    mask = OHCreateSquareMask(9, 9, 0, 0, 9);
+    OHAssertBlurMatchesGaussian("9x9 opaque mask, radius 12", mask, 9, 9, 12, 3, 1.5);
+    free(mask);
+}
+
+/***********************************************************************************/
+
+void OHShadowBlurTestsRun(void)
+{
+    OHTestBoxSizesMatchVariance();
+    OHTestSquare();
+    OHTestZeroRadius();
+    OHTestOnePixelWideMasks();
+    OHTestRadiusLargerThanMask();
+}
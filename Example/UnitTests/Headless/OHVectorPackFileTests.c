@@ -0,0 +1,382 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+
+
+/*
+ *  Tests of OHVectorPackFile: display lists written into a pack must decode back
+ *  to the same operations (within the quantization of colors and coordinates),
+ *  and truncated or corrupted packs must be rejected without reading out of bounds.
+ */
+
+#if !defined(__APPLE__) && !defined(_POSIX_C_SOURCE)
+  #define _POSIX_C_SOURCE 200809L /* For mkstemp in strict C99 mode */
+#endif
+#include "OHHeadlessTests.h"
+#include "OHVectorPackFile.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/***********************************************************************************/
+
+/* Uses every kind of encoded operand: path coordinates, colors, caps and joins, dashes and floats */
+static const char* const kIconList =
+    "save; concat 1 0 0 1 2.5 -3; fillcolor 1 0 0 1; moveto 0 0; lineto 24 0; curveto 24 12.5 12 24 0 24; close; fill; "
+    "restore; strokecolor 0 0.2 0.4 0.6; linewidth 1.5; linecap 1; linejoin 2; miterlimit 4; dash 2 0.5 3 1; "
+    "moveto 2 2; lineto 22 22; stroke; dash 0 0; moveto 4 4; lineto 20 4; lineto 12 18; eoclip; "
+    "moveto 0 0; lineto 24 0; lineto 24 24; eofillstroke";
+static const float kIconBox[4] = { 0, 0, 24, 24 };
+
+/* Tiny details far from the origin, which can't be quantized to 16 bits */
+static const char* const kFarList = "moveto 30000.125 -30000.25; lineto 30000.5 -30000; lineto 30000 -30000.75; fill";
+static const float kFarBox[4] = { 30000, -30001, 1, 1 };
+
+typedef struct {
+    OHDisplayListOp ops[64];
+    size_t counts[64];
+    float operands[64][8];
+    size_t count;
+} OHRecordedOps;
+
+static void OHRecordOp(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    OHRecordedOps* recorded = info;
+    if (recorded->count == 64) return;
+    recorded->ops[recorded->count] = op;
+    recorded->counts[recorded->count] = count;
+    for (size_t idx = 0; idx < count && idx < 8; ++idx) recorded->operands[recorded->count][idx] = operands[idx];
+    recorded->count++;
+}
+
+/**
+ *  Checks that a decoded display list has the operations of the original one, with their
+ *  operands equal up to `tolerance` (colors are always quantized to 8 bits).
+ */
+static void OHAssertSameDisplayList(const OHDisplayList* decoded, const OHDisplayList* original,
+                                    float tolerance, const char* name)
+{
+    static OHRecordedOps expected, actual;
+    memset(&expected, 0, sizeof(expected));
+    memset(&actual, 0, sizeof(actual));
+    OHDisplayListApply(original, &expected, OHRecordOp);
+    OHDisplayListApply(decoded, &actual, OHRecordOp);
+    if (!OHTestAssert(actual.count == expected.count, "%s: decoded %zu operations instead of %zu",
+                      name, actual.count, expected.count)) return;
+    
+    for (size_t idx = 0; idx < expected.count; ++idx)
+    {
+        OHDisplayListOp op = expected.ops[idx];
+        if (!OHTestAssert(actual.ops[idx] == op && actual.counts[idx] == expected.counts[idx],
+                          "%s: operation %zu is %s with %zu operands instead of %s with %zu", name, idx,
+                          OHTestOpName(actual.ops[idx]), actual.counts[idx], OHTestOpName(op), expected.counts[idx])) return;
+        
+        int isColor = (op == OHDisplayListOpSetFillColor || op == OHDisplayListOpSetStrokeColor);
+        for (size_t k = 0; k < expected.counts[idx] && k < 8; ++k)
+        {
+            float difference = fabsf(actual.operands[idx][k] - expected.operands[idx][k]);
+            OHTestAssert(difference <= (isColor ? 0.5f / 255 : tolerance), "%s: operand %zu of %s is %g instead of %g",
+                         name, k, OHTestOpName(op), actual.operands[idx][k], expected.operands[idx][k]);
+        }
+    }
+}
+
+/**
+ *  Writes a pack with the icon and far entries (plus `extraCount` small ones) to a temporary file.
+ *
+ *  @return The path of the file, to remove and free, or NULL on failure.
+ */
+static char* OHCreatePackFile(size_t extraCount)
+{
+    OHVectorPackWriter* writer = OHVectorPackWriterCreate();
+    OHDisplayList* icon = OHTestCreateDisplayList(kIconList);
+    OHDisplayList* far = OHTestCreateDisplayList(kFarList);
+    int failed = OHVectorPackWriterAddEntry(writer, "icon", kIconBox, kIconBox, icon) != 0
+              || OHVectorPackWriterAddEntry(writer, "far", kFarBox, kFarBox, far) != 0;
+    // Names are unique
+    OHTestAssert(OHVectorPackWriterAddEntry(writer, "icon", kIconBox, kIconBox, far) == -1, "Added a duplicate entry");
+    for (size_t idx = 0; idx < extraCount && !failed; ++idx)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "extra-%zu", idx);
+        failed = OHVectorPackWriterAddEntry(writer, name, kIconBox, kIconBox, far) != 0;
+    }
+    OHTestAssert(failed || OHVectorPackWriterGetEntryCount(writer) == 2 + extraCount, "Wrong entry count");
+    OHDisplayListRelease(icon);
+    OHDisplayListRelease(far);
+    
+    char* path = malloc(64);
+    strcpy(path, "/tmp/OHVectorPackTestsXXXXXX");
+    int fd = failed ? -1 : mkstemp(path);
+    FILE* file = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (fd >= 0 && !file) close(fd);
+    failed = !file || OHVectorPackWriterWrite(writer, file) != 0;
+    if (file) fclose(file);
+    OHVectorPackWriterRelease(writer);
+    if (!OHTestAssert(!failed, "Failed to write the pack"))
+    {
+        if (fd >= 0) remove(path);
+        free(path);
+        return NULL;
+    }
+    return path;
+}
+
+static uint8_t* OHCopyFileBytes(const char* path, size_t* length)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return NULL;
+    fseek(file, 0, SEEK_END);
+    *length = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* bytes = malloc(*length);
+    if (bytes && fread(bytes, 1, *length, file) != *length)
+    {
+        free(bytes);
+        bytes = NULL;
+    }
+    fclose(file);
+    return bytes;
+}
+
+/* Opens a copy of `length` bytes, so that reading past them is caught by the address sanitizer */
+static OHVectorPackFile* OHOpenCopy(const uint8_t* bytes, size_t length, uint8_t** copy)
+{
+    *copy = malloc(length ? length : 1);
+    memcpy(*copy, bytes, length);
+    return OHVectorPackFileOpenWithBytes(*copy, length);
+}
+
+/* Looks up and decodes every entry, which must not crash even if the pack is corrupted */
+static void OHDecodeAllEntries(const OHVectorPackFile* pack)
+{
+    for (size_t idx = 0; idx < OHVectorPackFileGetEntryCount(pack); ++idx)
+    {
+        const char* name = OHVectorPackFileGetEntryName(pack, idx);
+        (void)OHVectorPackFileFindEntry(pack, name);
+        float mediaBox[4], cropBox[4];
+        OHVectorPackFileGetEntryBoxes(pack, idx, mediaBox, cropBox);
+        OHDisplayListRelease(OHVectorPackFileCopyDisplayList(pack, idx));
+    }
+}
+
+// MARK: - Tests
+
+static void OHTestRoundTrip(void)
+{
+    char* path = OHCreatePackFile(40);
+    if (!path) return;
+    OHVectorPackFile* pack = OHVectorPackFileOpen(path);
+    remove(path);
+    free(path);
+    if (!OHTestAssert(pack != NULL, "Failed to open the pack")) return;
+    OHTestAssert(OHVectorPackFileGetEntryCount(pack) == 42, "Wrong entry count");
+    
+    long index = OHVectorPackFileFindEntry(pack, "icon");
+    if (OHTestAssert(index >= 0, "Entry \"icon\" not found"))
+    {
+        OHTestAssert(strcmp(OHVectorPackFileGetEntryName(pack, (size_t)index), "icon") == 0, "Wrong entry name");
+        float mediaBox[4], cropBox[4];
+        OHVectorPackFileGetEntryBoxes(pack, (size_t)index, mediaBox, cropBox);
+        OHTestAssert(memcmp(mediaBox, kIconBox, sizeof(mediaBox)) == 0 && memcmp(cropBox, kIconBox, sizeof(cropBox)) == 0,
+                     "Wrong boxes");
+        OHDisplayList* original = OHTestCreateDisplayList(kIconList);
+        OHDisplayList* decoded = OHVectorPackFileCopyDisplayList(pack, (size_t)index);
+        // The coordinates of a 24pt icon are quantized much finer than a thousandth of a point
+        if (OHTestAssert(decoded != NULL, "Failed to decode \"icon\"")) OHAssertSameDisplayList(decoded, original, 1e-3f, "icon");
+        OHDisplayListRelease(decoded);
+        OHDisplayListRelease(original);
+    }
+    
+    // Coordinates that can't be quantized are kept exactly
+    index = OHVectorPackFileFindEntry(pack, "far");
+    if (OHTestAssert(index >= 0, "Entry \"far\" not found"))
+    {
+        OHDisplayList* original = OHTestCreateDisplayList(kFarList);
+        OHDisplayList* decoded = OHVectorPackFileCopyDisplayList(pack, (size_t)index);
+        if (OHTestAssert(decoded != NULL, "Failed to decode \"far\"")) OHAssertSameDisplayList(decoded, original, 0, "far");
+        OHDisplayListRelease(decoded);
+        OHDisplayListRelease(original);
+    }
+    
+    OHTestAssert(OHVectorPackFileFindEntry(pack, "extra-39") >= 0, "Entry \"extra-39\" not found");
+    OHTestAssert(OHVectorPackFileFindEntry(pack, "missing") == -1, "Found a missing entry");
+    OHTestAssert(OHVectorPackFileFindEntry(pack, "ico") == -1, "Found an entry by its prefix");
+    OHVectorPackFileClose(pack);
+}
+
+static void OHTestEmptyPack(void)
+{
+    OHVectorPackWriter* writer = OHVectorPackWriterCreate();
+    FILE* file = tmpfile();
+    if (OHTestAssert(file && OHVectorPackWriterWrite(writer, file) == 0, "Failed to write an empty pack"))
+    {
+        uint8_t bytes[256];
+        rewind(file);
+        size_t length = fread(bytes, 1, sizeof(bytes), file);
+        OHVectorPackFile* pack = OHVectorPackFileOpenWithBytes(bytes, length);
+        if (OHTestAssert(pack != NULL, "Failed to open an empty pack"))
+        {
+            OHTestAssert(OHVectorPackFileGetEntryCount(pack) == 0, "Empty pack has entries");
+            OHTestAssert(OHVectorPackFileFindEntry(pack, "icon") == -1, "Found an entry in an empty pack");
+        }
+        OHVectorPackFileClose(pack);
+    }
+    if (file) fclose(file);
+    OHVectorPackWriterRelease(writer);
+    
+    OHTestAssert(OHVectorPackFileOpen("/nonexistent/OHVectorPackTests.ohvp") == NULL, "Opened a missing file");
+}
+
+static void OHTestTruncatedPacks(void)
+{
+    char* path = OHCreatePackFile(0);
+    if (!path) return;
+    size_t length = 0;
+    uint8_t* bytes = OHCopyFileBytes(path, &length);
+    remove(path);
+    free(path);
+    if (!OHTestAssert(bytes != NULL, "Failed to read the pack")) return;
+    
+    // The last display list ends at the end of the file, so any truncation is detected when opening
+    for (size_t truncated = 0; truncated < length; ++truncated)
+    {
+        uint8_t* copy;
+        OHVectorPackFile* pack = OHOpenCopy(bytes, truncated, &copy);
+        OHTestAssert(pack == NULL, "Opened a pack truncated to %zu of %zu bytes", truncated, length);
+        OHVectorPackFileClose(pack);
+        free(copy);
+    }
+    free(bytes);
+}
+
+/* Header fields, as in OHVectorPackFile.c */
+enum {
+    kHeaderVersion = 4, kHeaderEntryCount = 8, kHeaderTableSize = 12,
+    kHeaderTableOffset = 16, kHeaderEntriesOffset = 20, kHeaderNamesOffset = 24, kHeaderDataOffset = 28,
+    kEntryNameLength = 8, kEntryDataOffset = 48, kEntryDataSize = 52, kEntryOpCount = 56,
+};
+
+static void OHPutU32(uint8_t* bytes, uint32_t value)
+{
+    for (int idx = 0; idx < 4; ++idx) bytes[idx] = (uint8_t)(value >> (8 * idx));
+}
+
+static uint32_t OHGetU32(const uint8_t* bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void OHTestCorruptedPacks(void)
+{
+    char* path = OHCreatePackFile(0);
+    if (!path) return;
+    size_t length = 0;
+    uint8_t* bytes = OHCopyFileBytes(path, &length);
+    remove(path);
+    free(path);
+    if (!OHTestAssert(bytes != NULL && length > 32, "Failed to read the pack")) return;
+    
+    uint32_t tableOffset = OHGetU32(bytes + kHeaderTableOffset);
+    uint32_t entriesOffset = OHGetU32(bytes + kHeaderEntriesOffset);
+    struct { const char* name; size_t offset; uint32_t value; } const kCorruptions[] = {
+        { "magic", 0, 0x50564F4F },
+        { "version", kHeaderVersion, 2 },
+        { "empty table", kHeaderTableSize, 0 },
+        { "table size not a power of two", kHeaderTableSize, 3 },
+        { "table smaller than the entries", kHeaderEntryCount, 5 },
+        { "table past the end", kHeaderTableOffset, (uint32_t)length - 4 },
+        { "entries past the end", kHeaderEntriesOffset, (uint32_t)length - 8 },
+        { "entry count overflow", kHeaderEntryCount, UINT32_MAX },
+        { "names after the data", kHeaderNamesOffset, (uint32_t)length },
+        { "data past the end", kHeaderDataOffset, (uint32_t)length + 1 },
+        { "invalid slot", tableOffset, 3 },
+        { "name not terminated", entriesOffset + kEntryNameLength, 2 },
+        { "name past the names", entriesOffset + kEntryNameLength, (uint32_t)length },
+        { "data of an entry past the end", entriesOffset + kEntryDataOffset, (uint32_t)length - 1 },
+        { "huge data of an entry", entriesOffset + kEntryDataSize, UINT32_MAX },
+    };
+    for (size_t idx = 0; idx < sizeof(kCorruptions) / sizeof(kCorruptions[0]); ++idx)
+    {
+        uint8_t* copy;
+        uint8_t saved[4];
+        memcpy(saved, bytes + kCorruptions[idx].offset, 4);
+        OHPutU32(bytes + kCorruptions[idx].offset, kCorruptions[idx].value);
+        OHVectorPackFile* pack = OHOpenCopy(bytes, length, &copy);
+        OHTestAssert(pack == NULL, "Opened a pack with a corrupted header (%s)", kCorruptions[idx].name);
+        OHVectorPackFileClose(pack);
+        free(copy);
+        memcpy(bytes + kCorruptions[idx].offset, saved, 4);
+    }
+    
+    // Corrupted display lists are only detected when decoding them
+    uint8_t* copy;
+    OHPutU32(bytes + entriesOffset + kEntryOpCount, OHGetU32(bytes + entriesOffset + kEntryOpCount) + 1);
+    OHVectorPackFile* pack = OHOpenCopy(bytes, length, &copy);
+    if (OHTestAssert(pack != NULL, "Failed to open a pack with a corrupted display list"))
+    {
+        OHTestAssert(OHVectorPackFileCopyDisplayList(pack, 0) == NULL, "Decoded a display list with a wrong operation count");
+    }
+    OHVectorPackFileClose(pack);
+    free(copy);
+    OHPutU32(bytes + entriesOffset + kEntryOpCount, OHGetU32(bytes + entriesOffset + kEntryOpCount) - 1);
+    
+    uint8_t* firstOp = bytes + OHGetU32(bytes + entriesOffset + kEntryDataOffset);
+    uint8_t savedOp = *firstOp;
+    *firstOp = OHDisplayListOpCount;
+    pack = OHOpenCopy(bytes, length, &copy);
+    if (OHTestAssert(pack != NULL, "Failed to open a pack with a corrupted display list"))
+    {
+        OHTestAssert(OHVectorPackFileCopyDisplayList(pack, 0) == NULL, "Decoded an unknown operation");
+    }
+    OHVectorPackFileClose(pack);
+    free(copy);
+    *firstOp = savedOp;
+    
+    // Random corruptions may open, but must never read out of bounds
+    uint32_t state = 0x12345678;
+    for (int iteration = 0; iteration < 2000; ++iteration)
+    {
+        size_t offset = OHTestRandom(&state) % length;
+        uint8_t saved = bytes[offset];
+        bytes[offset] = (uint8_t)(OHTestRandom(&state) >> 24);
+        pack = OHOpenCopy(bytes, length, &copy);
+        if (pack) OHDecodeAllEntries(pack);
+        OHVectorPackFileClose(pack);
+        free(copy);
+        bytes[offset] = saved;
+    }
+    free(bytes);
+}
+
+void OHVectorPackFileTestsRun(void)
+{
+    OHTestRoundTrip();
+    OHTestEmptyPack();
+    OHTestTruncatedPacks();
+    OHTestCorruptedPacks();
+}
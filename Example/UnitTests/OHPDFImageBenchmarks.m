@@ -0,0 +1,233 @@
+//
+//  OHPDFImageBenchmarks.m
+//  OHPDFImageDemoTests
+//
+//  Copyright (c) 2014 AliSoftware. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import <OHPDFImage/OHPDFImage.h>
+#import "OHBenchmark.h"
+
+/*
+ *  Benchmarks -[OHVectorImage renderAtSize:] on the demo PDFs and on a generated
+ *  PDF of 10000 paths, for every size from 16pt to 2048pt and every combination of
+ *  tint, background, shadow and insets, then runs the portable benchmarks of
+ *  OHBenchmark.c (the same as the headless OHBenchmarkMain.c) on the device.
+ *
+ *  The full sweep takes several minutes, so it only runs when the OHPDFIMAGE_BENCHMARKS
+ *  environment variable is set in the scheme (to "quick" for sizes up to 128pt only).
+ *  The JSON report is written to the path in OHPDFIMAGE_BENCHMARKS_OUTPUT, or to
+ *  OHPDFImageBenchmarks.json in the temporary directory.
+ */
+
+static NSString* const kBenchmarkedPDFNames[] = { @"check", @"circle", @"dotmask", @"dingbats" };
+static const size_t kCorpusPathCount = 10000;
+static const CGFloat kCorpusPageSize = 100;
+
+@interface OHRenderAtSizeCase : NSObject
+@property(nonatomic, strong) OHVectorImage* image;
+@property(nonatomic, assign) CGSize size;
+@end
+
+@implementation OHRenderAtSizeCase
+@end
+
+static void OHRunRenderAtSize(void* info)
+{
+    OHRenderAtSizeCase* renderCase = (__bridge OHRenderAtSizeCase*)info;
+    @autoreleasepool {
+        (void)[renderCase.image renderAtSize:renderCase.size];
+    }
+}
+
+static void OHDrawCorpusOperation(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    CGContextRef context = (CGContextRef)info;
+    switch (op)
+    {
+        case OHDisplayListOpMoveTo: CGContextMoveToPoint(context, operands[0], operands[1]); break;
+        case OHDisplayListOpLineTo: CGContextAddLineToPoint(context, operands[0], operands[1]); break;
+        case OHDisplayListOpCurveTo:
+            CGContextAddCurveToPoint(context, operands[0], operands[1], operands[2], operands[3], operands[4], operands[5]);
+            break;
+        case OHDisplayListOpClosePath: CGContextClosePath(context); break;
+        case OHDisplayListOpFill: CGContextDrawPath(context, kCGPathFill); break;
+        case OHDisplayListOpEOFill: CGContextDrawPath(context, kCGPathEOFill); break;
+        case OHDisplayListOpStroke: CGContextDrawPath(context, kCGPathStroke); break;
+        case OHDisplayListOpFillStroke: CGContextDrawPath(context, kCGPathFillStroke); break;
+        case OHDisplayListOpSetFillColor:
+            CGContextSetRGBFillColor(context, operands[0], operands[1], operands[2], operands[3]);
+            break;
+        case OHDisplayListOpSetStrokeColor:
+            CGContextSetRGBStrokeColor(context, operands[0], operands[1], operands[2], operands[3]);
+            break;
+        case OHDisplayListOpSetLineWidth: CGContextSetLineWidth(context, operands[0]); break;
+        default: break; // Not generated by OHBenchmarkCreatePathCorpus
+    }
+}
+
+@interface OHPDFImageBenchmarks : XCTestCase
+@end
+
+@implementation OHPDFImageBenchmarks
+
+- (void)testRenderingBenchmarks
+{
+    NSDictionary* environment = [NSProcessInfo processInfo].environment;
+    NSString* mode = environment[@"OHPDFIMAGE_BENCHMARKS"];
+    if (!mode)
+    {
+        NSLog(@"Skipping the rendering benchmarks, set OHPDFIMAGE_BENCHMARKS in the scheme to run them");
+        return;
+    }
+    BOOL quick = [mode isEqualToString:@"quick"];
+    double maxSize = quick ? 128 : 2048;
+    OHBenchmarkLimits limits = quick ? (OHBenchmarkLimits){ 3, 100, 10000000 } : (OHBenchmarkLimits){ 3, 1000, 100000000 };
+    double screenScale = [UIScreen mainScreen].scale;
+
+    NSString* outputPath = environment[@"OHPDFIMAGE_BENCHMARKS_OUTPUT"]
+                         ?: [NSTemporaryDirectory() stringByAppendingPathComponent:@"OHPDFImageBenchmarks.json"];
+    FILE* output = fopen(outputPath.fileSystemRepresentation, "w");
+    XCTAssertTrue(output != NULL, @"Could not create %@", outputPath);
+    if (!output) return;
+
+    UIDevice* device = [UIDevice currentDevice];
+    NSString* platform = [NSString stringWithFormat:@"%@ %@ (%@, @%gx)",
+                          device.systemName, device.systemVersion, device.model, screenScale];
+    OHBenchmarkReport* report = OHBenchmarkReportCreate(output, platform.UTF8String);
+    XCTAssertTrue(report != NULL);
+
+    // Demo PDFs
+    for (size_t i = 0; report && i < sizeof(kBenchmarkedPDFNames) / sizeof(kBenchmarkedPDFNames[0]); ++i)
+    {
+        OHVectorImage* image = [OHVectorImage imageWithPDFNamed:kBenchmarkedPDFNames[i]];
+        XCTAssertNotNil(image, @"Missing %@.pdf", kBenchmarkedPDFNames[i]);
+        NSString* input = [kBenchmarkedPDFNames[i] stringByAppendingPathExtension:@"pdf"];
+        [self benchmarkRenderAtSizeWithImage:image input:input report:report maxSize:maxSize limits:limits];
+    }
+
+    // Generated corpus, rendered both by Quartz and by the portable rasterizer
+    OHDisplayList* corpus = OHBenchmarkCreatePathCorpus(42, kCorpusPathCount, kCorpusPageSize, kCorpusPageSize);
+    XCTAssertTrue(corpus != NULL);
+    if (report && corpus)
+    {
+        NSString* input = [NSString stringWithFormat:@"paths-%lu", (unsigned long)kCorpusPathCount];
+        NSURL* corpusURL = [self writePDFWithDisplayList:corpus name:input];
+        OHVectorImage* image = corpusURL ? [OHVectorImage imageWithPDFURL:corpusURL] : nil;
+        XCTAssertNotNil(image);
+        [self benchmarkRenderAtSizeWithImage:image input:input report:report maxSize:maxSize limits:limits];
+        [self benchmarkMipmapsWithImage:image input:input report:report maxSize:maxSize limits:limits];
+        XCTAssertEqual(OHBenchmarkRunRasterizer(report, input.UTF8String, corpus, kCorpusPageSize, kCorpusPageSize,
+                                                maxSize, screenScale, limits), 0);
+    }
+    if (corpus) OHDisplayListRelease(corpus);
+
+    if (report)
+    {
+        XCTAssertEqual(OHBenchmarkRunKernels(report, maxSize, screenScale, limits), 0);
+        OHBenchmarkReportFinish(report);
+    }
+    fclose(output);
+    NSLog(@"Rendering benchmarks written to %@", outputPath);
+}
+
+#pragma mark - Private Methods
+
+- (void)benchmarkRenderAtSizeWithImage:(OHVectorImage*)image
+                                 input:(NSString*)input
+                                report:(OHBenchmarkReport*)report
+                               maxSize:(double)maxSize
+                                limits:(OHBenchmarkLimits)limits
+{
+    if (!image) return;
+
+    // Measure the rendering itself, not the render cache
+    image.renderCache = nil;
+    CGSize nativeSize = image.nativeSize;
+    OHRenderAtSizeCase* renderCase = [OHRenderAtSizeCase new];
+    renderCase.image = image;
+
+    for (size_t s = 0; s < OH_BENCHMARK_SIZES_COUNT && OHBenchmarkSizes[s] <= maxSize; ++s)
+    {
+        renderCase.size = CGSizeMake(OHBenchmarkSizes[s], OHBenchmarkSizes[s]);
+        CGSize pixelSize = [image pixelSizeForSize:renderCase.size];
+
+        for (unsigned options = 0; options < OHBenchmarkOptionCombinationsCount; ++options)
+        {
+            // Shadow and insets are in the unit of the PDF, so scale them like the rasterizer benchmarks
+            image.tintColor = (options & OHBenchmarkOptionTint) ? [UIColor redColor] : nil;
+            image.backgroundColor = (options & OHBenchmarkOptionBackground) ? [UIColor whiteColor] : nil;
+            if (options & OHBenchmarkOptionShadow)
+            {
+                NSShadow* shadow = [NSShadow new];
+                shadow.shadowOffset = CGSizeMake(0.02 * nativeSize.width, 0.02 * nativeSize.height);
+                shadow.shadowBlurRadius = 0.03 * nativeSize.width;
+                shadow.shadowColor = [UIColor colorWithWhite:0 alpha:0.5];
+                image.shadow = shadow;
+            }
+            else
+            {
+                image.shadow = nil;
+            }
+            image.insets = (options & OHBenchmarkOptionInsets)
+                         ? UIEdgeInsetsMake(0.1 * nativeSize.height, 0.1 * nativeSize.width,
+                                            0.1 * nativeSize.height, 0.1 * nativeSize.width)
+                         : UIEdgeInsetsZero;
+
+            OHBenchmarkResult result = { .name = "renderAtSize", .input = input.UTF8String, .size = OHBenchmarkSizes[s],
+                                         .options = options, .pixels = (uint64_t)(pixelSize.width * pixelSize.height) };
+            XCTAssertEqual(OHBenchmarkRun(OHRunRenderAtSize, NULL, (__bridge void*)renderCase, limits, &result), 0);
+            OHBenchmarkReportAddResult(report, &result);
+        }
+    }
+}
+
+- (void)benchmarkMipmapsWithImage:(OHVectorImage*)image
+                            input:(NSString*)input
+                           report:(OHBenchmarkReport*)report
+                          maxSize:(double)maxSize
+                           limits:(OHBenchmarkLimits)limits
+{
+    if (!image) return;
+
+    // 3/4 of each size of the sweep, derived from the bucket of that size
+    // (rasterized once, by the warm-up run, then kept in the mipmap cache)
+    image.renderCache = nil;
+    image.tintColor = image.backgroundColor = nil;
+    image.shadow = nil;
+    image.insets = UIEdgeInsetsZero;
+    image.usesMipmaps = YES;
+    OHRenderAtSizeCase* renderCase = [OHRenderAtSizeCase new];
+    renderCase.image = image;
+
+    for (size_t s = 0; s < OH_BENCHMARK_SIZES_COUNT && OHBenchmarkSizes[s] <= maxSize; ++s)
+    {
+        renderCase.size = CGSizeMake(0.75 * OHBenchmarkSizes[s], 0.75 * OHBenchmarkSizes[s]);
+        CGSize pixelSize = [image pixelSizeForSize:renderCase.size];
+        OHBenchmarkResult result = { .name = "renderAtSizeFromMipmap", .input = input.UTF8String,
+                                     .size = renderCase.size.width, .pixels = (uint64_t)(pixelSize.width * pixelSize.height) };
+        XCTAssertEqual(OHBenchmarkRun(OHRunRenderAtSize, NULL, (__bridge void*)renderCase, limits, &result), 0);
+        OHBenchmarkReportAddResult(report, &result);
+    }
+    image.usesMipmaps = NO;
+}
+
+- (NSURL*)writePDFWithDisplayList:(OHDisplayList*)list name:(NSString*)name
+{
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:[name stringByAppendingPathExtension:@"pdf"]];
+    NSURL* url = [NSURL fileURLWithPath:path];
+    CGRect mediaBox = CGRectMake(0, 0, kCorpusPageSize, kCorpusPageSize);
+    CGContextRef context = CGPDFContextCreateWithURL((__bridge CFURLRef)url, &mediaBox, NULL);
+    if (!context) return nil;
+
+    CGPDFContextBeginPage(context, NULL);
+    OHDisplayListApply(list, context, OHDrawCorpusOperation);
+    CGPDFContextEndPage(context);
+    CGPDFContextClose(context);
+    CGContextRelease(context);
+    return url;
+}
+
+@end
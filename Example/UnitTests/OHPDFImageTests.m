@@ -8,21 +8,216 @@
 
 #import <UIKit/UIKit.h>
 #import <XCTest/XCTest.h>
+#import <OHPDFImage/OHPDFImage.h>
 
-@interface OHPDFImageDemoTests : XCTestCase
+/*
+ *  Golden-image tests of -[OHVectorImage renderAtSize:]: the renderings of the pixel
+ *  kernels path (tint, background and shadow composited by OHPixelKernels) must match
+ *  the reference renderings of the Quartz path, for every demo PDF and every
+ *  combination of tint, background, shadow and insets.
+ *
+ *  The bit-exactness of the SIMD kernels with their scalar implementation is tested
+ *  by the headless tests (Headless/OHHeadlessTests.c), which can run on any platform.
+ */
+
+static NSString* const kGoldenPDFNames[] = { @"check", @"circle", @"dotmask", @"dingbats" };
+static const CGFloat kGoldenSize = 64;
+static const CGFloat kGoldenScreenScale = 2;
+
+/* Both paths round premultiplied values differently, by a few units at most */
+static const NSUInteger kMaxChannelDifference = 3;
+static const double kMaxMeanDifference = 1;
+/* Quartz does not document its shadow blur, which the box blurs only approximate */
+static const NSUInteger kMaxShadowChannelDifference = 48;
+static const double kMaxShadowMeanDifference = 2;
+
+enum {
+    OHGoldenOptionTint       = 1 << 0,
+    OHGoldenOptionBackground = 1 << 1,
+    OHGoldenOptionShadow     = 1 << 2,
+    OHGoldenOptionInsets     = 1 << 3,
+    OHGoldenOptionCombinationsCount = 1 << 4
+};
 
+/**
+ *  Returns the pixels of an image, as premultiplied RGBA bytes.
+ */
+static NSData* OHPixelsOfImage(UIImage* image)
+{
+    CGImageRef cgImage = image.CGImage;
+    size_t width = CGImageGetWidth(cgImage), height = CGImageGetHeight(cgImage);
+    NSMutableData* pixels = [NSMutableData dataWithLength:width * height * 4];
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(pixels.mutableBytes, width, height, 8, width * 4, colorSpace,
+                                                 kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) return nil;
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), cgImage);
+    CGContextRelease(context);
+    return pixels;
+}
+
+@interface OHPDFImageDemoTests : XCTestCase
 @end
 
 @implementation OHPDFImageDemoTests
 
-- (void)setUp {
-    [super setUp];
-    // Put setup code here. This method is called before the invocation of each test method in the class.
+- (void)testPixelKernelsRenderingsMatchQuartz
+{
+    for (size_t i = 0; i < sizeof(kGoldenPDFNames) / sizeof(kGoldenPDFNames[0]); ++i)
+    {
+        OHVectorImage* image = [OHVectorImage imageWithPDFNamed:kGoldenPDFNames[i]];
+        XCTAssertNotNil(image, @"Missing %@.pdf", kGoldenPDFNames[i]);
+        if (!image) continue;
+        image.renderCache = nil;
+        image.screenScale = kGoldenScreenScale;
+
+        // The combinations share their geometry, so this also tests reusing the cached coverage layer
+        for (unsigned options = 0; options < OHGoldenOptionCombinationsCount; ++options)
+        {
+            [self configureImage:image options:options];
+            NSString* name = [NSString stringWithFormat:@"%@.pdf with options 0x%x", kGoldenPDFNames[i], options];
+
+            image.prepareContextBlock = nil;
+            UIImage* rendering = [image renderAtSize:CGSizeMake(kGoldenSize, kGoldenSize)];
+            // An empty prepareContextBlock forces the Quartz path
+            image.prepareContextBlock = ^(CGContextRef ctx) {};
+            UIImage* reference = [image renderAtSize:CGSizeMake(kGoldenSize, kGoldenSize)];
+            image.prepareContextBlock = nil;
+
+            BOOL hasShadow = (options & OHGoldenOptionShadow) != 0;
+            [self assertImage:rendering matchesReference:reference name:name
+                maxDifference:hasShadow ? kMaxShadowChannelDifference : kMaxChannelDifference
+               meanDifference:hasShadow ? kMaxShadowMeanDifference : kMaxMeanDifference];
+        }
+    }
+}
+
+- (void)testRecoloringCachedCoverageMatchesQuartz
+{
+    // Changing only the colors reuses the coverage layer rasterized for the previous tint
+    OHVectorImage* image = [OHVectorImage imageWithPDFNamed:@"dingbats"];
+    XCTAssertNotNil(image);
+    image.renderCache = nil;
+    image.screenScale = kGoldenScreenScale;
+
+    NSArray* tintColors = @[ [UIColor redColor], [UIColor colorWithRed:0.2 green:0.4 blue:0.9 alpha:0.5], [UIColor blackColor] ];
+    for (UIColor* tintColor in tintColors)
+    {
+        image.tintColor = tintColor;
+        image.prepareContextBlock = nil;
+        UIImage* rendering = [image renderAtSize:CGSizeMake(kGoldenSize, kGoldenSize)];
+        image.prepareContextBlock = ^(CGContextRef ctx) {};
+        UIImage* reference = [image renderAtSize:CGSizeMake(kGoldenSize, kGoldenSize)];
+        image.prepareContextBlock = nil;
+
+        [self assertImage:rendering matchesReference:reference name:tintColor.description
+            maxDifference:kMaxChannelDifference meanDifference:kMaxMeanDifference];
+    }
+}
+
+- (void)testTintOnlyRecolorsThePDF
+{
+    // What the prepareContextBlock draws (here, in a corner the inset PDF doesn't paint) is not tinted
+    OHVectorImage* image = [OHVectorImage imageWithPDFNamed:@"check"];
+    XCTAssertNotNil(image);
+    image.renderCache = nil;
+    image.screenScale = 1;
+    image.tintColor = [UIColor redColor];
+    CGSize nativeSize = image.nativeSize;
+    image.insets = UIEdgeInsetsMake(0.5 * nativeSize.height, 0.5 * nativeSize.width, 0, 0);
+    image.prepareContextBlock = ^(CGContextRef ctx) {
+        CGContextSetFillColorWithColor(ctx, [UIColor greenColor].CGColor);
+        CGContextFillRect(ctx, CGRectMake(0, 0, 8, 8));
+    };
+
+    UIImage* rendering = [image renderAtSize:CGSizeMake(kGoldenSize, kGoldenSize)];
+    NSData* pixels = OHPixelsOfImage(rendering);
+    XCTAssertNotNil(pixels);
+    if (pixels.length < 4) return;
+    const uint8_t* corner = (const uint8_t*)pixels.bytes + (2 * CGImageGetWidth(rendering.CGImage) + 2) * 4;
+    XCTAssertEqual(corner[0], 0);
+    XCTAssertEqual(corner[1], 255);
+    XCTAssertEqual(corner[2], 0);
+    XCTAssertEqual(corner[3], 255);
 }
 
-- (void)tearDown {
-    // Put teardown code here. This method is called after the invocation of each test method in the class.
-    [super tearDown];
+- (void)testMipmapRenderingsAreCachedApart
+{
+    // Renderings downsampled from a mipmap are slightly softer, so they must not be served for rasterized ones
+    OHVectorImage* image = [OHVectorImage imageWithPDFNamed:@"dingbats"];
+    XCTAssertNotNil(image);
+    image.renderCache = [OHRenderCache new];
+    image.screenScale = 1;
+    CGSize size = CGSizeMake(50, 50);
+
+    UIImage* rasterized = [image renderAtSize:size];
+    image.usesMipmaps = YES;
+    UIImage* downsampled = [image renderAtSize:size];
+    XCTAssertNotEqual(downsampled, rasterized);
+    XCTAssertEqual([image renderAtSize:size], downsampled);
+
+    // Without a bucket within the downsampling ratio, the rasterized rendering is used
+    image.mipmapMaxDownsamplingRatio = 1;
+    XCTAssertEqual([image renderAtSize:size], rasterized);
+}
+
+#pragma mark - Private Methods
+
+- (void)configureImage:(OHVectorImage*)image options:(unsigned)options
+{
+    // Shadow and insets are in the unit of the PDF, so scale them with its size
+    CGSize nativeSize = image.nativeSize;
+    image.tintColor = (options & OHGoldenOptionTint) ? [UIColor redColor] : nil;
+    image.backgroundColor = (options & OHGoldenOptionBackground) ? [UIColor colorWithWhite:0.9 alpha:1] : nil;
+    if (options & OHGoldenOptionShadow)
+    {
+        NSShadow* shadow = [NSShadow new];
+        shadow.shadowOffset = CGSizeMake(0.04 * nativeSize.width, -0.04 * nativeSize.height);
+        shadow.shadowBlurRadius = 0.05 * nativeSize.width;
+        shadow.shadowColor = [UIColor colorWithWhite:0 alpha:0.5];
+        image.shadow = shadow;
+    }
+    else
+    {
+        image.shadow = nil;
+    }
+    image.insets = (options & OHGoldenOptionInsets)
+                 ? UIEdgeInsetsMake(0.1 * nativeSize.height, 0.05 * nativeSize.width,
+                                    0.15 * nativeSize.height, 0.1 * nativeSize.width)
+                 : UIEdgeInsetsZero;
+}
+
+- (void)assertImage:(UIImage*)image
+   matchesReference:(UIImage*)reference
+               name:(NSString*)name
+      maxDifference:(NSUInteger)maxDifference
+     meanDifference:(double)meanDifference
+{
+    XCTAssertNotNil(image, @"%@: no rendering", name);
+    XCTAssertNotNil(reference, @"%@: no reference rendering", name);
+    if (!image || !reference) return;
+    XCTAssertEqual(CGImageGetWidth(image.CGImage), CGImageGetWidth(reference.CGImage), @"%@", name);
+    XCTAssertEqual(CGImageGetHeight(image.CGImage), CGImageGetHeight(reference.CGImage), @"%@", name);
+    XCTAssertEqual(image.scale, reference.scale, @"%@", name);
+
+    NSData* pixels = OHPixelsOfImage(image);
+    NSData* referencePixels = OHPixelsOfImage(reference);
+    if (pixels.length != referencePixels.length || pixels.length == 0) return;
+
+    const uint8_t* bytes = pixels.bytes;
+    const uint8_t* referenceBytes = referencePixels.bytes;
+    NSUInteger largestDifference = 0, sum = 0;
+    for (NSUInteger idx = 0; idx < pixels.length; ++idx)
+    {
+        NSUInteger difference = (NSUInteger)abs((int)bytes[idx] - (int)referenceBytes[idx]);
+        largestDifference = MAX(largestDifference, difference);
+        sum += difference;
+    }
+    double mean = (double)sum / pixels.length;
+    XCTAssertLessThanOrEqual(largestDifference, maxDifference, @"%@: largest difference", name);
+    XCTAssertLessThanOrEqual(mean, meanDifference, @"%@: mean difference", name);
 }
 
 @end
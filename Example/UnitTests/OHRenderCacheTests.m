@@ -0,0 +1,165 @@
+//
+//  OHRenderCacheTests.m
+//  OHPDFImageDemoTests
+//
+//  Copyright (c) 2014 AliSoftware. All rights reserved.
+//
+
+#import <UIKit/UIKit.h>
+#import <XCTest/XCTest.h>
+#import <OHPDFImage/OHPDFImage.h>
+
+/*
+ *  Tests of OHRenderCache: LRU eviction order, byte cost accounting against the
+ *  totalCostLimit, hit/miss counters, and purging (by PDF, all, on memory warnings).
+ */
+
+static UIImage* OHTestImage(CGFloat side)
+{
+    UIGraphicsBeginImageContextWithOptions(CGSizeMake(side, side), NO, 1);
+    UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
+    UIGraphicsEndImageContext();
+    return image;
+}
+
+/* The cost the cache charges for an image: the bytes of its bitmap */
+static NSUInteger OHTestImageCost(UIImage* image)
+{
+    return CGImageGetBytesPerRow(image.CGImage) * CGImageGetHeight(image.CGImage);
+}
+
+@interface OHRenderCacheTests : XCTestCase
+@property(nonatomic, strong) UIImage* image;
+@property(nonatomic, assign) NSUInteger cost;
+@end
+
+@implementation OHRenderCacheTests
+
+- (void)setUp
+{
+    [super setUp];
+    self.image = OHTestImage(16);
+    self.cost = OHTestImageCost(self.image);
+}
+
+- (void)testEvictsLeastRecentlyUsedImagesFirst
+{
+    OHRenderCache* cache = [OHRenderCache new];
+    cache.totalCostLimit = 3 * self.cost;
+    [cache setImage:self.image forKey:@"a" pdfURL:nil];
+    [cache setImage:self.image forKey:@"b" pdfURL:nil];
+    [cache setImage:self.image forKey:@"c" pdfURL:nil];
+    XCTAssertEqual(cache.count, 3u);
+
+    // Using "a" makes "b" the least recently used image
+    XCTAssertNotNil([cache imageForKey:@"a"]);
+    [cache setImage:self.image forKey:@"d" pdfURL:nil];
+    XCTAssertEqual(cache.count, 3u);
+    XCTAssertNil([cache imageForKey:@"b"]);
+    XCTAssertNotNil([cache imageForKey:@"a"]);
+    XCTAssertNotNil([cache imageForKey:@"c"]);
+    XCTAssertNotNil([cache imageForKey:@"d"]);
+
+    // Now "a" is the least recently used one
+    [cache setImage:self.image forKey:@"e" pdfURL:nil];
+    XCTAssertNil([cache imageForKey:@"a"]);
+    XCTAssertNotNil([cache imageForKey:@"e"]);
+}
+
+- (void)testAccountsForTheCostOfTheImages
+{
+    OHRenderCache* cache = [OHRenderCache new];
+    cache.totalCostLimit = 4 * self.cost;
+    [cache setImage:self.image forKey:@"a" pdfURL:nil];
+    [cache setImage:self.image forKey:@"b" pdfURL:nil];
+    XCTAssertEqual(cache.totalCost, 2 * self.cost);
+
+    // Replacing an image charges its new cost instead of adding it
+    UIImage* largerImage = OHTestImage(24);
+    [cache setImage:largerImage forKey:@"a" pdfURL:nil];
+    XCTAssertEqual(cache.count, 2u);
+    XCTAssertEqual(cache.totalCost, self.cost + OHTestImageCost(largerImage));
+    XCTAssertEqual([cache imageForKey:@"a"], largerImage);
+
+    // An image larger than the whole budget is not stored, and doesn't evict anything
+    UIImage* hugeImage = OHTestImage(64);
+    XCTAssertGreaterThan(OHTestImageCost(hugeImage), cache.totalCostLimit);
+    [cache setImage:hugeImage forKey:@"huge" pdfURL:nil];
+    XCTAssertNil([cache imageForKey:@"huge"]);
+    XCTAssertEqual(cache.count, 2u);
+
+    // Lowering the limit evicts down to it, starting with the least recently used image
+    [cache imageForKey:@"b"];
+    cache.totalCostLimit = self.cost;
+    XCTAssertEqual(cache.count, 1u);
+    XCTAssertEqual(cache.totalCost, self.cost);
+    XCTAssertNotNil([cache imageForKey:@"b"]);
+
+    // A zero limit disables the cache
+    cache.totalCostLimit = 0;
+    [cache setImage:self.image forKey:@"c" pdfURL:nil];
+    XCTAssertEqual(cache.count, 0u);
+    XCTAssertEqual(cache.totalCost, 0u);
+}
+
+- (void)testCountsHitsAndMisses
+{
+    OHRenderCache* cache = [OHRenderCache new];
+    [cache setImage:self.image forKey:@"a" pdfURL:nil];
+    [cache imageForKey:@"a"];
+    [cache imageForKey:@"a"];
+    [cache imageForKey:@"missing"];
+    XCTAssertEqual(cache.hitCount, 2u);
+    XCTAssertEqual(cache.missCount, 1u);
+
+    [cache resetStatistics];
+    XCTAssertEqual(cache.hitCount, 0u);
+    XCTAssertEqual(cache.missCount, 0u);
+    XCTAssertEqual(cache.count, 1u);
+}
+
+- (void)testRemovesImagesOfAPDF
+{
+    OHRenderCache* cache = [OHRenderCache new];
+    NSURL* firstURL = [NSURL fileURLWithPath:@"/first.pdf"];
+    NSURL* secondURL = [NSURL fileURLWithPath:@"/second.pdf"];
+    [cache setImage:self.image forKey:@"a" pdfURL:firstURL];
+    [cache setImage:self.image forKey:@"b" pdfURL:secondURL];
+    [cache setImage:self.image forKey:@"c" pdfURL:firstURL];
+
+    [cache removeImagesForPDFURL:firstURL];
+    XCTAssertEqual(cache.count, 1u);
+    XCTAssertEqual(cache.totalCost, self.cost);
+    XCTAssertNotNil([cache imageForKey:@"b"]);
+}
+
+- (void)testRemovesAllImages
+{
+    OHRenderCache* cache = [OHRenderCache new];
+    // Enough entries to overflow the stack if the LRU list was released recursively
+    cache.totalCostLimit = NSUIntegerMax;
+    for (NSUInteger idx = 0; idx < 100000; ++idx)
+    {
+        [cache setImage:self.image forKey:@(idx).stringValue pdfURL:nil];
+    }
+    [cache removeAllImages];
+    XCTAssertEqual(cache.count, 0u);
+    XCTAssertEqual(cache.totalCost, 0u);
+
+    // The cache is still usable afterwards
+    [cache setImage:self.image forKey:@"a" pdfURL:nil];
+    [cache setImage:self.image forKey:@"b" pdfURL:nil];
+    XCTAssertEqual(cache.totalCost, 2 * self.cost);
+}
+
+- (void)testPurgesOnMemoryWarnings
+{
+    OHRenderCache* cache = [OHRenderCache new];
+    [cache setImage:self.image forKey:@"a" pdfURL:nil];
+    [[NSNotificationCenter defaultCenter] postNotificationName:UIApplicationDidReceiveMemoryWarningNotification
+                                                        object:[UIApplication sharedApplication]];
+    XCTAssertEqual(cache.count, 0u);
+    XCTAssertEqual(cache.totalCost, 0u);
+}
+
+@end
@@ -0,0 +1,307 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#if !defined(__APPLE__) && !defined(_POSIX_C_SOURCE)
+  #define _POSIX_C_SOURCE 200809L /* For pthreads in strict C99 mode */
+#endif
+#include "OHBitmapPool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+// Size classes: 4KB, then 4 classes per power of two up to 16MB
+#define OH_POOL_MIN_SHIFT 12
+#define OH_POOL_MAX_SHIFT 24
+#define OH_POOL_STEPS 4
+#define OH_POOL_CLASSES ((OH_POOL_MAX_SHIFT - OH_POOL_MIN_SHIFT) * OH_POOL_STEPS + 1)
+
+// The header stored before each buffer, padded so that buffers stay 16-byte aligned
+#define OH_POOL_HEADER_SIZE 64
+
+typedef struct OHPoolBlock {
+    struct OHPoolBlock* next;
+    size_t capacity;
+    size_t dirtyStart, dirtyEnd; // The bytes not known to be zero
+    int sizeClass;               // -1 for buffers too large to be pooled
+} OHPoolBlock;
+
+/* The free lists of a thread. Its lock is only contended while trimming. */
+typedef struct OHPoolCache {
+    pthread_mutex_t lock;
+    OHPoolBlock* freeLists[OH_POOL_CLASSES];
+    struct OHPoolCache* previous;
+    struct OHPoolCache* next;
+} OHPoolCache;
+
+static pthread_once_t sCacheKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t sCacheKey;
+static pthread_mutex_t sCachesLock = PTHREAD_MUTEX_INITIALIZER; // Protects sCaches
+static OHPoolCache* sCaches;
+
+static size_t sMaxRetainedBytes = 16 * 1024 * 1024;
+static OHBitmapPoolStats sStats;
+
+#define OH_ATOMIC_ADD(counter, value) __atomic_add_fetch(&(counter), (value), __ATOMIC_RELAXED)
+#define OH_ATOMIC_SUB(counter, value) __atomic_sub_fetch(&(counter), (value), __ATOMIC_RELAXED)
+#define OH_ATOMIC_LOAD(counter) __atomic_load_n(&(counter), __ATOMIC_RELAXED)
+
+// MARK: - Size classes
+
+/**
+ *  Returns the size class of a size, and its capacity, or -1 if the size is too large to be pooled.
+ */
+static int OHPoolSizeClass(size_t size, size_t* capacity)
+{
+    if (size <= ((size_t)1 << OH_POOL_MIN_SHIFT))
+    {
+        *capacity = (size_t)1 << OH_POOL_MIN_SHIFT;
+        return 0;
+    }
+    if (size > ((size_t)1 << OH_POOL_MAX_SHIFT)) return -1;
+    
+    // 2^shift < size <= 2^(shift+1), split in OH_POOL_STEPS classes
+    int shift = OH_POOL_MIN_SHIFT;
+    while (((size_t)1 << (shift + 1)) < size) ++shift;
+    size_t base = (size_t)1 << shift, step = base / OH_POOL_STEPS;
+    size_t stepIndex = (size - base + step - 1) / step;
+    *capacity = base + stepIndex * step;
+    return (shift - OH_POOL_MIN_SHIFT) * OH_POOL_STEPS + (int)stepIndex;
+}
+
+static OHPoolBlock* OHPoolBlockForBuffer(void* buffer)
+{
+    return (OHPoolBlock*)((uint8_t*)buffer - OH_POOL_HEADER_SIZE);
+}
+
+static void* OHPoolBufferForBlock(OHPoolBlock* block)
+{
+    return (uint8_t*)block + OH_POOL_HEADER_SIZE;
+}
+
+// MARK: - Per-thread caches
+
+/**
+ *  Frees all the blocks of a cache, whose lock must be held. Returns the number of bytes freed.
+ */
+static size_t OHPoolCacheEmpty(OHPoolCache* cache)
+{
+    size_t freedBytes = 0;
+    for (size_t sizeClass = 0; sizeClass < OH_POOL_CLASSES; ++sizeClass)
+    {
+        OHPoolBlock* block = cache->freeLists[sizeClass];
+        cache->freeLists[sizeClass] = NULL;
+        while (block)
+        {
+            OHPoolBlock* next = block->next;
+            freedBytes += block->capacity;
+            OH_ATOMIC_SUB(sStats.retainedBytes, block->capacity);
+            OH_ATOMIC_SUB(sStats.retainedBuffers, 1);
+            free(block);
+            block = next;
+        }
+    }
+    return freedBytes;
+}
+
+/* Called when a thread exits: its free lists are freed */
+static void OHPoolCacheDestroy(void* value)
+{
+    OHPoolCache* cache = value;
+    pthread_mutex_lock(&sCachesLock);
+    if (cache->previous) cache->previous->next = cache->next;
+    else sCaches = cache->next;
+    if (cache->next) cache->next->previous = cache->previous;
+    pthread_mutex_unlock(&sCachesLock);
+    
+    pthread_mutex_lock(&cache->lock);
+    OHPoolCacheEmpty(cache);
+    pthread_mutex_unlock(&cache->lock);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static void OHPoolCreateCacheKey(void)
+{
+    pthread_key_create(&sCacheKey, OHPoolCacheDestroy);
+}
+
+/**
+ *  Returns the cache of the current thread, creating it if needed, or NULL if it could not be created.
+ */
+static OHPoolCache* OHPoolCurrentCache(void)
+{
+    pthread_once(&sCacheKeyOnce, OHPoolCreateCacheKey);
+    OHPoolCache* cache = pthread_getspecific(sCacheKey);
+    if (cache) return cache;
+    
+    cache = calloc(1, sizeof(*cache));
+    if (!cache) return NULL;
+    if (pthread_mutex_init(&cache->lock, NULL) != 0)
+    {
+        free(cache);
+        return NULL;
+    }
+    pthread_mutex_lock(&sCachesLock);
+    cache->next = sCaches;
+    if (sCaches) sCaches->previous = cache;
+    sCaches = cache;
+    pthread_mutex_unlock(&sCachesLock);
+    
+    if (pthread_setspecific(sCacheKey, cache) != 0)
+    {
+        OHPoolCacheDestroy(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+// MARK: - Acquiring and releasing buffers
+
+void* OHBitmapPoolAcquire(size_t size, int zeroed)
+{
+    size_t capacity = size;
+    int sizeClass = OHPoolSizeClass(size, &capacity);
+    
+    OHPoolBlock* block = NULL;
+    OHPoolCache* cache = (sizeClass >= 0) ? OHPoolCurrentCache() : NULL;
+    if (cache)
+    {
+        pthread_mutex_lock(&cache->lock);
+        block = cache->freeLists[sizeClass];
+        if (block) cache->freeLists[sizeClass] = block->next;
+        pthread_mutex_unlock(&cache->lock);
+    }
+    
+    if (block)
+    {
+        OH_ATOMIC_ADD(sStats.hits, 1);
+        OH_ATOMIC_SUB(sStats.retainedBytes, block->capacity);
+        OH_ATOMIC_SUB(sStats.retainedBuffers, 1);
+        if (zeroed && block->dirtyEnd > block->dirtyStart)
+        {
+            memset((uint8_t*)OHPoolBufferForBlock(block) + block->dirtyStart, 0, block->dirtyEnd - block->dirtyStart);
+            block->dirtyStart = block->dirtyEnd = 0;
+        }
+    }
+    else
+    {
+        OH_ATOMIC_ADD(sStats.misses, 1);
+        block = calloc(1, OH_POOL_HEADER_SIZE + capacity);
+        if (!block) return NULL;
+        block->capacity = capacity;
+        block->sizeClass = sizeClass;
+    }
+    block->next = NULL;
+    return OHPoolBufferForBlock(block);
+}
+
+void OHBitmapPoolRelease(void* buffer, size_t dirtyOffset, size_t dirtyLength)
+{
+    if (!buffer) return;
+    OHPoolBlock* block = OHPoolBlockForBuffer(buffer);
+    
+    // Buffers acquired without zeroing may still have dirty bytes from their previous use
+    if (dirtyLength > 0 && dirtyOffset < block->capacity)
+    {
+        size_t dirtyEnd = (dirtyLength > block->capacity - dirtyOffset) ? block->capacity : dirtyOffset + dirtyLength;
+        if (block->dirtyEnd > block->dirtyStart)
+        {
+            if (dirtyOffset < block->dirtyStart) block->dirtyStart = dirtyOffset;
+            if (dirtyEnd > block->dirtyEnd) block->dirtyEnd = dirtyEnd;
+        }
+        else
+        {
+            block->dirtyStart = dirtyOffset;
+            block->dirtyEnd = dirtyEnd;
+        }
+    }
+    
+    OHPoolCache* cache = (block->sizeClass >= 0) ? OHPoolCurrentCache() : NULL;
+    size_t maxRetainedBytes = __atomic_load_n(&sMaxRetainedBytes, __ATOMIC_RELAXED);
+    if (!cache || OH_ATOMIC_ADD(sStats.retainedBytes, block->capacity) > maxRetainedBytes)
+    {
+        if (cache) OH_ATOMIC_SUB(sStats.retainedBytes, block->capacity);
+        OH_ATOMIC_ADD(sStats.discardedBytes, block->capacity);
+        free(block);
+        return;
+    }
+    OH_ATOMIC_ADD(sStats.retainedBuffers, 1);
+    pthread_mutex_lock(&cache->lock);
+    block->next = cache->freeLists[block->sizeClass];
+    cache->freeLists[block->sizeClass] = block;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// MARK: - Budget
+
+void OHBitmapPoolTrim(void)
+{
+    size_t trimmedBytes = 0;
+    pthread_mutex_lock(&sCachesLock);
+    for (OHPoolCache* cache = sCaches; cache; cache = cache->next)
+    {
+        pthread_mutex_lock(&cache->lock);
+        trimmedBytes += OHPoolCacheEmpty(cache);
+        pthread_mutex_unlock(&cache->lock);
+    }
+    pthread_mutex_unlock(&sCachesLock);
+    OH_ATOMIC_ADD(sStats.trimmedBytes, trimmedBytes);
+}
+
+size_t OHBitmapPoolGetMaxRetainedBytes(void)
+{
+    return __atomic_load_n(&sMaxRetainedBytes, __ATOMIC_RELAXED);
+}
+
+void OHBitmapPoolSetMaxRetainedBytes(size_t maxRetainedBytes)
+{
+    size_t previousMax = __atomic_exchange_n(&sMaxRetainedBytes, maxRetainedBytes, __ATOMIC_RELAXED);
+    if (maxRetainedBytes < previousMax && OH_ATOMIC_LOAD(sStats.retainedBytes) > maxRetainedBytes)
+    {
+        OHBitmapPoolTrim();
+    }
+}
+
+// MARK: - Statistics
+
+void OHBitmapPoolGetStats(OHBitmapPoolStats* stats)
+{
+    if (!stats) return;
+    stats->hits = OH_ATOMIC_LOAD(sStats.hits);
+    stats->misses = OH_ATOMIC_LOAD(sStats.misses);
+    stats->retainedBytes = OH_ATOMIC_LOAD(sStats.retainedBytes);
+    stats->retainedBuffers = OH_ATOMIC_LOAD(sStats.retainedBuffers);
+    stats->discardedBytes = OH_ATOMIC_LOAD(sStats.discardedBytes);
+    stats->trimmedBytes = OH_ATOMIC_LOAD(sStats.trimmedBytes);
+}
+
+void OHBitmapPoolResetStats(void)
+{
+    __atomic_store_n(&sStats.hits, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&sStats.misses, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&sStats.discardedBytes, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&sStats.trimmedBytes, 0, __ATOMIC_RELAXED);
+}
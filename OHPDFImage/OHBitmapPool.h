@@ -0,0 +1,125 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+#ifndef OHPDFImage_OHBitmapPool_h
+#define OHPDFImage_OHBitmapPool_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***********************************************************************************/
+
+/*
+ *  A pool of pixel buffers, reused across renders instead of allocating
+ *  (and zero-filling) a new bitmap for every pass of every render.
+ *
+ *  Buffers are bucketed by size class (4 classes per power of two, from 4KB
+ *  to 16MB; larger buffers are not pooled). Released buffers are kept in free
+ *  lists owned by the releasing thread, so that concurrent renders never
+ *  contend on a shared lock. Each buffer remembers the byte range that was
+ *  written to, so that only this range is cleared when it is reused.
+ *
+ *  The pool retains at most `OHBitmapPoolGetMaxRetainedBytes()` bytes, and can
+ *  be emptied at any time (e.g. on memory warnings) using `OHBitmapPoolTrim`.
+ *  Like OHPixelKernels, this module is plain C with no dependency on Apple
+ *  frameworks; it uses POSIX threads.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  The statistics of the pool, to tune its budget.
+ */
+typedef struct {
+    uint64_t hits;              /* Buffers acquired from the free lists */
+    uint64_t misses;            /* Buffers acquired by allocating new memory */
+    uint64_t retainedBytes;     /* Bytes held by the free lists right now */
+    uint64_t retainedBuffers;   /* Buffers held by the free lists right now */
+    uint64_t discardedBytes;    /* Bytes of released buffers freed because they were over budget or not poolable */
+    uint64_t trimmedBytes;      /* Bytes freed by OHBitmapPoolTrim */
+} OHBitmapPoolStats;
+
+// MARK: - Acquiring and releasing buffers
+
+/**
+ *  Acquires a buffer from the pool, or allocates a new one if there is no
+ *  free buffer of the right size class.
+ *
+ *  @param size   The number of bytes needed
+ *  @param zeroed If non-zero, the buffer is filled with zeros. Otherwise its
+ *                content is undefined, for buffers the caller overwrites anyway.
+ *
+ *  @return A buffer of at least `size` bytes, aligned on 16 bytes, or NULL if
+ *          the memory could not be allocated. Release it using `OHBitmapPoolRelease`.
+ */
+void* OHBitmapPoolAcquire(size_t size, int zeroed);
+
+/**
+ *  Returns a buffer to the pool, from any thread.
+ *
+ *  @param buffer      The buffer, returned by `OHBitmapPoolAcquire`. May be NULL.
+ *  @param dirtyOffset The offset of the first byte written to since the buffer was acquired
+ *  @param dirtyLength The number of bytes written to (the whole size acquired if unknown),
+ *                     which are cleared when the buffer is reused as a zeroed buffer
+ */
+void OHBitmapPoolRelease(void* buffer, size_t dirtyOffset, size_t dirtyLength);
+
+// MARK: - Budget
+
+/**
+ *  Frees all the buffers held by the free lists of every thread.
+ *  Buffers currently acquired are not affected.
+ */
+void OHBitmapPoolTrim(void);
+
+/**
+ *  The maximum number of bytes retained by the free lists. Defaults to 16MB.
+ */
+size_t OHBitmapPoolGetMaxRetainedBytes(void);
+
+/**
+ *  Sets the maximum number of bytes retained by the free lists. Released buffers
+ *  that would exceed it are freed. Lowering it trims the pool. 0 disables pooling.
+ */
+void OHBitmapPoolSetMaxRetainedBytes(size_t maxRetainedBytes);
+
+// MARK: - Statistics
+
+/**
+ *  Copies the current statistics of the pool.
+ */
+void OHBitmapPoolGetStats(OHBitmapPoolStats* stats);
+
+/**
+ *  Resets the `hits`, `misses`, `discardedBytes` and `trimmedBytes` statistics to zero.
+ */
+void OHBitmapPoolResetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,490 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#include "OHDisplayList.h"
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+struct OHDisplayList {
+    uint8_t* ops;
+    size_t opCount;
+    size_t opCapacity;
+    float* operands;
+    size_t operandCount;
+    size_t operandCapacity;
+};
+
+/* The number of operands of each operation, -1 for variable (first operand + 2) */
+static int const kOperandCounts[OHDisplayListOpCount] = {
+    [OHDisplayListOpMoveTo] = 2,
+    [OHDisplayListOpLineTo] = 2,
+    [OHDisplayListOpCurveTo] = 6,
+    [OHDisplayListOpConcatCTM] = 6,
+    [OHDisplayListOpSetFillColor] = 4,
+    [OHDisplayListOpSetStrokeColor] = 4,
+    [OHDisplayListOpSetLineWidth] = 1,
+    [OHDisplayListOpSetLineCap] = 1,
+    [OHDisplayListOpSetLineJoin] = 1,
+    [OHDisplayListOpSetMiterLimit] = 1,
+    [OHDisplayListOpSetDash] = -1,
+};
+
+static int OHGrow(void** buffer, size_t* capacity, size_t needed, size_t elementSize)
+{
+    if (needed <= *capacity) return 0;
+    size_t newCapacity = *capacity ? *capacity : 64;
+    while (newCapacity < needed) newCapacity *= 2;
+    void* newBuffer = realloc(*buffer, newCapacity * elementSize);
+    if (!newBuffer) return -1;
+    *buffer = newBuffer;
+    *capacity = newCapacity;
+    return 0;
+}
+
+// MARK: - Display list
+
+OHDisplayList* OHDisplayListCreate(void)
+{
+    return calloc(1, sizeof(OHDisplayList));
+}
+
+void OHDisplayListRelease(OHDisplayList* list)
+{
+    if (!list) return;
+    free(list->ops);
+    free(list->operands);
+    free(list);
+}
+
+int OHDisplayListAppend(OHDisplayList* list, OHDisplayListOp op, const float* operands, size_t count)
+{
+    if (op >= OHDisplayListOpCount) return -1;
+    int expected = kOperandCounts[op];
+    if (expected >= 0 ? count != (size_t)expected : (count < 2 || count != (size_t)operands[0] + 2)) return -1;
+    
+    if (OHGrow((void**)&list->ops, &list->opCapacity, list->opCount + 1, sizeof(uint8_t)) != 0) return -1;
+    if (OHGrow((void**)&list->operands, &list->operandCapacity, list->operandCount + count, sizeof(float)) != 0) return -1;
+    
+    list->ops[list->opCount++] = (uint8_t)op;
+    if (count) memcpy(list->operands + list->operandCount, operands, count * sizeof(float));
+    list->operandCount += count;
+    return 0;
+}
+
+void OHDisplayListRemoveAll(OHDisplayList* list)
+{
+    list->opCount = 0;
+    list->operandCount = 0;
+}
+
+size_t OHDisplayListGetOpCount(const OHDisplayList* list)
+{
+    return list->opCount;
+}
+
+size_t OHDisplayListGetByteSize(const OHDisplayList* list)
+{
+    return list->opCount * sizeof(uint8_t) + list->operandCount * sizeof(float);
+}
+
+int OHDisplayListGetOperandCount(OHDisplayListOp op)
+{
+    return op < OHDisplayListOpCount ? kOperandCounts[op] : 0;
+}
+
+void OHDisplayListApply(const OHDisplayList* list, void* info, OHDisplayListApplierFunction applier)
+{
+    const float* operands = list->operands;
+    for (size_t idx = 0; idx < list->opCount; ++idx)
+    {
+        OHDisplayListOp op = (OHDisplayListOp)list->ops[idx];
+        int expected = kOperandCounts[op];
+        size_t count = expected >= 0 ? (size_t)expected : (size_t)operands[0] + 2;
+        applier(info, op, operands, count);
+        operands += count;
+    }
+}
+
+// MARK: - Builder
+
+typedef struct {
+    int fillComponents;
+    int strokeComponents;
+    float fillColor[3];
+    float strokeColor[3];
+    float fillAlpha;
+    float strokeAlpha;
+} OHBuilderState;
+
+struct OHDisplayListBuilder {
+    OHDisplayList* list;
+    OHDisplayList* path;    /* The path being built, emitted when painted or clipped */
+    OHBuilderState* states; /* states[stateCount-1] is the current state */
+    size_t stateCount;
+    size_t stateCapacity;
+    int pendingClip;        /* 0: none, 1: nonzero (W), 2: even-odd (W*) */
+    float currentX, currentY;
+    float subpathX, subpathY;
+    int failed;
+};
+
+static OHBuilderState* OHCurrentState(OHDisplayListBuilder* builder)
+{
+    return &builder->states[builder->stateCount - 1];
+}
+
+static void OHEmit(OHDisplayListBuilder* builder, OHDisplayListOp op, const float* operands, size_t count)
+{
+    if (OHDisplayListAppend(builder->list, op, operands, count) != 0) builder->failed = 1;
+}
+
+static void OHEmitColor(OHDisplayListBuilder* builder, int stroke)
+{
+    OHBuilderState* state = OHCurrentState(builder);
+    const float* rgb = stroke ? state->strokeColor : state->fillColor;
+    float rgba[4] = { rgb[0], rgb[1], rgb[2], stroke ? state->strokeAlpha : state->fillAlpha };
+    OHEmit(builder, stroke ? OHDisplayListOpSetStrokeColor : OHDisplayListOpSetFillColor, rgba, 4);
+}
+
+static void OHPathAppend(OHDisplayListBuilder* builder, OHDisplayListOp op, const float* operands, size_t count)
+{
+    if (OHDisplayListAppend(builder->path, op, operands, count) != 0) builder->failed = 1;
+}
+
+static void OHCopyPathOp(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    OHEmit((OHDisplayListBuilder*)info, op, operands, count);
+}
+
+/* Emits the current path followed by the painting operation (if any), then the
+ * pending clip (which, in PDF, applies after painting), and resets the path. */
+static void OHPaintPath(OHDisplayListBuilder* builder, int hasPaintOp, OHDisplayListOp paintOp)
+{
+    if (builder->path->opCount > 0)
+    {
+        if (hasPaintOp)
+        {
+            OHDisplayListApply(builder->path, builder, OHCopyPathOp);
+            OHEmit(builder, paintOp, NULL, 0);
+        }
+        if (builder->pendingClip)
+        {
+            OHDisplayListApply(builder->path, builder, OHCopyPathOp);
+            OHEmit(builder, builder->pendingClip == 2 ? OHDisplayListOpEOClip : OHDisplayListOpClip, NULL, 0);
+        }
+    }
+    builder->pendingClip = 0;
+    OHDisplayListRemoveAll(builder->path);
+}
+
+static void OHSetColor(OHDisplayListBuilder* builder, int stroke, int components, const double* operands)
+{
+    OHBuilderState* state = OHCurrentState(builder);
+    float* rgb = stroke ? state->strokeColor : state->fillColor;
+    switch (components)
+    {
+        case 1:
+            rgb[0] = rgb[1] = rgb[2] = (float)operands[0];
+            break;
+        case 3:
+            rgb[0] = (float)operands[0];
+            rgb[1] = (float)operands[1];
+            rgb[2] = (float)operands[2];
+            break;
+        case 4:
+        {
+            // Naive CMYK to RGB conversion, no color management
+            double k = 1.0 - operands[3];
+            rgb[0] = (float)((1.0 - operands[0]) * k);
+            rgb[1] = (float)((1.0 - operands[1]) * k);
+            rgb[2] = (float)((1.0 - operands[2]) * k);
+            break;
+        }
+        default:
+            builder->failed = 1;
+            return;
+    }
+    OHEmitColor(builder, stroke);
+}
+
+OHDisplayListBuilder* OHDisplayListBuilderCreate(void)
+{
+    OHDisplayListBuilder* builder = calloc(1, sizeof(OHDisplayListBuilder));
+    if (!builder) return NULL;
+    
+    builder->list = OHDisplayListCreate();
+    builder->path = OHDisplayListCreate();
+    builder->stateCapacity = 8;
+    builder->states = calloc(builder->stateCapacity, sizeof(OHBuilderState));
+    if (!builder->list || !builder->path || !builder->states)
+    {
+        OHDisplayListBuilderRelease(builder);
+        return NULL;
+    }
+    // Initial PDF graphics state: DeviceGray black, opaque
+    builder->stateCount = 1;
+    builder->states[0] = (OHBuilderState){
+        .fillComponents = 1, .strokeComponents = 1,
+        .fillAlpha = 1.f, .strokeAlpha = 1.f
+    };
+    return builder;
+}
+
+void OHDisplayListBuilderRelease(OHDisplayListBuilder* builder)
+{
+    if (!builder) return;
+    OHDisplayListRelease(builder->list);
+    OHDisplayListRelease(builder->path);
+    free(builder->states);
+    free(builder);
+}
+
+int OHDisplayListBuilderOperandCount(const OHDisplayListBuilder* builder, const char* op)
+{
+    static const struct { const char* op; int count; } kOperators[] = {
+        { "q", 0 }, { "Q", 0 }, { "cm", 6 },
+        { "w", 1 }, { "J", 1 }, { "j", 1 }, { "M", 1 }, { "ri", -2 }, { "i", 1 },
+        { "m", 2 }, { "l", 2 }, { "c", 6 }, { "v", 4 }, { "y", 4 }, { "h", 0 }, { "re", 4 },
+        { "S", 0 }, { "s", 0 }, { "f", 0 }, { "F", 0 }, { "f*", 0 },
+        { "B", 0 }, { "B*", 0 }, { "b", 0 }, { "b*", 0 }, { "n", 0 },
+        { "W", 0 }, { "W*", 0 },
+        { "g", 1 }, { "G", 1 }, { "rg", 3 }, { "RG", 3 }, { "k", 4 }, { "K", 4 },
+    };
+    
+    if (strcmp(op, "sc") == 0 || strcmp(op, "scn") == 0)
+    {
+        const OHBuilderState* state = &builder->states[builder->stateCount - 1];
+        return state->fillComponents > 0 ? state->fillComponents : -1;
+    }
+    if (strcmp(op, "SC") == 0 || strcmp(op, "SCN") == 0)
+    {
+        const OHBuilderState* state = &builder->states[builder->stateCount - 1];
+        return state->strokeComponents > 0 ? state->strokeComponents : -1;
+    }
+    for (size_t idx = 0; idx < sizeof(kOperators)/sizeof(kOperators[0]); ++idx)
+    {
+        if (strcmp(op, kOperators[idx].op) == 0)
+        {
+            // "ri" takes a name operand, which we don't need: no numeric operands
+            return kOperators[idx].count == -2 ? 0 : kOperators[idx].count;
+        }
+    }
+    return -1;
+}
+
+void OHDisplayListBuilderApplyOperator(OHDisplayListBuilder* builder, const char* op,
+                                       const double* operands, size_t count)
+{
+    if (builder->failed) return;
+    int expected = OHDisplayListBuilderOperandCount(builder, op);
+    if (expected < 0 || (size_t)expected != count)
+    {
+        builder->failed = 1;
+        return;
+    }
+    
+    float f[6];
+    for (size_t idx = 0; idx < count && idx < 6; ++idx) f[idx] = (float)operands[idx];
+    
+    switch (op[0])
+    {
+        // Graphics state
+        case 'q':
+        {
+            if (builder->stateCount == builder->stateCapacity)
+            {
+                OHBuilderState* states = realloc(builder->states, 2 * builder->stateCapacity * sizeof(OHBuilderState));
+                if (!states) { builder->failed = 1; return; }
+                builder->states = states;
+                builder->stateCapacity *= 2;
+            }
+            builder->states[builder->stateCount] = builder->states[builder->stateCount - 1];
+            builder->stateCount++;
+            OHEmit(builder, OHDisplayListOpSave, NULL, 0);
+            return;
+        }
+        case 'Q':
+            // Ignore unbalanced Q, like PDF renderers do
+            if (builder->stateCount > 1)
+            {
+                builder->stateCount--;
+                OHEmit(builder, OHDisplayListOpRestore, NULL, 0);
+            }
+            return;
+        case 'w': OHEmit(builder, OHDisplayListOpSetLineWidth, f, 1); return;
+        case 'J': OHEmit(builder, OHDisplayListOpSetLineCap, f, 1); return;
+        case 'j': OHEmit(builder, OHDisplayListOpSetLineJoin, f, 1); return;
+        case 'M': OHEmit(builder, OHDisplayListOpSetMiterLimit, f, 1); return;
+        case 'i': return; // Flatness tolerance: irrelevant for the display list
+        case 'r':
+            if (op[1] == 'i') return; // Rendering intent: ignored
+            if (op[1] == 'e')
+            {
+                // x y w h re  =>  m, 3 l, h
+                float p[2] = { f[0], f[1] };
+                OHPathAppend(builder, OHDisplayListOpMoveTo, p, 2);
+                p[0] = f[0] + f[2]; OHPathAppend(builder, OHDisplayListOpLineTo, p, 2);
+                p[1] = f[1] + f[3]; OHPathAppend(builder, OHDisplayListOpLineTo, p, 2);
+                p[0] = f[0];        OHPathAppend(builder, OHDisplayListOpLineTo, p, 2);
+                OHPathAppend(builder, OHDisplayListOpClosePath, NULL, 0);
+                builder->currentX = builder->subpathX = f[0];
+                builder->currentY = builder->subpathY = f[1];
+                return;
+            }
+            OHSetColor(builder, 0, 3, operands); // rg
+            OHCurrentState(builder)->fillComponents = 3;
+            return;
+        case 'c':
+            if (op[1] == 'm') { OHEmit(builder, OHDisplayListOpConcatCTM, f, 6); return; }
+            OHPathAppend(builder, OHDisplayListOpCurveTo, f, 6);
+            builder->currentX = f[4]; builder->currentY = f[5];
+            return;
+            
+        // Path construction
+        case 'm':
+            OHPathAppend(builder, OHDisplayListOpMoveTo, f, 2);
+            builder->currentX = builder->subpathX = f[0];
+            builder->currentY = builder->subpathY = f[1];
+            return;
+        case 'l':
+            OHPathAppend(builder, OHDisplayListOpLineTo, f, 2);
+            builder->currentX = f[0]; builder->currentY = f[1];
+            return;
+        case 'v':
+        {
+            // The first control point is the current point
+            float p[6] = { builder->currentX, builder->currentY, f[0], f[1], f[2], f[3] };
+            OHPathAppend(builder, OHDisplayListOpCurveTo, p, 6);
+            builder->currentX = f[2]; builder->currentY = f[3];
+            return;
+        }
+        case 'y':
+        {
+            // The second control point is the end point
+            float p[6] = { f[0], f[1], f[2], f[3], f[2], f[3] };
+            OHPathAppend(builder, OHDisplayListOpCurveTo, p, 6);
+            builder->currentX = f[2]; builder->currentY = f[3];
+            return;
+        }
+        case 'h':
+            OHPathAppend(builder, OHDisplayListOpClosePath, NULL, 0);
+            builder->currentX = builder->subpathX; builder->currentY = builder->subpathY;
+            return;
+            
+        // Painting & clipping
+        case 'S':
+            if (op[1] == 'C')
+            {
+                OHSetColor(builder, 1, OHCurrentState(builder)->strokeComponents, operands);
+                return;
+            }
+            OHPaintPath(builder, 1, OHDisplayListOpStroke);
+            return;
+        case 's':
+            if (op[1] == 'c') { OHSetColor(builder, 0, OHCurrentState(builder)->fillComponents, operands); return; }
+            OHPathAppend(builder, OHDisplayListOpClosePath, NULL, 0);
+            OHPaintPath(builder, 1, OHDisplayListOpStroke);
+            return;
+        case 'f':
+        case 'F':
+            OHPaintPath(builder, 1, op[1] == '*' ? OHDisplayListOpEOFill : OHDisplayListOpFill);
+            return;
+        case 'B':
+            OHPaintPath(builder, 1, op[1] == '*' ? OHDisplayListOpEOFillStroke : OHDisplayListOpFillStroke);
+            return;
+        case 'b':
+            OHPathAppend(builder, OHDisplayListOpClosePath, NULL, 0);
+            OHPaintPath(builder, 1, op[1] == '*' ? OHDisplayListOpEOFillStroke : OHDisplayListOpFillStroke);
+            return;
+        case 'n': OHPaintPath(builder, 0, OHDisplayListOpFill); return;
+        case 'W': builder->pendingClip = op[1] == '*' ? 2 : 1; return;
+            
+        // Colors
+        case 'g': OHSetColor(builder, 0, 1, operands); OHCurrentState(builder)->fillComponents = 1; return;
+        case 'G': OHSetColor(builder, 1, 1, operands); OHCurrentState(builder)->strokeComponents = 1; return;
+        case 'R': OHSetColor(builder, 1, 3, operands); OHCurrentState(builder)->strokeComponents = 3; return;
+        case 'k': OHSetColor(builder, 0, 4, operands); OHCurrentState(builder)->fillComponents = 4; return;
+        case 'K': OHSetColor(builder, 1, 4, operands); OHCurrentState(builder)->strokeComponents = 4; return;
+        default:
+            builder->failed = 1;
+            return;
+    }
+}
+
+void OHDisplayListBuilderSetColorSpace(OHDisplayListBuilder* builder, int stroke, int components)
+{
+    OHBuilderState* state = OHCurrentState(builder);
+    if (stroke) state->strokeComponents = components;
+    else state->fillComponents = components;
+    
+    if (components > 0)
+    {
+        // Selecting a color space resets the color to its initial value (black)
+        static double const kBlack[4] = { 0, 0, 0, 1 };
+        static double const kZeros[4] = { 0, 0, 0, 0 };
+        OHSetColor(builder, stroke, components, components == 4 ? kBlack : kZeros);
+    }
+}
+
+void OHDisplayListBuilderSetAlpha(OHDisplayListBuilder* builder, int stroke, double alpha)
+{
+    OHBuilderState* state = OHCurrentState(builder);
+    if (stroke) state->strokeAlpha = (float)alpha;
+    else state->fillAlpha = (float)alpha;
+    OHEmitColor(builder, stroke);
+}
+
+void OHDisplayListBuilderSetDash(OHDisplayListBuilder* builder, const double* lengths, size_t count, double phase)
+{
+    float* operands = malloc((count + 2) * sizeof(float));
+    if (!operands) { builder->failed = 1; return; }
+    operands[0] = (float)count;
+    operands[1] = (float)phase;
+    for (size_t idx = 0; idx < count; ++idx) operands[idx + 2] = (float)lengths[idx];
+    OHEmit(builder, OHDisplayListOpSetDash, operands, count + 2);
+    free(operands);
+}
+
+void OHDisplayListBuilderMarkUnsupported(OHDisplayListBuilder* builder)
+{
+    builder->failed = 1;
+}
+
+int OHDisplayListBuilderFailed(const OHDisplayListBuilder* builder)
+{
+    return builder->failed;
+}
+
+OHDisplayList* OHDisplayListBuilderCopyDisplayList(OHDisplayListBuilder* builder)
+{
+    // Balance the `q` operators not matched by a `Q` in the content stream
+    for (; builder->stateCount > 1; --builder->stateCount) OHEmit(builder, OHDisplayListOpRestore, NULL, 0);
+    if (builder->failed) return NULL;
+    OHDisplayList* list = builder->list;
+    builder->list = OHDisplayListCreate();
+    return list;
+}
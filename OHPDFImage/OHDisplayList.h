@@ -0,0 +1,218 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHPDFImage_OHDisplayList_h
+#define OHPDFImage_OHDisplayList_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***********************************************************************************/
+
+/*
+ *  A compact, replayable list of drawing operations (paths, fills, strokes,
+ *  clips, colors and transforms) compiled from the content stream of a PDF page.
+ *
+ *  Coordinates are stored as 32-bit floats in the PDF user space of the page,
+ *  so a display list can be replayed at any scale. Colors are stored as
+ *  straight (non-premultiplied) RGBA, with the PDF constant alpha (`ca`/`CA`)
+ *  already applied to their alpha component.
+ *
+ *  Like the display list itself, the builder implementing the PDF operators
+ *  semantics is plain C with no dependency on Apple frameworks, so that
+ *  compilation can be tested against recorded operator streams on any platform.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  The operations of a display list. The comment gives the operands of each one.
+ *
+ *  Path construction operations build the current path, which is consumed
+ *  (and reset) by the painting and clipping operations, like in CoreGraphics.
+ */
+typedef enum {
+    OHDisplayListOpMoveTo,          /* x, y */
+    OHDisplayListOpLineTo,          /* x, y */
+    OHDisplayListOpCurveTo,         /* cp1x, cp1y, cp2x, cp2y, x, y */
+    OHDisplayListOpClosePath,       /* - */
+    OHDisplayListOpFill,            /* - (nonzero winding rule) */
+    OHDisplayListOpEOFill,          /* - (even-odd rule) */
+    OHDisplayListOpStroke,          /* - */
+    OHDisplayListOpFillStroke,      /* - */
+    OHDisplayListOpEOFillStroke,    /* - */
+    OHDisplayListOpClip,            /* - (nonzero winding rule) */
+    OHDisplayListOpEOClip,          /* - (even-odd rule) */
+    OHDisplayListOpSave,            /* - */
+    OHDisplayListOpRestore,         /* - */
+    OHDisplayListOpConcatCTM,       /* a, b, c, d, tx, ty */
+    OHDisplayListOpSetFillColor,    /* r, g, b, a */
+    OHDisplayListOpSetStrokeColor,  /* r, g, b, a */
+    OHDisplayListOpSetLineWidth,    /* width */
+    OHDisplayListOpSetLineCap,      /* cap (0 butt, 1 round, 2 square) */
+    OHDisplayListOpSetLineJoin,     /* join (0 miter, 1 round, 2 bevel) */
+    OHDisplayListOpSetMiterLimit,   /* limit */
+    OHDisplayListOpSetDash,         /* count, phase, length[0] … length[count-1] */
+    OHDisplayListOpCount
+} OHDisplayListOp;
+
+typedef struct OHDisplayList OHDisplayList;
+
+// MARK: - Display list
+
+/**
+ *  Creates an empty display list. Release it using `OHDisplayListRelease`.
+ */
+OHDisplayList* OHDisplayListCreate(void);
+
+/**
+ *  Releases a display list created by `OHDisplayListCreate`.
+ */
+void OHDisplayListRelease(OHDisplayList* list);
+
+/**
+ *  Appends an operation to the display list.
+ *
+ *  @param list     The display list
+ *  @param op       The operation to append
+ *  @param operands The operands of the operation (see `OHDisplayListOp`)
+ *  @param count    The number of operands. Must match the operation.
+ *
+ *  @return 0 on success, -1 if the operands count is wrong or on allocation failure.
+ */
+int OHDisplayListAppend(OHDisplayList* list, OHDisplayListOp op, const float* operands, size_t count);
+
+/**
+ *  Removes all the operations of the display list, keeping its allocated memory.
+ */
+void OHDisplayListRemoveAll(OHDisplayList* list);
+
+/**
+ *  The number of operations in the display list.
+ */
+size_t OHDisplayListGetOpCount(const OHDisplayList* list);
+
+/**
+ *  The number of bytes used by the operations and operands of the display list.
+ */
+size_t OHDisplayListGetByteSize(const OHDisplayList* list);
+
+/**
+ *  The number of operands of an operation, or -1 for `OHDisplayListOpSetDash`
+ *  whose number of operands is variable (its first operand + 2).
+ */
+int OHDisplayListGetOperandCount(OHDisplayListOp op);
+
+/**
+ *  The function called for each operation of a display list by `OHDisplayListApply`.
+ */
+typedef void (*OHDisplayListApplierFunction)(void* info, OHDisplayListOp op,
+                                             const float* operands, size_t count);
+
+/**
+ *  Calls the applier function for each operation of the display list, in order.
+ */
+void OHDisplayListApply(const OHDisplayList* list, void* info, OHDisplayListApplierFunction applier);
+
+// MARK: - Builder
+
+typedef struct OHDisplayListBuilder OHDisplayListBuilder;
+
+/**
+ *  Creates a builder translating PDF content stream operators into a display list.
+ *
+ *  The builder handles the PDF semantics that differ from the display list:
+ *  `v`/`y`/`re` path shortcuts, clipping paths applied after painting (`W n`),
+ *  color spaces (gray, RGB and CMYK, converted to RGB), constant alpha, and
+ *  the corresponding graphics state stack.
+ */
+OHDisplayListBuilder* OHDisplayListBuilderCreate(void);
+
+/**
+ *  Releases a builder, and its display list if it was not taken with
+ *  `OHDisplayListBuilderCopyDisplayList`.
+ */
+void OHDisplayListBuilderRelease(OHDisplayListBuilder* builder);
+
+/**
+ *  Returns the number of numeric operands expected by a PDF operator in the
+ *  current state of the builder (e.g. 3 for `rg`, or the number of components
+ *  of the current color space for `sc`), or -1 if the operator is not supported.
+ */
+int OHDisplayListBuilderOperandCount(const OHDisplayListBuilder* builder, const char* op);
+
+/**
+ *  Applies a PDF operator with numeric operands, in the order they appear
+ *  in the content stream (e.g. `1 0 0 rg` is passed as { 1, 0, 0 }).
+ *
+ *  Operators not supported by the display list (text, images, shadings, XObjects…)
+ *  mark the builder as failed.
+ */
+void OHDisplayListBuilderApplyOperator(OHDisplayListBuilder* builder, const char* op,
+                                       const double* operands, size_t count);
+
+/**
+ *  Sets the number of components of the fill (`cs`) or stroke (`CS`) color space,
+ *  and resets the corresponding color to black. Use 1 for gray, 3 for RGB, 4 for
+ *  CMYK, and 0 for unsupported color spaces (which fail the build when used).
+ */
+void OHDisplayListBuilderSetColorSpace(OHDisplayListBuilder* builder, int stroke, int components);
+
+/**
+ *  Sets the constant alpha for fills (`ca`) or strokes (`CA`), from an ExtGState.
+ */
+void OHDisplayListBuilderSetAlpha(OHDisplayListBuilder* builder, int stroke, double alpha);
+
+/**
+ *  Sets the dash pattern (`d` operator).
+ */
+void OHDisplayListBuilderSetDash(OHDisplayListBuilder* builder, const double* lengths, size_t count, double phase);
+
+/**
+ *  Marks the builder as failed, e.g. when encountering an operator or a
+ *  resource the display list can't represent.
+ */
+void OHDisplayListBuilderMarkUnsupported(OHDisplayListBuilder* builder);
+
+/**
+ *  Returns non-zero if the content could not be compiled into a display list.
+ */
+int OHDisplayListBuilderFailed(const OHDisplayListBuilder* builder);
+
+/**
+ *  Takes the built display list out of the builder. Its Save and Restore
+ *  operations are balanced, even if the content stream's `q` and `Q` were not.
+ *
+ *  @return The display list, owned by the caller, or NULL if the builder failed.
+ */
+OHDisplayList* OHDisplayListBuilderCopyDisplayList(OHDisplayListBuilder* builder);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
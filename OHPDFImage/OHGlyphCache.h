@@ -0,0 +1,143 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <Foundation/Foundation.h>
+#import <CoreText/CoreText.h>
+
+/***********************************************************************************/
+
+/**
+ *  An element of a glyph outline, in text space units (i.e. for a font size of 1).
+ *  Quadratic curves are converted to cubic ones, so `op` is one of the path
+ *  construction operators of the PDF content streams: 'm', 'l', 'c' or 'h'.
+ */
+typedef struct {
+    char op;
+    float points[6];
+} OHGlyphOutlineElement;
+
+/**
+ *  A font program embedded in a PDF (TrueType or OpenType), loaded once per process.
+ */
+@interface OHGlyphFont : NSObject
+
+/**
+ *  The font, at a size of 1.
+ */
+@property(nonatomic, assign, readonly) CTFontRef fontRef;
+
+/**
+ *  Returns the glyph with the given PostScript name (as used by the `Differences`
+ *  of a PDF font encoding), or 0 if the font has no such glyph.
+ */
+- (CGGlyph)glyphWithName:(NSString*)name;
+
+/**
+ *  Returns the glyph mapped to a character by the cmap of the font, or 0 if none.
+ */
+- (CGGlyph)glyphForCharacter:(UniChar)character;
+
+@end
+
+/***********************************************************************************/
+
+/**
+ *  A process-wide, bounded cache of the font programs embedded in PDF files and
+ *  of the outlines of their glyphs, keyed by (font program, glyph id).
+ *
+ *  `OHPDFDisplayList` compiles the text of a page into the outlines of its glyphs,
+ *  taken from this cache, so that a font embedded in many PDFs (like an icon font
+ *  exported as one PDF per icon) is parsed once, and each of its glyphs is
+ *  extracted once, however many times it is used.
+ *
+ *  Font programs are identified by their content, not by the PDF object embedding
+ *  them, so the entries stay valid after the PDF documents are released.
+ */
+@interface OHGlyphCache : NSObject
+
+/**
+ *  The maximum number of bytes of glyph outlines the cache can hold
+ *  before it starts evicting outlines.
+ *
+ *  Defaults to 1MB. Setting it to 0 disables the caching of the outlines.
+ */
+@property(nonatomic, assign) NSUInteger totalCostLimit;
+/**
+ *  The number of outline lookups that found the outline in the cache.
+ */
+@property(nonatomic, readonly) NSUInteger hitCount;
+/**
+ *  The number of outline lookups that had to extract the outline from its font.
+ */
+@property(nonatomic, readonly) NSUInteger missCount;
+
+#pragma mark - Constructor
+
+/**
+ *  The cache used by `OHPDFDisplayList`.
+ *
+ *  @return The shared glyph cache.
+ */
++ (instancetype)sharedCache;
+
+#pragma mark - Accessing fonts and glyphs
+
+/**
+ *  Returns the font for a font program embedded in a PDF (the decoded content of
+ *  the `FontFile2` or OpenType `FontFile3` stream of a font descriptor), loading
+ *  it only if an identical program was not loaded before.
+ *
+ *  @param program The font program
+ *
+ *  @return The font, or `nil` if the program can't be loaded.
+ */
+- (OHGlyphFont*)fontWithProgram:(NSData*)program;
+
+/**
+ *  Returns the outline of a glyph, as an array of `OHGlyphOutlineElement`.
+ *
+ *  @param glyph The glyph id
+ *  @param font  The font of the glyph, returned by `fontWithProgram:`
+ *
+ *  @return The outline of the glyph, which is empty for glyphs without
+ *          outline (like spaces), or `nil` if the glyph does not exist.
+ */
+- (NSData*)outlineOfGlyph:(CGGlyph)glyph inFont:(OHGlyphFont*)font;
+
+#pragma mark - Purging the cache
+
+/**
+ *  Removes every font and outline from the cache.
+ *
+ *  @note The cache is also purged automatically under memory pressure.
+ */
+- (void)removeAllGlyphs;
+
+/**
+ *  Resets the `hitCount` and `missCount` counters to zero.
+ */
+- (void)resetStatistics;
+
+@end
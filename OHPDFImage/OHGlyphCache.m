@@ -0,0 +1,255 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "OHGlyphCache.h"
+
+/***********************************************************************************/
+
+static NSUInteger const kDefaultTotalCostLimit = 1024 * 1024;
+static NSUInteger const kFontCacheCountLimit = 16;
+
+/**
+ *  Identifies a font program by its content (64-bit FNV-1a hash and length).
+ */
+static NSString* OHFontProgramKey(NSData* program)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const uint8_t* bytes = program.bytes;
+    for (NSUInteger idx = 0; idx < program.length; ++idx)
+    {
+        hash = (hash ^ bytes[idx]) * 1099511628211ULL;
+    }
+    return [NSString stringWithFormat:@"%016llx-%lu", hash, (unsigned long)program.length];
+}
+
+/***********************************************************************************/
+
+@interface OHGlyphFont()
+@property(nonatomic, copy) NSString* key;
+@end
+
+@implementation OHGlyphFont
+{
+    CGFontRef _graphicsFont;
+}
+
+- (instancetype)initWithProgram:(NSData*)program key:(NSString*)key
+{
+    self = [super init];
+    if (self)
+    {
+        CGDataProviderRef provider = CGDataProviderCreateWithCFData((__bridge CFDataRef)program);
+        _graphicsFont = provider ? CGFontCreateWithDataProvider(provider) : NULL;
+        CGDataProviderRelease(provider);
+        if (!_graphicsFont) return nil;
+        _fontRef = CTFontCreateWithGraphicsFont(_graphicsFont, 1.0, NULL, NULL);
+        if (!_fontRef) return nil;
+        _key = [key copy];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fontRef) CFRelease(_fontRef);
+    CGFontRelease(_graphicsFont);
+}
+
+- (CGGlyph)glyphWithName:(NSString*)name
+{
+    return name ? CGFontGetGlyphWithGlyphName(_graphicsFont, (__bridge CFStringRef)name) : 0;
+}
+
+- (CGGlyph)glyphForCharacter:(UniChar)character
+{
+    CGGlyph glyph = 0;
+    return CTFontGetGlyphsForCharacters(_fontRef, &character, &glyph, 1) ? glyph : 0;
+}
+
+@end
+
+/***********************************************************************************/
+
+typedef struct {
+    __unsafe_unretained NSMutableData* elements;
+    CGPoint currentPoint;
+} OHOutlineBuilder;
+
+static void OHAppendOutlineElement(OHOutlineBuilder* builder, char op, const CGPoint* points, int count)
+{
+    OHGlyphOutlineElement element = { .op = op };
+    for (int idx = 0; idx < count; ++idx)
+    {
+        element.points[2*idx]   = (float)points[idx].x;
+        element.points[2*idx+1] = (float)points[idx].y;
+    }
+    if (count > 0) builder->currentPoint = points[count-1];
+    [builder->elements appendBytes:&element length:sizeof(element)];
+}
+
+static void OHApplyPathElement(void* info, const CGPathElement* element)
+{
+    OHOutlineBuilder* builder = (OHOutlineBuilder*)info;
+    const CGPoint* points = element->points;
+    switch (element->type)
+    {
+        case kCGPathElementMoveToPoint:
+            OHAppendOutlineElement(builder, 'm', points, 1);
+            break;
+        case kCGPathElementAddLineToPoint:
+            OHAppendOutlineElement(builder, 'l', points, 1);
+            break;
+        case kCGPathElementAddQuadCurveToPoint:
+        {
+            // The cubic curve with the same shape: control points 2/3 of the way to the quadratic one
+            CGPoint p0 = builder->currentPoint;
+            CGPoint cubic[3] = {
+                { p0.x + 2.0/3.0 * (points[0].x - p0.x), p0.y + 2.0/3.0 * (points[0].y - p0.y) },
+                { points[1].x + 2.0/3.0 * (points[0].x - points[1].x), points[1].y + 2.0/3.0 * (points[0].y - points[1].y) },
+                points[1]
+            };
+            OHAppendOutlineElement(builder, 'c', cubic, 3);
+            break;
+        }
+        case kCGPathElementAddCurveToPoint:
+            OHAppendOutlineElement(builder, 'c', points, 3);
+            break;
+        case kCGPathElementCloseSubpath:
+            OHAppendOutlineElement(builder, 'h', NULL, 0);
+            break;
+    }
+}
+
+/***********************************************************************************/
+
+@interface OHGlyphCache()
+@property(nonatomic, strong) NSCache* fonts;
+@property(nonatomic, strong) NSCache* outlines;
+@property(nonatomic, assign, readwrite) NSUInteger hitCount;
+@property(nonatomic, assign, readwrite) NSUInteger missCount;
+@end
+
+@implementation OHGlyphCache
+
+#pragma mark - Constructor
+
++ (instancetype)sharedCache
+{
+    static OHGlyphCache* sharedCache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedCache = [self new];
+    });
+    return sharedCache;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _fonts = [NSCache new];
+        _fonts.countLimit = kFontCacheCountLimit;
+        _outlines = [NSCache new];
+        _outlines.totalCostLimit = kDefaultTotalCostLimit;
+    }
+    return self;
+}
+
+- (NSUInteger)totalCostLimit
+{
+    return self.outlines.totalCostLimit;
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    // NSCache treats a limit of 0 as no limit
+    self.outlines.totalCostLimit = totalCostLimit;
+    if (totalCostLimit == 0) [self.outlines removeAllObjects];
+}
+
+#pragma mark - Accessing fonts and glyphs
+
+- (OHGlyphFont*)fontWithProgram:(NSData*)program
+{
+    if (program.length == 0) return nil;
+    
+    NSString* key = OHFontProgramKey(program);
+    OHGlyphFont* font = [self.fonts objectForKey:key];
+    if (!font)
+    {
+        font = [[OHGlyphFont alloc] initWithProgram:program key:key];
+        if (font) [self.fonts setObject:font forKey:key];
+    }
+    return font;
+}
+
+- (NSData*)outlineOfGlyph:(CGGlyph)glyph inFont:(OHGlyphFont*)font
+{
+    if (!font || glyph >= CTFontGetGlyphCount(font.fontRef)) return nil;
+    
+    NSString* key = [NSString stringWithFormat:@"%@#%u", font.key, (unsigned)glyph];
+    NSData* outline = [self.outlines objectForKey:key];
+    @synchronized(self)
+    {
+        if (outline) self.hitCount++; else self.missCount++;
+    }
+    if (outline) return outline;
+    
+    NSMutableData* elements = [NSMutableData new];
+    CGPathRef path = CTFontCreatePathForGlyph(font.fontRef, glyph, NULL);
+    if (path)
+    {
+        OHOutlineBuilder builder = { .elements = elements };
+        CGPathApply(path, &builder, OHApplyPathElement);
+        CGPathRelease(path);
+    }
+    outline = [elements copy];
+    if (self.totalCostLimit > 0)
+    {
+        // Empty outlines cost their key, so that spaces are not extracted again
+        [self.outlines setObject:outline forKey:key cost:MAX(outline.length, key.length)];
+    }
+    return outline;
+}
+
+#pragma mark - Purging the cache
+
+- (void)removeAllGlyphs
+{
+    [self.fonts removeAllObjects];
+    [self.outlines removeAllObjects];
+}
+
+- (void)resetStatistics
+{
+    @synchronized(self)
+    {
+        self.hitCount = 0;
+        self.missCount = 0;
+    }
+}
+
+@end
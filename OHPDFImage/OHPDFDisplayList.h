@@ -0,0 +1,98 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <Foundation/Foundation.h>
+#import <QuartzCore/QuartzCore.h>
+#import "OHDisplayList.h"
+@class OHPDFPage;
+
+/***********************************************************************************/
+
+/**
+ *  The content of a PDF page, compiled once into a display list
+ *  (see `OHDisplayList.h`) that can then be replayed in any graphic
+ *  context, at any scale, without parsing the PDF content stream again.
+ *
+ *  Only vector content is supported: paths, fills, strokes, clipping,
+ *  transforms, gray/RGB/CMYK colors and constant alpha. Text is supported
+ *  when its fonts embed a TrueType or OpenType program (simple fonts, or
+ *  Type0 fonts with the Identity-H encoding), and is compiled into the
+ *  outlines of its glyphs, taken from the shared `OHGlyphCache`. Pages using
+ *  other fonts, clipping text, images, shadings, patterns, XObjects, soft masks
+ *  or blend modes can't be compiled, and must be drawn using `CGContextDrawPDFPage` instead.
+ */
+@interface OHPDFDisplayList : NSObject
+
+/**
+ *  The compiled display list. Owned by the receiver.
+ */
+@property(nonatomic, assign, readonly) const OHDisplayList* listRef;
+/**
+ *  The number of operations in the display list.
+ */
+@property(nonatomic, assign, readonly) NSUInteger operationsCount;
+/**
+ *  The memory used by the display list, in bytes.
+ */
+@property(nonatomic, assign, readonly) NSUInteger byteSize;
+/**
+ *  The crop box of the page the display list was compiled from.
+ */
+@property(nonatomic, assign, readonly) CGRect cropBox;
+
+#pragma mark - Constructor
+
+/**
+ *  Compile the content stream of a PDF page into a display list.
+ *
+ *  @param page The PDF page to compile
+ *
+ *  @return The compiled display list, or `nil` if the page uses content
+ *          that the display list does not support.
+ */
++ (instancetype)displayListWithPage:(OHPDFPage*)page;
+
+/**
+ *  Wrap a display list that was already compiled, e.g. decoded from a
+ *  vector pack (see `OHVectorPack`).
+ *
+ *  @param list    The display list. The returned object takes ownership of it.
+ *  @param cropBox The crop box of the page the display list was compiled from
+ *
+ *  @return The display list object, or `nil` if `list` is NULL.
+ */
++ (instancetype)displayListWithList:(OHDisplayList*)list cropBox:(CGRect)cropBox;
+
+#pragma mark - Drawing in a graphic context
+
+/**
+ *  Replays the display list in a Graphic Context, in the PDF user space,
+ *  clipped to the crop box, exactly like `CGContextDrawPDFPage` would.
+ *
+ *  @param context The context to draw the display list into
+ */
+- (void)drawInContext:(CGContextRef)context;
+
+@end
@@ -0,0 +1,891 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "OHPDFDisplayList.h"
+#import "OHPDFPage.h"
+#import "OHGlyphCache.h"
+
+/***********************************************************************************/
+
+@class OHPDFTextFont;
+
+/**
+ *  The text state parameters, which are saved and restored by `q` and `Q`
+ *  like the rest of the graphics state.
+ */
+typedef struct {
+    __unsafe_unretained OHPDFTextFont* font; // Owned by OHScanContext.fonts, nil if not supported
+    CGFloat fontSize, charSpacing, wordSpacing, horizontalScaling, leading, rise;
+    int renderingMode;
+} OHTextState;
+
+typedef struct {
+    OHDisplayListBuilder* builder;
+    CGPDFContentStreamRef contentStream;
+    OHTextState textState;
+    OHTextState* textStateStack;
+    size_t textStateStackCount;
+    CGAffineTransform textMatrix, textLineMatrix;
+    __unsafe_unretained NSMutableDictionary* fonts; // OHPDFTextFont by font dictionary, owned by the caller
+} OHScanContext;
+
+#pragma mark - Operators with numeric operands
+
+static void OHScanNumericOperator(CGPDFScannerRef scanner, void* info, const char* op)
+{
+    OHDisplayListBuilder* builder = ((OHScanContext*)info)->builder;
+    int count = OHDisplayListBuilderOperandCount(builder, op);
+    double operands[6];
+    if (count < 0 || count > 6)
+    {
+        OHDisplayListBuilderMarkUnsupported(builder);
+        return;
+    }
+    // Operands are popped from the stack in reverse order
+    for (int idx = count-1; idx >= 0; --idx)
+    {
+        CGPDFReal value;
+        if (!CGPDFScannerPopNumber(scanner, &value))
+        {
+            // e.g. `scn` with a pattern name
+            OHDisplayListBuilderMarkUnsupported(builder);
+            return;
+        }
+        operands[idx] = value;
+    }
+    OHDisplayListBuilderApplyOperator(builder, op, operands, (size_t)count);
+}
+
+#define OH_NUMERIC_OPERATOR(name, op) \
+    static void OHScan_##name(CGPDFScannerRef scanner, void* info) { OHScanNumericOperator(scanner, info, op); }
+
+OH_NUMERIC_OPERATOR(cm, "cm")
+OH_NUMERIC_OPERATOR(w, "w")
+OH_NUMERIC_OPERATOR(J, "J")
+OH_NUMERIC_OPERATOR(j, "j")
+OH_NUMERIC_OPERATOR(M, "M")
+OH_NUMERIC_OPERATOR(ri, "ri")
+OH_NUMERIC_OPERATOR(i, "i")
+OH_NUMERIC_OPERATOR(m, "m")
+OH_NUMERIC_OPERATOR(l, "l")
+OH_NUMERIC_OPERATOR(c, "c")
+OH_NUMERIC_OPERATOR(v, "v")
+OH_NUMERIC_OPERATOR(y, "y")
+OH_NUMERIC_OPERATOR(h, "h")
+OH_NUMERIC_OPERATOR(re, "re")
+OH_NUMERIC_OPERATOR(S, "S")
+OH_NUMERIC_OPERATOR(s, "s")
+OH_NUMERIC_OPERATOR(f, "f")
+OH_NUMERIC_OPERATOR(F, "F")
+OH_NUMERIC_OPERATOR(fStar, "f*")
+OH_NUMERIC_OPERATOR(B, "B")
+OH_NUMERIC_OPERATOR(BStar, "B*")
+OH_NUMERIC_OPERATOR(b, "b")
+OH_NUMERIC_OPERATOR(bStar, "b*")
+OH_NUMERIC_OPERATOR(n, "n")
+OH_NUMERIC_OPERATOR(W, "W")
+OH_NUMERIC_OPERATOR(WStar, "W*")
+OH_NUMERIC_OPERATOR(g, "g")
+OH_NUMERIC_OPERATOR(G, "G")
+OH_NUMERIC_OPERATOR(rg, "rg")
+OH_NUMERIC_OPERATOR(RG, "RG")
+OH_NUMERIC_OPERATOR(k, "k")
+OH_NUMERIC_OPERATOR(K, "K")
+OH_NUMERIC_OPERATOR(sc, "sc")
+OH_NUMERIC_OPERATOR(scn, "scn")
+OH_NUMERIC_OPERATOR(SC, "SC")
+OH_NUMERIC_OPERATOR(SCN, "SCN")
+
+#pragma mark - Operators using resources
+
+/**
+ *  Returns the number of components of a color space (name or array),
+ *  or 0 if the display list does not support it (Pattern, Indexed, Lab, …).
+ */
+static int OHColorSpaceComponents(CGPDFContentStreamRef contentStream, CGPDFObjectRef colorSpace, int depth)
+{
+    const char* name = NULL;
+    CGPDFArrayRef array = NULL;
+    if (CGPDFObjectGetValue(colorSpace, kCGPDFObjectTypeName, &name))
+    {
+        if (strcmp(name, "DeviceGray") == 0 || strcmp(name, "G") == 0) return 1;
+        if (strcmp(name, "DeviceRGB") == 0 || strcmp(name, "RGB") == 0) return 3;
+        if (strcmp(name, "DeviceCMYK") == 0 || strcmp(name, "CMYK") == 0) return 4;
+        // Named color space from the page resources
+        CGPDFObjectRef resource = depth == 0 ? CGPDFContentStreamGetResource(contentStream, "ColorSpace", name) : NULL;
+        return resource ? OHColorSpaceComponents(contentStream, resource, depth+1) : 0;
+    }
+    if (CGPDFObjectGetValue(colorSpace, kCGPDFObjectTypeArray, &array) && CGPDFArrayGetName(array, 0, &name))
+    {
+        if (strcmp(name, "CalGray") == 0) return 1;
+        if (strcmp(name, "CalRGB") == 0) return 3;
+        if (strcmp(name, "ICCBased") == 0)
+        {
+            CGPDFStreamRef stream = NULL;
+            CGPDFInteger components = 0;
+            if (CGPDFArrayGetStream(array, 1, &stream)
+                && CGPDFDictionaryGetInteger(CGPDFStreamGetDictionary(stream), "N", &components)
+                && (components == 1 || components == 3 || components == 4))
+            {
+                return (int)components;
+            }
+        }
+    }
+    return 0;
+}
+
+static void OHScanColorSpace(CGPDFScannerRef scanner, void* info, int stroke)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    CGPDFObjectRef colorSpace = NULL;
+    int components = CGPDFScannerPopObject(scanner, &colorSpace)
+                   ? OHColorSpaceComponents(context->contentStream, colorSpace, 0) : 0;
+    OHDisplayListBuilderSetColorSpace(context->builder, stroke, components);
+}
+
+static void OHScan_cs(CGPDFScannerRef scanner, void* info) { OHScanColorSpace(scanner, info, 0); }
+static void OHScan_CS(CGPDFScannerRef scanner, void* info) { OHScanColorSpace(scanner, info, 1); }
+
+static void OHScan_gs(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    const char* name = NULL;
+    CGPDFDictionaryRef extGState = NULL;
+    CGPDFObjectRef resource = CGPDFScannerPopName(scanner, &name)
+                            ? CGPDFContentStreamGetResource(context->contentStream, "ExtGState", name) : NULL;
+    if (!resource || !CGPDFObjectGetValue(resource, kCGPDFObjectTypeDictionary, &extGState))
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+        return;
+    }
+    
+    // Soft masks and blend modes other than Normal can't be represented
+    const char* value = NULL;
+    CGPDFObjectRef object = NULL;
+    if (CGPDFDictionaryGetObject(extGState, "SMask", &object)
+        && !(CGPDFDictionaryGetName(extGState, "SMask", &value) && strcmp(value, "None") == 0))
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+    }
+    if (CGPDFDictionaryGetObject(extGState, "BM", &object)
+        && !(CGPDFDictionaryGetName(extGState, "BM", &value) && (strcmp(value, "Normal") == 0 || strcmp(value, "Compatible") == 0)))
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+    }
+    
+    CGPDFReal number;
+    if (CGPDFDictionaryGetNumber(extGState, "ca", &number)) OHDisplayListBuilderSetAlpha(context->builder, 0, number);
+    if (CGPDFDictionaryGetNumber(extGState, "CA", &number)) OHDisplayListBuilderSetAlpha(context->builder, 1, number);
+    if (CGPDFDictionaryGetNumber(extGState, "LW", &number))
+    {
+        double lineWidth = number;
+        OHDisplayListBuilderApplyOperator(context->builder, "w", &lineWidth, 1);
+    }
+}
+
+static void OHScan_d(CGPDFScannerRef scanner, void* info)
+{
+    OHDisplayListBuilder* builder = ((OHScanContext*)info)->builder;
+    CGPDFReal phase;
+    CGPDFArrayRef array = NULL;
+    if (!CGPDFScannerPopNumber(scanner, &phase) || !CGPDFScannerPopArray(scanner, &array))
+    {
+        OHDisplayListBuilderMarkUnsupported(builder);
+        return;
+    }
+    size_t count = CGPDFArrayGetCount(array);
+    double* lengths = malloc(MAX(count, 1) * sizeof(double));
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        CGPDFReal length = 0;
+        CGPDFArrayGetNumber(array, idx, &length);
+        lengths[idx] = length;
+    }
+    OHDisplayListBuilderSetDash(builder, lengths, count, phase);
+    free(lengths);
+}
+
+static void OHScanUnsupported(CGPDFScannerRef scanner, void* info)
+{
+    OHDisplayListBuilderMarkUnsupported(((OHScanContext*)info)->builder);
+}
+
+#pragma mark - Text
+
+/**
+ *  A font of the page resources, with the mapping of its character codes to the
+ *  glyphs and widths of its embedded font program.
+ *
+ *  Only embedded TrueType and OpenType programs are supported, used by simple fonts
+ *  or by Type0 fonts with the Identity-H encoding.
+ */
+@interface OHPDFTextFont : NSObject
+@property(nonatomic, strong) OHGlyphFont* glyphFont;
+/// YES for Type0 fonts, whose character codes are 2 bytes long
+@property(nonatomic, assign) BOOL composite;
+@end
+
+@implementation OHPDFTextFont
+{
+    CGGlyph _glyphs[256];     // Simple fonts
+    CGFloat _widths[256];     // Simple fonts, in text space units
+    NSData* _cidToGIDMap;     // Type0 fonts, nil for Identity
+    NSDictionary* _cidWidths; // Type0 fonts, in text space units
+    CGFloat _defaultWidth;    // Type0 fonts, in text space units
+}
+
+static NSData* OHCopyFontProgram(CGPDFDictionaryRef descriptor)
+{
+    CGPDFStreamRef stream = NULL;
+    const char* subtype = NULL;
+    if (!CGPDFDictionaryGetStream(descriptor, "FontFile2", &stream)
+        && !(CGPDFDictionaryGetStream(descriptor, "FontFile3", &stream)
+             && CGPDFDictionaryGetName(CGPDFStreamGetDictionary(stream), "Subtype", &subtype)
+             && strcmp(subtype, "OpenType") == 0))
+    {
+        return nil; // Type1 and bare CFF programs can't be loaded by CoreGraphics
+    }
+    CGPDFDataFormat format;
+    NSData* program = (__bridge_transfer NSData*)CGPDFStreamCopyData(stream, &format);
+    return format == CGPDFDataFormatRaw ? program : nil;
+}
+
++ (instancetype)fontWithDictionary:(CGPDFDictionaryRef)dictionary
+{
+    const char* subtype = NULL;
+    if (!CGPDFDictionaryGetName(dictionary, "Subtype", &subtype)) return nil;
+    OHPDFTextFont* font = [self new];
+    BOOL loaded = (strcmp(subtype, "Type0") == 0) ? [font loadCompositeFont:dictionary]
+                : (strcmp(subtype, "TrueType") == 0 || strcmp(subtype, "Type1") == 0) ? [font loadSimpleFont:dictionary]
+                : NO;
+    return loaded ? font : nil;
+}
+
+- (BOOL)loadSimpleFont:(CGPDFDictionaryRef)dictionary
+{
+    CGPDFDictionaryRef descriptor = NULL;
+    if (!CGPDFDictionaryGetDictionary(dictionary, "FontDescriptor", &descriptor)) return NO;
+    self.glyphFont = [[OHGlyphCache sharedCache] fontWithProgram:OHCopyFontProgram(descriptor)];
+    if (!self.glyphFont) return NO;
+    
+    CGPDFReal missingWidth = 0;
+    CGPDFDictionaryGetNumber(descriptor, "MissingWidth", &missingWidth);
+    CGPDFInteger firstChar = 0;
+    CGPDFArrayRef widths = NULL;
+    CGPDFDictionaryGetInteger(dictionary, "FirstChar", &firstChar);
+    CGPDFDictionaryGetArray(dictionary, "Widths", &widths);
+    
+    // The glyph names of the Differences of the encoding, if any
+    CGPDFDictionaryRef encoding = NULL;
+    CGPDFArrayRef differences = NULL;
+    NSMutableDictionary* names = [NSMutableDictionary new];
+    if (CGPDFDictionaryGetDictionary(dictionary, "Encoding", &encoding)
+        && CGPDFDictionaryGetArray(encoding, "Differences", &differences))
+    {
+        CGPDFInteger code = 0;
+        for (size_t idx = 0; idx < CGPDFArrayGetCount(differences); ++idx)
+        {
+            const char* name = NULL;
+            CGPDFInteger number;
+            if (CGPDFArrayGetInteger(differences, idx, &number)) code = number;
+            else if (CGPDFArrayGetName(differences, idx, &name)) names[@(code++)] = @(name);
+        }
+    }
+    
+    for (NSUInteger code = 0; code < 256; ++code)
+    {
+        CGPDFReal width = missingWidth;
+        if (widths && (CGPDFInteger)code >= firstChar) CGPDFArrayGetNumber(widths, (size_t)(code - firstChar), &width);
+        _widths[code] = width / 1000;
+        
+        // Glyph names first, then the Unicode cmap (close to WinAnsi for the common codes),
+        // then the (3,0) cmap of symbolic fonts, which maps the codes to U+F000–U+F0FF
+        CGGlyph glyph = [self.glyphFont glyphWithName:names[@(code)]];
+        if (!glyph) glyph = [self.glyphFont glyphForCharacter:(UniChar)code];
+        if (!glyph) glyph = [self.glyphFont glyphForCharacter:(UniChar)(0xF000 + code)];
+        _glyphs[code] = glyph;
+    }
+    return YES;
+}
+
+- (BOOL)loadCompositeFont:(CGPDFDictionaryRef)dictionary
+{
+    const char* encoding = NULL;
+    CGPDFArrayRef descendants = NULL;
+    CGPDFDictionaryRef cidFont = NULL, descriptor = NULL;
+    if (!CGPDFDictionaryGetName(dictionary, "Encoding", &encoding) || strcmp(encoding, "Identity-H") != 0
+        || !CGPDFDictionaryGetArray(dictionary, "DescendantFonts", &descendants)
+        || !CGPDFArrayGetDictionary(descendants, 0, &cidFont)
+        || !CGPDFDictionaryGetDictionary(cidFont, "FontDescriptor", &descriptor))
+    {
+        return NO;
+    }
+    self.composite = YES;
+    self.glyphFont = [[OHGlyphCache sharedCache] fontWithProgram:OHCopyFontProgram(descriptor)];
+    if (!self.glyphFont) return NO;
+    
+    CGPDFStreamRef cidToGIDMap = NULL;
+    if (CGPDFDictionaryGetStream(cidFont, "CIDToGIDMap", &cidToGIDMap))
+    {
+        CGPDFDataFormat format;
+        _cidToGIDMap = (__bridge_transfer NSData*)CGPDFStreamCopyData(cidToGIDMap, &format);
+        if (!_cidToGIDMap || format != CGPDFDataFormatRaw) return NO;
+    }
+    
+    CGPDFReal defaultWidth = 1000;
+    CGPDFDictionaryGetNumber(cidFont, "DW", &defaultWidth);
+    _defaultWidth = defaultWidth / 1000;
+    
+    // The W array is made of `c [w1 w2 …]` and `cfirst clast w` entries
+    CGPDFArrayRef widths = NULL;
+    NSMutableDictionary* cidWidths = [NSMutableDictionary new];
+    if (CGPDFDictionaryGetArray(cidFont, "W", &widths))
+    {
+        size_t count = CGPDFArrayGetCount(widths), idx = 0;
+        CGPDFInteger first, last;
+        CGPDFReal width;
+        CGPDFArrayRef list = NULL;
+        while (idx + 1 < count && CGPDFArrayGetInteger(widths, idx, &first))
+        {
+            if (CGPDFArrayGetArray(widths, idx + 1, &list))
+            {
+                for (size_t item = 0; item < CGPDFArrayGetCount(list); ++item)
+                {
+                    if (CGPDFArrayGetNumber(list, item, &width)) cidWidths[@(first + (CGPDFInteger)item)] = @(width / 1000);
+                }
+                idx += 2;
+            }
+            else if (idx + 2 < count && CGPDFArrayGetInteger(widths, idx + 1, &last) && CGPDFArrayGetNumber(widths, idx + 2, &width))
+            {
+                for (CGPDFInteger cid = first; cid <= last && cid - first < 0xFFFF; ++cid) cidWidths[@(cid)] = @(width / 1000);
+                idx += 3;
+            }
+            else break;
+        }
+    }
+    _cidWidths = cidWidths;
+    return YES;
+}
+
+/**
+ *  The glyph of a character code, or 0 (.notdef) if the code has no glyph.
+ */
+- (CGGlyph)glyphForCode:(unsigned)code
+{
+    if (!self.composite) return _glyphs[code & 0xFF];
+    if (!_cidToGIDMap) return (CGGlyph)code; // Identity-H maps codes to CIDs, and Identity CIDs to GIDs
+    if ((NSUInteger)code * 2 + 1 >= _cidToGIDMap.length) return 0;
+    const uint8_t* map = _cidToGIDMap.bytes;
+    return (CGGlyph)((map[code * 2] << 8) | map[code * 2 + 1]);
+}
+
+/**
+ *  The horizontal displacement of a character code, in text space units.
+ */
+- (CGFloat)widthForCode:(unsigned)code
+{
+    if (!self.composite) return _widths[code & 0xFF];
+    NSNumber* width = _cidWidths[@(code)];
+    return width ? width.doubleValue : _defaultWidth;
+}
+
+@end
+
+static void OHEmitGlyphOutline(OHDisplayListBuilder* builder, NSData* outline, CGAffineTransform transform)
+{
+    const OHGlyphOutlineElement* elements = outline.bytes;
+    size_t count = outline.length / sizeof(OHGlyphOutlineElement);
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        double operands[6];
+        int pointsCount = elements[idx].op == 'c' ? 3 : elements[idx].op == 'h' ? 0 : 1;
+        for (int point = 0; point < pointsCount; ++point)
+        {
+            CGPoint p = CGPointApplyAffineTransform(CGPointMake(elements[idx].points[2*point], elements[idx].points[2*point+1]),
+                                                   transform);
+            operands[2*point] = p.x;
+            operands[2*point+1] = p.y;
+        }
+        char op[2] = { elements[idx].op, '\0' };
+        OHDisplayListBuilderApplyOperator(builder, op, operands, (size_t)(2 * pointsCount));
+    }
+}
+
+/**
+ *  Shows a string (`Tj`), by filling and/or stroking the outline of each glyph,
+ *  transformed by the text rendering matrix, as paths.
+ */
+static void OHShowText(OHScanContext* context, CGPDFStringRef string)
+{
+    OHTextState* state = &context->textState;
+    OHPDFTextFont* font = state->font;
+    // Clipping modes (4-7) would accumulate the glyphs into a clip path until ET
+    if (!font || !string || state->renderingMode < 0 || state->renderingMode > 3)
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+        return;
+    }
+    static const char* const kPaintOperators[] = { "f", "S", "B", NULL };
+    const char* paintOperator = kPaintOperators[state->renderingMode];
+    
+    const unsigned char* bytes = CGPDFStringGetBytePtr(string);
+    size_t length = CGPDFStringGetLength(string);
+    size_t codeLength = font.composite ? 2 : 1;
+    OHGlyphCache* glyphCache = [OHGlyphCache sharedCache];
+    for (size_t idx = 0; idx + codeLength <= length; idx += codeLength)
+    {
+        unsigned code = (codeLength == 2) ? (unsigned)((bytes[idx] << 8) | bytes[idx+1]) : bytes[idx];
+        if (paintOperator)
+        {
+            CGGlyph glyph = [font glyphForCode:code];
+            NSData* outline = glyph ? [glyphCache outlineOfGlyph:glyph inFont:font.glyphFont] : nil;
+            if (!outline)
+            {
+                // Let CoreGraphics draw the text with its own fallbacks
+                OHDisplayListBuilderMarkUnsupported(context->builder);
+                return;
+            }
+            if (outline.length > 0)
+            {
+                CGAffineTransform renderingMatrix = CGAffineTransformConcat(
+                    CGAffineTransformMake(state->fontSize * state->horizontalScaling, 0, 0, state->fontSize, 0, state->rise),
+                    context->textMatrix);
+                OHEmitGlyphOutline(context->builder, outline, renderingMatrix);
+                // Each glyph is painted separately, like overlapping glyphs with transparency would be
+                OHDisplayListBuilderApplyOperator(context->builder, paintOperator, NULL, 0);
+            }
+        }
+        
+        CGFloat wordSpacing = (codeLength == 1 && code == 32) ? state->wordSpacing : 0;
+        CGFloat advance = ([font widthForCode:code] * state->fontSize + state->charSpacing + wordSpacing)
+                        * state->horizontalScaling;
+        context->textMatrix = CGAffineTransformConcat(CGAffineTransformMakeTranslation(advance, 0), context->textMatrix);
+    }
+}
+
+static void OHMoveToNextLine(OHScanContext* context, CGFloat tx, CGFloat ty)
+{
+    context->textLineMatrix = CGAffineTransformConcat(CGAffineTransformMakeTranslation(tx, ty), context->textLineMatrix);
+    context->textMatrix = context->textLineMatrix;
+}
+
+static void OHScan_q(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    OHTextState* stack = realloc(context->textStateStack, (context->textStateStackCount + 1) * sizeof(OHTextState));
+    if (!stack)
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+        return;
+    }
+    context->textStateStack = stack;
+    context->textStateStack[context->textStateStackCount++] = context->textState;
+    OHScanNumericOperator(scanner, info, "q");
+}
+
+static void OHScan_Q(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    if (context->textStateStackCount > 0)
+    {
+        context->textState = context->textStateStack[--context->textStateStackCount];
+    }
+    OHScanNumericOperator(scanner, info, "Q");
+}
+
+static void OHScan_BT(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    context->textMatrix = context->textLineMatrix = CGAffineTransformIdentity;
+}
+
+static void OHScan_ET(CGPDFScannerRef scanner, void* info)
+{
+}
+
+static void OHScan_Tf(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    CGPDFReal size;
+    const char* name = NULL;
+    CGPDFDictionaryRef dictionary = NULL;
+    if (!CGPDFScannerPopNumber(scanner, &size) || !CGPDFScannerPopName(scanner, &name))
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+        return;
+    }
+    context->textState.fontSize = size;
+    CGPDFObjectRef resource = CGPDFContentStreamGetResource(context->contentStream, "Font", name);
+    if (!resource || !CGPDFObjectGetValue(resource, kCGPDFObjectTypeDictionary, &dictionary))
+    {
+        context->textState.font = nil;
+        return;
+    }
+    
+    // Fonts are resolved once per page, and their programs once per process (see OHGlyphCache)
+    NSValue* key = [NSValue valueWithPointer:dictionary];
+    id font = context->fonts[key];
+    if (!font)
+    {
+        font = [OHPDFTextFont fontWithDictionary:dictionary] ?: [NSNull null];
+        context->fonts[key] = font;
+    }
+    context->textState.font = (font == [NSNull null]) ? nil : font;
+}
+
+static void OHScanTextStateNumber(CGPDFScannerRef scanner, void* info, CGFloat* parameter, CGFloat factor)
+{
+    CGPDFReal value;
+    if (!CGPDFScannerPopNumber(scanner, &value))
+    {
+        OHDisplayListBuilderMarkUnsupported(((OHScanContext*)info)->builder);
+        return;
+    }
+    *parameter = value * factor;
+}
+
+static void OHScan_Tc(CGPDFScannerRef scanner, void* info)
+{
+    OHScanTextStateNumber(scanner, info, &((OHScanContext*)info)->textState.charSpacing, 1);
+}
+
+static void OHScan_Tw(CGPDFScannerRef scanner, void* info)
+{
+    OHScanTextStateNumber(scanner, info, &((OHScanContext*)info)->textState.wordSpacing, 1);
+}
+
+static void OHScan_Tz(CGPDFScannerRef scanner, void* info)
+{
+    OHScanTextStateNumber(scanner, info, &((OHScanContext*)info)->textState.horizontalScaling, 0.01);
+}
+
+static void OHScan_TL(CGPDFScannerRef scanner, void* info)
+{
+    OHScanTextStateNumber(scanner, info, &((OHScanContext*)info)->textState.leading, 1);
+}
+
+static void OHScan_Ts(CGPDFScannerRef scanner, void* info)
+{
+    OHScanTextStateNumber(scanner, info, &((OHScanContext*)info)->textState.rise, 1);
+}
+
+static void OHScan_Tr(CGPDFScannerRef scanner, void* info)
+{
+    CGPDFInteger mode;
+    if (!CGPDFScannerPopInteger(scanner, &mode))
+    {
+        OHDisplayListBuilderMarkUnsupported(((OHScanContext*)info)->builder);
+        return;
+    }
+    ((OHScanContext*)info)->textState.renderingMode = (int)mode;
+}
+
+static void OHScan_Td(CGPDFScannerRef scanner, void* info)
+{
+    CGPDFReal tx, ty;
+    if (!CGPDFScannerPopNumber(scanner, &ty) || !CGPDFScannerPopNumber(scanner, &tx))
+    {
+        OHDisplayListBuilderMarkUnsupported(((OHScanContext*)info)->builder);
+        return;
+    }
+    OHMoveToNextLine((OHScanContext*)info, tx, ty);
+}
+
+static void OHScan_TD(CGPDFScannerRef scanner, void* info)
+{
+    CGPDFReal tx, ty;
+    if (!CGPDFScannerPopNumber(scanner, &ty) || !CGPDFScannerPopNumber(scanner, &tx))
+    {
+        OHDisplayListBuilderMarkUnsupported(((OHScanContext*)info)->builder);
+        return;
+    }
+    ((OHScanContext*)info)->textState.leading = -ty;
+    OHMoveToNextLine((OHScanContext*)info, tx, ty);
+}
+
+static void OHScan_Tm(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    CGPDFReal m[6];
+    for (int idx = 5; idx >= 0; --idx)
+    {
+        if (!CGPDFScannerPopNumber(scanner, &m[idx]))
+        {
+            OHDisplayListBuilderMarkUnsupported(context->builder);
+            return;
+        }
+    }
+    context->textMatrix = context->textLineMatrix = CGAffineTransformMake(m[0], m[1], m[2], m[3], m[4], m[5]);
+}
+
+static void OHScan_TStar(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    OHMoveToNextLine(context, 0, -context->textState.leading);
+}
+
+static void OHScan_Tj(CGPDFScannerRef scanner, void* info)
+{
+    CGPDFStringRef string = NULL;
+    CGPDFScannerPopString(scanner, &string);
+    OHShowText((OHScanContext*)info, string);
+}
+
+static void OHScan_TJ(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    CGPDFArrayRef array = NULL;
+    if (!CGPDFScannerPopArray(scanner, &array))
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+        return;
+    }
+    for (size_t idx = 0; idx < CGPDFArrayGetCount(array); ++idx)
+    {
+        CGPDFStringRef string = NULL;
+        CGPDFReal adjustment;
+        if (CGPDFArrayGetString(array, idx, &string))
+        {
+            OHShowText(context, string);
+        }
+        else if (CGPDFArrayGetNumber(array, idx, &adjustment))
+        {
+            // Adjustments are in thousandths of text space units, and move backwards
+            CGFloat tx = -adjustment / 1000 * context->textState.fontSize * context->textState.horizontalScaling;
+            context->textMatrix = CGAffineTransformConcat(CGAffineTransformMakeTranslation(tx, 0), context->textMatrix);
+        }
+    }
+}
+
+static void OHScan_quote(CGPDFScannerRef scanner, void* info)
+{
+    OHScan_TStar(scanner, info);
+    OHScan_Tj(scanner, info);
+}
+
+static void OHScan_doubleQuote(CGPDFScannerRef scanner, void* info)
+{
+    OHScanContext* context = (OHScanContext*)info;
+    CGPDFStringRef string = NULL;
+    CGPDFReal charSpacing, wordSpacing;
+    if (!CGPDFScannerPopString(scanner, &string) || !CGPDFScannerPopNumber(scanner, &charSpacing)
+        || !CGPDFScannerPopNumber(scanner, &wordSpacing))
+    {
+        OHDisplayListBuilderMarkUnsupported(context->builder);
+        return;
+    }
+    context->textState.wordSpacing = wordSpacing;
+    context->textState.charSpacing = charSpacing;
+    OHScan_TStar(scanner, info);
+    OHShowText(context, string);
+}
+
+#pragma mark - Replay
+
+static void OHReplayOperation(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    CGContextRef context = (CGContextRef)info;
+    switch (op)
+    {
+        case OHDisplayListOpMoveTo: CGContextMoveToPoint(context, operands[0], operands[1]); break;
+        case OHDisplayListOpLineTo: CGContextAddLineToPoint(context, operands[0], operands[1]); break;
+        case OHDisplayListOpCurveTo:
+            CGContextAddCurveToPoint(context, operands[0], operands[1], operands[2],
+                                     operands[3], operands[4], operands[5]);
+            break;
+        case OHDisplayListOpClosePath: CGContextClosePath(context); break;
+        case OHDisplayListOpFill: CGContextFillPath(context); break;
+        case OHDisplayListOpEOFill: CGContextEOFillPath(context); break;
+        case OHDisplayListOpStroke: CGContextStrokePath(context); break;
+        case OHDisplayListOpFillStroke: CGContextDrawPath(context, kCGPathFillStroke); break;
+        case OHDisplayListOpEOFillStroke: CGContextDrawPath(context, kCGPathEOFillStroke); break;
+        case OHDisplayListOpClip: CGContextClip(context); break;
+        case OHDisplayListOpEOClip: CGContextEOClip(context); break;
+        case OHDisplayListOpSave: CGContextSaveGState(context); break;
+        case OHDisplayListOpRestore: CGContextRestoreGState(context); break;
+        case OHDisplayListOpConcatCTM:
+            CGContextConcatCTM(context, CGAffineTransformMake(operands[0], operands[1], operands[2],
+                                                              operands[3], operands[4], operands[5]));
+            break;
+        case OHDisplayListOpSetFillColor:
+            CGContextSetRGBFillColor(context, operands[0], operands[1], operands[2], operands[3]);
+            break;
+        case OHDisplayListOpSetStrokeColor:
+            CGContextSetRGBStrokeColor(context, operands[0], operands[1], operands[2], operands[3]);
+            break;
+        case OHDisplayListOpSetLineWidth: CGContextSetLineWidth(context, operands[0]); break;
+        case OHDisplayListOpSetLineCap: CGContextSetLineCap(context, (CGLineCap)operands[0]); break;
+        case OHDisplayListOpSetLineJoin: CGContextSetLineJoin(context, (CGLineJoin)operands[0]); break;
+        case OHDisplayListOpSetMiterLimit: CGContextSetMiterLimit(context, operands[0]); break;
+        case OHDisplayListOpSetDash:
+        {
+            size_t lengthsCount = count - 2;
+            CGFloat lengths[lengthsCount > 0 ? lengthsCount : 1];
+            for (size_t idx = 0; idx < lengthsCount; ++idx) lengths[idx] = operands[idx + 2];
+            CGContextSetLineDash(context, operands[1], lengthsCount > 0 ? lengths : NULL, lengthsCount);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/***********************************************************************************/
+
+@interface OHPDFDisplayList()
+- (instancetype)initWithList:(OHDisplayList*)list cropBox:(CGRect)cropBox NS_DESIGNATED_INITIALIZER;
+@end
+
+@implementation OHPDFDisplayList
+{
+    OHDisplayList* _list;
+}
+
+#pragma mark - Constructor
+
++ (instancetype)displayListWithPage:(OHPDFPage*)page
+{
+    NS_VALID_UNTIL_END_OF_SCOPE NSMutableDictionary* fonts = [NSMutableDictionary new];
+    OHScanContext context = {
+        .builder = OHDisplayListBuilderCreate(),
+        .contentStream = CGPDFContentStreamCreateWithPage(page.pageRef),
+        .textState = { .horizontalScaling = 1 },
+        .textMatrix = CGAffineTransformIdentity,
+        .textLineMatrix = CGAffineTransformIdentity,
+        .fonts = fonts
+    };
+    if (!context.builder || !context.contentStream)
+    {
+        OHDisplayListBuilderRelease(context.builder);
+        CGPDFContentStreamRelease(context.contentStream);
+        return nil;
+    }
+    
+    CGPDFOperatorTableRef table = CGPDFOperatorTableCreate();
+#define OH_SET_CALLBACK(name, op) CGPDFOperatorTableSetCallback(table, op, OHScan_##name)
+    OH_SET_CALLBACK(q, "q");     OH_SET_CALLBACK(Q, "Q");      OH_SET_CALLBACK(cm, "cm");
+    OH_SET_CALLBACK(w, "w");     OH_SET_CALLBACK(J, "J");      OH_SET_CALLBACK(j, "j");
+    OH_SET_CALLBACK(M, "M");     OH_SET_CALLBACK(d, "d");      OH_SET_CALLBACK(ri, "ri");
+    OH_SET_CALLBACK(i, "i");     OH_SET_CALLBACK(gs, "gs");
+    OH_SET_CALLBACK(m, "m");     OH_SET_CALLBACK(l, "l");      OH_SET_CALLBACK(c, "c");
+    OH_SET_CALLBACK(v, "v");     OH_SET_CALLBACK(y, "y");      OH_SET_CALLBACK(h, "h");
+    OH_SET_CALLBACK(re, "re");
+    OH_SET_CALLBACK(S, "S");     OH_SET_CALLBACK(s, "s");      OH_SET_CALLBACK(f, "f");
+    OH_SET_CALLBACK(F, "F");     OH_SET_CALLBACK(fStar, "f*"); OH_SET_CALLBACK(B, "B");
+    OH_SET_CALLBACK(BStar, "B*"); OH_SET_CALLBACK(b, "b");     OH_SET_CALLBACK(bStar, "b*");
+    OH_SET_CALLBACK(n, "n");     OH_SET_CALLBACK(W, "W");      OH_SET_CALLBACK(WStar, "W*");
+    OH_SET_CALLBACK(cs, "cs");   OH_SET_CALLBACK(CS, "CS");
+    OH_SET_CALLBACK(g, "g");     OH_SET_CALLBACK(G, "G");      OH_SET_CALLBACK(rg, "rg");
+    OH_SET_CALLBACK(RG, "RG");   OH_SET_CALLBACK(k, "k");      OH_SET_CALLBACK(K, "K");
+    OH_SET_CALLBACK(sc, "sc");   OH_SET_CALLBACK(scn, "scn");  OH_SET_CALLBACK(SC, "SC");
+    OH_SET_CALLBACK(SCN, "SCN");
+    // Text is compiled into the outlines of its glyphs
+    OH_SET_CALLBACK(BT, "BT");   OH_SET_CALLBACK(ET, "ET");    OH_SET_CALLBACK(Tf, "Tf");
+    OH_SET_CALLBACK(Tc, "Tc");   OH_SET_CALLBACK(Tw, "Tw");    OH_SET_CALLBACK(Tz, "Tz");
+    OH_SET_CALLBACK(TL, "TL");   OH_SET_CALLBACK(Ts, "Ts");    OH_SET_CALLBACK(Tr, "Tr");
+    OH_SET_CALLBACK(Td, "Td");   OH_SET_CALLBACK(TD, "TD");    OH_SET_CALLBACK(Tm, "Tm");
+    OH_SET_CALLBACK(TStar, "T*"); OH_SET_CALLBACK(Tj, "Tj");   OH_SET_CALLBACK(TJ, "TJ");
+    OH_SET_CALLBACK(quote, "'"); OH_SET_CALLBACK(doubleQuote, "\"");
+#undef OH_SET_CALLBACK
+    // Content the display list can't represent: XObjects, shadings, inline images, Type3 glyphs
+    for (NSString* op in @[@"Do", @"sh", @"BI", @"ID", @"EI", @"d0", @"d1"])
+    {
+        CGPDFOperatorTableSetCallback(table, op.UTF8String, OHScanUnsupported);
+    }
+    
+    CGPDFScannerRef scanner = CGPDFScannerCreate(context.contentStream, table, &context);
+    BOOL scanned = CGPDFScannerScan(scanner);
+    CGPDFScannerRelease(scanner);
+    CGPDFOperatorTableRelease(table);
+    CGPDFContentStreamRelease(context.contentStream);
+    free(context.textStateStack);
+    
+    OHDisplayList* list = scanned ? OHDisplayListBuilderCopyDisplayList(context.builder) : NULL;
+    OHDisplayListBuilderRelease(context.builder);
+    if (!list) return nil;
+    
+    return [[self alloc] initWithList:list cropBox:page.cropBox];
+}
+
++ (instancetype)displayListWithList:(OHDisplayList*)list cropBox:(CGRect)cropBox
+{
+    if (!list) return nil;
+    return [[self alloc] initWithList:list cropBox:cropBox];
+}
+
+- (instancetype)initWithList:(OHDisplayList*)list cropBox:(CGRect)cropBox
+{
+    self = [super init];
+    if (self)
+    {
+        _list = list;
+        _cropBox = cropBox;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    OHDisplayListRelease(_list);
+}
+
+#pragma mark - Properties
+
+- (const OHDisplayList*)listRef
+{
+    return _list;
+}
+
+- (NSUInteger)operationsCount
+{
+    return OHDisplayListGetOpCount(_list);
+}
+
+- (NSUInteger)byteSize
+{
+    return OHDisplayListGetByteSize(_list);
+}
+
+#pragma mark - Drawing in a graphic context
+
+- (void)drawInContext:(CGContextRef)context
+{
+    CGContextSaveGState(context);
+    CGContextClipToRect(context, _cropBox);
+    // Initial PDF graphics state
+    CGContextSetRGBFillColor(context, 0, 0, 0, 1);
+    CGContextSetRGBStrokeColor(context, 0, 0, 0, 1);
+    CGContextSetLineWidth(context, 1);
+    CGContextSetLineCap(context, kCGLineCapButt);
+    CGContextSetLineJoin(context, kCGLineJoinMiter);
+    CGContextSetMiterLimit(context, 10);
+    CGContextSetLineDash(context, 0, NULL, 0);
+    
+    OHDisplayListApply(_list, context, OHReplayOperation);
+    
+    CGContextRestoreGState(context);
+}
+
+@end
@@ -41,6 +41,23 @@
  *  The number of pages of the document.
  */
 @property(nonatomic, assign, readonly) size_t pagesCount;
+/**
+ *  The number of bytes of the PDF data accessed in place (without copy),
+ *  i.e. the size of the memory-mapped file for documents created using
+ *  `documentWithMappedFileURL:`, or the length passed to
+ *  `documentWithBytesNoCopy:length:deallocator:`.
+ *
+ *  0 for documents created by other constructors.
+ */
+@property(nonatomic, assign, readonly) size_t mappedBytes;
+/**
+ *  The number of bytes of `mappedBytes` currently resident in memory.
+ *
+ *  For memory-mapped files, pages of the file are only loaded when they
+ *  are accessed, so this is usually much smaller than `mappedBytes`.
+ *  0 for documents without `mappedBytes`.
+ */
+@property(nonatomic, assign, readonly) size_t residentBytes;
 
 #pragma mark - Constructors
 /**
@@ -70,10 +87,49 @@
  */
 + (instancetype)documentWithData:(NSData*)data;
 
+/**
+ *  Create an OHPDFDocument from a PDF file mapped in memory (read-only).
+ *
+ *  Unlike `documentWithURL:` or `documentWithData:`, the file is not read
+ *  up-front: its pages are only loaded by the system when they are accessed,
+ *  and can be evicted under memory pressure without being written anywhere.
+ *  This is the recommended way to open large PDF files.
+ *
+ *  @note Only files in the app bundle are mapped by this method: reading a
+ *        mapped file that is truncated meanwhile crashes (SIGBUS), and the app
+ *        can't modify its bundle. Other files (e.g. in Documents or Caches) are
+ *        loaded using `NSDataReadingMappedIfSafe`, and have no `mappedBytes`.
+ *
+ *  @param url The file URL pointing to the PDF file to load
+ *
+ *  @return The OHPDFDocument representing the PDF document, or `nil`
+ *          if the file could not be mapped or is not a valid PDF.
+ */
++ (instancetype)documentWithMappedFileURL:(NSURL*)url;
+
+/**
+ *  Create an OHPDFDocument from bytes in memory, without copying them.
+ *
+ *  @param bytes       The bytes of the PDF file. They must stay valid and
+ *                     unmodified until the deallocator is called.
+ *  @param length      The number of bytes
+ *  @param deallocator The block called once the document does not need the bytes
+ *                     anymore (typically to free or unmap them). May be `nil`.
+ *
+ *  @return The OHPDFDocument representing the PDF document. If `nil` is returned,
+ *          the deallocator has already been called.
+ */
++ (instancetype)documentWithBytesNoCopy:(const void*)bytes
+                                 length:(size_t)length
+                            deallocator:(void(^)(const void* bytes, size_t length))deallocator;
+
 #pragma mark - Getting a page
 /**
  *  Return a given page in the PDF. Page indexes starts at 1.
  *
+ *  Recently used pages (up to 64 of them, with up to 8MB of
+ *  compiled display lists) are kept, and returned again by the next calls.
+ *
  *  @param pageNumber Page number, starting at 1
  *
  *  @return The specified page in the PDF
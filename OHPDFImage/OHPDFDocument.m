@@ -24,11 +24,64 @@
 
 #import "OHPDFDocument.h"
 #import "OHPDFPage.h"
+#import "OHRenderStats.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/***********************************************************************************/
+
+// The pages kept for reuse: at most this many, and this many bytes of display lists
+static NSUInteger const kPageCacheCountLimit = 64;
+static NSUInteger const kPageCacheCostLimit = 8 * 1024 * 1024;
+// The estimated memory used by a parsed page, besides its display list
+static NSUInteger const kCostPerPage = 16 * 1024;
+
+/***********************************************************************************/
+
+/**
+ *  Bytes accessed in place by a direct-access CGDataProvider.
+ *  The deallocator is called when this object is deallocated.
+ */
+@interface OHPDFBytes : NSObject
+@property(nonatomic, assign) const void* bytes;
+@property(nonatomic, assign) size_t length;
+@property(nonatomic, copy) void(^deallocator)(const void* bytes, size_t length);
+@end
+
+@implementation OHPDFBytes
+- (void)dealloc
+{
+    if (_deallocator) _deallocator(_bytes, _length);
+}
+@end
+
+static const void* OHPDFBytesGetBytePointer(void* info)
+{
+    return ((__bridge OHPDFBytes*)info).bytes;
+}
+
+static size_t OHPDFBytesGetBytesAtPosition(void* info, void* buffer, off_t position, size_t count)
+{
+    OHPDFBytes* pdfBytes = (__bridge OHPDFBytes*)info;
+    if (position < 0 || (size_t)position >= pdfBytes.length) return 0;
+    count = MIN(count, pdfBytes.length - (size_t)position);
+    memcpy(buffer, (const uint8_t*)pdfBytes.bytes + position, count);
+    return count;
+}
+
+static void OHPDFBytesReleaseInfo(void* info)
+{
+    CFBridgingRelease(info);
+}
 
 /***********************************************************************************/
 
 @interface OHPDFDocument()
 - (instancetype)initWithRef:(CGPDFDocumentRef)docRef NS_DESIGNATED_INITIALIZER;
+@property(nonatomic, strong) OHPDFBytes* pdfBytes;
+@property(nonatomic, strong) NSCache* pages;
 @end
 
 @implementation OHPDFDocument
@@ -52,6 +105,91 @@
 }
 
 
+/**
+ *  YES if the file is in the app bundle, which is read-only: the app can't truncate it
+ *  while it is mapped, which would crash the reads of the mapping (SIGBUS) instead of failing.
+ */
+static BOOL OHIsFileInAppBundle(NSURL* url)
+{
+    NSString* bundlePath = [[NSBundle mainBundle].bundlePath stringByResolvingSymlinksInPath];
+    NSString* path = [url.path stringByResolvingSymlinksInPath];
+    return bundlePath.length > 0 && [path hasPrefix:[bundlePath stringByAppendingString:@"/"]];
+}
+
++ (instancetype)documentWithMappedFileURL:(NSURL*)url
+{
+    if (!url.isFileURL) return nil;
+    if (!OHIsFileInAppBundle(url))
+    {
+        // Files the app can write to (Documents, Caches…) are left to NSData to map or read
+        NSData* data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:NULL];
+        return [self documentWithData:data];
+    }
+    
+    int fd = open(url.path.fileSystemRepresentation, O_RDONLY);
+    if (fd < 0) return nil;
+    
+    struct stat fileStat;
+    void* bytes = MAP_FAILED;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+    {
+        bytes = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping stays valid once the file descriptor is closed
+    close(fd);
+    if (bytes == MAP_FAILED) return nil;
+    
+    // Pages are read lazily and the PDF parser jumps around the file (xref table, objects)
+    madvise(bytes, (size_t)fileStat.st_size, MADV_RANDOM);
+    
+    return [self documentWithBytesNoCopy:bytes length:(size_t)fileStat.st_size deallocator:^(const void* mappedBytes, size_t length) {
+        munmap((void*)mappedBytes, length);
+    }];
+}
+
++ (instancetype)documentWithBytesNoCopy:(const void*)bytes
+                                 length:(size_t)length
+                            deallocator:(void(^)(const void* bytes, size_t length))deallocator
+{
+    if (!bytes || length == 0)
+    {
+        if (deallocator) deallocator(bytes, length);
+        return nil;
+    }
+    
+    // From now on, the deallocator is called when pdfBytes is deallocated
+    OHPDFBytes* pdfBytes = [OHPDFBytes new];
+    pdfBytes.bytes = bytes;
+    pdfBytes.length = length;
+    pdfBytes.deallocator = deallocator;
+    
+    static CGDataProviderDirectCallbacks const callbacks = {
+        .version = 0,
+        .getBytePointer = OHPDFBytesGetBytePointer,
+        .releaseBytePointer = NULL,
+        .getBytesAtPosition = OHPDFBytesGetBytesAtPosition,
+        .releaseInfo = OHPDFBytesReleaseInfo
+    };
+    void* info = (__bridge_retained void*)pdfBytes;
+    CGDataProviderRef dataRef = CGDataProviderCreateDirect(info, (off_t)length, &callbacks);
+    
+    if (!dataRef)
+    {
+        // The provider was not created, so it won't release the info: balance the retain ourselves
+        CFBridgingRelease(info);
+        return nil;
+    }
+    CGPDFDocumentRef docRef = CGPDFDocumentCreateWithProvider(dataRef);
+    CGDataProviderRelease(dataRef);
+    
+    if (!docRef) return nil;
+    OHPDFDocument* doc = [self documentWithRef:docRef];
+    CGPDFDocumentRelease(docRef);
+    doc.pdfBytes = pdfBytes;
+    
+    return doc;
+}
+
 + (instancetype)documentWithURL:(NSURL*)url
 {
     CGPDFDocumentRef docRef = CGPDFDocumentCreateWithURL((__bridge CFURLRef)url);
@@ -77,6 +215,9 @@
         CGPDFDocumentRetain(docRef);
         _documentRef = docRef;
         _pagesCount = CGPDFDocumentGetNumberOfPages(docRef);
+        _pages = [NSCache new];
+        _pages.countLimit = kPageCacheCountLimit;
+        _pages.totalCostLimit = kPageCacheCostLimit;
     }
     return self;
 }
@@ -90,17 +231,66 @@
     }
 }
 
+#pragma mark - Memory footprint
+
+- (size_t)mappedBytes
+{
+    return self.pdfBytes.length;
+}
+
+- (size_t)residentBytes
+{
+    if (!self.pdfBytes) return 0;
+    
+    // mincore() works on whole pages, starting at a page boundary
+    size_t const pageSize = (size_t)getpagesize();
+    uintptr_t start = (uintptr_t)self.pdfBytes.bytes & ~(uintptr_t)(pageSize - 1);
+    size_t length = (uintptr_t)self.pdfBytes.bytes + self.pdfBytes.length - start;
+    size_t pagesCount = (length + pageSize - 1) / pageSize;
+    
+    char* residency = malloc(pagesCount);
+    if (!residency) return 0;
+    
+    size_t residentBytes = 0;
+    if (mincore((const void*)start, length, residency) == 0)
+    {
+        for (size_t idx = 0; idx < pagesCount; ++idx)
+        {
+            if (residency[idx] & MINCORE_INCORE) residentBytes += pageSize;
+        }
+    }
+    free(residency);
+    
+    return MIN(residentBytes, self.pdfBytes.length);
+}
+
 #pragma mark - Getting a page
 
 - (OHPDFPage*)pageAtIndex:(size_t)pageNumber
 {
     if (pageNumber > 0 && pageNumber <= _pagesCount)
     {
-        CGPDFPageRef pageRef = CGPDFDocumentGetPage(_documentRef, pageNumber);
-        if (pageRef)
+        // Pages are kept so that their compiled display list can be reused,
+        // as long as they fit in the page cache
+        OHPDFPage* page = nil;
+        @synchronized(self.pages)
         {
-            return [OHPDFPage pageWithRef:pageRef];
+            page = [self.pages objectForKey:@(pageNumber)];
+            if (!page)
+            {
+                OH_RENDER_STATS_BEGIN(fetchStart);
+                CGPDFPageRef pageRef = CGPDFDocumentGetPage(_documentRef, pageNumber);
+                page = pageRef ? [OHPDFPage pageWithRef:pageRef] : nil;
+                if (page) [self.pages setObject:page forKey:@(pageNumber) cost:kCostPerPage];
+                OH_RENDER_STATS_END(OHRenderStagePageFetch, fetchStart);
+                return page;
+            }
         }
+        // The display list is compiled after the page is fetched, so its bytes are
+        // accounted for when the page is fetched again (outside of the lock, which
+        // would otherwise wait for a display list being compiled by another thread)
+        [self.pages setObject:page forKey:@(pageNumber) cost:kCostPerPage + page.displayListByteSize];
+        return page;
     }
     return nil;
 }
@@ -0,0 +1,126 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <Foundation/Foundation.h>
+@class OHPDFDocument;
+
+/***********************************************************************************/
+
+/**
+ *  A thread-safe registry of loaded PDF documents, used by `OHVectorImage`
+ *  to avoid loading the same PDF file twice.
+ *
+ *  - Each document is loaded only once, even if it is requested by several
+ *    threads at the same time: the other threads wait for the first load.
+ *  - Loaded documents are kept in memory, evicted according to their cost
+ *    (an estimate of the dirty memory they use) when the total cost of
+ *    the registry exceeds its `totalCostLimit`, or on memory warnings.
+ */
+@interface OHPDFDocumentRegistry : NSObject
+
+/**
+ *  The total cost of the documents the registry can keep before it
+ *  starts evicting them. The cost of a document estimates the dirty memory
+ *  it uses: 16KB per page for its parsed pages, plus its file size in bytes
+ *  if it could not be memory-mapped. The bytes of a memory-mapped file are
+ *  not counted, as the system can drop them and read them again at will,
+ *  so large local PDFs stay loaded like small ones.
+ *
+ *  Defaults to 32MB.
+ */
+@property(nonatomic, assign) NSUInteger totalCostLimit;
+
+#pragma mark - Constructor
+
+/**
+ *  The registry used by `OHVectorImage` to load PDF files.
+ *
+ *  @return The shared registry.
+ */
++ (instancetype)sharedRegistry;
+
+#pragma mark - Getting documents
+
+/**
+ *  Returns the URL of the PDF file with the given name in the given bundle.
+ *
+ *  @param pdfName     The name of the PDF file. If it has no extension,
+ *                     the "pdf" extension is used.
+ *  @param bundleOrNil The bundle in which to search the file. If `nil`,
+ *                     will use the main bundle.
+ *
+ *  @return The URL of the PDF file, or `nil` if it does not exist.
+ */
++ (NSURL*)URLForPDFNamed:(NSString*)pdfName inBundle:(NSBundle*)bundleOrNil;
+
+/**
+ *  Returns the document at the given URL, loading it if it is not
+ *  in the registry yet.
+ *
+ *  If the document is being loaded by another thread, this method
+ *  blocks until that load finishes, and returns its result.
+ *
+ *  @param url The URL of the PDF file
+ *
+ *  @return The loaded document, or `nil` if it could not be loaded.
+ */
+- (OHPDFDocument*)documentWithURL:(NSURL*)url;
+
+/**
+ *  Loads the document at the given URL in the background (if it is not
+ *  in the registry yet), then calls the completion block on the main queue.
+ *
+ *  @param url        The URL of the PDF file
+ *  @param completion The block to call with the loaded document, or `nil`
+ *                    if it could not be loaded.
+ */
+- (void)loadDocumentWithURL:(NSURL*)url completion:(void(^)(OHPDFDocument* document))completion;
+
+/**
+ *  Loads the PDF files with the given names in the background, so that
+ *  they are already loaded when needed. Typically called at app launch.
+ *
+ *  Preloads run at a low priority. A thread requesting a document that is
+ *  still being preloaded loads it itself instead of waiting behind them.
+ *
+ *  @param pdfNames    The names of the PDF files to load
+ *  @param bundleOrNil The bundle in which to search the files. If `nil`,
+ *                     will use the main bundle.
+ */
+- (void)preloadPDFsNamed:(NSArray*)pdfNames inBundle:(NSBundle*)bundleOrNil;
+
+#pragma mark - Purging the registry
+
+/**
+ *  Removes the document at the given URL from the registry.
+ */
+- (void)removeDocumentWithURL:(NSURL*)url;
+
+/**
+ *  Removes every document from the registry.
+ */
+- (void)removeAllDocuments;
+
+@end
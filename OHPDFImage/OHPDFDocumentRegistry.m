@@ -0,0 +1,254 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "OHPDFDocumentRegistry.h"
+#import "OHPDFDocument.h"
+#import "OHRenderStats.h"
+#import <UIKit/UIKit.h>
+
+/***********************************************************************************/
+
+static NSUInteger const kDefaultTotalCostLimit = 32 * 1024 * 1024;
+static NSUInteger const kCostPerPage = 16 * 1024;
+
+/**
+ *  A load in progress, that other threads requesting the same URL wait for.
+ */
+@interface OHPDFDocumentLoad : NSObject
+@property(nonatomic, strong) OHPDFDocument* document;
+@property(nonatomic, assign) BOOL isPreload; // Run at a low priority, so not worth waiting for
+- (OHPDFDocument*)waitForDocument;
+- (void)finishWithDocument:(OHPDFDocument*)document;
+@end
+
+@implementation OHPDFDocumentLoad
+{
+    NSCondition* _condition;
+    BOOL _finished;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _condition = [NSCondition new];
+    }
+    return self;
+}
+
+- (OHPDFDocument*)waitForDocument
+{
+    [_condition lock];
+    while (!_finished) [_condition wait];
+    [_condition unlock];
+    return self.document;
+}
+
+- (void)finishWithDocument:(OHPDFDocument*)document
+{
+    [_condition lock];
+    self.document = document;
+    _finished = YES;
+    [_condition broadcast];
+    [_condition unlock];
+}
+
+@end
+
+/***********************************************************************************/
+
+@interface OHPDFDocumentRegistry()
+@property(nonatomic, strong) NSCache* documents;
+@property(nonatomic, strong) NSMutableDictionary* loadsInProgress;
+@end
+
+@implementation OHPDFDocumentRegistry
+
+#pragma mark - Constructor
+
++ (instancetype)sharedRegistry
+{
+    static OHPDFDocumentRegistry* sharedRegistry;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedRegistry = [self new];
+    });
+    return sharedRegistry;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _documents = [NSCache new];
+        _documents.totalCostLimit = kDefaultTotalCostLimit;
+        _loadsInProgress = [NSMutableDictionary new];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(removeAllDocuments)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (NSUInteger)totalCostLimit
+{
+    return self.documents.totalCostLimit;
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    self.documents.totalCostLimit = totalCostLimit;
+}
+
+#pragma mark - Getting documents
+
++ (NSURL*)URLForPDFNamed:(NSString*)pdfName inBundle:(NSBundle*)bundleOrNil
+{
+    if (!pdfName) return nil;
+    
+    NSString* basename = [pdfName stringByDeletingPathExtension];
+    NSString* ext = [pdfName pathExtension];
+    if (ext.length == 0) ext = @"pdf";
+    return [(bundleOrNil?:[NSBundle mainBundle]) URLForResource:basename withExtension:ext];
+}
+
+- (OHPDFDocument*)documentWithURL:(NSURL*)url
+{
+    return [self documentWithURL:url preloading:NO];
+}
+
+- (OHPDFDocument*)documentWithURL:(NSURL*)url preloading:(BOOL)preloading
+{
+    if (!url) return nil;
+    
+    OHPDFDocumentLoad* load = nil;
+    BOOL isLoader = NO;
+    @synchronized(self)
+    {
+        OHPDFDocument* document = [self.documents objectForKey:url];
+        if (document) return document;
+        
+        // Waiting for a low priority preload would be a priority inversion (e.g. stalling
+        // the main thread), so load the document again instead, which is cheap when mapped
+        load = self.loadsInProgress[url];
+        if (!load || (load.isPreload && !preloading))
+        {
+            load = [OHPDFDocumentLoad new];
+            load.isPreload = preloading;
+            self.loadsInProgress[url] = load;
+            isLoader = YES;
+        }
+    }
+    
+    if (!isLoader)
+    {
+        // Another thread is loading this document, wait for it
+        return [load waitForDocument];
+    }
+    
+    // Map local files in memory rather than reading them up-front
+    OH_RENDER_STATS_BEGIN(loadStart);
+    OHPDFDocument* document = url.isFileURL ? [OHPDFDocument documentWithMappedFileURL:url] : nil;
+    if (!document) document = [OHPDFDocument documentWithURL:url];
+    OH_RENDER_STATS_END(OHRenderStageLoad, loadStart);
+    @synchronized(self)
+    {
+        // If another load of the same URL finished first, use its document, so there is only one
+        OHPDFDocument* loadedDocument = [self.documents objectForKey:url];
+        if (loadedDocument)
+        {
+            document = loadedDocument;
+        }
+        else if (document)
+        {
+            [self.documents setObject:document forKey:url cost:[self costForDocument:document url:url]];
+        }
+        if (self.loadsInProgress[url] == load) [self.loadsInProgress removeObjectForKey:url];
+    }
+    [load finishWithDocument:document];
+    
+    return document;
+}
+
+- (void)loadDocumentWithURL:(NSURL*)url completion:(void(^)(OHPDFDocument* document))completion
+{
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        OHPDFDocument* document = [self documentWithURL:url];
+        if (completion)
+        {
+            dispatch_async(dispatch_get_main_queue(), ^{ completion(document); });
+        }
+    });
+}
+
+- (void)preloadPDFsNamed:(NSArray*)pdfNames inBundle:(NSBundle*)bundleOrNil
+{
+    NSArray* names = [pdfNames copy];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0), ^{
+        for (NSString* pdfName in names)
+        {
+            [self documentWithURL:[[self class] URLForPDFNamed:pdfName inBundle:bundleOrNil] preloading:YES];
+        }
+    });
+}
+
+#pragma mark - Purging the registry
+
+- (void)removeDocumentWithURL:(NSURL*)url
+{
+    if (!url) return;
+    [self.documents removeObjectForKey:url];
+}
+
+- (void)removeAllDocuments
+{
+    [self.documents removeAllObjects];
+}
+
+#pragma mark - Private Methods
+
+- (NSUInteger)costForDocument:(OHPDFDocument*)document url:(NSURL*)url
+{
+    // The bytes of a memory-mapped file are clean pages, that the system drops under
+    // memory pressure and reads again on demand: only count the parsed pages for them
+    NSUInteger cost = document.pagesCount * kCostPerPage;
+    if (document.mappedBytes == 0)
+    {
+        NSNumber* fileSize = nil;
+        [url getResourceValue:&fileSize forKey:NSURLFileSizeKey error:NULL];
+        cost += fileSize.unsignedIntegerValue;
+    }
+    return cost;
+}
+
+@end
@@ -31,7 +31,14 @@
   #endif
 #endif
 
+#import "OHGlyphCache.h"
+#import "OHPDFDisplayList.h"
 #import "OHPDFDocument.h"
+#import "OHPDFDocumentRegistry.h"
 #import "OHPDFPage.h"
+#import "OHPDFThumbnailAtlas.h"
+#import "OHRenderCache.h"
+#import "OHRenderQueue.h"
 #import "OHVectorImage.h"
+#import "OHVectorPack.h"
 #import "UIImage+OHPDF.h"
@@ -25,6 +25,7 @@
 #import <Foundation/Foundation.h>
 #import <QuartzCore/QuartzCore.h>
 @class UIImage;
+@class OHPDFDisplayList;
 
 /***********************************************************************************/
 
@@ -35,6 +36,7 @@
 
 /**
  *  The CoreGraphics reference (CGPDFPageRef) to the PDF page.
+ *  NULL for pages created from a display list (see `pageWithDisplayList:mediaBox:`).
  */
 @property(nonatomic, assign, readonly) CGPDFPageRef pageRef;
 
@@ -61,6 +63,43 @@
  */
 @property(nonatomic, readonly) CGRect artBox;
 
+#pragma mark - Display list
+
+/**
+ *  The content of the page compiled into a display list, so that drawing
+ *  the page again does not need to parse its PDF content stream again.
+ *
+ *  The display list is compiled lazily the first time it is needed, then
+ *  kept for the lifetime of the page. `nil` if the page uses content that
+ *  the display list does not support (see `OHPDFDisplayList`).
+ */
+@property(nonatomic, readonly) OHPDFDisplayList* displayList;
+/**
+ *  The number of bytes used by the `displayList`, or 0 if it was not compiled
+ *  yet. Unlike `displayList.byteSize`, this doesn't compile the display list.
+ */
+@property(nonatomic, readonly) NSUInteger displayListByteSize;
+/**
+ *  If YES (the default), the drawing methods replay the `displayList`
+ *  when the page could be compiled into one, and only fall back to
+ *  `CGContextDrawPDFPage` otherwise.
+ */
+@property(nonatomic, assign) BOOL usesDisplayList;
+
+#pragma mark - Content bounds
+
+/**
+ *  The bounding box of the ink actually painted on the page, in PDF user
+ *  space, clipped to the crop box. `CGRectNull` if nothing is painted.
+ *
+ *  Computed lazily the first time it is needed, then kept for the lifetime
+ *  of the page. When the page has a `displayList`, the box is measured from
+ *  the path geometry itself (including stroke widths, caps, joins and
+ *  clipping); otherwise it is found by scanning a low resolution rendering
+ *  of the page, and is then accurate to about 1/1000 of the crop box.
+ */
+@property(nonatomic, readonly) CGRect contentBox;
+
 #pragma mark - Constructor
 
 /**
@@ -72,6 +111,21 @@
  */
 + (instancetype)pageWithRef:(CGPDFPageRef)pageRef;
 
+/**
+ *  Create a new OHPDFPage from an already compiled display list, without
+ *  any underlying PDF document (e.g. a page loaded from an `OHVectorPack`).
+ *
+ *  Such a page is always drawn using its display list, whatever the value of
+ *  `usesDisplayList`. Its crop box is the crop box of the display list, and its
+ *  bleed, trim and art boxes default to the crop box, like in PDF.
+ *
+ *  @param displayList The display list of the page
+ *  @param mediaBox    The media box of the page
+ *
+ *  @return An OHPDFPage object drawing the display list
+ */
++ (instancetype)pageWithDisplayList:(OHPDFDisplayList*)displayList mediaBox:(CGRect)mediaBox;
+
 #pragma mark - Drawing in a graphic context
 
 /**
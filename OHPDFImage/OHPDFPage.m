@@ -23,6 +23,8 @@
  ***********************************************************************************/
 
 #import "OHPDFPage.h"
+#import "OHPDFDisplayList.h"
+#import "OHRasterizer.h"
 #import <UIKit/UIKit.h>
 
 /***********************************************************************************/
@@ -32,6 +34,13 @@
 @end
 
 @implementation OHPDFPage
+{
+    OHPDFDisplayList* _displayList;
+    BOOL _displayListCompiled;
+    CGRect _mediaBox; // Only used by pages without pageRef
+    CGRect _contentBox;
+    BOOL _contentBoxComputed;
+}
 
 + (instancetype)pageWithRef:(CGPDFPageRef)pageRef
 {
@@ -45,10 +54,22 @@
     {
         CGPDFPageRetain(pageRef);
         _pageRef = pageRef;
+        _usesDisplayList = YES;
     }
     return self;
 }
 
++ (instancetype)pageWithDisplayList:(OHPDFDisplayList*)displayList mediaBox:(CGRect)mediaBox
+{
+    if (!displayList) return nil;
+    
+    OHPDFPage* page = [[self alloc] initWithRef:NULL];
+    page->_displayList = displayList;
+    page->_displayListCompiled = YES;
+    page->_mediaBox = mediaBox;
+    return page;
+}
+
 - (void)dealloc
 {
     if (_pageRef)
@@ -62,24 +83,122 @@
 
 - (CGRect)mediaBox
 {
-    return CGPDFPageGetBoxRect(_pageRef, kCGPDFMediaBox);
+    return _pageRef ? CGPDFPageGetBoxRect(_pageRef, kCGPDFMediaBox) : _mediaBox;
 }
 
 - (CGRect)cropBox
 {
-    return CGPDFPageGetBoxRect(_pageRef, kCGPDFCropBox);
+    return _pageRef ? CGPDFPageGetBoxRect(_pageRef, kCGPDFCropBox) : _displayList.cropBox;
 }
 - (CGRect)bleedBox
 {
-    return CGPDFPageGetBoxRect(_pageRef, kCGPDFBleedBox);
+    return _pageRef ? CGPDFPageGetBoxRect(_pageRef, kCGPDFBleedBox) : self.cropBox;
 }
 - (CGRect)trimBox
 {
-    return CGPDFPageGetBoxRect(_pageRef, kCGPDFTrimBox);
+    return _pageRef ? CGPDFPageGetBoxRect(_pageRef, kCGPDFTrimBox) : self.cropBox;
 }
 - (CGRect)artBox
 {
-    return CGPDFPageGetBoxRect(_pageRef, kCGPDFArtBox);
+    return _pageRef ? CGPDFPageGetBoxRect(_pageRef, kCGPDFArtBox) : self.cropBox;
+}
+
+#pragma mark - Display list
+
+- (OHPDFDisplayList*)displayList
+{
+    @synchronized(self)
+    {
+        if (!_displayListCompiled)
+        {
+            _displayList = [OHPDFDisplayList displayListWithPage:self];
+            _displayListCompiled = YES;
+        }
+        return _displayList;
+    }
+}
+
+- (NSUInteger)displayListByteSize
+{
+    @synchronized(self)
+    {
+        return _displayListCompiled ? _displayList.byteSize : 0;
+    }
+}
+
+#pragma mark - Content bounds
+
+// Longest side, in pixels, of the rendering scanned by -scanContentBox.
+static size_t const kContentScanMaxSize = 1024;
+
+- (CGRect)contentBox
+{
+    @synchronized(self)
+    {
+        if (!_contentBoxComputed)
+        {
+            OHPDFDisplayList* displayList = (self.usesDisplayList || !_pageRef) ? self.displayList : nil;
+            _contentBox = displayList ? [self measureContentBoxOfDisplayList:displayList] : [self scanContentBox];
+            _contentBoxComputed = YES;
+        }
+        return _contentBox;
+    }
+}
+
+- (CGRect)measureContentBoxOfDisplayList:(OHPDFDisplayList*)displayList
+{
+    CGRect cropBox = self.cropBox;
+    OHRasterRect clipRect = { cropBox.origin.x, cropBox.origin.y, cropBox.size.width, cropBox.size.height };
+    OHRasterRect bounds;
+    if (OHRasterGetContentBounds(displayList.listRef, &clipRect, &bounds) <= 0)
+    {
+        return CGRectNull;
+    }
+    CGRect contentBox = CGRectMake(bounds.x, bounds.y, bounds.width, bounds.height);
+    return CGRectIntersection(contentBox, cropBox);
+}
+
+- (CGRect)scanContentBox
+{
+    CGRect cropBox = self.cropBox;
+    CGFloat longestSide = MAX(cropBox.size.width, cropBox.size.height);
+    if (CGRectIsEmpty(cropBox) || longestSide <= 0) return CGRectNull;
+
+    CGFloat scale = kContentScanMaxSize / longestSide;
+    size_t width = MAX((size_t)1, (size_t)ceil(cropBox.size.width * scale));
+    size_t height = MAX((size_t)1, (size_t)ceil(cropBox.size.height * scale));
+    CGContextRef ctx = CGBitmapContextCreate(NULL, width, height, 8, 0, NULL, (CGBitmapInfo)kCGImageAlphaOnly);
+    if (!ctx) return cropBox;
+
+    CGContextScaleCTM(ctx, scale, scale);
+    CGContextTranslateCTM(ctx, -cropBox.origin.x, -cropBox.origin.y);
+    [self drawInContext:ctx rect:(CGRect){CGPointZero, self.mediaBox.size} flipped:NO];
+
+    const uint8_t* data = CGBitmapContextGetData(ctx);
+    size_t bytesPerRow = CGBitmapContextGetBytesPerRow(ctx);
+    size_t minX = width, maxX = 0, minY = height, maxY = 0;
+    for (size_t y = 0; y < height; ++y)
+    {
+        const uint8_t* row = data + y * bytesPerRow;
+        for (size_t x = 0; x < width; ++x)
+        {
+            if (!row[x]) continue;
+            minX = MIN(minX, x);
+            maxX = MAX(maxX, x);
+            minY = MIN(minY, y);
+            maxY = MAX(maxY, y);
+        }
+    }
+    CGContextRelease(ctx);
+    if (minX > maxX) return CGRectNull;
+
+    // Rows are stored top-down, and a pixel is widened by one on each side
+    // to account for the partial coverage lost by the low resolution.
+    CGRect contentBox = CGRectMake(cropBox.origin.x + (minX - 1.0) / scale,
+                                   cropBox.origin.y + (height - maxY - 2.0) / scale,
+                                   (maxX - minX + 3.0) / scale,
+                                   (maxY - minY + 3.0) / scale);
+    return CGRectIntersection(contentBox, cropBox);
 }
 
 #pragma mark - Drawing in a graphic context
@@ -104,7 +223,15 @@
         CGContextConcatCTM(context, CGAffineTransformMakeScale(kScaleFactorIdentity, -kScaleFactorIdentity));
         CGContextConcatCTM(context, CGAffineTransformMakeTranslation(0, -self.mediaBox.size.height));
     }
-    CGContextDrawPDFPage(context, _pageRef);
+    OHPDFDisplayList* displayList = (self.usesDisplayList || !_pageRef) ? self.displayList : nil;
+    if (displayList)
+    {
+        [displayList drawInContext:context];
+    }
+    else
+    {
+        CGContextDrawPDFPage(context, _pageRef);
+    }
     
     CGContextRestoreGState(context);
 }
@@ -0,0 +1,176 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <UIKit/UIKit.h>
+#import "OHRenderQueue.h"
+#import "OHVectorImage.h"
+@class OHPDFDocument;
+
+/***********************************************************************************/
+
+/**
+ *  The order in which `-[OHPDFThumbnailAtlas renderThumbnailsForPages:order:handler:completion:]`
+ *  delivers the thumbnails.
+ */
+typedef NS_ENUM(NSInteger, OHThumbnailDeliveryOrder) {
+    /**
+     *  The thumbnails are delivered in page order: a thumbnail rendered before
+     *  the ones of the previous pages is held until they are delivered.
+     */
+    OHThumbnailDeliveryOrderPageOrder = 0,
+    /**
+     *  Each thumbnail is delivered as soon as it is rendered.
+     */
+    OHThumbnailDeliveryOrderAsCompleted,
+};
+
+/**
+ *  The thumbnails of the pages of a PDF document, rendered in the background
+ *  and stored in a single shared bitmap (the atlas) instead of one bitmap per page.
+ *
+ *  Each page has a cell of the atlas, as large as the `thumbnailSize`, in which
+ *  it is rendered once, keeping its aspect ratio. The atlas is allocated one row
+ *  of cells at a time, when the first page of the row is rendered.
+ *
+ *  The `UIImage`s returned for the thumbnails don't copy their pixels: they
+ *  reference the row of cells holding them, and keep the whole row alive as long
+ *  as they are, even after the atlas is released.
+ *
+ *  Pages are rendered in parallel, with at most `maxConcurrentRenderCount` pages
+ *  at a time, and only once even if several requests ask for the same page.
+ *  This class is thread-safe.
+ */
+@interface OHPDFThumbnailAtlas : NSObject
+
+/**
+ *  The document whose pages are rendered.
+ */
+@property(nonatomic, strong, readonly) OHPDFDocument* document;
+/**
+ *  The size of the box in which each thumbnail fits, in points.
+ */
+@property(nonatomic, assign, readonly) CGSize thumbnailSize;
+/**
+ *  The scale factor (pixels per point) of the thumbnails.
+ */
+@property(nonatomic, assign, readonly) CGFloat scale;
+/**
+ *  The pixel format of the atlas. Use `OHVectorImagePixelFormatRGB555` to
+ *  halve the memory used by thumbnails of opaque pages.
+ */
+@property(nonatomic, assign, readonly) OHVectorImagePixelFormat pixelFormat;
+/**
+ *  The memory used by the pixels of the atlas, in bytes: the rows of cells
+ *  in which at least one page has been rendered.
+ */
+@property(nonatomic, assign, readonly) size_t byteSize;
+/**
+ *  The color filling the thumbnails behind the page content.
+ *  Defaults to white. Only affects the thumbnails rendered afterwards,
+ *  and can be changed from any thread.
+ */
+@property(nonatomic, strong) UIColor* backgroundColor;
+/**
+ *  The maximum number of pages rendered concurrently.
+ *  Defaults to the number of active processors.
+ */
+@property(nonatomic, assign) NSUInteger maxConcurrentRenderCount;
+
+#pragma mark - Constructor
+
+/**
+ *  Create an atlas for the thumbnails of a document, in RGBA.
+ *
+ *  @param document      The document whose pages are rendered
+ *  @param thumbnailSize The size of the box in which each thumbnail fits, in points
+ *  @param scale         The scale factor of the thumbnails. If 0, uses the scale of the main screen.
+ *
+ *  @return The atlas, or `nil` if the document is `nil` or the size is empty.
+ */
++ (instancetype)atlasWithDocument:(OHPDFDocument*)document
+                    thumbnailSize:(CGSize)thumbnailSize
+                            scale:(CGFloat)scale;
+
+/**
+ *  Create an atlas for the thumbnails of a document.
+ *
+ *  @param document      The document whose pages are rendered
+ *  @param thumbnailSize The size of the box in which each thumbnail fits, in points
+ *  @param scale         The scale factor of the thumbnails. If 0, uses the scale of the main screen.
+ *  @param pixelFormat   The pixel format of the atlas. `OHVectorImagePixelFormatA8`
+ *                       is not supported, and renders RGBA thumbnails instead.
+ *
+ *  @return The atlas, or `nil` if the document is `nil` or the size is empty.
+ */
++ (instancetype)atlasWithDocument:(OHPDFDocument*)document
+                    thumbnailSize:(CGSize)thumbnailSize
+                            scale:(CGFloat)scale
+                      pixelFormat:(OHVectorImagePixelFormat)pixelFormat;
+
+#pragma mark - Rendering thumbnails
+
+/**
+ *  Renders the thumbnails of a range of pages in the background, streaming them
+ *  to the handler as they are rendered. Pages already rendered are delivered
+ *  without being rendered again.
+ *
+ *  @param pageRange  The pages to render. Page numbers start at 1, like in
+ *                    `-[OHPDFDocument pageAtIndex:]`. Clipped to the pages of the document.
+ *  @param order      The order in which the thumbnails are delivered
+ *  @param handler    The block called on the main queue with each thumbnail (`nil` if the
+ *                    page could not be rendered) and the number of its page
+ *  @param completion The block called on the main queue once every thumbnail has been
+ *                    delivered. May be `nil`.
+ *
+ *  @return A token to cancel the request, e.g. when the user scrolls away. Once
+ *          cancelled, neither the handler nor the completion are called anymore, and
+ *          the pages that no other request is waiting for are not rendered.
+ */
+- (OHRenderRequest*)renderThumbnailsForPages:(NSRange)pageRange
+                                       order:(OHThumbnailDeliveryOrder)order
+                                     handler:(void(^)(size_t pageNumber, UIImage* thumbnail))handler
+                                  completion:(void(^)(void))completion;
+
+#pragma mark - Getting thumbnails
+
+/**
+ *  Returns the thumbnail of a page, if it is already rendered.
+ *
+ *  @param pageNumber The page number, starting at 1
+ *
+ *  @return The thumbnail of the page, referencing the pixels of the atlas, or `nil`
+ *          if the page has not been rendered (yet) or could not be rendered.
+ */
+- (UIImage*)thumbnailForPageAtIndex:(size_t)pageNumber;
+
+/**
+ *  Returns the rect of the thumbnail of a page in the atlas, in pixels with the
+ *  origin at the top left, or `CGRectNull` if it has not been rendered (yet).
+ *
+ *  @param pageNumber The page number, starting at 1
+ */
+- (CGRect)pixelRectForPageAtIndex:(size_t)pageNumber;
+
+@end
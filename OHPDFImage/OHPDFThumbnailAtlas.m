@@ -0,0 +1,454 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "OHPDFThumbnailAtlas.h"
+#import "OHPDFDocument.h"
+#import "OHPDFPage.h"
+#import "OHRenderStats.h"
+
+/***********************************************************************************/
+
+typedef NS_ENUM(uint8_t, OHThumbnailState) {
+    OHThumbnailStateNotRendered = 0,
+    OHThumbnailStateRendering,
+    OHThumbnailStateRendered,
+    OHThumbnailStateFailed,
+};
+
+/**
+ *  The state of a `renderThumbnailsForPages:order:handler:completion:` request.
+ *  Only accessed on the main queue.
+ */
+@interface OHThumbnailBatch : NSObject
+@property(nonatomic, strong) OHRenderRequest* request;
+@property(nonatomic, assign) OHThumbnailDeliveryOrder order;
+@property(nonatomic, copy) void(^handler)(size_t pageNumber, UIImage* thumbnail);
+@property(nonatomic, copy) void(^completion)(void);
+@property(nonatomic, assign) size_t nextPageNumber; // The next page to deliver, in page order
+@property(nonatomic, assign) size_t remainingCount;
+@property(nonatomic, strong) NSMutableDictionary* heldThumbnails; // Rendered before the previous pages
+@end
+
+@implementation OHThumbnailBatch
+
+- (void)didRenderPage:(size_t)pageNumber thumbnail:(UIImage*)thumbnail
+{
+    if (self.request.isCancelled) return;
+    
+    if (self.order == OHThumbnailDeliveryOrderAsCompleted)
+    {
+        [self deliverPage:pageNumber thumbnail:thumbnail];
+    }
+    else
+    {
+        self.heldThumbnails[@(pageNumber)] = thumbnail ?: (id)[NSNull null];
+        id heldThumbnail;
+        while ((heldThumbnail = self.heldThumbnails[@(self.nextPageNumber)]))
+        {
+            [self.heldThumbnails removeObjectForKey:@(self.nextPageNumber)];
+            [self deliverPage:self.nextPageNumber++ thumbnail:(heldThumbnail == [NSNull null]) ? nil : heldThumbnail];
+        }
+    }
+}
+
+- (void)deliverPage:(size_t)pageNumber thumbnail:(UIImage*)thumbnail
+{
+    if (self.handler) self.handler(pageNumber, thumbnail);
+    if (--self.remainingCount == 0)
+    {
+        if (self.completion && !self.request.isCancelled) self.completion();
+        self.handler = nil;
+        self.completion = nil;
+    }
+}
+
+@end
+
+/***********************************************************************************/
+
+@interface OHPDFThumbnailAtlas()
+- (instancetype)initWithDocument:(OHPDFDocument*)document
+                   thumbnailSize:(CGSize)thumbnailSize
+                           scale:(CGFloat)scale
+                     pixelFormat:(OHVectorImagePixelFormat)pixelFormat NS_DESIGNATED_INITIALIZER;
+@property(nonatomic, strong) NSOperationQueue* operationQueue;
+@property(nonatomic, strong) NSMutableArray* strips; // The pixels of each row of cells, or NSNull until used
+@property(nonatomic, strong) NSMutableDictionary* pageBatches; // Page number -> batches waiting for the page
+@end
+
+@implementation OHPDFThumbnailAtlas
+{
+    UIColor* _backgroundColor;
+    size_t _byteSize;
+    size_t _pagesCount;
+    size_t _columnsCount;
+    size_t _cellWidth, _cellHeight; // In pixels
+    size_t _bytesPerPixel, _bytesPerRow;
+    OHThumbnailState* _states; // Indexed by page number - 1, like the two arrays below
+    uint16_t* _widths;
+    uint16_t* _heights;
+}
+
+#pragma mark - Constructor
+
++ (instancetype)atlasWithDocument:(OHPDFDocument*)document
+                    thumbnailSize:(CGSize)thumbnailSize
+                            scale:(CGFloat)scale
+{
+    return [self atlasWithDocument:document thumbnailSize:thumbnailSize scale:scale
+                       pixelFormat:OHVectorImagePixelFormatRGBA8888];
+}
+
++ (instancetype)atlasWithDocument:(OHPDFDocument*)document
+                    thumbnailSize:(CGSize)thumbnailSize
+                            scale:(CGFloat)scale
+                      pixelFormat:(OHVectorImagePixelFormat)pixelFormat
+{
+    return [[self alloc] initWithDocument:document thumbnailSize:thumbnailSize scale:scale pixelFormat:pixelFormat];
+}
+
+- (instancetype)initWithDocument:(OHPDFDocument*)document
+                   thumbnailSize:(CGSize)thumbnailSize
+                           scale:(CGFloat)scale
+                     pixelFormat:(OHVectorImagePixelFormat)pixelFormat
+{
+    if (!document || thumbnailSize.width <= 0 || thumbnailSize.height <= 0) return nil;
+    
+    self = [super init];
+    if (self)
+    {
+        _document = document;
+        _thumbnailSize = thumbnailSize;
+        _scale = scale > 0 ? scale : [UIScreen mainScreen].scale;
+        _pixelFormat = (pixelFormat == OHVectorImagePixelFormatRGB555) ? pixelFormat : OHVectorImagePixelFormatRGBA8888;
+        _backgroundColor = [UIColor whiteColor];
+        
+        // Lay the cells out in a roughly square grid
+        _pagesCount = document.pagesCount;
+        _columnsCount = MAX((size_t)1, (size_t)ceil(sqrt((double)_pagesCount)));
+        _cellWidth = MIN((size_t)ceil(thumbnailSize.width * _scale), (size_t)UINT16_MAX);
+        _cellHeight = MIN((size_t)ceil(thumbnailSize.height * _scale), (size_t)UINT16_MAX);
+        _bytesPerPixel = (_pixelFormat == OHVectorImagePixelFormatRGB555) ? 2 : 4;
+        _bytesPerRow = _columnsCount * _cellWidth * _bytesPerPixel;
+        _states = calloc(MAX(_pagesCount, (size_t)1), sizeof(*_states));
+        _widths = calloc(MAX(_pagesCount, (size_t)1), sizeof(*_widths));
+        _heights = calloc(MAX(_pagesCount, (size_t)1), sizeof(*_heights));
+        if (!_states || !_widths || !_heights) return nil;
+        
+        size_t rowsCount = (_pagesCount + _columnsCount - 1) / _columnsCount;
+        _strips = [NSMutableArray arrayWithCapacity:rowsCount];
+        for (size_t row = 0; row < rowsCount; ++row) [_strips addObject:[NSNull null]];
+        _pageBatches = [NSMutableDictionary new];
+        _operationQueue = [NSOperationQueue new];
+        _operationQueue.name = @"com.alisoftware.OHPDFImage.thumbnails";
+        self.maxConcurrentRenderCount = [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_states);
+    free(_widths);
+    free(_heights);
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)maxConcurrentRenderCount
+{
+    return (NSUInteger)self.operationQueue.maxConcurrentOperationCount;
+}
+
+- (void)setMaxConcurrentRenderCount:(NSUInteger)maxConcurrentRenderCount
+{
+    self.operationQueue.maxConcurrentOperationCount = (NSInteger)MAX(maxConcurrentRenderCount, 1u);
+}
+
+- (size_t)byteSize
+{
+    @synchronized(self)
+    {
+        return _byteSize;
+    }
+}
+
+// The pages are rendered in the background, so the color must be read under the lock
+- (UIColor*)backgroundColor
+{
+    @synchronized(self)
+    {
+        return _backgroundColor;
+    }
+}
+
+- (void)setBackgroundColor:(UIColor*)backgroundColor
+{
+    @synchronized(self)
+    {
+        _backgroundColor = backgroundColor;
+    }
+}
+
+#pragma mark - Rendering thumbnails
+
+- (OHRenderRequest*)renderThumbnailsForPages:(NSRange)pageRange
+                                       order:(OHThumbnailDeliveryOrder)order
+                                     handler:(void(^)(size_t pageNumber, UIImage* thumbnail))handler
+                                  completion:(void(^)(void))completion
+{
+    OHRenderRequest* request = [OHRenderRequest new];
+    size_t firstPage = MAX((size_t)pageRange.location, (size_t)1);
+    size_t endPage = MIN((size_t)NSMaxRange(pageRange), _pagesCount + 1);
+    if (firstPage >= endPage)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion && !request.isCancelled) completion();
+        });
+        return request;
+    }
+    
+    OHThumbnailBatch* batch = [OHThumbnailBatch new];
+    batch.request = request;
+    batch.order = order;
+    batch.handler = handler;
+    batch.completion = completion;
+    batch.nextPageNumber = firstPage;
+    batch.remainingCount = endPage - firstPage;
+    batch.heldThumbnails = [NSMutableDictionary new];
+    
+    NSMutableArray* renderedPages = [NSMutableArray new];
+    @synchronized(self)
+    {
+        for (size_t pageNumber = firstPage; pageNumber < endPage; ++pageNumber)
+        {
+            OHThumbnailState state = _states[pageNumber - 1];
+            if (state == OHThumbnailStateRendered || state == OHThumbnailStateFailed)
+            {
+                [renderedPages addObject:@(pageNumber)];
+                continue;
+            }
+            
+            // Wait for the rendering of the page, starting it if no other request did
+            NSMutableArray* batches = self.pageBatches[@(pageNumber)];
+            if (!batches) self.pageBatches[@(pageNumber)] = batches = [NSMutableArray new];
+            [batches addObject:batch];
+            if (state == OHThumbnailStateNotRendered)
+            {
+                _states[pageNumber - 1] = OHThumbnailStateRendering;
+                [self.operationQueue addOperationWithBlock:^{
+                    [self renderPage:pageNumber];
+                }];
+            }
+        }
+    }
+    
+    if (renderedPages.count > 0)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            for (NSNumber* pageNumber in renderedPages)
+            {
+                [batch didRenderPage:pageNumber.unsignedLongValue
+                           thumbnail:[self thumbnailForPageAtIndex:pageNumber.unsignedLongValue]];
+            }
+        });
+    }
+    return request;
+}
+
+#pragma mark - Getting thumbnails
+
+static void OHAtlasStripRelease(void* info, const void* data, size_t size)
+{
+    CFBridgingRelease(info);
+}
+
+- (UIImage*)thumbnailForPageAtIndex:(size_t)pageNumber
+{
+    CGRect pixelRect = [self pixelRectForPageAtIndex:pageNumber];
+    if (CGRectIsNull(pixelRect)) return nil;
+    
+    size_t width = (size_t)pixelRect.size.width, height = (size_t)pixelRect.size.height;
+    NSMutableData* strip;
+    @synchronized(self)
+    {
+        strip = self.strips[(pageNumber - 1) / _columnsCount];
+    }
+    uint8_t* cell = (uint8_t*)strip.mutableBytes + (size_t)pixelRect.origin.x * _bytesPerPixel;
+    
+    // The image reads the pixels of the atlas in place, and keeps their row of cells alive
+    CGDataProviderRef provider = CGDataProviderCreateWithData((__bridge_retained void*)strip, cell,
+                                                              (height - 1) * _bytesPerRow + width * _bytesPerPixel,
+                                                              OHAtlasStripRelease);
+    if (!provider) return nil;
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef cgImage = NULL;
+    if (self.pixelFormat == OHVectorImagePixelFormatRGB555)
+    {
+        cgImage = CGImageCreate(width, height, 5, 16, _bytesPerRow, colorSpace, (CGBitmapInfo)kCGImageAlphaNoneSkipFirst,
+                                provider, NULL, false, kCGRenderingIntentDefault);
+    }
+    else
+    {
+        cgImage = CGImageCreate(width, height, 8, 32, _bytesPerRow, colorSpace,
+                                (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big,
+                                provider, NULL, false, kCGRenderingIntentDefault);
+    }
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    if (!cgImage) return nil;
+    
+    UIImage* image = [UIImage imageWithCGImage:cgImage scale:self.scale orientation:UIImageOrientationUp];
+    CGImageRelease(cgImage);
+    return image;
+}
+
+- (CGRect)pixelRectForPageAtIndex:(size_t)pageNumber
+{
+    if (pageNumber == 0 || pageNumber > _pagesCount) return CGRectNull;
+    
+    size_t index = pageNumber - 1;
+    @synchronized(self)
+    {
+        if (_states[index] != OHThumbnailStateRendered) return CGRectNull;
+        return CGRectMake((index % _columnsCount) * _cellWidth, (index / _columnsCount) * _cellHeight,
+                          _widths[index], _heights[index]);
+    }
+}
+
+#pragma mark - Private Methods
+
+/**
+ *  Renders the thumbnail of a page in its cell, then delivers it to the batches waiting for it.
+ *  Executed on the operation queue.
+ */
+- (void)renderPage:(size_t)pageNumber
+{
+    @synchronized(self)
+    {
+        // Pages that nobody waits for anymore (e.g. after scrolling away) are not rendered
+        BOOL isAwaited = NO;
+        for (OHThumbnailBatch* batch in self.pageBatches[@(pageNumber)])
+        {
+            isAwaited = isAwaited || !batch.request.isCancelled;
+        }
+        if (!isAwaited)
+        {
+            _states[pageNumber - 1] = OHThumbnailStateNotRendered;
+            [self.pageBatches removeObjectForKey:@(pageNumber)];
+            return;
+        }
+    }
+    
+    BOOL success = NO;
+    @autoreleasepool {
+        success = [self drawPage:pageNumber];
+    }
+    
+    NSArray* batches;
+    @synchronized(self)
+    {
+        _states[pageNumber - 1] = success ? OHThumbnailStateRendered : OHThumbnailStateFailed;
+        batches = self.pageBatches[@(pageNumber)];
+        [self.pageBatches removeObjectForKey:@(pageNumber)];
+    }
+    UIImage* thumbnail = success ? [self thumbnailForPageAtIndex:pageNumber] : nil;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        for (OHThumbnailBatch* batch in batches)
+        {
+            [batch didRenderPage:pageNumber thumbnail:thumbnail];
+        }
+    });
+}
+
+/**
+ *  Draws a page in its cell of the atlas, aspect-fitted at the top left of the cell.
+ */
+- (BOOL)drawPage:(size_t)pageNumber
+{
+    OHPDFPage* page = [self.document pageAtIndex:pageNumber];
+    CGSize mediaSize = page.mediaBox.size;
+    if (!page || mediaSize.width <= 0 || mediaSize.height <= 0) return NO;
+    
+    size_t index = pageNumber - 1;
+    uint8_t* pixels = NULL;
+    @synchronized(self)
+    {
+        // Each row of cells is allocated, zero-filled, when the first of its pages is rendered
+        id strip = self.strips[index / _columnsCount];
+        if (strip == [NSNull null])
+        {
+            strip = [NSMutableData dataWithLength:_cellHeight * _bytesPerRow];
+            if (!strip) return NO;
+            self.strips[index / _columnsCount] = strip;
+            _byteSize += _cellHeight * _bytesPerRow;
+        }
+        pixels = [strip mutableBytes];
+    }
+    if (!pixels) return NO;
+    
+    CGFloat fitScale = MIN(_cellWidth / mediaSize.width, _cellHeight / mediaSize.height);
+    size_t width = MIN(MAX((size_t)round(mediaSize.width * fitScale), (size_t)1), _cellWidth);
+    size_t height = MIN(MAX((size_t)round(mediaSize.height * fitScale), (size_t)1), _cellHeight);
+    uint8_t* cell = pixels + (index % _columnsCount) * _cellWidth * _bytesPerPixel;
+    
+    // Each page only draws in its own cell, so pages can be drawn concurrently
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef ctx = NULL;
+    if (self.pixelFormat == OHVectorImagePixelFormatRGB555)
+    {
+        ctx = CGBitmapContextCreate(cell, width, height, 5, _bytesPerRow, colorSpace, (CGBitmapInfo)kCGImageAlphaNoneSkipFirst);
+    }
+    else
+    {
+        ctx = CGBitmapContextCreate(cell, width, height, 8, _bytesPerRow, colorSpace,
+                                    (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    }
+    CGColorSpaceRelease(colorSpace);
+    if (!ctx) return NO;
+    
+    OH_RENDER_STATS_BEGIN(rasterStart);
+    CGRect rect = CGRectMake(0, 0, width, height);
+    UIColor* backgroundColor = self.backgroundColor;
+    if (backgroundColor)
+    {
+        CGContextSetFillColorWithColor(ctx, backgroundColor.CGColor);
+        CGContextFillRect(ctx, rect);
+    }
+    [page drawInContext:ctx rect:rect flipped:NO];
+    OH_RENDER_STATS_END(OHRenderStageRaster, rasterStart);
+    CGContextRelease(ctx);
+    // The pixels live in the atlas, so rendering a thumbnail allocates nothing
+    OHRenderStatsRecordRender(width * height, 0);
+    
+    @synchronized(self)
+    {
+        _widths[index] = (uint16_t)width;
+        _heights[index] = (uint16_t)height;
+    }
+    return YES;
+}
+
+@end
@@ -0,0 +1,814 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#include "OHPixelKernels.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define OH_PIXEL_KERNELS_X86 1
+  #include <emmintrin.h>
+  #include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  #define OH_PIXEL_KERNELS_NEON 1
+  #include <arm_neon.h>
+#endif
+
+/***********************************************************************************/
+
+/*
+ *  Every implementation divides by 255 using the same rounding formula,
+ *  so that the SIMD implementations are bit-exact with the scalar one:
+ *      x / 255  ~=  ((x + 128) + ((x + 128) >> 8)) >> 8
+ *  which is exact (correctly rounded) for every x in [0, 255*255].
+ */
+static inline uint8_t OHDiv255(unsigned x)
+{
+    x += 128;
+    return (uint8_t)((x + (x >> 8)) >> 8);
+}
+
+typedef struct {
+    const char* name;
+    void (*recolorRow)(uint8_t* pixels, size_t count, OHPixelColor color);
+    void (*fillUnderRow)(uint8_t* pixels, size_t count, OHPixelColor color);
+    void (*premultiplyRow)(uint8_t* pixels, size_t count);
+    void (*shadowUnderRow)(uint8_t* pixels, const uint8_t* mask, size_t count, OHPixelColor color);
+    void (*blendSpanRow)(uint8_t* pixels, const uint8_t* coverage, size_t count, OHPixelColor color);
+    void (*accumulateRow)(uint32_t* sums, const uint8_t* bytes, size_t count, uint16_t weight);
+} OHPixelKernelsImpl;
+
+// MARK: - Scalar implementation
+
+static void OHRecolorRowScalar(uint8_t* px, size_t count, OHPixelColor color)
+{
+    for (size_t idx = 0; idx < count; ++idx, px += 4)
+    {
+        unsigned alpha = px[3];
+        px[0] = OHDiv255(color.r * alpha);
+        px[1] = OHDiv255(color.g * alpha);
+        px[2] = OHDiv255(color.b * alpha);
+        px[3] = OHDiv255(color.a * alpha);
+    }
+}
+
+static inline uint8_t OHAddSaturate(unsigned a, unsigned b)
+{
+    unsigned sum = a + b;
+    return (uint8_t)(sum > 255 ? 255 : sum);
+}
+
+static void OHFillUnderRowScalar(uint8_t* px, size_t count, OHPixelColor color)
+{
+    for (size_t idx = 0; idx < count; ++idx, px += 4)
+    {
+        unsigned inverseAlpha = 255 - px[3];
+        px[0] = OHAddSaturate(px[0], OHDiv255(color.r * inverseAlpha));
+        px[1] = OHAddSaturate(px[1], OHDiv255(color.g * inverseAlpha));
+        px[2] = OHAddSaturate(px[2], OHDiv255(color.b * inverseAlpha));
+        px[3] = OHAddSaturate(px[3], OHDiv255(color.a * inverseAlpha));
+    }
+}
+
+static void OHPremultiplyRowScalar(uint8_t* px, size_t count)
+{
+    for (size_t idx = 0; idx < count; ++idx, px += 4)
+    {
+        unsigned alpha = px[3];
+        px[0] = OHDiv255(px[0] * alpha);
+        px[1] = OHDiv255(px[1] * alpha);
+        px[2] = OHDiv255(px[2] * alpha);
+    }
+}
+
+static void OHShadowUnderRowScalar(uint8_t* px, const uint8_t* mask, size_t count, OHPixelColor color)
+{
+    for (size_t idx = 0; idx < count; ++idx, px += 4)
+    {
+        unsigned coverage = mask[idx];
+        unsigned inverseAlpha = 255 - px[3];
+        px[0] = OHAddSaturate(px[0], OHDiv255(OHDiv255(color.r * coverage) * inverseAlpha));
+        px[1] = OHAddSaturate(px[1], OHDiv255(OHDiv255(color.g * coverage) * inverseAlpha));
+        px[2] = OHAddSaturate(px[2], OHDiv255(OHDiv255(color.b * coverage) * inverseAlpha));
+        px[3] = OHAddSaturate(px[3], OHDiv255(OHDiv255(color.a * coverage) * inverseAlpha));
+    }
+}
+
+static void OHBlendSpanRowScalar(uint8_t* px, const uint8_t* coverage, size_t count, OHPixelColor color)
+{
+    for (size_t idx = 0; idx < count; ++idx, px += 4)
+    {
+        unsigned cov = coverage[idx];
+        if (cov == 0) continue;
+        unsigned inverseAlpha = 255 - OHDiv255(color.a * cov);
+        px[0] = OHAddSaturate(OHDiv255(color.r * cov), OHDiv255(px[0] * inverseAlpha));
+        px[1] = OHAddSaturate(OHDiv255(color.g * cov), OHDiv255(px[1] * inverseAlpha));
+        px[2] = OHAddSaturate(OHDiv255(color.b * cov), OHDiv255(px[2] * inverseAlpha));
+        px[3] = OHAddSaturate(OHDiv255(color.a * cov), OHDiv255(px[3] * inverseAlpha));
+    }
+}
+
+/* Adds weight * bytes[i] to sums[i]: the vertical pass of OHPixelDownsample */
+static void OHAccumulateRowScalar(uint32_t* sums, const uint8_t* bytes, size_t count, uint16_t weight)
+{
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        sums[idx] += (uint32_t)bytes[idx] * weight;
+    }
+}
+
+static const OHPixelKernelsImpl kScalarImpl = {
+    "scalar", OHRecolorRowScalar, OHFillUnderRowScalar, OHPremultiplyRowScalar, OHShadowUnderRowScalar,
+    OHBlendSpanRowScalar, OHAccumulateRowScalar
+};
+
+// MARK: - SSE2 & AVX2 implementations
+
+#if OH_PIXEL_KERNELS_X86
+
+/* Generates the kernels for a given vector width. Both SSE2 and AVX2 unpack and
+ * pack within 128-bit lanes, so the same code works for both widths. */
+#define OH_X86_KERNELS(SUFFIX, TARGET, VEC, PREFIX, LOADU, STOREU, SET1_32, WIDTH)       \
+static inline VEC OHDiv255_##SUFFIX(VEC x)                                             \
+{                                                                                       \
+    x = PREFIX##_add_epi16(x, PREFIX##_set1_epi16(128));                               \
+    return PREFIX##_srli_epi16(PREFIX##_add_epi16(x, PREFIX##_srli_epi16(x, 8)), 8);   \
+}                                                                                       \
+/* Multiplies the bytes of px by the bytes of factor, divided by 255 */                \
+static inline VEC OHMulDiv255_##SUFFIX(VEC px, VEC factor)                             \
+{                                                                                       \
+    VEC zero = PREFIX##_setzero_si##WIDTH();                                            \
+    VEC lo = PREFIX##_mullo_epi16(PREFIX##_unpacklo_epi8(px, zero),                    \
+                                  PREFIX##_unpacklo_epi8(factor, zero));               \
+    VEC hi = PREFIX##_mullo_epi16(PREFIX##_unpackhi_epi8(px, zero),                    \
+                                  PREFIX##_unpackhi_epi8(factor, zero));               \
+    return PREFIX##_packus_epi16(OHDiv255_##SUFFIX(lo), OHDiv255_##SUFFIX(hi));        \
+}                                                                                       \
+/* Broadcasts the alpha byte of each pixel to the 4 bytes of the pixel */              \
+static inline VEC OHBroadcastAlpha_##SUFFIX(VEC px)                                    \
+{                                                                                       \
+    VEC alpha = PREFIX##_srli_epi32(px, 24);                                           \
+    alpha = PREFIX##_or_si##WIDTH(alpha, PREFIX##_slli_epi32(alpha, 8));               \
+    return PREFIX##_or_si##WIDTH(alpha, PREFIX##_slli_epi32(alpha, 16));               \
+}                                                                                       \
+TARGET static void OHRecolorRow_##SUFFIX(uint8_t* px, size_t count, OHPixelColor color) \
+{                                                                                       \
+    const size_t step = sizeof(VEC)/4;                                                  \
+    VEC colorVec = SET1_32((int)(color.r | color.g << 8 | color.b << 16 | (uint32_t)color.a << 24)); \
+    size_t idx = 0;                                                                     \
+    for (; idx + step <= count; idx += step, px += 4*step)                              \
+    {                                                                                   \
+        VEC alpha = OHBroadcastAlpha_##SUFFIX(LOADU((const VEC*)px));                  \
+        STOREU((VEC*)px, OHMulDiv255_##SUFFIX(alpha, colorVec));                       \
+    }                                                                                   \
+    OHRecolorRowScalar(px, count - idx, color);                                         \
+}                                                                                       \
+TARGET static void OHFillUnderRow_##SUFFIX(uint8_t* px, size_t count, OHPixelColor color) \
+{                                                                                       \
+    const size_t step = sizeof(VEC)/4;                                                  \
+    VEC colorVec = SET1_32((int)(color.r | color.g << 8 | color.b << 16 | (uint32_t)color.a << 24)); \
+    VEC ones = PREFIX##_set1_epi8((char)0xFF);                                          \
+    size_t idx = 0;                                                                     \
+    for (; idx + step <= count; idx += step, px += 4*step)                              \
+    {                                                                                   \
+        VEC pixels = LOADU((const VEC*)px);                                            \
+        VEC inverseAlpha = PREFIX##_xor_si##WIDTH(OHBroadcastAlpha_##SUFFIX(pixels), ones); \
+        VEC under = OHMulDiv255_##SUFFIX(inverseAlpha, colorVec);                      \
+        STOREU((VEC*)px, PREFIX##_adds_epu8(pixels, under));                           \
+    }                                                                                   \
+    OHFillUnderRowScalar(px, count - idx, color);                                       \
+}                                                                                       \
+TARGET static void OHPremultiplyRow_##SUFFIX(uint8_t* px, size_t count)               \
+{                                                                                       \
+    const size_t step = sizeof(VEC)/4;                                                  \
+    VEC alphaMask = SET1_32((int)0xFF000000);                                           \
+    size_t idx = 0;                                                                     \
+    for (; idx + step <= count; idx += step, px += 4*step)                              \
+    {                                                                                   \
+        VEC pixels = LOADU((const VEC*)px);                                            \
+        /* Multiply R, G, B by alpha, and alpha by 255 to keep it unchanged */          \
+        VEC factor = PREFIX##_or_si##WIDTH(OHBroadcastAlpha_##SUFFIX(pixels), alphaMask); \
+        STOREU((VEC*)px, OHMulDiv255_##SUFFIX(pixels, factor));                        \
+    }                                                                                   \
+    OHPremultiplyRowScalar(px, count - idx);                                            \
+}
+
+#define OH_TARGET_NONE
+OH_X86_KERNELS(SSE2, OH_TARGET_NONE, __m128i, _mm, _mm_loadu_si128, _mm_storeu_si128, _mm_set1_epi32, 128)
+
+#if defined(__GNUC__) || defined(__clang__)
+  #define OH_HAS_AVX2_KERNELS 1
+  #define OH_TARGET_AVX2 __attribute__((target("avx2")))
+  /* Helpers must also be compiled for AVX2 to be inlined in the AVX2 kernels */
+  #if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+  #else
+    #pragma GCC push_options
+    #pragma GCC target("avx2")
+  #endif
+OH_X86_KERNELS(AVX2, OH_TARGET_AVX2, __m256i, _mm256, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_set1_epi32, 256)
+  #if defined(__clang__)
+    #pragma clang attribute pop
+  #else
+    #pragma GCC pop_options
+  #endif
+#endif
+
+/* Expanding the mask bytes to whole pixels crosses 128-bit lanes, so these ones
+ * only have an SSE2 version, which is used by the AVX2 implementation too. */
+static void OHShadowUnderRow_SSE2(uint8_t* px, const uint8_t* mask, size_t count, OHPixelColor color)
+{
+    __m128i colorVec = _mm_set1_epi32((int)(color.r | color.g << 8 | color.b << 16 | (uint32_t)color.a << 24));
+    __m128i ones = _mm_set1_epi8((char)0xFF);
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4, px += 16)
+    {
+        uint32_t maskBytes;
+        memcpy(&maskBytes, mask + idx, sizeof(maskBytes));
+        __m128i coverage = _mm_cvtsi32_si128((int)maskBytes);
+        coverage = _mm_unpacklo_epi8(coverage, coverage);
+        coverage = _mm_unpacklo_epi16(coverage, coverage);
+        __m128i pixels = _mm_loadu_si128((const __m128i*)px);
+        __m128i inverseAlpha = _mm_xor_si128(OHBroadcastAlpha_SSE2(pixels), ones);
+        __m128i shadow = OHMulDiv255_SSE2(coverage, colorVec);
+        __m128i under = OHMulDiv255_SSE2(shadow, inverseAlpha);
+        _mm_storeu_si128((__m128i*)px, _mm_adds_epu8(pixels, under));
+    }
+    OHShadowUnderRowScalar(px, mask + idx, count - idx, color);
+}
+
+static void OHBlendSpanRow_SSE2(uint8_t* px, const uint8_t* coverage, size_t count, OHPixelColor color)
+{
+    uint32_t colorBits = color.r | color.g << 8 | color.b << 16 | (uint32_t)color.a << 24;
+    __m128i colorVec = _mm_set1_epi32((int)colorBits);
+    __m128i ones = _mm_set1_epi8((char)0xFF);
+    size_t idx = 0;
+    for (; idx + 4 <= count; idx += 4, px += 16)
+    {
+        uint32_t maskBytes;
+        memcpy(&maskBytes, coverage + idx, sizeof(maskBytes));
+        // Fast paths for the outside and the inside of opaque shapes (bit-exact with the general case)
+        if (maskBytes == 0) continue;
+        if (maskBytes == 0xFFFFFFFF && color.a == 255)
+        {
+            _mm_storeu_si128((__m128i*)px, colorVec);
+            continue;
+        }
+        __m128i cov = _mm_cvtsi32_si128((int)maskBytes);
+        cov = _mm_unpacklo_epi8(cov, cov);
+        cov = _mm_unpacklo_epi16(cov, cov);
+        __m128i source = OHMulDiv255_SSE2(cov, colorVec);
+        __m128i inverseAlpha = _mm_xor_si128(OHBroadcastAlpha_SSE2(source), ones);
+        __m128i pixels = _mm_loadu_si128((const __m128i*)px);
+        _mm_storeu_si128((__m128i*)px, _mm_adds_epu8(source, OHMulDiv255_SSE2(pixels, inverseAlpha)));
+    }
+    OHBlendSpanRowScalar(px, coverage + idx, count - idx, color);
+}
+
+static void OHAccumulateRow_SSE2(uint32_t* sums, const uint8_t* bytes, size_t count, uint16_t weight)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i weightVec = _mm_set1_epi16((short)weight);
+    size_t idx = 0;
+    for (; idx + 16 <= count; idx += 16)
+    {
+        __m128i values = _mm_loadu_si128((const __m128i*)(bytes + idx));
+        for (int half = 0; half < 2; ++half)
+        {
+            __m128i words = half ? _mm_unpackhi_epi8(values, zero) : _mm_unpacklo_epi8(values, zero);
+            // The 32-bit products, from their low and high 16-bit halves
+            __m128i productLo = _mm_mullo_epi16(words, weightVec);
+            __m128i productHi = _mm_mulhi_epu16(words, weightVec);
+            __m128i* sum = (__m128i*)(sums + idx + 8*half);
+            _mm_storeu_si128(sum, _mm_add_epi32(_mm_loadu_si128(sum), _mm_unpacklo_epi16(productLo, productHi)));
+            _mm_storeu_si128(sum + 1, _mm_add_epi32(_mm_loadu_si128(sum + 1), _mm_unpackhi_epi16(productLo, productHi)));
+        }
+    }
+    OHAccumulateRowScalar(sums + idx, bytes + idx, count - idx, weight);
+}
+
+static const OHPixelKernelsImpl kSSE2Impl = {
+    "sse2", OHRecolorRow_SSE2, OHFillUnderRow_SSE2, OHPremultiplyRow_SSE2, OHShadowUnderRow_SSE2,
+    OHBlendSpanRow_SSE2, OHAccumulateRow_SSE2
+};
+#if OH_HAS_AVX2_KERNELS
+static const OHPixelKernelsImpl kAVX2Impl = {
+    "avx2", OHRecolorRow_AVX2, OHFillUnderRow_AVX2, OHPremultiplyRow_AVX2, OHShadowUnderRow_SSE2,
+    OHBlendSpanRow_SSE2, OHAccumulateRow_SSE2
+};
+#endif
+
+#endif /* OH_PIXEL_KERNELS_X86 */
+
+// MARK: - NEON implementation
+
+#if OH_PIXEL_KERNELS_NEON
+
+/* Multiplies two vectors of bytes, divided by 255 (same rounding as OHDiv255) */
+static inline uint8x16_t OHMulDiv255_NEON(uint8x16_t a, uint8x16_t b)
+{
+    uint16x8_t lo = vmull_u8(vget_low_u8(a), vget_low_u8(b));
+    uint16x8_t hi = vmull_u8(vget_high_u8(a), vget_high_u8(b));
+    return vcombine_u8(vraddhn_u16(lo, vrshrq_n_u16(lo, 8)),
+                       vraddhn_u16(hi, vrshrq_n_u16(hi, 8)));
+}
+
+static void OHRecolorRow_NEON(uint8_t* px, size_t count, OHPixelColor color)
+{
+    size_t idx = 0;
+    for (; idx + 16 <= count; idx += 16, px += 64)
+    {
+        uint8x16x4_t pixels = vld4q_u8(px);
+        uint8x16_t alpha = pixels.val[3];
+        pixels.val[0] = OHMulDiv255_NEON(alpha, vdupq_n_u8(color.r));
+        pixels.val[1] = OHMulDiv255_NEON(alpha, vdupq_n_u8(color.g));
+        pixels.val[2] = OHMulDiv255_NEON(alpha, vdupq_n_u8(color.b));
+        pixels.val[3] = OHMulDiv255_NEON(alpha, vdupq_n_u8(color.a));
+        vst4q_u8(px, pixels);
+    }
+    OHRecolorRowScalar(px, count - idx, color);
+}
+
+static void OHFillUnderRow_NEON(uint8_t* px, size_t count, OHPixelColor color)
+{
+    size_t idx = 0;
+    for (; idx + 16 <= count; idx += 16, px += 64)
+    {
+        uint8x16x4_t pixels = vld4q_u8(px);
+        uint8x16_t inverseAlpha = vmvnq_u8(pixels.val[3]);
+        pixels.val[0] = vqaddq_u8(pixels.val[0], OHMulDiv255_NEON(inverseAlpha, vdupq_n_u8(color.r)));
+        pixels.val[1] = vqaddq_u8(pixels.val[1], OHMulDiv255_NEON(inverseAlpha, vdupq_n_u8(color.g)));
+        pixels.val[2] = vqaddq_u8(pixels.val[2], OHMulDiv255_NEON(inverseAlpha, vdupq_n_u8(color.b)));
+        pixels.val[3] = vqaddq_u8(pixels.val[3], OHMulDiv255_NEON(inverseAlpha, vdupq_n_u8(color.a)));
+        vst4q_u8(px, pixels);
+    }
+    OHFillUnderRowScalar(px, count - idx, color);
+}
+
+static void OHPremultiplyRow_NEON(uint8_t* px, size_t count)
+{
+    size_t idx = 0;
+    for (; idx + 16 <= count; idx += 16, px += 64)
+    {
+        uint8x16x4_t pixels = vld4q_u8(px);
+        pixels.val[0] = OHMulDiv255_NEON(pixels.val[0], pixels.val[3]);
+        pixels.val[1] = OHMulDiv255_NEON(pixels.val[1], pixels.val[3]);
+        pixels.val[2] = OHMulDiv255_NEON(pixels.val[2], pixels.val[3]);
+        vst4q_u8(px, pixels);
+    }
+    OHPremultiplyRowScalar(px, count - idx);
+}
+
+static void OHShadowUnderRow_NEON(uint8_t* px, const uint8_t* mask, size_t count, OHPixelColor color)
+{
+    size_t idx = 0;
+    for (; idx + 16 <= count; idx += 16, px += 64)
+    {
+        uint8x16_t coverage = vld1q_u8(mask + idx);
+        uint8x16x4_t pixels = vld4q_u8(px);
+        uint8x16_t inverseAlpha = vmvnq_u8(pixels.val[3]);
+        const uint8_t components[4] = { color.r, color.g, color.b, color.a };
+        for (int c = 0; c < 4; ++c)
+        {
+            uint8x16_t shadow = OHMulDiv255_NEON(coverage, vdupq_n_u8(components[c]));
+            pixels.val[c] = vqaddq_u8(pixels.val[c], OHMulDiv255_NEON(shadow, inverseAlpha));
+        }
+        vst4q_u8(px, pixels);
+    }
+    OHShadowUnderRowScalar(px, mask + idx, count - idx, color);
+}
+
+static void OHBlendSpanRow_NEON(uint8_t* px, const uint8_t* coverage, size_t count, OHPixelColor color)
+{
+    size_t idx = 0;
+    const uint8_t components[4] = { color.r, color.g, color.b, color.a };
+    for (; idx + 16 <= count; idx += 16, px += 64)
+    {
+        uint8x16_t cov = vld1q_u8(coverage + idx);
+        uint8x16x4_t pixels = vld4q_u8(px);
+        uint8x16_t inverseAlpha = vmvnq_u8(OHMulDiv255_NEON(cov, vdupq_n_u8(color.a)));
+        for (int c = 0; c < 4; ++c)
+        {
+            uint8x16_t source = OHMulDiv255_NEON(cov, vdupq_n_u8(components[c]));
+            pixels.val[c] = vqaddq_u8(source, OHMulDiv255_NEON(pixels.val[c], inverseAlpha));
+        }
+        vst4q_u8(px, pixels);
+    }
+    OHBlendSpanRowScalar(px, coverage + idx, count - idx, color);
+}
+
+static void OHAccumulateRow_NEON(uint32_t* sums, const uint8_t* bytes, size_t count, uint16_t weight)
+{
+    uint16x4_t weightVec = vdup_n_u16(weight);
+    size_t idx = 0;
+    for (; idx + 16 <= count; idx += 16)
+    {
+        uint8x16_t values = vld1q_u8(bytes + idx);
+        uint16x8_t lo = vmovl_u8(vget_low_u8(values));
+        uint16x8_t hi = vmovl_u8(vget_high_u8(values));
+        uint32_t* sum = sums + idx;
+        vst1q_u32(sum,      vmlal_u16(vld1q_u32(sum),      vget_low_u16(lo),  weightVec));
+        vst1q_u32(sum + 4,  vmlal_u16(vld1q_u32(sum + 4),  vget_high_u16(lo), weightVec));
+        vst1q_u32(sum + 8,  vmlal_u16(vld1q_u32(sum + 8),  vget_low_u16(hi),  weightVec));
+        vst1q_u32(sum + 12, vmlal_u16(vld1q_u32(sum + 12), vget_high_u16(hi), weightVec));
+    }
+    OHAccumulateRowScalar(sums + idx, bytes + idx, count - idx, weight);
+}
+
+static const OHPixelKernelsImpl kNEONImpl = {
+    "neon", OHRecolorRow_NEON, OHFillUnderRow_NEON, OHPremultiplyRow_NEON, OHShadowUnderRow_NEON,
+    OHBlendSpanRow_NEON, OHAccumulateRow_NEON
+};
+
+#endif /* OH_PIXEL_KERNELS_NEON */
+
+// MARK: - Runtime dispatch
+
+static int sForceScalar = 0;
+
+static const OHPixelKernelsImpl* OHSelectImpl(void)
+{
+    if (sForceScalar) return &kScalarImpl;
+    
+    // Selecting is idempotent, so a race on first use is harmless
+    static const OHPixelKernelsImpl* selectedImpl = NULL;
+    if (!selectedImpl)
+    {
+#if OH_PIXEL_KERNELS_X86
+  #if OH_HAS_AVX2_KERNELS
+        __builtin_cpu_init();
+        selectedImpl = __builtin_cpu_supports("avx2") ? &kAVX2Impl : &kSSE2Impl;
+  #else
+        selectedImpl = &kSSE2Impl;
+  #endif
+#elif OH_PIXEL_KERNELS_NEON
+        selectedImpl = &kNEONImpl;
+#else
+        selectedImpl = &kScalarImpl;
+#endif
+    }
+    return selectedImpl;
+}
+
+const char* OHPixelKernelsImplementationName(void)
+{
+    return OHSelectImpl()->name;
+}
+
+void OHPixelKernelsForceScalar(int forceScalar)
+{
+    sForceScalar = forceScalar;
+}
+
+// MARK: - Public kernels
+
+OHPixelColor OHPixelColorPremultiply(OHPixelColor color)
+{
+    return (OHPixelColor){
+        .r = OHDiv255(color.r * color.a),
+        .g = OHDiv255(color.g * color.a),
+        .b = OHDiv255(color.b * color.a),
+        .a = color.a
+    };
+}
+
+void OHPixelRecolor(OHPixelBuffer buffer, OHPixelColor color)
+{
+    const OHPixelKernelsImpl* impl = OHSelectImpl();
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        impl->recolorRow(buffer.data + y * buffer.bytesPerRow, buffer.width, color);
+    }
+}
+
+/* The nearest level of the straight component `component * 255 / alpha` of a premultiplied pixel */
+static inline size_t OHRecolorLevel(unsigned component, unsigned alpha)
+{
+    unsigned level = (2 * (OH_PIXEL_RECOLOR_LEVELS - 1) * component + alpha) / (2 * alpha);
+    return level < OH_PIXEL_RECOLOR_LEVELS ? level : OH_PIXEL_RECOLOR_LEVELS - 1;
+}
+
+static inline size_t OHRecolorIndex(size_t r, size_t g, size_t b)
+{
+    return (r * OH_PIXEL_RECOLOR_LEVELS + g) * OH_PIXEL_RECOLOR_LEVELS + b;
+}
+
+size_t OHPixelRecolorTableIndex(OHPixelColor color)
+{
+    return OHRecolorIndex(OHRecolorLevel(color.r, 255), OHRecolorLevel(color.g, 255), OHRecolorLevel(color.b, 255));
+}
+
+void OHPixelRecolorWithLookupTable(OHPixelBuffer buffer, const OHPixelColor table[OH_PIXEL_RECOLOR_TABLE_SIZE])
+{
+    // Table lookups are gathers, which don't vectorize well on every target, so this one stays scalar
+    OHPixelColor premultipliedTable[OH_PIXEL_RECOLOR_TABLE_SIZE];
+    for (size_t idx = 0; idx < OH_PIXEL_RECOLOR_TABLE_SIZE; ++idx)
+    {
+        premultipliedTable[idx] = OHPixelColorPremultiply(table[idx]);
+    }
+    
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        uint8_t* px = buffer.data + y * buffer.bytesPerRow;
+        for (size_t x = 0; x < buffer.width; ++x, px += 4)
+        {
+            unsigned alpha = px[3];
+            if (alpha == 0) continue;
+            
+            // The levels of the straight color, without unpremultiplying each component first
+            OHPixelColor color = premultipliedTable[OHRecolorIndex(OHRecolorLevel(px[0], alpha),
+                                                                   OHRecolorLevel(px[1], alpha),
+                                                                   OHRecolorLevel(px[2], alpha))];
+            px[0] = OHDiv255(color.r * alpha);
+            px[1] = OHDiv255(color.g * alpha);
+            px[2] = OHDiv255(color.b * alpha);
+            px[3] = OHDiv255(color.a * alpha);
+        }
+    }
+}
+
+/**
+ *  Projects a color on the segment between two colors.
+ *
+ *  @return The squared distance between the color and its projection, and in `t`
+ *          the position of the projection on the segment, between 0 (at `a`) and 1 (at `b`).
+ */
+static double OHProjectOnSegment(const double color[3], OHPixelColor a, OHPixelColor b, double* t)
+{
+    const double ab[3] = { (double)b.r - a.r, (double)b.g - a.g, (double)b.b - a.b };
+    const double ac[3] = { color[0] - a.r, color[1] - a.g, color[2] - a.b };
+    double length = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+    double u = length > 0 ? (ab[0] * ac[0] + ab[1] * ac[1] + ab[2] * ac[2]) / length : 0;
+    u = u < 0 ? 0 : u > 1 ? 1 : u;
+    *t = u;
+    double distance = 0;
+    for (int idx = 0; idx < 3; ++idx)
+    {
+        double delta = ac[idx] - u * ab[idx];
+        distance += delta * delta;
+    }
+    return distance;
+}
+
+static uint8_t OHInterpolateComponent(uint8_t from, uint8_t to, double t)
+{
+    return (uint8_t)(from + (to - from) * t + 0.5);
+}
+
+int OHPixelLookupTableFromColorMap(const OHPixelColor* sources, const OHPixelColor* targets, size_t count,
+                                   OHPixelColor table[OH_PIXEL_RECOLOR_TABLE_SIZE])
+{
+    if (count == 0) return -1;
+    
+    const size_t levels = OH_PIXEL_RECOLOR_LEVELS;
+    for (size_t idx = 0; idx < OH_PIXEL_RECOLOR_TABLE_SIZE; ++idx)
+    {
+        const double step = 255.0 / (levels - 1);
+        const double color[3] = { (double)(idx / (levels * levels)) * step, (double)(idx / levels % levels) * step,
+                                  (double)(idx % levels) * step };
+        
+        // The nearest segment between two sources (or source, when both ends are the same)
+        double bestDistance = -1, bestT = 0;
+        size_t from = 0, to = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (size_t j = i; j < count; ++j)
+            {
+                double t;
+                double distance = OHProjectOnSegment(color, sources[i], sources[j], &t);
+                if (bestDistance < 0 || distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    bestT = t;
+                    from = i;
+                    to = j;
+                }
+            }
+        }
+        table[idx] = (OHPixelColor){
+            .r = OHInterpolateComponent(targets[from].r, targets[to].r, bestT),
+            .g = OHInterpolateComponent(targets[from].g, targets[to].g, bestT),
+            .b = OHInterpolateComponent(targets[from].b, targets[to].b, bestT),
+            .a = OHInterpolateComponent(targets[from].a, targets[to].a, bestT)
+        };
+    }
+    
+    // The quantized sources themselves take their exact targets
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        table[OHPixelRecolorTableIndex(sources[idx])] = targets[idx];
+    }
+    return 0;
+}
+
+void OHPixelFillUnder(OHPixelBuffer buffer, OHPixelColor color)
+{
+    const OHPixelKernelsImpl* impl = OHSelectImpl();
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        impl->fillUnderRow(buffer.data + y * buffer.bytesPerRow, buffer.width, color);
+    }
+}
+
+void OHPixelShadowUnder(OHPixelBuffer buffer, const uint8_t* mask, size_t maskBytesPerRow,
+                        long offsetX, long offsetY, OHPixelColor color)
+{
+    const OHPixelKernelsImpl* impl = OHSelectImpl();
+    
+    // Only process the pixels for which the shifted mask is defined, the rest is unshadowed
+    long width = (long)buffer.width, height = (long)buffer.height;
+    long minX = offsetX > 0 ? offsetX : 0, maxX = offsetX < 0 ? width + offsetX : width;
+    long minY = offsetY > 0 ? offsetY : 0, maxY = offsetY < 0 ? height + offsetY : height;
+    if (minX >= maxX) return;
+    
+    for (long y = minY; y < maxY; ++y)
+    {
+        uint8_t* px = buffer.data + (size_t)y * buffer.bytesPerRow + (size_t)minX * 4;
+        const uint8_t* maskRow = mask + (size_t)(y - offsetY) * maskBytesPerRow + (size_t)(minX - offsetX);
+        impl->shadowUnderRow(px, maskRow, (size_t)(maxX - minX), color);
+    }
+}
+
+void OHPixelBlendSpan(uint8_t* pixels, const uint8_t* coverage, size_t count, OHPixelColor color)
+{
+    OHSelectImpl()->blendSpanRow(pixels, coverage, count, color);
+}
+
+void OHPixelPremultiply(OHPixelBuffer buffer)
+{
+    const OHPixelKernelsImpl* impl = OHSelectImpl();
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        impl->premultiplyRow(buffer.data + y * buffer.bytesPerRow, buffer.width);
+    }
+}
+
+void OHPixelUnpremultiply(OHPixelBuffer buffer)
+{
+    // Division does not vectorize well on every target, so this one stays scalar
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        uint8_t* px = buffer.data + y * buffer.bytesPerRow;
+        for (size_t x = 0; x < buffer.width; ++x, px += 4)
+        {
+            unsigned alpha = px[3];
+            if (alpha == 0)
+            {
+                px[0] = px[1] = px[2] = 0;
+            }
+            else if (alpha < 255)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    unsigned value = (px[c] * 255 + alpha/2) / alpha;
+                    px[c] = (uint8_t)(value > 255 ? 255 : value);
+                }
+            }
+        }
+    }
+}
+
+void OHPixelAlphaShadowUnder(uint8_t* alpha, size_t width, size_t height, size_t bytesPerRow,
+                             const uint8_t* mask, size_t maskBytesPerRow,
+                             long offsetX, long offsetY, uint8_t shadowAlpha)
+{
+    // A8 buffers are a quarter of the size of RGBA ones, so this one stays scalar
+    long minX = offsetX > 0 ? offsetX : 0, maxX = offsetX < 0 ? (long)width + offsetX : (long)width;
+    long minY = offsetY > 0 ? offsetY : 0, maxY = offsetY < 0 ? (long)height + offsetY : (long)height;
+    for (long y = minY; y < maxY; ++y)
+    {
+        uint8_t* row = alpha + (size_t)y * bytesPerRow;
+        const uint8_t* maskRow = mask + (size_t)(y - offsetY) * maskBytesPerRow;
+        for (long x = minX; x < maxX; ++x)
+        {
+            unsigned shadow = OHDiv255(shadowAlpha * maskRow[x - offsetX]);
+            row[x] = (uint8_t)(row[x] + OHDiv255(shadow * (255u - row[x])));
+        }
+    }
+}
+
+// MARK: - Downsampling
+
+/* The source pixels covered by one destination pixel (or row), and their weights */
+typedef struct {
+    size_t first;
+    size_t count;
+    const uint16_t* weights;
+} OHAreaSpan;
+
+static const uint32_t kAreaWeightOne = 1u << 15;
+
+/* Computes the area filter of every destination pixel along one axis. The weights are
+ * in Q15 and always sum to exactly kAreaWeightOne, so that a uniform source stays uniform.
+ * `weights` must have room for sourceSize + destinationSize weights. */
+static void OHComputeAreaSpans(size_t sourceSize, size_t destinationSize, OHAreaSpan* spans, uint16_t* weights)
+{
+    for (size_t idx = 0; idx < destinationSize; ++idx)
+    {
+        // The destination pixel covers [start, end), in units of 1/destinationSize source pixel
+        size_t start = idx * sourceSize, end = start + sourceSize;
+        size_t first = start / destinationSize, last = (end - 1) / destinationSize;
+        spans[idx] = (OHAreaSpan){ .first = first, .count = last - first + 1, .weights = weights };
+        
+        uint32_t total = 0;
+        size_t largest = 0;
+        for (size_t src = first; src <= last; ++src)
+        {
+            size_t pixelStart = src * destinationSize, pixelEnd = pixelStart + destinationSize;
+            size_t overlap = (end < pixelEnd ? end : pixelEnd) - (start > pixelStart ? start : pixelStart);
+            uint16_t weight = (uint16_t)(((overlap << 15) + sourceSize/2) / sourceSize);
+            weights[src - first] = weight;
+            total += weight;
+            if (weight > weights[largest]) largest = src - first;
+        }
+        // Give the rounding error to the largest weight
+        weights[largest] = (uint16_t)(weights[largest] + kAreaWeightOne - total);
+        weights += spans[idx].count;
+    }
+}
+
+int OHPixelDownsample(OHPixelBuffer source, OHPixelBuffer destination)
+{
+    if (destination.width > source.width || destination.height > source.height) return -1;
+    if (destination.width == 0 || destination.height == 0) return 0;
+    
+    const size_t rowBytes = source.width * 4;
+    OHAreaSpan* columns = malloc(destination.width * sizeof(OHAreaSpan));
+    OHAreaSpan* rows = malloc(destination.height * sizeof(OHAreaSpan));
+    uint16_t* columnWeights = malloc((source.width + destination.width) * sizeof(uint16_t));
+    uint16_t* rowWeights = malloc((source.height + destination.height) * sizeof(uint16_t));
+    uint32_t* sums = malloc(rowBytes * sizeof(uint32_t));
+    uint8_t* row = malloc(rowBytes);
+    int result = -1;
+    if (columns && rows && columnWeights && rowWeights && sums && row)
+    {
+        OHComputeAreaSpans(source.width, destination.width, columns, columnWeights);
+        OHComputeAreaSpans(source.height, destination.height, rows, rowWeights);
+        const OHPixelKernelsImpl* impl = OHSelectImpl();
+        
+        for (size_t y = 0; y < destination.height; ++y)
+        {
+            // Vertical pass, on whole rows: this is where most of the source bytes are read
+            memset(sums, 0, rowBytes * sizeof(uint32_t));
+            const uint8_t* sourceRow = source.data + rows[y].first * source.bytesPerRow;
+            for (size_t k = 0; k < rows[y].count; ++k, sourceRow += source.bytesPerRow)
+            {
+                impl->accumulateRow(sums, sourceRow, rowBytes, rows[y].weights[k]);
+            }
+            for (size_t idx = 0; idx < rowBytes; ++idx)
+            {
+                row[idx] = (uint8_t)((sums[idx] + kAreaWeightOne/2) >> 15);
+            }
+            
+            // Horizontal pass, on the (much shorter) intermediate row
+            uint8_t* px = destination.data + y * destination.bytesPerRow;
+            for (size_t x = 0; x < destination.width; ++x, px += 4)
+            {
+                const uint8_t* sourcePx = row + columns[x].first * 4;
+                uint32_t r = kAreaWeightOne/2, g = r, b = r, a = r;
+                for (size_t k = 0; k < columns[x].count; ++k, sourcePx += 4)
+                {
+                    uint32_t weight = columns[x].weights[k];
+                    r += sourcePx[0] * weight;
+                    g += sourcePx[1] * weight;
+                    b += sourcePx[2] * weight;
+                    a += sourcePx[3] * weight;
+                }
+                px[0] = (uint8_t)(r >> 15);
+                px[1] = (uint8_t)(g >> 15);
+                px[2] = (uint8_t)(b >> 15);
+                px[3] = (uint8_t)(a >> 15);
+            }
+        }
+        result = 0;
+    }
+    free(columns);
+    free(rows);
+    free(columnWeights);
+    free(rowWeights);
+    free(sums);
+    free(row);
+    return result;
+}
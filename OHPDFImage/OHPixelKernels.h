@@ -0,0 +1,219 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHPDFImage_OHPixelKernels_h
+#define OHPDFImage_OHPixelKernels_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***********************************************************************************/
+
+/*
+ *  Pixel kernels operating on 8-bit RGBA buffers (R, G, B, A bytes in memory,
+ *  i.e. kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big).
+ *
+ *  This module is plain C with no dependency on Apple frameworks, so that it
+ *  can be compiled, tested and benchmarked on any platform. Each kernel has a
+ *  scalar implementation, and SIMD implementations (SSE2/AVX2 on x86, NEON on
+ *  ARM) that are selected at runtime and produce bit-exact results.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  An 8-bit RGBA color.
+ */
+typedef struct {
+    uint8_t r, g, b, a;
+} OHPixelColor;
+
+/**
+ *  A buffer of 8-bit RGBA pixels.
+ */
+typedef struct {
+    uint8_t* data;
+    size_t width;
+    size_t height;
+    size_t bytesPerRow;
+} OHPixelBuffer;
+
+/**
+ *  Returns the premultiplied version of a straight (non-premultiplied) color.
+ */
+OHPixelColor OHPixelColorPremultiply(OHPixelColor color);
+
+/**
+ *  Recolors every pixel of a premultiplied buffer with a solid color,
+ *  keeping only the alpha of the pixels (`pixel = color * pixel.alpha`).
+ *
+ *  @param buffer The premultiplied buffer to recolor in place
+ *  @param color  The premultiplied color to use
+ */
+void OHPixelRecolor(OHPixelBuffer buffer, OHPixelColor color);
+
+/**
+ *  The lookup tables of `OHPixelRecolorWithLookupTable` are indexed by the straight
+ *  color of the pixels, quantized to `OH_PIXEL_RECOLOR_LEVELS` levels per component
+ *  (0, 17, 34… 255): the entry of the levels (r, g, b) is at `(r * 16 + g) * 16 + b`.
+ */
+#define OH_PIXEL_RECOLOR_LEVELS 16
+#define OH_PIXEL_RECOLOR_TABLE_SIZE (OH_PIXEL_RECOLOR_LEVELS * OH_PIXEL_RECOLOR_LEVELS * OH_PIXEL_RECOLOR_LEVELS)
+
+/**
+ *  Returns the index of a straight color in the tables of `OHPixelRecolorWithLookupTable`,
+ *  i.e. of the nearest levels of its components. The alpha is ignored.
+ */
+size_t OHPixelRecolorTableIndex(OHPixelColor color);
+
+/**
+ *  Recolors every pixel of a premultiplied buffer through a lookup table indexed by
+ *  the quantized straight color of the pixel, keeping its coverage
+ *  (`pixel = table[index(pixel)] * pixel.alpha`). This maps the colors of a
+ *  multi-color image to other colors in a single pass, e.g. to theme two-tone icons.
+ *
+ *  @param buffer The premultiplied buffer to recolor in place
+ *  @param table  The `OH_PIXEL_RECOLOR_TABLE_SIZE` straight colors to map each quantized
+ *                color to. The alpha of an entry scales the alpha of the pixels it applies to.
+ */
+void OHPixelRecolorWithLookupTable(OHPixelBuffer buffer, const OHPixelColor table[OH_PIXEL_RECOLOR_TABLE_SIZE]);
+
+/**
+ *  Fills a lookup table for `OHPixelRecolorWithLookupTable` from a map of source
+ *  colors to target colors. Each source color is mapped to its target, and every
+ *  other color is mapped like its projection on the nearest segment between two
+ *  sources, so that the antialiased edges between two source colors blend between
+ *  their targets. With a single source, every color is mapped to its target.
+ *
+ *  @param sources The straight source colors. Their alpha is ignored, and sources with
+ *                 the same quantized color (see `OHPixelRecolorTableIndex`) are told
+ *                 apart by their last one only.
+ *  @param targets The straight target colors, one per source
+ *  @param count   The number of colors in `sources` and `targets`
+ *  @param table   The `OH_PIXEL_RECOLOR_TABLE_SIZE` entries to fill
+ *
+ *  @return 0 on success, -1 if `count` is 0.
+ */
+int OHPixelLookupTableFromColorMap(const OHPixelColor* sources, const OHPixelColor* targets, size_t count,
+                                   OHPixelColor table[OH_PIXEL_RECOLOR_TABLE_SIZE]);
+
+/**
+ *  Composites a solid color under every pixel of a premultiplied buffer
+ *  (`pixel = pixel + color * (1 - pixel.alpha)`).
+ *
+ *  @param buffer The premultiplied buffer to composite in place
+ *  @param color  The premultiplied color to fill the background with
+ */
+void OHPixelFillUnder(OHPixelBuffer buffer, OHPixelColor color);
+
+/**
+ *  Composites a shadow under every pixel of a premultiplied buffer, using an 8-bit
+ *  coverage mask shifted by the given offset
+ *  (`pixel = pixel + color * mask[y - offsetY][x - offsetX] * (1 - pixel.alpha)`).
+ *
+ *  @param buffer          The premultiplied buffer to composite in place
+ *  @param mask            The (typically blurred) shadow coverage mask,
+ *                         with the same width and height as the buffer
+ *  @param maskBytesPerRow The number of bytes per row of the mask
+ *  @param offsetX         The horizontal offset of the shadow, in pixels
+ *  @param offsetY         The vertical offset of the shadow, in pixels (rows)
+ *  @param color           The premultiplied shadow color
+ */
+void OHPixelShadowUnder(OHPixelBuffer buffer, const uint8_t* mask, size_t maskBytesPerRow,
+                        long offsetX, long offsetY, OHPixelColor color);
+
+/**
+ *  Composites a solid color over a span of premultiplied pixels, using an 8-bit
+ *  coverage per pixel (`pixel = color * coverage + pixel * (1 - color.alpha * coverage)`).
+ *  This is the span filling primitive of `OHRasterizer`.
+ *
+ *  @param pixels   The first pixel of the span, composited in place
+ *  @param coverage The coverage of each pixel of the span
+ *  @param count    The number of pixels in the span
+ *  @param color    The premultiplied color to composite
+ */
+void OHPixelBlendSpan(uint8_t* pixels, const uint8_t* coverage, size_t count, OHPixelColor color);
+
+/**
+ *  Converts a buffer with straight alpha to premultiplied alpha, in place.
+ */
+void OHPixelPremultiply(OHPixelBuffer buffer);
+
+/**
+ *  Converts a buffer with premultiplied alpha to straight alpha, in place.
+ */
+void OHPixelUnpremultiply(OHPixelBuffer buffer);
+
+/**
+ *  Composites a shadow under every pixel of an 8-bit alpha-only (A8) buffer.
+ *  This is the A8 counterpart of `OHPixelShadowUnder`
+ *  (`alpha = alpha + shadowAlpha * mask[y - offsetY][x - offsetX] * (1 - alpha)`).
+ *
+ *  @param alpha           The alpha buffer to composite in place
+ *  @param width           The width of the buffer (and of the mask)
+ *  @param height          The height of the buffer (and of the mask)
+ *  @param bytesPerRow     The number of bytes per row of the buffer
+ *  @param mask            The (typically blurred) shadow coverage mask
+ *  @param maskBytesPerRow The number of bytes per row of the mask
+ *  @param offsetX         The horizontal offset of the shadow, in pixels
+ *  @param offsetY         The vertical offset of the shadow, in pixels (rows)
+ *  @param shadowAlpha     The alpha of the shadow color
+ */
+void OHPixelAlphaShadowUnder(uint8_t* alpha, size_t width, size_t height, size_t bytesPerRow,
+                             const uint8_t* mask, size_t maskBytesPerRow,
+                             long offsetX, long offsetY, uint8_t shadowAlpha);
+
+/**
+ *  Downsamples a premultiplied buffer into a smaller one with an area (box) filter:
+ *  each destination pixel is the average of the source pixels it covers, weighted by
+ *  the covered area. The scale factor can differ on each axis and needs not be an integer.
+ *
+ *  @param source      The premultiplied buffer to downsample
+ *  @param destination The buffer to fill, which must not be larger than the source
+ *
+ *  @return 0 on success, -1 if the destination is larger than the source
+ *          or if the scratch memory could not be allocated
+ */
+int OHPixelDownsample(OHPixelBuffer source, OHPixelBuffer destination);
+
+/**
+ *  The name of the implementation selected at runtime for the SIMD kernels
+ *  ("scalar", "sse2", "avx2" or "neon"). Useful for logging benchmarks.
+ */
+const char* OHPixelKernelsImplementationName(void);
+
+/**
+ *  Forces the use of the scalar implementation (if `forceScalar` is non-zero)
+ *  or restores the runtime selection. Intended for tests and benchmarks.
+ */
+void OHPixelKernelsForceScalar(int forceScalar);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
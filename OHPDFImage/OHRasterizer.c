@@ -0,0 +1,1256 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#include "OHRasterizer.h"
+#include "OHShadowBlur.h"
+#include "OHRenderStats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+#define OH_SUBSCANLINES 16       /* Sub-scanlines sampled per pixel row */
+#define OH_MAX_DASH_COUNT 16     /* Longer dash arrays are drawn solid */
+static double const kFlatteningTolerance = 0.1; /* Max distance to curves, in pixels */
+static double const kPi = 3.14159265358979323846;
+
+static inline uint8_t OHDiv255(unsigned x)
+{
+    x += 128;
+    return (uint8_t)((x + (x >> 8)) >> 8);
+}
+
+static int OHGrowArray(void** array, size_t* capacity, size_t needed, size_t elementSize)
+{
+    if (needed <= *capacity) return 0;
+    size_t newCapacity = *capacity ? *capacity : 64;
+    while (newCapacity < needed) newCapacity *= 2;
+    void* newArray = realloc(*array, newCapacity * elementSize);
+    if (!newArray) return -1;
+    *array = newArray;
+    *capacity = newCapacity;
+    return 0;
+}
+
+// MARK: - Contours
+
+typedef struct {
+    double x, y;
+} OHPoint;
+
+/* Flattened subpaths, in user space */
+typedef struct {
+    OHPoint* points;
+    size_t pointCount, pointCapacity;
+    size_t* ends;       /* Index past the last point of each contour */
+    uint8_t* closed;    /* Whether each contour was closed using ClosePath */
+    size_t contourCount, contourCapacity, closedCapacity;
+} OHContours;
+
+static void OHContoursReset(OHContours* contours)
+{
+    contours->pointCount = 0;
+    contours->contourCount = 0;
+}
+
+static int OHContoursBegin(OHContours* contours)
+{
+    if (OHGrowArray((void**)&contours->ends, &contours->contourCapacity,
+                    contours->contourCount + 1, sizeof(size_t)) != 0) return -1;
+    if (OHGrowArray((void**)&contours->closed, &contours->closedCapacity,
+                    contours->contourCount + 1, sizeof(uint8_t)) != 0) return -1;
+    contours->ends[contours->contourCount] = contours->pointCount;
+    contours->closed[contours->contourCount] = 0;
+    contours->contourCount++;
+    return 0;
+}
+
+static int OHContoursAddPoint(OHContours* contours, OHPoint point)
+{
+    if (contours->contourCount == 0 && OHContoursBegin(contours) != 0) return -1;
+    if (OHGrowArray((void**)&contours->points, &contours->pointCapacity,
+                    contours->pointCount + 1, sizeof(OHPoint)) != 0) return -1;
+    contours->points[contours->pointCount++] = point;
+    contours->ends[contours->contourCount - 1] = contours->pointCount;
+    return 0;
+}
+
+static size_t OHContourStart(const OHContours* contours, size_t contour)
+{
+    return contour == 0 ? 0 : contours->ends[contour - 1];
+}
+
+static void OHContoursRelease(OHContours* contours)
+{
+    free(contours->points);
+    free(contours->ends);
+    free(contours->closed);
+}
+
+// MARK: - Edges
+
+typedef struct {
+    double x0, y0, y1, dxdy;
+    int winding;
+} OHEdge;
+
+/* Polygon edges, in device space */
+typedef struct {
+    OHEdge* edges;
+    size_t count, capacity;
+    double minY, maxY;
+    int failed;
+} OHEdgeList;
+
+static void OHEdgeListReset(OHEdgeList* list)
+{
+    list->count = 0;
+    list->minY = INFINITY;
+    list->maxY = -INFINITY;
+    list->failed = 0;
+}
+
+static void OHEdgeListAddLine(OHEdgeList* list, OHPoint p0, OHPoint p1, int winding)
+{
+    if (p0.y == p1.y || !isfinite(p0.x + p0.y + p1.x + p1.y)) return;
+    if (p0.y > p1.y)
+    {
+        OHPoint p = p0; p0 = p1; p1 = p;
+        winding = -winding;
+    }
+    if (OHGrowArray((void**)&list->edges, &list->capacity, list->count + 1, sizeof(OHEdge)) != 0)
+    {
+        list->failed = 1;
+        return;
+    }
+    list->edges[list->count++] = (OHEdge){
+        .x0 = p0.x, .y0 = p0.y, .y1 = p1.y,
+        .dxdy = (p1.x - p0.x) / (p1.y - p0.y),
+        .winding = winding
+    };
+    if (p0.y < list->minY) list->minY = p0.y;
+    if (p1.y > list->maxY) list->maxY = p1.y;
+}
+
+/* The bounds { minX, minY, maxX, maxY } of the edges, empty (min > max) if there are none */
+static void OHEdgeListGetBounds(const OHEdgeList* list, double bounds[4])
+{
+    bounds[0] = bounds[1] = INFINITY;
+    bounds[2] = bounds[3] = -INFINITY;
+    for (size_t idx = 0; idx < list->count; ++idx)
+    {
+        const OHEdge* edge = &list->edges[idx];
+        double x1 = edge->x0 + edge->dxdy * (edge->y1 - edge->y0);
+        bounds[0] = fmin(bounds[0], fmin(edge->x0, x1));
+        bounds[2] = fmax(bounds[2], fmax(edge->x0, x1));
+    }
+    if (list->count > 0)
+    {
+        bounds[1] = list->minY;
+        bounds[3] = list->maxY;
+    }
+}
+
+static inline OHPoint OHTransform(const double ctm[6], OHPoint p)
+{
+    return (OHPoint){ ctm[0]*p.x + ctm[2]*p.y + ctm[4], ctm[1]*p.x + ctm[3]*p.y + ctm[5] };
+}
+
+/* Adds a closed polygon given in user space. If `normalize` is set, the polygon is
+ * added with a positive orientation, so that overlapping polygons (like the pieces
+ * of a stroke) combine into their union with the nonzero winding rule. */
+static void OHEdgeListAddPolygon(OHEdgeList* list, const double ctm[6], const OHPoint* points, size_t count, int normalize)
+{
+    if (count < 2) return;
+    int winding = 1;
+    if (normalize)
+    {
+        double area = 0;
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            OHPoint a = points[idx], b = points[(idx + 1) % count];
+            area += a.x * b.y - b.x * a.y;
+        }
+        // The orientation is preserved or reversed by the transform, like the area sign
+        if (ctm[0]*ctm[3] - ctm[1]*ctm[2] < 0) area = -area;
+        winding = area < 0 ? -1 : 1;
+    }
+    OHPoint first = OHTransform(ctm, points[0]), previous = first;
+    for (size_t idx = 1; idx < count; ++idx)
+    {
+        OHPoint point = OHTransform(ctm, points[idx]);
+        OHEdgeListAddLine(list, previous, point, winding);
+        previous = point;
+    }
+    OHEdgeListAddLine(list, previous, first, winding);
+}
+
+static int OHCompareEdges(const void* a, const void* b)
+{
+    double ya = ((const OHEdge*)a)->y0, yb = ((const OHEdge*)b)->y0;
+    return ya < yb ? -1 : ya > yb;
+}
+
+// MARK: - Scan conversion
+
+typedef struct {
+    int32_t x; /* 24.8 fixed point */
+    int winding;
+} OHCrossing;
+
+/* Scratch memory of the scan converter, reused between paths */
+typedef struct {
+    size_t width, height;
+    int32_t* accumulation; /* width + 2 coverage deltas */
+    uint8_t* coverage;     /* width coverage bytes */
+    size_t* active;
+    size_t activeCapacity;
+    OHCrossing* crossings;
+    size_t crossingsCapacity;
+} OHScanner;
+
+/* Called for each row covered by a path, with the coverage of pixels [x0, x1) */
+typedef void (*OHScanRowFunction)(void* info, size_t y, uint8_t* coverage, size_t x0, size_t x1);
+
+static inline void OHAccumulateSpan(int32_t* accumulation, int32_t a, int32_t b)
+{
+    int32_t ia = a >> 8, fa = a & 255;
+    int32_t ib = b >> 8, fb = b & 255;
+    if (ia == ib)
+    {
+        accumulation[ia] += fb - fa;
+        accumulation[ia + 1] -= fb - fa;
+    }
+    else
+    {
+        // Partial first pixel, full pixels, partial last pixel, as deltas
+        accumulation[ia] += 256 - fa;
+        accumulation[ia + 1] += fa;
+        accumulation[ib] += fb - 256;
+        accumulation[ib + 1] -= fb;
+    }
+}
+
+static int OHScanEdges(OHScanner* scanner, OHEdgeList* list, int evenOdd, OHScanRowFunction function, void* info)
+{
+    if (list->failed) return -1;
+    if (list->count == 0) return 0;
+    
+    qsort(list->edges, list->count, sizeof(OHEdge), OHCompareEdges);
+    if (OHGrowArray((void**)&scanner->active, &scanner->activeCapacity, list->count, sizeof(size_t)) != 0) return -1;
+    if (OHGrowArray((void**)&scanner->crossings, &scanner->crossingsCapacity, list->count, sizeof(OHCrossing)) != 0) return -1;
+    
+    const double maxX = (double)scanner->width;
+    long minY = (long)floor(list->minY), maxY = (long)ceil(list->maxY);
+    if (minY < 0) minY = 0;
+    if (maxY > (long)scanner->height) maxY = (long)scanner->height;
+    
+    size_t nextEdge = 0, activeCount = 0;
+    for (long y = minY; y < maxY; ++y)
+    {
+        // Skip the rows without active edges
+        if (activeCount == 0)
+        {
+            if (nextEdge == list->count) break;
+            long firstRow = (long)floor(list->edges[nextEdge].y0);
+            if (firstRow > y) y = firstRow;
+            if (y >= maxY) break;
+        }
+        
+        size_t rowMinX = scanner->width, rowMaxX = 0;
+        for (int sub = 0; sub < OH_SUBSCANLINES; ++sub)
+        {
+            double sy = (double)y + (sub + 0.5) / OH_SUBSCANLINES;
+            while (nextEdge < list->count && list->edges[nextEdge].y0 <= sy)
+            {
+                scanner->active[activeCount++] = nextEdge++;
+            }
+            
+            // Drop the edges ending above the sub-scanline, and intersect the others
+            size_t crossingCount = 0, kept = 0;
+            for (size_t idx = 0; idx < activeCount; ++idx)
+            {
+                const OHEdge* edge = &list->edges[scanner->active[idx]];
+                if (edge->y1 <= sy) continue;
+                scanner->active[kept++] = scanner->active[idx];
+                if (edge->y0 > sy) continue;
+                double x = edge->x0 + (sy - edge->y0) * edge->dxdy;
+                x = x < 0 ? 0 : (x > maxX ? maxX : x);
+                OHCrossing crossing = { (int32_t)lround(x * 256), edge->winding };
+                // Insertion sort: crossings are few, and mostly sorted from one sub-scanline to the next
+                size_t pos = crossingCount++;
+                while (pos > 0 && scanner->crossings[pos - 1].x > crossing.x)
+                {
+                    scanner->crossings[pos] = scanner->crossings[pos - 1];
+                    --pos;
+                }
+                scanner->crossings[pos] = crossing;
+            }
+            activeCount = kept;
+            
+            int winding = 0;
+            for (size_t idx = 0; idx + 1 < crossingCount; ++idx)
+            {
+                winding += scanner->crossings[idx].winding;
+                int inside = evenOdd ? (winding & 1) : (winding != 0);
+                int32_t a = scanner->crossings[idx].x, b = scanner->crossings[idx + 1].x;
+                if (!inside || a == b) continue;
+                OHAccumulateSpan(scanner->accumulation, a, b);
+                size_t first = (size_t)(a >> 8), last = (size_t)((b - 1) >> 8);
+                if (first < rowMinX) rowMinX = first;
+                if (last > rowMaxX) rowMaxX = last;
+            }
+        }
+        
+        if (rowMinX <= rowMaxX)
+        {
+            // Integrate the deltas, and clear them for the next row
+            int32_t sum = 0;
+            for (size_t x = rowMinX; x <= rowMaxX; ++x)
+            {
+                sum += scanner->accumulation[x];
+                scanner->accumulation[x] = 0;
+                int32_t alpha = (sum * 255 + (OH_SUBSCANLINES * 256) / 2) / (OH_SUBSCANLINES * 256);
+                scanner->coverage[x] = (uint8_t)(alpha > 255 ? 255 : (alpha < 0 ? 0 : alpha));
+            }
+            scanner->accumulation[rowMaxX + 1] = 0;
+            scanner->accumulation[rowMaxX + 2] = 0;
+            function(info, (size_t)y, scanner->coverage, rowMinX, rowMaxX + 1);
+        }
+    }
+    return 0;
+}
+
+// MARK: - Graphics state
+
+typedef struct {
+    int refCount;
+    uint8_t* data; /* width * height coverage bytes */
+} OHClipMask;
+
+typedef struct {
+    double ctm[6];
+    OHPixelColor fillColor;   /* Straight */
+    OHPixelColor strokeColor; /* Straight */
+    double lineWidth;
+    double miterLimit;
+    int lineCap;
+    int lineJoin;
+    double dash[OH_MAX_DASH_COUNT];
+    size_t dashCount;
+    double dashPhase;
+    OHClipMask* clip;         /* NULL if not clipped */
+    double clipBounds[4];     /* When measuring: the bounds of the clip, in device space */
+} OHRasterState;
+
+typedef struct {
+    OHRasterBuffer buffer;
+    OHRasterState* states;
+    size_t stateCount, stateCapacity;
+    OHDisplayList* path;  /* The current path, in user space */
+    OHContours contours;
+    OHEdgeList edges;
+    OHScanner scanner;
+    OHPixelColor paintColor; /* Premultiplied color of the current paint operation */
+    const uint8_t* paintClip;
+    uint8_t* newClip;
+    int measuring;            /* Accumulate the bounds of the painted edges instead of rasterizing */
+    double bounds[4];
+    int failed;
+    size_t bytesAllocated;    /* Clip masks and dashes allocated so far, for OHRenderStats */
+} OHRasterContext;
+
+static OHRasterState* OHCurrentState(OHRasterContext* context)
+{
+    return &context->states[context->stateCount - 1];
+}
+
+static void OHClipMaskRelease(OHClipMask* clip)
+{
+    if (clip && --clip->refCount == 0)
+    {
+        free(clip->data);
+        free(clip);
+    }
+}
+
+static OHPixelColor OHColorFromOperands(const float* operands)
+{
+    uint8_t components[4];
+    for (int idx = 0; idx < 4; ++idx)
+    {
+        float value = operands[idx] < 0 ? 0 : (operands[idx] > 1 ? 1 : operands[idx]);
+        components[idx] = (uint8_t)lroundf(value * 255);
+    }
+    return (OHPixelColor){ components[0], components[1], components[2], components[3] };
+}
+
+/* The largest scale factor of the transform, used to convert device tolerances to user space */
+static double OHTransformScale(const double ctm[6])
+{
+    double sx = ctm[0]*ctm[0] + ctm[1]*ctm[1];
+    double sy = ctm[2]*ctm[2] + ctm[3]*ctm[3];
+    double scale = sqrt(sx > sy ? sx : sy);
+    return scale > 1e-9 ? scale : 1e-9;
+}
+
+// MARK: - Flattening
+
+typedef struct {
+    OHContours* contours;
+    double tolerance;   /* In user space */
+    OHPoint current;
+    OHPoint start;
+    int hasCurrent;
+    int needsMoveTo;    /* After a ClosePath, the next segment starts a new contour */
+    int failed;
+} OHFlattener;
+
+static void OHFlattenerLineTo(OHFlattener* flattener, OHPoint point)
+{
+    if (flattener->needsMoveTo || !flattener->hasCurrent)
+    {
+        OHPoint start = flattener->hasCurrent ? flattener->current : point;
+        if (OHContoursBegin(flattener->contours) != 0 || OHContoursAddPoint(flattener->contours, start) != 0) flattener->failed = 1;
+        flattener->start = start;
+        flattener->needsMoveTo = 0;
+        flattener->hasCurrent = 1;
+    }
+    if (OHContoursAddPoint(flattener->contours, point) != 0) flattener->failed = 1;
+    flattener->current = point;
+}
+
+static void OHFlattenOperation(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    OHFlattener* flattener = (OHFlattener*)info;
+    (void)count;
+    switch (op)
+    {
+        case OHDisplayListOpMoveTo:
+        {
+            OHPoint point = { operands[0], operands[1] };
+            if (OHContoursBegin(flattener->contours) != 0 || OHContoursAddPoint(flattener->contours, point) != 0) flattener->failed = 1;
+            flattener->current = flattener->start = point;
+            flattener->hasCurrent = 1;
+            flattener->needsMoveTo = 0;
+            break;
+        }
+        case OHDisplayListOpLineTo:
+            OHFlattenerLineTo(flattener, (OHPoint){ operands[0], operands[1] });
+            break;
+        case OHDisplayListOpCurveTo:
+        {
+            OHPoint p0 = flattener->hasCurrent ? flattener->current : (OHPoint){ operands[0], operands[1] };
+            OHPoint p1 = { operands[0], operands[1] }, p2 = { operands[2], operands[3] }, p3 = { operands[4], operands[5] };
+            // Wang's formula: number of segments keeping the flattening error under the tolerance
+            double ddx = fmax(fabs(p0.x - 2*p1.x + p2.x), fabs(p1.x - 2*p2.x + p3.x));
+            double ddy = fmax(fabs(p0.y - 2*p1.y + p2.y), fabs(p1.y - 2*p2.y + p3.y));
+            double segments = ceil(sqrt(0.75 * sqrt(ddx*ddx + ddy*ddy) / flattener->tolerance));
+            int n = segments < 1 ? 1 : (segments > 256 ? 256 : (int)segments);
+            for (int idx = 1; idx <= n; ++idx)
+            {
+                double t = (double)idx / n, u = 1 - t;
+                double b0 = u*u*u, b1 = 3*u*u*t, b2 = 3*u*t*t, b3 = t*t*t;
+                OHFlattenerLineTo(flattener, (OHPoint){
+                    b0*p0.x + b1*p1.x + b2*p2.x + b3*p3.x,
+                    b0*p0.y + b1*p1.y + b2*p2.y + b3*p3.y
+                });
+            }
+            break;
+        }
+        case OHDisplayListOpClosePath:
+            if (flattener->hasCurrent && !flattener->needsMoveTo && flattener->contours->contourCount > 0)
+            {
+                flattener->contours->closed[flattener->contours->contourCount - 1] = 1;
+                flattener->current = flattener->start;
+                flattener->needsMoveTo = 1;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static int OHFlattenPath(OHRasterContext* context)
+{
+    OHContoursReset(&context->contours);
+    OHFlattener flattener = {
+        .contours = &context->contours,
+        .tolerance = kFlatteningTolerance / OHTransformScale(OHCurrentState(context)->ctm)
+    };
+    OHDisplayListApply(context->path, &flattener, OHFlattenOperation);
+    return flattener.failed ? -1 : 0;
+}
+
+static void OHAddFillEdges(OHRasterContext* context)
+{
+    const OHContours* contours = &context->contours;
+    const double* ctm = OHCurrentState(context)->ctm;
+    for (size_t contour = 0; contour < contours->contourCount; ++contour)
+    {
+        size_t start = OHContourStart(contours, contour);
+        OHEdgeListAddPolygon(&context->edges, ctm, contours->points + start, contours->ends[contour] - start, 0);
+    }
+}
+
+// MARK: - Stroking
+
+typedef struct {
+    OHEdgeList* edges;
+    const double* ctm;
+    double halfWidth;
+    double tolerance;
+    int lineCap;
+    int lineJoin;
+    double miterLimit;
+    size_t* bytesAllocated;
+} OHStroker;
+
+static void OHStrokeCircle(const OHStroker* stroker, OHPoint center)
+{
+    double r = stroker->halfWidth;
+    double ratio = 1 - stroker->tolerance / r;
+    int n = ratio <= 0 ? 8 : (int)ceil(kPi / acos(ratio));
+    n = n < 8 ? 8 : (n > 128 ? 128 : n);
+    OHPoint points[128];
+    for (int idx = 0; idx < n; ++idx)
+    {
+        double angle = 2 * kPi * idx / n;
+        points[idx] = (OHPoint){ center.x + r * cos(angle), center.y + r * sin(angle) };
+    }
+    OHEdgeListAddPolygon(stroker->edges, stroker->ctm, points, (size_t)n, 1);
+}
+
+static void OHStrokeSegment(const OHStroker* stroker, OHPoint a, OHPoint b)
+{
+    double dx = b.x - a.x, dy = b.y - a.y, length = hypot(dx, dy);
+    double nx = -dy / length * stroker->halfWidth, ny = dx / length * stroker->halfWidth;
+    OHPoint quad[4] = {
+        { a.x + nx, a.y + ny }, { b.x + nx, b.y + ny },
+        { b.x - nx, b.y - ny }, { a.x - nx, a.y - ny }
+    };
+    OHEdgeListAddPolygon(stroker->edges, stroker->ctm, quad, 4, 1);
+}
+
+static void OHStrokeJoin(const OHStroker* stroker, OHPoint previous, OHPoint point, OHPoint next)
+{
+    if (stroker->lineJoin == 1)
+    {
+        OHStrokeCircle(stroker, point);
+        return;
+    }
+    double d1x = point.x - previous.x, d1y = point.y - previous.y, l1 = hypot(d1x, d1y);
+    double d2x = next.x - point.x, d2y = next.y - point.y, l2 = hypot(d2x, d2y);
+    d1x /= l1; d1y /= l1; d2x /= l2; d2y /= l2;
+    double cross = d1x * d2y - d1y * d2x;
+    if (fabs(cross) < 1e-12 && d1x * d2x + d1y * d2y > 0) return; // Collinear, nothing to join
+    
+    // The join is on the outer side of the turn (the right side when turning left)
+    double side = cross > 0 ? -1 : 1, hw = stroker->halfWidth;
+    OHPoint n1 = { -d1y * side, d1x * side }, n2 = { -d2y * side, d2x * side };
+    OHPoint a = { point.x + n1.x * hw, point.y + n1.y * hw };
+    OHPoint b = { point.x + n2.x * hw, point.y + n2.y * hw };
+    
+    // Miter length / line width = 1 / sin(angle/2), and 1 / sin²(angle/2) = 2 / (1 + n1.n2)
+    double dot = n1.x * n2.x + n1.y * n2.y;
+    if (stroker->lineJoin == 0 && dot > -1 + 1e-9 && 2 / (1 + dot) <= stroker->miterLimit * stroker->miterLimit)
+    {
+        OHPoint miter = { point.x + (n1.x + n2.x) * hw / (1 + dot), point.y + (n1.y + n2.y) * hw / (1 + dot) };
+        OHPoint quad[4] = { point, a, miter, b };
+        OHEdgeListAddPolygon(stroker->edges, stroker->ctm, quad, 4, 1);
+    }
+    else
+    {
+        OHPoint triangle[3] = { point, a, b };
+        OHEdgeListAddPolygon(stroker->edges, stroker->ctm, triangle, 3, 1);
+    }
+}
+
+static void OHStrokeCap(const OHStroker* stroker, OHPoint end, OHPoint previous)
+{
+    if (stroker->lineCap == 1)
+    {
+        OHStrokeCircle(stroker, end);
+    }
+    else if (stroker->lineCap == 2)
+    {
+        // Square cap: extend the segment by half the line width
+        double dx = end.x - previous.x, dy = end.y - previous.y, length = hypot(dx, dy);
+        dx = dx / length * stroker->halfWidth;
+        dy = dy / length * stroker->halfWidth;
+        OHStrokeSegment(stroker, end, (OHPoint){ end.x + dx, end.y + dy });
+    }
+}
+
+/* Strokes a polyline whose consecutive points are distinct */
+static void OHStrokePolyline(const OHStroker* stroker, const OHPoint* points, size_t count, int closed)
+{
+    if (count == 1)
+    {
+        // Zero-length subpaths are only drawn with round and square caps
+        if (stroker->lineCap == 1) OHStrokeCircle(stroker, points[0]);
+        else if (stroker->lineCap == 2)
+        {
+            double hw = stroker->halfWidth;
+            OHPoint square[4] = {
+                { points[0].x - hw, points[0].y - hw }, { points[0].x + hw, points[0].y - hw },
+                { points[0].x + hw, points[0].y + hw }, { points[0].x - hw, points[0].y + hw }
+            };
+            OHEdgeListAddPolygon(stroker->edges, stroker->ctm, square, 4, 1);
+        }
+        return;
+    }
+    if (closed && count < 3) closed = 0;
+    
+    size_t segments = closed ? count : count - 1;
+    for (size_t idx = 0; idx < segments; ++idx)
+    {
+        OHStrokeSegment(stroker, points[idx], points[(idx + 1) % count]);
+    }
+    if (closed)
+    {
+        for (size_t idx = 0; idx < count; ++idx)
+        {
+            OHStrokeJoin(stroker, points[(idx + count - 1) % count], points[idx], points[(idx + 1) % count]);
+        }
+    }
+    else
+    {
+        for (size_t idx = 1; idx + 1 < count; ++idx)
+        {
+            OHStrokeJoin(stroker, points[idx - 1], points[idx], points[idx + 1]);
+        }
+        OHStrokeCap(stroker, points[0], points[1]);
+        OHStrokeCap(stroker, points[count - 1], points[count - 2]);
+    }
+}
+
+/* Removes the consecutive duplicate points of a contour (in place) */
+static size_t OHRemoveDuplicatePoints(OHPoint* points, size_t count, int closed)
+{
+    size_t kept = count > 0 ? 1 : 0;
+    for (size_t idx = 1; idx < count; ++idx)
+    {
+        if (points[idx].x != points[kept - 1].x || points[idx].y != points[kept - 1].y)
+        {
+            points[kept++] = points[idx];
+        }
+    }
+    // The closing point of a closed contour is implicit
+    if (closed && kept > 1 && points[kept - 1].x == points[0].x && points[kept - 1].y == points[0].y) --kept;
+    return kept;
+}
+
+/* Splits a polyline into its dashes, and strokes each of them */
+static int OHStrokeDashed(const OHStroker* stroker, const OHRasterState* state,
+                          const OHPoint* points, size_t count, int closed)
+{
+    double total = 0;
+    for (size_t idx = 0; idx < state->dashCount; ++idx) total += state->dash[idx];
+    
+    // Find where the phase falls in the dash pattern
+    size_t dashIndex = 0;
+    double remaining = state->dash[0];
+    double phase = fmod(state->dashPhase, total);
+    if (phase < 0) phase += total;
+    while (phase > 0)
+    {
+        if (phase < remaining) { remaining -= phase; break; }
+        phase -= remaining;
+        dashIndex = (dashIndex + 1) % state->dashCount;
+        remaining = state->dash[dashIndex];
+    }
+    
+    OHPoint* dash = malloc((count + 2) * sizeof(OHPoint));
+    if (!dash) return -1;
+    *stroker->bytesAllocated += (count + 2) * sizeof(OHPoint);
+    size_t dashCount = 0;
+    int on = (dashIndex % 2) == 0;
+    if (on) dash[dashCount++] = points[0];
+    
+    size_t segments = closed ? count : count - 1;
+    for (size_t idx = 0; idx < segments; ++idx)
+    {
+        OHPoint a = points[idx], b = points[(idx + 1) % count];
+        double length = hypot(b.x - a.x, b.y - a.y), position = 0;
+        while (length - position > remaining)
+        {
+            position += remaining;
+            OHPoint split = { a.x + (b.x - a.x) * position / length, a.y + (b.y - a.y) * position / length };
+            if (on)
+            {
+                dash[dashCount++] = split;
+                OHStrokePolyline(stroker, dash, OHRemoveDuplicatePoints(dash, dashCount, 0), 0);
+                dashCount = 0;
+            }
+            else
+            {
+                dash[dashCount++] = split;
+            }
+            on = !on;
+            dashIndex = (dashIndex + 1) % state->dashCount;
+            remaining = state->dash[dashIndex];
+        }
+        remaining -= length - position;
+        if (on) dash[dashCount++] = b;
+    }
+    if (on && dashCount > 1) OHStrokePolyline(stroker, dash, OHRemoveDuplicatePoints(dash, dashCount, 0), 0);
+    free(dash);
+    return 0;
+}
+
+static int OHAddStrokeEdges(OHRasterContext* context)
+{
+    const OHRasterState* state = OHCurrentState(context);
+    double scale = OHTransformScale(state->ctm);
+    OHStroker stroker = {
+        .edges = &context->edges,
+        .ctm = state->ctm,
+        // A zero line width means the thinnest line that can be rendered: one pixel
+        .halfWidth = (state->lineWidth > 0 ? state->lineWidth : 1 / scale) / 2,
+        .tolerance = kFlatteningTolerance / scale,
+        .lineCap = state->lineCap,
+        .lineJoin = state->lineJoin,
+        .miterLimit = state->miterLimit,
+        .bytesAllocated = &context->bytesAllocated
+    };
+    
+    OHContours* contours = &context->contours;
+    for (size_t contour = 0; contour < contours->contourCount; ++contour)
+    {
+        size_t start = OHContourStart(contours, contour), count = contours->ends[contour] - start;
+        if (count < 2) continue; // A lone MoveTo draws nothing
+        int closed = contours->closed[contour];
+        OHPoint* points = contours->points + start;
+        count = OHRemoveDuplicatePoints(points, count, closed);
+        
+        if (state->dashCount > 0 && count > 1)
+        {
+            if (OHStrokeDashed(&stroker, state, points, count, closed) != 0) return -1;
+        }
+        else
+        {
+            OHStrokePolyline(&stroker, points, count, closed);
+        }
+    }
+    return 0;
+}
+
+// MARK: - Painting
+
+static void OHPaintRow(void* info, size_t y, uint8_t* coverage, size_t x0, size_t x1)
+{
+    OHRasterContext* context = (OHRasterContext*)info;
+    const OHRasterBuffer* buffer = &context->buffer;
+    if (context->paintClip)
+    {
+        const uint8_t* clip = context->paintClip + y * buffer->width;
+        for (size_t x = x0; x < x1; ++x) coverage[x] = OHDiv255(coverage[x] * clip[x]);
+    }
+    
+    uint8_t* row = buffer->data + y * buffer->bytesPerRow;
+    if (buffer->format == OHRasterFormatRGBA8)
+    {
+        OHPixelBlendSpan(row + x0 * 4, coverage + x0, x1 - x0, context->paintColor);
+    }
+    else
+    {
+        unsigned alpha = context->paintColor.a;
+        for (size_t x = x0; x < x1; ++x)
+        {
+            unsigned source = OHDiv255(alpha * coverage[x]);
+            row[x] = (uint8_t)(source + OHDiv255(row[x] * (255 - source)));
+        }
+    }
+}
+
+static void OHClipRow(void* info, size_t y, uint8_t* coverage, size_t x0, size_t x1)
+{
+    OHRasterContext* context = (OHRasterContext*)info;
+    size_t offset = y * context->buffer.width;
+    uint8_t* newClip = context->newClip + offset;
+    if (context->paintClip)
+    {
+        const uint8_t* clip = context->paintClip + offset;
+        for (size_t x = x0; x < x1; ++x) newClip[x] = OHDiv255(coverage[x] * clip[x]);
+    }
+    else
+    {
+        memcpy(newClip + x0, coverage + x0, x1 - x0);
+    }
+}
+
+/* Intersects bounds with other bounds, in place */
+static void OHIntersectBounds(double bounds[4], const double other[4])
+{
+    bounds[0] = fmax(bounds[0], other[0]);
+    bounds[1] = fmax(bounds[1], other[1]);
+    bounds[2] = fmin(bounds[2], other[2]);
+    bounds[3] = fmin(bounds[3], other[3]);
+}
+
+static void OHPaintEdges(OHRasterContext* context, int evenOdd, OHPixelColor color)
+{
+    const OHRasterState* state = OHCurrentState(context);
+    context->paintColor = OHPixelColorPremultiply(color);
+    context->paintClip = state->clip ? state->clip->data : NULL;
+    if (color.a == 0) return;
+    if (context->measuring)
+    {
+        double bounds[4];
+        OHEdgeListGetBounds(&context->edges, bounds);
+        OHIntersectBounds(bounds, state->clipBounds);
+        if (bounds[0] < bounds[2] && bounds[1] < bounds[3])
+        {
+            context->bounds[0] = fmin(context->bounds[0], bounds[0]);
+            context->bounds[1] = fmin(context->bounds[1], bounds[1]);
+            context->bounds[2] = fmax(context->bounds[2], bounds[2]);
+            context->bounds[3] = fmax(context->bounds[3], bounds[3]);
+        }
+        return;
+    }
+    if (OHScanEdges(&context->scanner, &context->edges, evenOdd, OHPaintRow, context) != 0) context->failed = 1;
+}
+
+static void OHFill(OHRasterContext* context, int evenOdd)
+{
+    OHEdgeListReset(&context->edges);
+    OHAddFillEdges(context);
+    OHPaintEdges(context, evenOdd, OHCurrentState(context)->fillColor);
+}
+
+static void OHStroke(OHRasterContext* context)
+{
+    OHEdgeListReset(&context->edges);
+    if (OHAddStrokeEdges(context) != 0) { context->failed = 1; return; }
+    OHPaintEdges(context, 0, OHCurrentState(context)->strokeColor);
+}
+
+static void OHClip(OHRasterContext* context, int evenOdd)
+{
+    OHRasterState* state = OHCurrentState(context);
+    if (context->measuring)
+    {
+        double bounds[4];
+        OHEdgeListReset(&context->edges);
+        OHAddFillEdges(context);
+        OHEdgeListGetBounds(&context->edges, bounds);
+        OHIntersectBounds(state->clipBounds, bounds);
+        return;
+    }
+    OHClipMask* clip = calloc(1, sizeof(OHClipMask));
+    size_t size = context->buffer.width * context->buffer.height;
+    if (clip) clip->data = calloc(size > 0 ? size : 1, 1);
+    if (!clip || !clip->data)
+    {
+        free(clip);
+        context->failed = 1;
+        return;
+    }
+    clip->refCount = 1;
+    context->bytesAllocated += size;
+    
+    OHEdgeListReset(&context->edges);
+    OHAddFillEdges(context);
+    context->paintClip = state->clip ? state->clip->data : NULL;
+    context->newClip = clip->data;
+    if (OHScanEdges(&context->scanner, &context->edges, evenOdd, OHClipRow, context) != 0) context->failed = 1;
+    
+    OHClipMaskRelease(state->clip);
+    state->clip = clip;
+}
+
+static void OHRasterOperation(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    OHRasterContext* context = (OHRasterContext*)info;
+    if (context->failed) return;
+    OHRasterState* state = OHCurrentState(context);
+    switch (op)
+    {
+        case OHDisplayListOpMoveTo:
+        case OHDisplayListOpLineTo:
+        case OHDisplayListOpCurveTo:
+        case OHDisplayListOpClosePath:
+            if (OHDisplayListAppend(context->path, op, operands, count) != 0) context->failed = 1;
+            return;
+        case OHDisplayListOpFill:
+        case OHDisplayListOpEOFill:
+        case OHDisplayListOpStroke:
+        case OHDisplayListOpFillStroke:
+        case OHDisplayListOpEOFillStroke:
+        case OHDisplayListOpClip:
+        case OHDisplayListOpEOClip:
+        {
+            if (OHFlattenPath(context) != 0) { context->failed = 1; break; }
+            int evenOdd = op == OHDisplayListOpEOFill || op == OHDisplayListOpEOFillStroke || op == OHDisplayListOpEOClip;
+            if (op == OHDisplayListOpClip || op == OHDisplayListOpEOClip)
+            {
+                OHClip(context, evenOdd);
+            }
+            else
+            {
+                if (op != OHDisplayListOpStroke) OHFill(context, evenOdd);
+                if (op == OHDisplayListOpStroke || op == OHDisplayListOpFillStroke || op == OHDisplayListOpEOFillStroke)
+                {
+                    OHStroke(context);
+                }
+            }
+            break;
+        }
+        case OHDisplayListOpSave:
+            if (OHGrowArray((void**)&context->states, &context->stateCapacity,
+                            context->stateCount + 1, sizeof(OHRasterState)) != 0)
+            {
+                context->failed = 1;
+                return;
+            }
+            state = OHCurrentState(context);
+            context->states[context->stateCount++] = *state;
+            if (state->clip) state->clip->refCount++;
+            return;
+        case OHDisplayListOpRestore:
+            if (context->stateCount > 1)
+            {
+                OHClipMaskRelease(state->clip);
+                context->stateCount--;
+            }
+            return;
+        case OHDisplayListOpConcatCTM:
+        {
+            const double* m = state->ctm;
+            double a = operands[0], b = operands[1], c = operands[2], d = operands[3], tx = operands[4], ty = operands[5];
+            double ctm[6] = {
+                a*m[0] + b*m[2], a*m[1] + b*m[3],
+                c*m[0] + d*m[2], c*m[1] + d*m[3],
+                tx*m[0] + ty*m[2] + m[4], tx*m[1] + ty*m[3] + m[5]
+            };
+            memcpy(state->ctm, ctm, sizeof(ctm));
+            return;
+        }
+        case OHDisplayListOpSetFillColor: state->fillColor = OHColorFromOperands(operands); return;
+        case OHDisplayListOpSetStrokeColor: state->strokeColor = OHColorFromOperands(operands); return;
+        case OHDisplayListOpSetLineWidth: state->lineWidth = operands[0]; return;
+        case OHDisplayListOpSetLineCap: state->lineCap = (int)operands[0]; return;
+        case OHDisplayListOpSetLineJoin: state->lineJoin = (int)operands[0]; return;
+        case OHDisplayListOpSetMiterLimit: state->miterLimit = operands[0] < 1 ? 1 : operands[0]; return;
+        case OHDisplayListOpSetDash:
+        {
+            // Like in PDF, an odd number of lengths is repeated, and a pattern of zeros is solid
+            size_t lengths = count - 2, dashCount = lengths % 2 ? 2 * lengths : lengths;
+            double total = 0;
+            for (size_t idx = 0; idx < lengths; ++idx) total += operands[idx + 2] > 0 ? operands[idx + 2] : 0;
+            state->dashCount = 0;
+            if (dashCount <= OH_MAX_DASH_COUNT && total > 0)
+            {
+                for (size_t idx = 0; idx < dashCount; ++idx)
+                {
+                    float length = operands[2 + idx % lengths];
+                    state->dash[idx] = length > 0 ? length : 0;
+                }
+                state->dashCount = dashCount;
+                state->dashPhase = operands[1];
+            }
+            return;
+        }
+        default:
+            return;
+    }
+    // Painting and clipping operations consume the current path
+    OHDisplayListRemoveAll(context->path);
+}
+
+// MARK: - Rasterizing a display list
+
+/* The scratch memory of a context, i.e. its allocations, at their largest size */
+static size_t OHRasterContextScratchSize(const OHRasterContext* context)
+{
+    const OHContours* contours = &context->contours;
+    const OHScanner* scanner = &context->scanner;
+    return context->bytesAllocated
+         + context->stateCapacity * sizeof(OHRasterState)
+         + contours->pointCapacity * sizeof(OHPoint)
+         + contours->contourCapacity * sizeof(size_t)
+         + contours->closedCapacity
+         + context->edges.capacity * sizeof(OHEdge)
+         + (scanner->width + 3) * sizeof(int32_t) + scanner->width + 1
+         + scanner->activeCapacity * sizeof(size_t)
+         + scanner->crossingsCapacity * sizeof(OHCrossing);
+}
+
+/*
+ *  Replays a display list in a context, rasterizing it or measuring its bounds.
+ *  If `bytesAllocated` is not NULL, the size of the scratch memory is added to it.
+ */
+static int OHRasterRunDisplayList(OHRasterBuffer buffer, const OHDisplayList* list, const double ctm[6],
+                                  const OHRasterRect* clipRect, int measuring, double bounds[4],
+                                  uint64_t* bytesAllocated)
+{
+    OHRasterContext context = {
+        .buffer = buffer,
+        .path = OHDisplayListCreate(),
+        .stateCapacity = 8,
+        .states = calloc(8, sizeof(OHRasterState)),
+        .stateCount = 1,
+        .scanner = {
+            .width = buffer.width,
+            .height = buffer.height,
+            .accumulation = calloc(buffer.width + 3, sizeof(int32_t)),
+            .coverage = malloc(buffer.width + 1)
+        },
+        .measuring = measuring,
+        .bounds = { INFINITY, INFINITY, -INFINITY, -INFINITY }
+    };
+    int result = -1;
+    if (!context.path || !context.states || !context.scanner.accumulation || !context.scanner.coverage) goto cleanup;
+    
+    // Initial PDF graphics state
+    OHRasterState* state = &context.states[0];
+    memcpy(state->ctm, ctm, sizeof(state->ctm));
+    state->fillColor = state->strokeColor = (OHPixelColor){ 0, 0, 0, 255 };
+    state->lineWidth = 1;
+    state->miterLimit = 10;
+    state->clipBounds[0] = state->clipBounds[1] = -INFINITY;
+    state->clipBounds[2] = state->clipBounds[3] = INFINITY;
+    
+    if (clipRect)
+    {
+        float rect[2];
+        rect[0] = clipRect->x; rect[1] = clipRect->y;
+        OHDisplayListAppend(context.path, OHDisplayListOpMoveTo, rect, 2);
+        rect[0] += clipRect->width;
+        OHDisplayListAppend(context.path, OHDisplayListOpLineTo, rect, 2);
+        rect[1] += clipRect->height;
+        OHDisplayListAppend(context.path, OHDisplayListOpLineTo, rect, 2);
+        rect[0] = clipRect->x;
+        OHDisplayListAppend(context.path, OHDisplayListOpLineTo, rect, 2);
+        OHRasterOperation(&context, OHDisplayListOpClip, NULL, 0);
+    }
+    
+    OHDisplayListApply(list, &context, OHRasterOperation);
+    result = context.failed ? -1 : 0;
+    if (bounds) memcpy(bounds, context.bounds, sizeof(context.bounds));
+    
+cleanup:
+    if (bytesAllocated) *bytesAllocated += OHRasterContextScratchSize(&context);
+    for (size_t idx = 0; idx < context.stateCount && context.states; ++idx)
+    {
+        OHClipMaskRelease(context.states[idx].clip);
+    }
+    free(context.states);
+    OHDisplayListRelease(context.path);
+    OHContoursRelease(&context.contours);
+    free(context.edges.edges);
+    free(context.scanner.accumulation);
+    free(context.scanner.coverage);
+    free(context.scanner.active);
+    free(context.scanner.crossings);
+    return result;
+}
+
+int OHRasterDrawDisplayList(OHRasterBuffer buffer, const OHDisplayList* list,
+                            const double ctm[6], const OHRasterRect* clipRect)
+{
+    return OHRasterRunDisplayList(buffer, list, ctm, clipRect, 0, NULL, NULL);
+}
+
+// MARK: - Measuring a display list
+
+int OHRasterGetContentBounds(const OHDisplayList* list, const OHRasterRect* clipRect, OHRasterRect* bounds)
+{
+    // Measure in a magnified space, so that curves are flattened much finer than when rendering
+    static const double kMeasuringScale = 64;
+    static const double kMeasuringCTM[6] = { kMeasuringScale, 0, 0, kMeasuringScale, 0, 0 };
+    OHRasterBuffer noBuffer = { NULL, 0, 0, 0, OHRasterFormatA8 };
+    double extent[4];
+    if (OHRasterRunDisplayList(noBuffer, list, kMeasuringCTM, clipRect, 1, extent, NULL) != 0) return -1;
+    if (!(extent[0] < extent[2] && extent[1] < extent[3])) return 0;
+    
+    // Flattened curves are within the tolerance of the actual curves, so outset by it
+    double x0 = (extent[0] - kFlatteningTolerance) / kMeasuringScale, y0 = (extent[1] - kFlatteningTolerance) / kMeasuringScale;
+    double x1 = (extent[2] + kFlatteningTolerance) / kMeasuringScale, y1 = (extent[3] + kFlatteningTolerance) / kMeasuringScale;
+    *bounds = (OHRasterRect){ (float)x0, (float)y0, (float)(x1 - x0), (float)(y1 - y0) };
+    return 1;
+}
+
+// MARK: - Rendering a page
+
+/* The geometry computed by -[OHVectorImage renderAtSize:] */
+typedef struct {
+    size_t width, height;     /* In pixels */
+    double ctm[6];
+    double shadowRadius;      /* In pixels */
+    long shadowOffsetX, shadowOffsetY;
+} OHRenderGeometry;
+
+static int OHComputeGeometry(const OHRasterPage* page, const OHRasterOptions* options, OHRenderGeometry* geometry)
+{
+    if (options->width <= 0 || options->height <= 0) return -1;
+    
+    // The part of the page scaled to the inset rect: the media box, or the ink when trimming
+    OHRasterRect box = { 0, 0, page->mediaBox.width, page->mediaBox.height };
+    if (options->trimToContent)
+    {
+        OHRasterRect content;
+        int result = OHRasterGetContentBounds(page->list, &page->cropBox, &content);
+        if (result < 0) return -1;
+        if (result > 0) box = content;
+    }
+    
+    // Like CGRectIntegral on a rect at the origin
+    double imageWidth = ceil(options->width), imageHeight = ceil(options->height);
+    double nativeWidth = box.width + options->insetLeft + options->insetRight;
+    double nativeHeight = box.height + options->insetTop + options->insetBottom;
+    double sx = 1, sy = 1;
+    if (nativeWidth != 0 || nativeHeight != 0)
+    {
+        sx = options->width / nativeWidth;
+        sy = options->height / nativeHeight;
+    }
+    
+    geometry->width = (size_t)ceil(imageWidth * options->screenScale);
+    geometry->height = (size_t)ceil(imageHeight * options->screenScale);
+    
+    // The inset rect, in CoreGraphics coordinates (origin at the bottom left), made integral
+    double x0 = floor(options->insetLeft * sx), y0 = floor(options->insetBottom * sy);
+    double x1 = ceil(imageWidth - options->insetRight * sx), y1 = ceil(imageHeight - options->insetTop * sy);
+    double pageScaleX = (x1 - x0) / box.width, pageScaleY = (y1 - y0) / box.height;
+    
+    // User space -> inset rect -> pixels, flipped so that row 0 is the top
+    double screenScale = options->screenScale;
+    geometry->ctm[0] = screenScale * pageScaleX;
+    geometry->ctm[1] = 0;
+    geometry->ctm[2] = 0;
+    geometry->ctm[3] = -screenScale * pageScaleY;
+    geometry->ctm[4] = screenScale * (x0 - box.x * pageScaleX);
+    geometry->ctm[5] = (double)geometry->height - screenScale * (y0 - box.y * pageScaleY);
+    
+    // Like with Quartz shadows, in device pixels but not scaled by the screen scale
+    geometry->shadowRadius = options->shadowBlurRadius * (sx + sy) / 2;
+    geometry->shadowOffsetX = lround(options->shadowOffsetX * sx);
+    geometry->shadowOffsetY = lround(options->shadowOffsetY * sy);
+    return 0;
+}
+
+int OHRasterGetImageSize(const OHRasterPage* page, const OHRasterOptions* options,
+                         size_t* width, size_t* height)
+{
+    OHRenderGeometry geometry;
+    if (OHComputeGeometry(page, options, &geometry) != 0) return -1;
+    *width = geometry.width;
+    *height = geometry.height;
+    return 0;
+}
+
+/* Applies the tint and shadow of an A8 buffer, like the RGBA kernels do. The background is ignored,
+ * like OHVectorImage does for A8 masks: it would only make the mask opaque */
+static void OHApplyEffectsA8(OHRasterBuffer buffer, const OHRasterOptions* options,
+                             const OHRenderGeometry* geometry, const uint8_t* shadowMask)
+{
+    unsigned tintAlpha = options->tintColor ? options->tintColor->a : 255;
+    if (options->tintColor)
+    {
+        for (size_t y = 0; y < buffer.height; ++y)
+        {
+            uint8_t* row = buffer.data + y * buffer.bytesPerRow;
+            for (size_t x = 0; x < buffer.width; ++x) row[x] = OHDiv255(row[x] * tintAlpha);
+        }
+    }
+    if (shadowMask)
+    {
+        OHPixelAlphaShadowUnder(buffer.data, buffer.width, buffer.height, buffer.bytesPerRow,
+                                shadowMask, buffer.width, geometry->shadowOffsetX, geometry->shadowOffsetY,
+                                OHDiv255(options->shadowColor->a * tintAlpha));
+    }
+}
+
+int OHRasterRenderPage(const OHRasterPage* page, const OHRasterOptions* options, OHRasterBuffer buffer)
+{
+    OHRenderGeometry geometry;
+    if (OHComputeGeometry(page, options, &geometry) != 0) return -1;
+    if (buffer.width < geometry.width || buffer.height < geometry.height) return -1;
+    buffer.width = geometry.width;
+    buffer.height = geometry.height;
+    
+    size_t bytesPerPixel = buffer.format == OHRasterFormatRGBA8 ? 4 : 1;
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        memset(buffer.data + y * buffer.bytesPerRow, 0, buffer.width * bytesPerPixel);
+    }
+    // The buffer is allocated by the caller, so only the scratch memory and shadow mask count as allocated
+    uint64_t bytesAllocated = 0;
+    OH_RENDER_STATS_BEGIN(rasterStart);
+    if (OHRasterRunDisplayList(buffer, page->list, geometry.ctm, &page->cropBox, 0, NULL, &bytesAllocated) != 0) return -1;
+    OH_RENDER_STATS_END(OHRenderStageRaster, rasterStart);
+    
+    uint8_t* shadowMask = NULL;
+    if (options->shadowColor)
+    {
+        OH_RENDER_STATS_BEGIN(maskStart);
+        shadowMask = malloc(buffer.width * buffer.height + 1);
+        if (!shadowMask) return -1;
+        bytesAllocated += buffer.width * buffer.height + 1
+                        + OHAlphaMaskBlurScratchSize(buffer.width, buffer.height, geometry.shadowRadius);
+        for (size_t y = 0; y < buffer.height; ++y)
+        {
+            uint8_t* maskRow = shadowMask + y * buffer.width;
+            const uint8_t* row = buffer.data + y * buffer.bytesPerRow;
+            if (bytesPerPixel == 1) memcpy(maskRow, row, buffer.width);
+            else for (size_t x = 0; x < buffer.width; ++x) maskRow[x] = row[4 * x + 3];
+        }
+        if (OHAlphaMaskBlur(shadowMask, buffer.width, buffer.height, geometry.shadowRadius) != 0)
+        {
+            free(shadowMask);
+            return -1;
+        }
+        OH_RENDER_STATS_END(OHRenderStageMask, maskStart);
+    }
+    
+    OH_RENDER_STATS_BEGIN(compositeStart);
+    if (buffer.format == OHRasterFormatA8)
+    {
+        OHApplyEffectsA8(buffer, options, &geometry, shadowMask);
+    }
+    else
+    {
+        // Same sequence as -[OHVectorImage renderWithPixelKernelsAtSize:scale:insets:]
+        OHPixelBuffer pixels = { buffer.data, buffer.width, buffer.height, buffer.bytesPerRow };
+        if (options->recolorTable && !options->tintColor) OHPixelRecolorWithLookupTable(pixels, options->recolorTable);
+        if (options->tintColor) OHPixelRecolor(pixels, OHPixelColorPremultiply(*options->tintColor));
+        if (shadowMask)
+        {
+            OHPixelColor shadowColor = *options->shadowColor;
+            if (options->tintColor) shadowColor.a = (uint8_t)((shadowColor.a * options->tintColor->a + 127) / 255);
+            OHPixelShadowUnder(pixels, shadowMask, buffer.width, geometry.shadowOffsetX, geometry.shadowOffsetY,
+                               OHPixelColorPremultiply(shadowColor));
+        }
+        if (options->backgroundColor) OHPixelFillUnder(pixels, OHPixelColorPremultiply(*options->backgroundColor));
+    }
+    OH_RENDER_STATS_END(OHRenderStageComposite, compositeStart);
+    free(shadowMask);
+    
+    OHRenderStatsRecordRender((uint64_t)buffer.width * buffer.height, bytesAllocated);
+    return 0;
+}
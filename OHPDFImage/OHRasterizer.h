@@ -0,0 +1,186 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHPDFImage_OHRasterizer_h
+#define OHPDFImage_OHRasterizer_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "OHDisplayList.h"
+#include "OHPixelKernels.h"
+
+/***********************************************************************************/
+
+/*
+ *  A software rasterizer rendering display lists (see `OHDisplayList.h`)
+ *  into RGBA or A8 buffers, with no dependency on Apple frameworks, so that
+ *  vector images can be rendered headless (e.g. on Linux build machines).
+ *
+ *  Paths are flattened into polygons, then scan converted with 16 sub-scanlines
+ *  per pixel row and 1/256 pixel horizontal precision, accumulating the exact
+ *  coverage of each sub-scanline span. Both the nonzero winding and even-odd
+ *  fill rules are supported, strokes (caps, joins, miter limit, dashes) are
+ *  converted into polygons, and spans are composited using `OHPixelBlendSpan`.
+ *
+ *  The rasterizer has no global state: different images can be rendered on
+ *  different threads concurrently.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  The pixel format of a raster buffer.
+ */
+typedef enum {
+    OHRasterFormatRGBA8, /* Premultiplied R, G, B, A bytes, like OHPixelBuffer */
+    OHRasterFormatA8     /* One alpha (coverage) byte per pixel */
+} OHRasterFormat;
+
+/**
+ *  A buffer to rasterize into. Row 0 is the top of the image.
+ */
+typedef struct {
+    uint8_t* data;
+    size_t width;
+    size_t height;
+    size_t bytesPerRow;
+    OHRasterFormat format;
+} OHRasterBuffer;
+
+/**
+ *  A rectangle, in PDF user space (origin at the bottom left).
+ */
+typedef struct {
+    float x, y, width, height;
+} OHRasterRect;
+
+/**
+ *  A PDF page compiled into a display list, with the page boxes
+ *  needed to render it like `OHPDFPage` does.
+ */
+typedef struct {
+    const OHDisplayList* list;
+    OHRasterRect mediaBox;
+    OHRasterRect cropBox;
+} OHRasterPage;
+
+/**
+ *  The rendering parameters of `OHRasterRenderPage`, mirroring the
+ *  properties of `OHVectorImage` used by `-[OHVectorImage renderAtSize:]`.
+ */
+typedef struct {
+    /* The requested size of the image, in points */
+    double width, height;
+    /* The number of pixels per point (the screen scale on iOS) */
+    double screenScale;
+    /* The insets around the PDF, in the unit of the PDF page (`OHVectorImage.insets`) */
+    double insetTop, insetLeft, insetBottom, insetRight;
+    /* The straight (non-premultiplied) tint and background colors, NULL for none.
+     * The background is ignored with A8, where it would only make the mask opaque */
+    const OHPixelColor* tintColor;
+    const OHPixelColor* backgroundColor;
+    /* The lookup table to recolor the page with (`OHVectorImage.recolorMap`), of OH_PIXEL_RECOLOR_TABLE_SIZE
+     * entries built with `OHPixelLookupTableFromColorMap`, NULL for none. Ignored when tinting and with A8 */
+    const OHPixelColor* recolorTable;
+    /* The straight shadow color (NULL for no shadow), and the shadow offset and blur radius
+     * in the unit of the PDF page (`OHVectorImage.shadow`). A positive offsetY goes down. */
+    const OHPixelColor* shadowColor;
+    double shadowOffsetX, shadowOffsetY, shadowBlurRadius;
+    /* If non-zero, the page is trimmed to the bounds of its ink (`OHVectorImage.trimToContent`),
+     * measured by `OHRasterGetContentBounds`, instead of using its whole media box */
+    int trimToContent;
+} OHRasterOptions;
+
+// MARK: - Rendering a page
+
+/**
+ *  Computes the size in pixels of the image rendered by `OHRasterRenderPage`.
+ *
+ *  @return 0 on success, -1 if the requested size is empty.
+ */
+int OHRasterGetImageSize(const OHRasterPage* page, const OHRasterOptions* options,
+                         size_t* width, size_t* height);
+
+/**
+ *  Renders a page with the same semantics as `-[OHVectorImage renderAtSize:]`:
+ *  the page is scaled to fill the requested size minus the insets, then
+ *  tinted, then the shadow and the background are composited under it.
+ *
+ *  With the A8 format, only the alpha of the tint and shadow colors is used,
+ *  and the background is ignored, like for OHVectorImage A8 masks.
+ *
+ *  @param page    The page to render
+ *  @param options The rendering parameters
+ *  @param buffer  The buffer to render into, at least as large as the size
+ *                 returned by `OHRasterGetImageSize`. It is cleared first.
+ *
+ *  @return 0 on success, -1 on allocation failure.
+ */
+int OHRasterRenderPage(const OHRasterPage* page, const OHRasterOptions* options, OHRasterBuffer buffer);
+
+// MARK: - Rasterizing a display list
+
+/**
+ *  Rasterizes a display list over the content of a buffer (source over).
+ *
+ *  @param buffer   The buffer to draw into
+ *  @param list     The display list to draw
+ *  @param ctm      The affine transform { a, b, c, d, tx, ty } from the user space
+ *                  of the display list to the pixels of the buffer (y pointing down)
+ *  @param clipRect If not NULL, a rectangle in user space to clip the drawing to
+ *                  (typically the crop box of the page)
+ *
+ *  @return 0 on success, -1 on allocation failure.
+ */
+int OHRasterDrawDisplayList(OHRasterBuffer buffer, const OHDisplayList* list,
+                            const double ctm[6], const OHRasterRect* clipRect);
+
+// MARK: - Measuring a display list
+
+/**
+ *  Computes the bounds of the ink of a display list: the union of its fills and
+ *  strokes (including their caps, joins and dashes), each one clipped by the clipping
+ *  paths in effect and by `clipRect`. Paints with a fully transparent color are ignored.
+ *
+ *  The bounds are computed from the geometry, not by rendering, so they don't depend
+ *  on any resolution. They may be slightly larger than the actual ink: curves are
+ *  measured on a fine flattening, and clipping paths by their bounding boxes.
+ *
+ *  @param list     The display list to measure
+ *  @param clipRect If not NULL, a rectangle to clip the content to (typically the crop box)
+ *  @param bounds   Receives the bounds of the ink, in user space
+ *
+ *  @return 1 if the display list paints something, 0 if it paints nothing
+ *          (`bounds` is then unchanged), or -1 on allocation failure.
+ */
+int OHRasterGetContentBounds(const OHDisplayList* list, const OHRasterRect* clipRect, OHRasterRect* bounds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
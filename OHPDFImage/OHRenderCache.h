@@ -0,0 +1,121 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <UIKit/UIKit.h>
+
+/***********************************************************************************/
+
+/**
+ *  A bounded, thread-safe cache of rendered bitmaps.
+ *
+ *  `OHVectorImage` stores every image it renders in this cache, keyed by
+ *  the full render descriptor (PDF URL, page, pixel size, screen scale,
+ *  `tintColor`, `backgroundColor`, `shadow` and `insets`), so that
+ *  rendering the same vector image with the same parameters twice only
+ *  rasterizes it once.
+ *
+ *  The cache is bounded by a byte budget (the memory used by the bitmaps)
+ *  and evicts the least recently used images first when it goes over budget.
+ *  It is also purged automatically on memory warnings.
+ */
+@interface OHRenderCache : NSObject
+
+/**
+ *  The maximum number of bytes of bitmap data the cache can hold
+ *  before it starts evicting the least recently used images.
+ *
+ *  Defaults to 16MB. Setting it to 0 disables the cache.
+ */
+@property(nonatomic, assign) NSUInteger totalCostLimit;
+/**
+ *  The number of bytes of bitmap data currently held by the cache.
+ */
+@property(nonatomic, readonly) NSUInteger totalCost;
+/**
+ *  The number of images currently held by the cache.
+ */
+@property(nonatomic, readonly) NSUInteger count;
+/**
+ *  The number of lookups that found an image in the cache.
+ */
+@property(nonatomic, readonly) NSUInteger hitCount;
+/**
+ *  The number of lookups that did not find an image in the cache.
+ */
+@property(nonatomic, readonly) NSUInteger missCount;
+
+#pragma mark - Constructor
+
+/**
+ *  The cache used by default by every `OHVectorImage`.
+ *
+ *  @return The shared render cache.
+ */
++ (instancetype)sharedCache;
+
+#pragma mark - Accessing images
+
+/**
+ *  Returns the image stored for the given key, and marks it as recently used.
+ *
+ *  @param key The key describing the rendering
+ *
+ *  @return The cached image, or `nil` if there is no image for this key.
+ */
+- (UIImage*)imageForKey:(NSString*)key;
+
+/**
+ *  Stores the given image in the cache, evicting the least recently used
+ *  images if needed to stay within the `totalCostLimit`.
+ *
+ *  @param image  The rendered image to store
+ *  @param key    The key describing the rendering
+ *  @param pdfURL The URL of the PDF the image was rendered from, used
+ *                by `removeImagesForPDFURL:`. May be `nil`.
+ */
+- (void)setImage:(UIImage*)image forKey:(NSString*)key pdfURL:(NSURL*)pdfURL;
+
+#pragma mark - Purging the cache
+
+/**
+ *  Removes every image rendered from the PDF at the given URL.
+ *
+ *  @param pdfURL The URL of the PDF file whose renderings should be purged
+ */
+- (void)removeImagesForPDFURL:(NSURL*)pdfURL;
+
+/**
+ *  Removes every image from the cache.
+ *
+ *  @note This is called automatically on memory warnings.
+ */
+- (void)removeAllImages;
+
+/**
+ *  Resets the `hitCount` and `missCount` counters to zero.
+ */
+- (void)resetStatistics;
+
+@end
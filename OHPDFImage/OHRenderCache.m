@@ -0,0 +1,251 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "OHRenderCache.h"
+#import "OHRenderStats.h"
+
+/***********************************************************************************/
+
+static NSUInteger const kDefaultTotalCostLimit = 16 * 1024 * 1024;
+
+/**
+ *  A node of the LRU list. The list goes from the most recently used entry
+ *  (head) to the least recently used one (tail).
+ */
+@interface OHRenderCacheEntry : NSObject
+@property(nonatomic, copy) NSString* key;
+@property(nonatomic, strong) NSURL* pdfURL;
+@property(nonatomic, strong) UIImage* image;
+@property(nonatomic, assign) NSUInteger cost;
+@property(nonatomic, strong) OHRenderCacheEntry* next;
+@property(nonatomic, unsafe_unretained) OHRenderCacheEntry* prev;
+@end
+
+@implementation OHRenderCacheEntry
+@end
+
+/***********************************************************************************/
+
+@interface OHRenderCache()
+@property(nonatomic, strong) NSMutableDictionary* entries;
+@property(nonatomic, strong) OHRenderCacheEntry* head;
+@property(nonatomic, unsafe_unretained) OHRenderCacheEntry* tail;
+@property(nonatomic, assign, readwrite) NSUInteger totalCost;
+@property(nonatomic, assign, readwrite) NSUInteger hitCount;
+@property(nonatomic, assign, readwrite) NSUInteger missCount;
+@end
+
+@implementation OHRenderCache
+
+#pragma mark - Constructor
+
++ (instancetype)sharedCache
+{
+    static OHRenderCache* sharedCache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedCache = [self new];
+    });
+    return sharedCache;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _entries = [NSMutableDictionary new];
+        _totalCostLimit = kDefaultTotalCostLimit;
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(removeAllImages)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (NSUInteger)count
+{
+    @synchronized(self)
+    {
+        return self.entries.count;
+    }
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit
+{
+    @synchronized(self)
+    {
+        _totalCostLimit = totalCostLimit;
+        [self evictToFitCostLimit];
+    }
+}
+
+#pragma mark - Accessing images
+
+- (UIImage*)imageForKey:(NSString*)key
+{
+    if (!key) return nil;
+    
+    @synchronized(self)
+    {
+        OHRenderCacheEntry* entry = self.entries[key];
+        OHRenderStatsRecordCacheLookup(entry != nil);
+        if (!entry)
+        {
+            self.missCount++;
+            return nil;
+        }
+        self.hitCount++;
+        [self unlinkEntry:entry];
+        [self linkEntryAtHead:entry];
+        return entry.image;
+    }
+}
+
+- (void)setImage:(UIImage*)image forKey:(NSString*)key pdfURL:(NSURL*)pdfURL
+{
+    if (!image || !key) return;
+    
+    CGImageRef cgImage = image.CGImage;
+    NSUInteger cost = CGImageGetBytesPerRow(cgImage) * CGImageGetHeight(cgImage);
+    
+    @synchronized(self)
+    {
+        if (cost > self.totalCostLimit) return;
+        
+        [self removeEntry:self.entries[key]];
+        
+        OHRenderCacheEntry* entry = [OHRenderCacheEntry new];
+        entry.key = key;
+        entry.pdfURL = pdfURL;
+        entry.image = image;
+        entry.cost = cost;
+        self.entries[entry.key] = entry;
+        [self linkEntryAtHead:entry];
+        self.totalCost += cost;
+        
+        [self evictToFitCostLimit];
+    }
+}
+
+#pragma mark - Purging the cache
+
+- (void)removeImagesForPDFURL:(NSURL*)pdfURL
+{
+    if (!pdfURL) return;
+    
+    @synchronized(self)
+    {
+        OHRenderCacheEntry* entry = self.head;
+        while (entry)
+        {
+            OHRenderCacheEntry* next = entry.next;
+            if ([entry.pdfURL isEqual:pdfURL])
+            {
+                [self removeEntry:entry];
+            }
+            entry = next;
+        }
+    }
+}
+
+- (void)removeAllImages
+{
+    @synchronized(self)
+    {
+        // Unlink the entries one at a time: releasing the head alone would free the
+        // chain of strong `next` references recursively, and could overflow the stack
+        OHRenderCacheEntry* entry = self.head;
+        self.head = nil;
+        self.tail = nil;
+        while (entry)
+        {
+            OHRenderCacheEntry* next = entry.next;
+            entry.next = nil;
+            entry = next;
+        }
+        [self.entries removeAllObjects];
+        self.totalCost = 0;
+    }
+}
+
+- (void)resetStatistics
+{
+    @synchronized(self)
+    {
+        self.hitCount = 0;
+        self.missCount = 0;
+    }
+}
+
+#pragma mark - Private Methods
+
+// All those methods must be called with the lock held
+
+- (void)evictToFitCostLimit
+{
+    while (self.tail && self.totalCost > self.totalCostLimit)
+    {
+        [self removeEntry:self.tail];
+    }
+}
+
+- (void)removeEntry:(OHRenderCacheEntry*)entry
+{
+    if (!entry) return;
+    
+    self.totalCost -= entry.cost;
+    [self.entries removeObjectForKey:entry.key];
+    [self unlinkEntry:entry];
+}
+
+- (void)linkEntryAtHead:(OHRenderCacheEntry*)entry
+{
+    entry.prev = nil;
+    entry.next = self.head;
+    self.head.prev = entry;
+    self.head = entry;
+    if (!self.tail) self.tail = entry;
+}
+
+- (void)unlinkEntry:(OHRenderCacheEntry*)entry
+{
+    // Keep the entry alive while we re-wire its neighbours
+    OHRenderCacheEntry* strongEntry = entry;
+    if (strongEntry.prev) strongEntry.prev.next = strongEntry.next;
+    else self.head = strongEntry.next;
+    if (strongEntry.next) strongEntry.next.prev = strongEntry.prev;
+    else self.tail = strongEntry.prev;
+    strongEntry.prev = nil;
+    strongEntry.next = nil;
+}
+
+@end
@@ -0,0 +1,151 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <UIKit/UIKit.h>
+@class OHVectorImage;
+
+/***********************************************************************************/
+
+/**
+ *  The priority of an asynchronous render request.
+ */
+typedef NS_ENUM(NSInteger, OHRenderPriority) {
+    OHRenderPriorityLow = -1,
+    OHRenderPriorityNormal = 0,
+    OHRenderPriorityHigh = 1,
+};
+
+/**
+ *  A token representing an asynchronous render request, allowing you to cancel it.
+ */
+@interface OHRenderRequest : NSObject
+/**
+ *  `YES` if the request has been cancelled.
+ */
+@property(nonatomic, readonly, getter=isCancelled) BOOL cancelled;
+/**
+ *  Cancels the request. Its completion block will not be called.
+ *
+ *  @note If other requests for the exact same rendering are still pending,
+ *        the rendering itself goes on for them.
+ */
+- (void)cancel;
+@end
+
+/***********************************************************************************/
+
+/**
+ *  A bounded concurrent queue used to render `OHVectorImage`s in the background.
+ *
+ *  Identical requests (same vector image, same size and same rendering
+ *  properties) that are in flight at the same time are coalesced, so that
+ *  they only trigger a single rasterization.
+ */
+@interface OHRenderQueue : NSObject
+
+/**
+ *  The maximum number of images rendered concurrently.
+ *  Defaults to the number of active processors.
+ */
+@property(nonatomic, assign) NSUInteger maxConcurrentRenderCount;
+
+#pragma mark - Statistics
+
+/**
+ *  The number of renderings waiting to be started.
+ */
+@property(nonatomic, readonly) NSUInteger queueDepth;
+/**
+ *  The number of renderings performed since the last `resetStatistics`.
+ */
+@property(nonatomic, readonly) NSUInteger renderCount;
+/**
+ *  The number of requests coalesced with an identical in-flight rendering
+ *  since the last `resetStatistics`.
+ */
+@property(nonatomic, readonly) NSUInteger coalescedCount;
+/**
+ *  The average time the renderings waited in the queue before being started.
+ */
+@property(nonatomic, readonly) NSTimeInterval averageWaitTime;
+/**
+ *  The average time taken by the renderings themselves.
+ */
+@property(nonatomic, readonly) NSTimeInterval averageRenderTime;
+
+/**
+ *  Resets the `renderCount`, `coalescedCount`, `averageWaitTime`
+ *  and `averageRenderTime` statistics.
+ */
+- (void)resetStatistics;
+
+#pragma mark - Constructor
+
+/**
+ *  The queue used by the asynchronous rendering methods of `OHVectorImage`.
+ *
+ *  @return The shared render queue.
+ */
++ (instancetype)sharedQueue;
+
+#pragma mark - Rendering
+
+/**
+ *  Renders the vector image at the given size in the background.
+ *
+ *  @param image      The vector image to render. Its properties are captured
+ *                    when this method is called, so it is safe to modify it afterwards.
+ *  @param size       The size to render the image at (see `-[OHVectorImage renderAtSize:]`)
+ *  @param priority   The priority of the request
+ *  @param completion The block to call on the main queue with the rendered image.
+ *                    Not called if the request is cancelled.
+ *
+ *  @return A token that can be used to cancel the request.
+ */
+- (OHRenderRequest*)renderImage:(OHVectorImage*)image
+                         atSize:(CGSize)size
+                       priority:(OHRenderPriority)priority
+                     completion:(void(^)(UIImage* image))completion;
+
+/**
+ *  Renders the vector image at each of the given sizes in the background.
+ *
+ *  @param image      The vector image to render. Its properties are captured
+ *                    when this method is called, so it is safe to modify it afterwards.
+ *  @param sizes      An array of `NSValue`s wrapping the `CGSize`s to render the image at
+ *  @param priority   The priority of the requests
+ *  @param completion The block to call on the main queue once every size has been
+ *                    rendered, with the images in the same order as `sizes`
+ *                    (`NSNull` for the sizes that could not be rendered).
+ *                    Not called if the request is cancelled.
+ *
+ *  @return A token that can be used to cancel all the requests at once.
+ */
+- (OHRenderRequest*)renderImage:(OHVectorImage*)image
+                        atSizes:(NSArray*)sizes
+                       priority:(OHRenderPriority)priority
+                     completion:(void(^)(NSArray* images))completion;
+
+@end
@@ -0,0 +1,330 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "OHRenderQueue.h"
+#import "OHVectorImage.h"
+
+/***********************************************************************************/
+
+@interface OHVectorImage (OHRenderQueuePrivate)
+- (NSString*)renderDescriptorForSize:(CGSize)size;
+@end
+
+@class OHRenderOperation;
+
+/***********************************************************************************/
+
+@interface OHRenderRequest()
+@property(nonatomic, assign, readwrite, getter=isCancelled) BOOL cancelled;
+@property(nonatomic, copy) void(^completion)(UIImage* image);
+@property(nonatomic, weak) OHRenderQueue* queue;
+@property(nonatomic, weak) OHRenderOperation* operation;
+@property(nonatomic, strong) NSArray* subrequests;
+@end
+
+@interface OHRenderQueue()
+@property(nonatomic, strong) NSOperationQueue* operationQueue;
+@property(nonatomic, strong) NSMutableDictionary* inFlightOperations;
+@property(nonatomic, assign, readwrite) NSUInteger queueDepth;
+@property(nonatomic, assign, readwrite) NSUInteger renderCount;
+@property(nonatomic, assign, readwrite) NSUInteger coalescedCount;
+@property(nonatomic, assign) NSTimeInterval totalWaitTime;
+@property(nonatomic, assign) NSTimeInterval totalRenderTime;
+- (void)cancelRequest:(OHRenderRequest*)request;
+- (void)operationDidStart:(OHRenderOperation*)operation;
+- (void)operationDidFinish:(OHRenderOperation*)operation image:(UIImage*)image;
+@end
+
+/***********************************************************************************/
+
+/**
+ *  The operation rendering a vector image at a given size, on behalf of one or
+ *  more identical requests. Its `requests` are protected by the queue's lock.
+ */
+@interface OHRenderOperation : NSOperation
+@property(nonatomic, strong) OHVectorImage* image;
+@property(nonatomic, assign) CGSize size;
+@property(nonatomic, copy) NSString* key;
+@property(nonatomic, strong) NSMutableArray* requests;
+@property(nonatomic, assign) CFAbsoluteTime enqueueTime;
+@property(nonatomic, assign) CFAbsoluteTime startTime;
+@property(nonatomic, assign) BOOL waitingInQueue;
+@property(nonatomic, weak) OHRenderQueue* queue;
+@end
+
+@implementation OHRenderOperation
+
+- (void)main
+{
+    [self.queue operationDidStart:self];
+    UIImage* image = self.isCancelled ? nil : [self.image renderAtSize:self.size];
+    [self.queue operationDidFinish:self image:image];
+}
+
+@end
+
+/***********************************************************************************/
+
+@implementation OHRenderRequest
+
+- (void)cancel
+{
+    self.cancelled = YES;
+    for (OHRenderRequest* subrequest in self.subrequests)
+    {
+        [subrequest cancel];
+    }
+    [self.queue cancelRequest:self];
+}
+
+@end
+
+/***********************************************************************************/
+
+@implementation OHRenderQueue
+
+#pragma mark - Constructor
+
++ (instancetype)sharedQueue
+{
+    static OHRenderQueue* sharedQueue;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedQueue = [self new];
+    });
+    return sharedQueue;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self)
+    {
+        _operationQueue = [NSOperationQueue new];
+        _operationQueue.name = @"com.alisoftware.OHPDFImage.render";
+        _inFlightOperations = [NSMutableDictionary new];
+        self.maxConcurrentRenderCount = [NSProcessInfo processInfo].activeProcessorCount;
+    }
+    return self;
+}
+
+- (NSUInteger)maxConcurrentRenderCount
+{
+    return (NSUInteger)self.operationQueue.maxConcurrentOperationCount;
+}
+
+- (void)setMaxConcurrentRenderCount:(NSUInteger)maxConcurrentRenderCount
+{
+    self.operationQueue.maxConcurrentOperationCount = (NSInteger)MAX(maxConcurrentRenderCount, 1u);
+}
+
+#pragma mark - Statistics
+
+- (NSTimeInterval)averageWaitTime
+{
+    @synchronized(self)
+    {
+        return self.renderCount ? self.totalWaitTime / self.renderCount : 0;
+    }
+}
+
+- (NSTimeInterval)averageRenderTime
+{
+    @synchronized(self)
+    {
+        return self.renderCount ? self.totalRenderTime / self.renderCount : 0;
+    }
+}
+
+- (void)resetStatistics
+{
+    @synchronized(self)
+    {
+        self.renderCount = 0;
+        self.coalescedCount = 0;
+        self.totalWaitTime = 0;
+        self.totalRenderTime = 0;
+    }
+}
+
+#pragma mark - Rendering
+
+- (OHRenderRequest*)renderImage:(OHVectorImage*)image
+                         atSize:(CGSize)size
+                       priority:(OHRenderPriority)priority
+                     completion:(void(^)(UIImage* image))completion
+{
+    OHRenderRequest* request = [OHRenderRequest new];
+    request.completion = completion;
+    request.queue = self;
+    if (!image)
+    {
+        [self deliverImage:nil toRequests:@[request]];
+        return request;
+    }
+    
+    // Coalesce with an identical in-flight rendering, if any
+    NSString* key = [image renderDescriptorForSize:size];
+    NSOperationQueuePriority queuePriority = OHQueuePriorityForRenderPriority(priority);
+    @synchronized(self)
+    {
+        OHRenderOperation* operation = key ? self.inFlightOperations[key] : nil;
+        if (operation)
+        {
+            [operation.requests addObject:request];
+            request.operation = operation;
+            if (queuePriority > operation.queuePriority) operation.queuePriority = queuePriority;
+            self.coalescedCount++;
+            return request;
+        }
+        
+        operation = [OHRenderOperation new];
+        // Capture the properties of the image as they are now
+        operation.image = [image copy];
+        operation.size = size;
+        operation.key = key;
+        operation.requests = [NSMutableArray arrayWithObject:request];
+        operation.enqueueTime = CFAbsoluteTimeGetCurrent();
+        operation.queuePriority = queuePriority;
+        operation.queue = self;
+        operation.waitingInQueue = YES;
+        request.operation = operation;
+        if (key) self.inFlightOperations[key] = operation;
+        self.queueDepth++;
+        [self.operationQueue addOperation:operation];
+    }
+    return request;
+}
+
+- (OHRenderRequest*)renderImage:(OHVectorImage*)image
+                        atSizes:(NSArray*)sizes
+                       priority:(OHRenderPriority)priority
+                     completion:(void(^)(NSArray* images))completion
+{
+    NSMutableArray* images = [NSMutableArray arrayWithCapacity:sizes.count];
+    for (NSUInteger idx = 0; idx < sizes.count; ++idx) [images addObject:[NSNull null]];
+    __block NSUInteger remaining = sizes.count;
+    
+    OHRenderRequest* batchRequest = [OHRenderRequest new];
+    NSMutableArray* subrequests = [NSMutableArray arrayWithCapacity:sizes.count];
+    [sizes enumerateObjectsUsingBlock:^(NSValue* sizeValue, NSUInteger idx, BOOL *stop) {
+        // Completion blocks are all called on the main queue, so no need to lock here
+        [subrequests addObject:[self renderImage:image atSize:sizeValue.CGSizeValue priority:priority completion:^(UIImage* renderedImage) {
+            if (renderedImage) images[idx] = renderedImage;
+            if (--remaining == 0 && completion) completion([images copy]);
+        }]];
+    }];
+    batchRequest.subrequests = subrequests;
+    
+    if (sizes.count == 0 && completion)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{ completion(@[]); });
+    }
+    return batchRequest;
+}
+
+#pragma mark - Private Methods
+
+static NSOperationQueuePriority OHQueuePriorityForRenderPriority(OHRenderPriority priority)
+{
+    switch (priority)
+    {
+        case OHRenderPriorityLow:  return NSOperationQueuePriorityLow;
+        case OHRenderPriorityHigh: return NSOperationQueuePriorityHigh;
+        default:                   return NSOperationQueuePriorityNormal;
+    }
+}
+
+- (void)cancelRequest:(OHRenderRequest*)request
+{
+    @synchronized(self)
+    {
+        OHRenderOperation* operation = request.operation;
+        if (!operation) return;
+        
+        [operation.requests removeObjectIdenticalTo:request];
+        request.operation = nil;
+        // Only cancel the rendering itself if nobody else is waiting for it
+        if (operation.requests.count == 0)
+        {
+            if (operation.key) [self.inFlightOperations removeObjectForKey:operation.key];
+            // A cancelled operation that has not started yet will never run its `main`
+            if (operation.waitingInQueue)
+            {
+                operation.waitingInQueue = NO;
+                self.queueDepth--;
+            }
+            [operation cancel];
+        }
+    }
+}
+
+- (void)operationDidStart:(OHRenderOperation*)operation
+{
+    @synchronized(self)
+    {
+        if (operation.waitingInQueue)
+        {
+            operation.waitingInQueue = NO;
+            self.queueDepth--;
+        }
+        operation.startTime = CFAbsoluteTimeGetCurrent();
+    }
+}
+
+- (void)operationDidFinish:(OHRenderOperation*)operation image:(UIImage*)image
+{
+    NSArray* requests;
+    @synchronized(self)
+    {
+        if (operation.key && self.inFlightOperations[operation.key] == operation)
+        {
+            [self.inFlightOperations removeObjectForKey:operation.key];
+        }
+        requests = [operation.requests copy];
+        [operation.requests removeAllObjects];
+        
+        if (!operation.isCancelled)
+        {
+            self.renderCount++;
+            self.totalWaitTime += operation.startTime - operation.enqueueTime;
+            self.totalRenderTime += CFAbsoluteTimeGetCurrent() - operation.startTime;
+        }
+    }
+    [self deliverImage:image toRequests:requests];
+}
+
+- (void)deliverImage:(UIImage*)image toRequests:(NSArray*)requests
+{
+    dispatch_async(dispatch_get_main_queue(), ^{
+        for (OHRenderRequest* request in requests)
+        {
+            if (!request.isCancelled && request.completion) request.completion(image);
+            request.completion = nil;
+        }
+    });
+}
+
+@end
@@ -0,0 +1,154 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#if !defined(__APPLE__) && !defined(_POSIX_C_SOURCE)
+  #define _POSIX_C_SOURCE 199309L /* For clock_gettime in strict C99 mode */
+#endif
+#include "OHRenderStats.h"
+#if defined(__APPLE__)
+  #include <mach/mach_time.h>
+#else
+  #include <time.h>
+#endif
+
+/***********************************************************************************/
+
+volatile int OHRenderStatsEnabledFlag = 0;
+
+/* Counters are updated using relaxed atomic additions, so recording never locks */
+static OHRenderStatsSnapshot sStats;
+
+#define OH_ATOMIC_ADD(counter, value) __atomic_fetch_add(&(counter), (value), __ATOMIC_RELAXED)
+
+// MARK: - Enabling
+
+void OHRenderStatsSetEnabled(int enabled)
+{
+    OHRenderStatsEnabledFlag = enabled ? 1 : 0;
+}
+
+// MARK: - Recording
+
+uint64_t OHRenderStatsNow(void)
+{
+#if defined(__APPLE__)
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) mach_timebase_info(&timebase);
+    return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static size_t OHBucketForNanoseconds(uint64_t nanoseconds)
+{
+    uint64_t microseconds = nanoseconds / 1000;
+    size_t bucket = 0;
+    while (microseconds > 0 && bucket < OH_RENDER_STATS_BUCKETS - 1)
+    {
+        microseconds >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void OHRenderStatsRecordStage(OHRenderStage stage, uint64_t nanoseconds)
+{
+    if (!OHRenderStatsIsEnabled() || stage >= OHRenderStageCount) return;
+    
+    OHRenderStageStats* stats = &sStats.stages[stage];
+    OH_ATOMIC_ADD(stats->count, 1);
+    OH_ATOMIC_ADD(stats->totalNanoseconds, nanoseconds);
+    OH_ATOMIC_ADD(stats->histogram[OHBucketForNanoseconds(nanoseconds)], 1);
+    
+    uint64_t max = __atomic_load_n(&stats->maxNanoseconds, __ATOMIC_RELAXED);
+    while (nanoseconds > max
+           && !__atomic_compare_exchange_n(&stats->maxNanoseconds, &max, nanoseconds, 1,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+void OHRenderStatsRecordRender(uint64_t pixels, uint64_t bytesAllocated)
+{
+    if (!OHRenderStatsIsEnabled()) return;
+    OH_ATOMIC_ADD(sStats.renders, 1);
+    OH_ATOMIC_ADD(sStats.pixels, pixels);
+    OH_ATOMIC_ADD(sStats.bytesAllocated, bytesAllocated);
+}
+
+void OHRenderStatsRecordCacheLookup(int hit)
+{
+    if (!OHRenderStatsIsEnabled()) return;
+    if (hit) OH_ATOMIC_ADD(sStats.cacheHits, 1);
+    else OH_ATOMIC_ADD(sStats.cacheMisses, 1);
+}
+
+// MARK: - Reading
+
+static void OHCopyCounters(uint64_t* destination, uint64_t* source, size_t count, int reset)
+{
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        uint64_t value = reset ? __atomic_exchange_n(&source[idx], 0, __ATOMIC_RELAXED)
+                               : __atomic_load_n(&source[idx], __ATOMIC_RELAXED);
+        if (destination) destination[idx] = value;
+    }
+}
+
+void OHRenderStatsGetSnapshot(OHRenderStatsSnapshot* snapshot)
+{
+    // The snapshot only contains uint64_t counters, so copy it as an array of them
+    OHCopyCounters((uint64_t*)snapshot, (uint64_t*)&sStats, sizeof(sStats) / sizeof(uint64_t), 0);
+}
+
+void OHRenderStatsReset(void)
+{
+    OHCopyCounters(NULL, (uint64_t*)&sStats, sizeof(sStats) / sizeof(uint64_t), 1);
+}
+
+const char* OHRenderStageName(OHRenderStage stage)
+{
+    static const char* const kNames[OHRenderStageCount] = {
+        "load", "pageFetch", "raster", "mask", "composite", "downsample"
+    };
+    return stage < OHRenderStageCount ? kNames[stage] : "unknown";
+}
+
+uint64_t OHRenderStageStatsPercentile(const OHRenderStageStats* stats, double percentile)
+{
+    uint64_t total = 0;
+    for (size_t idx = 0; idx < OH_RENDER_STATS_BUCKETS; ++idx) total += stats->histogram[idx];
+    if (total == 0) return 0;
+    
+    double rank = percentile / 100 * (double)total;
+    uint64_t cumulated = 0;
+    for (size_t idx = 0; idx < OH_RENDER_STATS_BUCKETS - 1; ++idx)
+    {
+        cumulated += stats->histogram[idx];
+        if ((double)cumulated >= rank) return ((uint64_t)1 << idx) * 1000;
+    }
+    return stats->maxNanoseconds;
+}
@@ -0,0 +1,179 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHPDFImage_OHRenderStats_h
+#define OHPDFImage_OHRenderStats_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***********************************************************************************/
+
+/*
+ *  Optional instrumentation of the rendering pipeline: per-stage durations
+ *  aggregated into histograms, pixel and allocation counts, and render cache
+ *  hits and misses, recorded into global lock-free counters that can be
+ *  snapshotted at any time.
+ *
+ *  Instrumentation is disabled by default. When disabled, each instrumented
+ *  point only costs the test of a global flag, so it can stay compiled in
+ *  production builds and be enabled on demand (e.g. from a debug menu).
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  The instrumented stages of the rendering pipeline.
+ */
+typedef enum {
+    OHRenderStageLoad,          /* Loading a PDF document or a vector pack entry */
+    OHRenderStagePageFetch,     /* Getting a page of a PDF document */
+    OHRenderStageRaster,        /* Drawing the PDF content into the bitmap */
+    OHRenderStageMask,          /* Computing the (blurred) shadow mask */
+    OHRenderStageComposite,     /* Applying the tint, shadow and background */
+    OHRenderStageDownsample,    /* Deriving a rendering from a mipmap (see OHVectorImage.usesMipmaps) */
+    OHRenderStageCount
+} OHRenderStage;
+
+/**
+ *  The durations of a stage are aggregated in a histogram with power of two
+ *  buckets: bucket `i` counts the durations in [2^(i-1), 2^i) microseconds
+ *  (bucket 0 counts the durations under 1µs, and the last one is unbounded).
+ */
+#define OH_RENDER_STATS_BUCKETS 24
+
+/**
+ *  The statistics of a stage.
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t totalNanoseconds;
+    uint64_t maxNanoseconds;
+    uint64_t histogram[OH_RENDER_STATS_BUCKETS];
+} OHRenderStageStats;
+
+/**
+ *  A snapshot of all the statistics.
+ */
+typedef struct {
+    OHRenderStageStats stages[OHRenderStageCount];
+    uint64_t renders;           /* Number of bitmaps rendered */
+    uint64_t pixels;            /* Number of pixels rendered */
+    uint64_t bytesAllocated;    /* Bytes of bitmaps, masks and scratch memory allocated by the renders */
+    uint64_t cacheHits;         /* Render cache hits */
+    uint64_t cacheMisses;       /* Render cache misses */
+} OHRenderStatsSnapshot;
+
+// MARK: - Enabling
+
+/* Private: use OHRenderStatsIsEnabled() */
+extern volatile int OHRenderStatsEnabledFlag;
+
+/**
+ *  Whether instrumentation is enabled. Inlined, so that disabled
+ *  instrumentation only costs the test of a global flag.
+ */
+static inline int OHRenderStatsIsEnabled(void)
+{
+    return OHRenderStatsEnabledFlag;
+}
+
+/**
+ *  Enables (non-zero) or disables (0) the instrumentation.
+ *  Counters are kept when disabling; use `OHRenderStatsReset` to clear them.
+ */
+void OHRenderStatsSetEnabled(int enabled);
+
+// MARK: - Recording
+
+/**
+ *  A monotonic timestamp, in nanoseconds.
+ */
+uint64_t OHRenderStatsNow(void);
+
+/**
+ *  Records the duration of a stage. Does nothing if instrumentation is disabled.
+ */
+void OHRenderStatsRecordStage(OHRenderStage stage, uint64_t nanoseconds);
+
+/**
+ *  Records a rendered bitmap, with its number of pixels and the number of
+ *  bytes allocated to render it. Does nothing if instrumentation is disabled.
+ */
+void OHRenderStatsRecordRender(uint64_t pixels, uint64_t bytesAllocated);
+
+/**
+ *  Records a render cache lookup. Does nothing if instrumentation is disabled.
+ */
+void OHRenderStatsRecordCacheLookup(int hit);
+
+/**
+ *  Convenience macros timing a block of code as a given stage:
+ *
+ *      OH_RENDER_STATS_BEGIN(start);
+ *      ... // Code of the stage
+ *      OH_RENDER_STATS_END(OHRenderStageMask, start);
+ */
+#define OH_RENDER_STATS_BEGIN(var) \
+    uint64_t var = OHRenderStatsIsEnabled() ? OHRenderStatsNow() : 0
+#define OH_RENDER_STATS_END(stage, var) \
+    do { if (var) OHRenderStatsRecordStage((stage), OHRenderStatsNow() - (var)); } while (0)
+
+// MARK: - Reading
+
+/**
+ *  Copies the current value of all the statistics. Counters are updated
+ *  independently, so a snapshot taken during renders may be off by one render.
+ */
+void OHRenderStatsGetSnapshot(OHRenderStatsSnapshot* snapshot);
+
+/**
+ *  Resets all the statistics to zero.
+ */
+void OHRenderStatsReset(void);
+
+/**
+ *  The name of a stage ("load", "pageFetch", "raster", "mask", "composite").
+ */
+const char* OHRenderStageName(OHRenderStage stage);
+
+/**
+ *  Estimates a percentile of the durations of a stage from its histogram.
+ *
+ *  @param stats      The statistics of the stage
+ *  @param percentile The percentile, between 0 and 100 (e.g. 50 for the median)
+ *
+ *  @return The upper bound of the histogram bucket containing the percentile,
+ *          in nanoseconds, or 0 if there are no durations.
+ */
+uint64_t OHRenderStageStatsPercentile(const OHRenderStageStats* stats, double percentile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#include "OHShadowBlur.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+static size_t const kBoxBlurPasses = 3;
+
+void OHAlphaMaskExtract(OHPixelBuffer buffer, uint8_t* mask)
+{
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        const uint8_t* px = buffer.data + y * buffer.bytesPerRow + 3;
+        uint8_t* maskRow = mask + y * buffer.width;
+        for (size_t x = 0; x < buffer.width; ++x, px += 4)
+        {
+            maskRow[x] = *px;
+        }
+    }
+}
+
+void OHBoxBlurSizesForSigma(double sigma, size_t sizes[3])
+{
+    // See "Fast Almost-Gaussian Filtering" (P. Kovesi): use boxes of width wl or wu=wl+2,
+    // choosing how many of each so that the total variance matches sigma².
+    double const n = kBoxBlurPasses;
+    double idealWidth = sqrt(12.0 * sigma * sigma / n + 1.0);
+    long wl = (long)floor(idealWidth);
+    if (wl % 2 == 0) wl--;
+    if (wl < 1) wl = 1;
+    long wu = wl + 2;
+    double idealCount = (12.0 * sigma * sigma - n * wl * wl - 4.0 * n * wl - 3.0 * n) / (-4.0 * wl - 4.0);
+    long m = lround(idealCount);
+    for (size_t idx = 0; idx < kBoxBlurPasses; ++idx)
+    {
+        sizes[idx] = (size_t)((long)idx < m ? wl : wu);
+    }
+}
+
+/**
+ *  Box-blurs the columns of `src` into `dst` (both `width` bytes per row), treating
+ *  pixels outside of the mask as transparent. Every row of the output is computed
+ *  at once from one running sum per column, so the inner loops run over contiguous
+ *  memory and are auto-vectorized by the compiler.
+ */
+static void OHBoxBlurColumns(const uint8_t* src, uint8_t* dst, size_t width, size_t height,
+                             size_t radius, uint32_t* sums)
+{
+    // 16.16 fixed-point reciprocal of the box size
+    uint32_t const reciprocal = (uint32_t)((65536.0 / (double)(2 * radius + 1)) + 0.5);
+    
+    memset(sums, 0, width * sizeof(uint32_t));
+    for (size_t y = 0; y <= radius && y < height; ++y)
+    {
+        const uint8_t* row = src + y * width;
+        for (size_t x = 0; x < width; ++x) sums[x] += row[x];
+    }
+    
+    for (size_t y = 0; y < height; ++y)
+    {
+        uint8_t* outRow = dst + y * width;
+        for (size_t x = 0; x < width; ++x)
+        {
+            outRow[x] = (uint8_t)((sums[x] * reciprocal + 32768) >> 16);
+        }
+        
+        // Slide the window down: add the row entering it, remove the row leaving it
+        if (y + radius + 1 < height)
+        {
+            const uint8_t* inRow = src + (y + radius + 1) * width;
+            for (size_t x = 0; x < width; ++x) sums[x] += inRow[x];
+        }
+        if (y >= radius)
+        {
+            const uint8_t* outgoingRow = src + (y - radius) * width;
+            for (size_t x = 0; x < width; ++x) sums[x] -= outgoingRow[x];
+        }
+    }
+}
+
+static void OHTranspose(const uint8_t* src, uint8_t* dst, size_t width, size_t height)
+{
+    // Work by blocks to stay cache-friendly
+    size_t const kBlock = 32;
+    for (size_t by = 0; by < height; by += kBlock)
+    {
+        for (size_t bx = 0; bx < width; bx += kBlock)
+        {
+            size_t maxY = by + kBlock < height ? by + kBlock : height;
+            size_t maxX = bx + kBlock < width ? bx + kBlock : width;
+            for (size_t y = by; y < maxY; ++y)
+            {
+                for (size_t x = bx; x < maxX; ++x)
+                {
+                    dst[x * height + y] = src[y * width + x];
+                }
+            }
+        }
+    }
+}
+
+/**
+ *  Applies the three box blurs on the columns of `buffer`, using `scratch` (same size
+ *  as `buffer`) as the ping-pong buffer.
+ *
+ *  @return The buffer holding the result, `buffer` or `scratch`.
+ */
+static uint8_t* OHBoxBlurColumnsPasses(uint8_t* buffer, uint8_t* scratch, size_t width, size_t height,
+                                       const size_t sizes[3], uint32_t* sums)
+{
+    uint8_t* src = buffer;
+    uint8_t* dst = scratch;
+    for (size_t pass = 0; pass < kBoxBlurPasses; ++pass)
+    {
+        OHBoxBlurColumns(src, dst, width, height, sizes[pass]/2, sums);
+        uint8_t* tmp = src; src = dst; dst = tmp;
+    }
+    return src;
+}
+
+/**
+ *  The first passes spread the mask out of its bounds, where the next passes must still
+ *  find it: the mask is blurred with enough transparent margin for them, or the edges
+ *  would lose coverage.
+ *
+ *  @return The margin, and in `count` the size of each of the two padded buffers.
+ */
+static size_t OHAlphaMaskBlurMargin(size_t width, size_t height, const size_t sizes[3], size_t* count)
+{
+    size_t const margin = sizes[1]/2 + sizes[2]/2;
+    size_t const paddedHeight = height + 2 * margin, paddedWidth = width + 2 * margin;
+    *count = (width * paddedHeight > height * paddedWidth) ? width * paddedHeight : height * paddedWidth;
+    return margin;
+}
+
+size_t OHAlphaMaskBlurScratchSize(size_t width, size_t height, double blurRadius)
+{
+    if (blurRadius <= 0 || width == 0 || height == 0) return 0;
+    
+    size_t sizes[3], count;
+    OHBoxBlurSizesForSigma(blurRadius / 2.0, sizes);
+    OHAlphaMaskBlurMargin(width, height, sizes, &count);
+    return 2 * count + (width > height ? width : height) * sizeof(uint32_t);
+}
+
+int OHAlphaMaskBlur(uint8_t* mask, size_t width, size_t height, double blurRadius)
+{
+    if (blurRadius <= 0 || width == 0 || height == 0) return 0;
+    
+    size_t sizes[3], count;
+    OHBoxBlurSizesForSigma(blurRadius / 2.0, sizes);
+    size_t const margin = OHAlphaMaskBlurMargin(width, height, sizes, &count);
+    size_t const paddedHeight = height + 2 * margin, paddedWidth = width + 2 * margin;
+    uint8_t* buffer = malloc(2 * count);
+    uint32_t* sums = malloc((width > height ? width : height) * sizeof(uint32_t));
+    if (!buffer || !sums)
+    {
+        free(buffer);
+        free(sums);
+        return -1;
+    }
+    uint8_t* scratch = buffer + count;
+    
+    // Vertical blur, on the mask between transparent rows
+    memset(buffer, 0, width * margin);
+    memcpy(buffer + width * margin, mask, width * height);
+    memset(buffer + width * (margin + height), 0, width * margin);
+    uint8_t* blurred = OHBoxBlurColumnsPasses(buffer, scratch, width, paddedHeight, sizes, sums);
+    
+    // Transpose the rows of the mask, so that the horizontal blur is a vertical one too
+    uint8_t* transposed = (blurred == buffer) ? scratch : buffer;
+    memset(transposed, 0, height * margin);
+    OHTranspose(blurred + width * margin, transposed + height * margin, width, height);
+    memset(transposed + height * (margin + width), 0, height * margin);
+    blurred = OHBoxBlurColumnsPasses(transposed, blurred, height, paddedWidth, sizes, sums);
+    OHTranspose(blurred + height * margin, mask, height, width);
+    
+    free(buffer);
+    free(sums);
+    return 0;
+}
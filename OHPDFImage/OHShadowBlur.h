@@ -0,0 +1,88 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHPDFImage_OHShadowBlur_h
+#define OHPDFImage_OHShadowBlur_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "OHPixelKernels.h"
+
+/***********************************************************************************/
+
+/*
+ *  Generation of drop shadow masks from 8-bit alpha masks.
+ *
+ *  The Gaussian blur is approximated by three successive box blurs, each
+ *  being separable (one vertical and one horizontal pass) and computed
+ *  with running sums, so the cost per pixel does not depend on the radius.
+ *  Like OHPixelKernels, this module is plain C with no dependency on
+ *  Apple frameworks.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Extracts the alpha channel of an RGBA buffer into an 8-bit mask.
+ *
+ *  @param buffer The RGBA buffer to extract the alpha from
+ *  @param mask   The destination mask, of `buffer.width * buffer.height` bytes
+ *                (tightly packed, i.e. `buffer.width` bytes per row)
+ */
+void OHAlphaMaskExtract(OHPixelBuffer buffer, uint8_t* mask);
+
+/**
+ *  Blurs an 8-bit mask in place, approximating a Gaussian blur with the
+ *  same extent as a Quartz shadow with the given blur radius.
+ *
+ *  @param mask       The mask to blur, tightly packed (`width` bytes per row)
+ *  @param width      The width of the mask
+ *  @param height     The height of the mask
+ *  @param blurRadius The blur radius, in pixels, as passed to `CGContextSetShadow`.
+ *                    The standard deviation of the Gaussian is half this value.
+ *
+ *  @return 0 on success, or -1 if the scratch memory could not be allocated.
+ */
+int OHAlphaMaskBlur(uint8_t* mask, size_t width, size_t height, double blurRadius);
+
+/**
+ *  The number of bytes of scratch memory `OHAlphaMaskBlur` allocates to blur a mask,
+ *  for accounting (see OHRenderStats). 0 if it does not need any.
+ */
+size_t OHAlphaMaskBlurScratchSize(size_t width, size_t height, double blurRadius);
+
+/**
+ *  Computes the sizes (odd widths, in pixels) of the three box blurs that
+ *  approximate a Gaussian blur of standard deviation `sigma`.
+ */
+void OHBoxBlurSizesForSigma(double sigma, size_t sizes[3]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
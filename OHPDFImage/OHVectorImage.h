@@ -23,10 +23,37 @@
  ***********************************************************************************/
 
 #import <UIKit/UIKit.h>
+#import "OHRenderQueue.h"
 @class OHPDFPage;
+@class OHRenderCache;
 
 /***********************************************************************************/
 
+/**
+ *  The pixel formats in which `-[OHVectorImage renderAtSize:]` can render images.
+ */
+typedef NS_ENUM(NSInteger, OHVectorImagePixelFormat) {
+    /**
+     *  32 bits per pixel: premultiplied RGBA, 8 bits per component.
+     */
+    OHVectorImagePixelFormatRGBA8888 = 0,
+    /**
+     *  8 bits per pixel: alpha only. The image is a template mask, made of the
+     *  alpha of the PDF (and of its `shadow`). The `tintColor` and `backgroundColor`
+     *  are not applied, as the tint is meant to be applied at draw time
+     *  (see `+[OHVectorImage drawMask:inRect:tintColor:]`), so a single mask can
+     *  be rendered (and cached) for every tint color.
+     */
+    OHVectorImagePixelFormatA8,
+    /**
+     *  16 bits per pixel: opaque RGB, 5 bits per component. The image is composited
+     *  over the `backgroundColor`, or over black if there is none.
+     *
+     *  @note CoreGraphics has no RGB565 bitmap format, hence the 5 bits of green.
+     */
+    OHVectorImagePixelFormatRGB555,
+};
+
 /**
  *  This class represents a vector image, typically loaded from a PDF file.
  *
@@ -49,6 +76,27 @@
  */
 @property(nonatomic, strong) UIColor* tintColor;
 
+/**
+ *  A map of source colors to target colors (both `UIColor`s) to recolor a
+ *  multi-color image with, e.g. to theme two-tone icons without separate PDFs.
+ *
+ *  - If `nil` (the default), the colors of the PDF are kept.
+ *  - If non-`nil`, each pixel is recolored according to its color: the colors
+ *    of the PDF matching a source color take its target color, and the colors
+ *    in between two sources (like antialiased edges) blend between their
+ *    targets. The alpha of a target color scales the alpha of the pixels it applies to.
+ *
+ *  The recoloring is applied on a rendering of the PDF with its original colors,
+ *  which is cached separately, so that rendering the same image with other maps
+ *  (e.g. for another theme) does not rasterize the PDF again.
+ *
+ *  @note Colors are matched with 16 levels per component, so source colors should
+ *        differ by more than 1/16 on at least one component. Ignored when a `tintColor`
+ *        is set, for A8 images, and when the colors can't be expressed as RGBA (e.g. pattern
+ *        colors), in which case a message is logged.
+ */
+@property(nonatomic, copy) NSDictionary* recolorMap;
+
 /**
  *  The background color to apply to the image when rendering into an `UIImage`.
  *
@@ -91,7 +139,90 @@
 @property(nonatomic, copy) void(^prepareContextBlock)(CGContextRef ctx);
 
 /**
- *  The size the Vector image was designed to be rendered in.
+ *  The cache in which the images rendered by `renderAtSize:` are stored.
+ *
+ *  Defaults to `[OHRenderCache sharedCache]`. Set it to `nil` to disable
+ *  the caching of rendered images for this vector image.
+ *
+ *  @note Only vector images loaded from an URL (or a PDF name) are cached,
+ *        and only when no `prepareContextBlock` is set and no color is a
+ *        pattern color, as such renderings cannot be described by a cache key.
+ */
+@property(nonatomic, strong) OHRenderCache* renderCache;
+
+/**
+ *  The pixel format of the images rendered by `renderAtSize:`.
+ *
+ *  Defaults to `OHVectorImagePixelFormatRGBA8888`. Use `OHVectorImagePixelFormatA8`
+ *  to render template masks (e.g. monochrome icons) using a quarter of the memory,
+ *  and tint them at draw time, or `OHVectorImagePixelFormatRGB555` for images
+ *  displayed on an opaque background using half of the memory.
+ *
+ *  @note The tiled rendering methods always render RGBA pixels.
+ */
+@property(nonatomic, assign) OHVectorImagePixelFormat pixelFormat;
+
+/**
+ *  If YES, `renderAtSize:` doesn't rasterize the PDF at every requested size:
+ *  it rasterizes it once per size bucket (see `mipmapBucketSizes`), and derives
+ *  the requested size by downsampling the rendering of the nearest larger bucket
+ *  with an area filter, which is much cheaper than rasterizing a complex PDF.
+ *  This is useful when rendering the same PDF at many slightly different sizes.
+ *
+ *  Defaults to NO.
+ *
+ *  @note Only RGBA renderings of vector images loaded from an URL (or a PDF name)
+ *        without a `prepareContextBlock` use mipmaps. Other renderings, sizes
+ *        without a bucket within `mipmapMaxDownsamplingRatio`, and buckets larger
+ *        than the 16MB mipmap cache, are rasterized at the requested size.
+ *        Downsampling slightly softens the thinnest details (like hairlines)
+ *        compared to rasterizing at the requested size, so the render cache
+ *        keeps the two kinds of renderings apart.
+ */
+@property(nonatomic, assign) BOOL usesMipmaps;
+
+/**
+ *  The sizes of the mipmap buckets, in points, as an array of `NSNumber`s.
+ *  The bucket used for each dimension of a requested size is the smallest
+ *  bucket size that is at least as large.
+ *
+ *  Defaults to `nil`, which uses the powers of two (1, 2, 4, 8, 16, …).
+ */
+@property(nonatomic, copy) NSArray* mipmapBucketSizes;
+
+/**
+ *  The quality threshold of the mipmaps: the maximum ratio, on each axis,
+ *  between the size of a bucket and the requested size for the bucket to be used.
+ *  Above this ratio, the PDF is rasterized at the requested size instead.
+ *
+ *  Defaults to 2, so that the power-of-two buckets are always used.
+ */
+@property(nonatomic, assign) CGFloat mipmapMaxDownsamplingRatio;
+
+/**
+ *  The scale factor (pixels per point) of the images rendered by `renderAtSize:`
+ *  and of the tiles rendered by the tiled rendering methods.
+ *
+ *  Defaults to 0, which uses the scale of the main screen. Set it to render
+ *  images for another screen, or the 1x, 2x and 3x variants of an asset.
+ */
+@property(nonatomic, assign) CGFloat screenScale;
+
+/**
+ *  If YES, the empty margins around the content of the PDF are ignored: the
+ *  `nativeSize` is the size of the ink actually painted on the page (see
+ *  `-[OHPDFPage contentBox]`) instead of the size of its media box, and the
+ *  content is rendered edge to edge (before applying the `insets`).
+ *
+ *  Defaults to NO. Has no effect if the page doesn't paint anything.
+ *
+ *  @note Use `insets` to get some margin back, e.g. for a `shadow`.
+ */
+@property(nonatomic, assign) BOOL trimToContent;
+
+/**
+ *  The size the Vector image was designed to be rendered in: the size of the
+ *  media box of the PDF page, or of its content if `trimToContent` is YES.
  */
 @property(nonatomic, readonly) CGSize nativeSize;
 
@@ -105,7 +236,7 @@
  *
  *  @return The `OHVectorImage` corresponding to the first page of the PDF.
  *
- *  @note PDF images are cached.
+ *  @note PDF documents are cached (see `OHPDFDocumentRegistry`).
  */
 + (instancetype)imageWithPDFNamed:(NSString*)pdfName;
 
@@ -119,9 +250,9 @@
  *
  *  @return The `OHVectorImage` corresponding to the first page of the PDF.
  *
- *  @note PDF pages are cached, but requesting a `OHVectorImage` with the same name
- *        twice will still lead to a new `OHVectorImage` with independant tintColor
- *        and backgroundColor.
+ *  @note PDF documents are cached (see `OHPDFDocumentRegistry`), but requesting
+ *        a `OHVectorImage` with the same name twice will still lead to a new
+ *        `OHVectorImage` with independant tintColor and backgroundColor.
  */
 + (instancetype)imageWithPDFNamed:(NSString*)pdfName
                          inBundle:(NSBundle*)bundleOrNil;
@@ -134,9 +265,9 @@
  *
  *  @return The `OHVectorImage` corresponding to the first page of the PDF
  *
- *  @note PDF pages are cached, but requesting a `OHVectorImage` with the same name
- *        twice will still lead to a new `OHVectorImage` with independant `tintColor`
- *        and `backgroundColor`.
+ *  @note PDF documents are cached (see `OHPDFDocumentRegistry`), but requesting
+ *        a `OHVectorImage` with the same URL twice will still lead to a new
+ *        `OHVectorImage` with independant `tintColor` and `backgroundColor`.
  */
 + (instancetype)imageWithPDFURL:(NSURL*)pdfURL;
 
@@ -225,4 +356,174 @@
  */
 - (UIImage*)renderAtSizeThatFits:(CGSize)size;
 
+/**
+ *  Render the `OHVectorImage` at several sizes and screen scales in a single call,
+ *  e.g. to produce the 1x, 2x and 3x variants of an icon.
+ *
+ *  @param sizes  An array of `NSValue`s wrapping the bounding box `CGSize`s to render
+ *                the image in (see `renderAtSizeThatFits:`)
+ *  @param scales An array of `NSNumber`s wrapping the screen scales to render each
+ *                size at (see `screenScale`). If `nil` or empty, every size is rendered
+ *                at the `screenScale` of the receiver.
+ *
+ *  @return The rendered images, in request order: the first size at each scale, then
+ *          the second size at each scale, and so on (`NSNull` for the variants that
+ *          could not be rendered).
+ *
+ *  @note The variants are rendered concurrently on the available cores, and share the
+ *        PDF page, its display list and its content bounds, which are only computed once.
+ *        Variants already in the `renderCache` are not rendered again.
+ */
+- (NSArray*)renderAtSizesThatFit:(NSArray*)sizes scales:(NSArray*)scales;
+
+#pragma mark - Rendering asynchronously
+
+/**
+ *  Render the `OHVectorImage` as a bitmap image with the given size, in the background
+ *
+ *  @param size       The size to render the image
+ *  @param completion The block called on the main queue with the rendered image
+ *
+ *  @return A token that can be used to cancel the request.
+ *
+ *  @note The vector image's properties are captured when calling this method, so
+ *        it is safe to modify them afterwards.
+ *
+ *  @note Renderings are performed on the `[OHRenderQueue sharedQueue]` queue, and
+ *        identical requests in flight at the same time are only rendered once.
+ */
+- (OHRenderRequest*)renderAtSize:(CGSize)size
+                      completion:(void(^)(UIImage* image))completion;
+
+/**
+ *  Render the `OHVectorImage` as a bitmap image with the given size, in the background
+ *
+ *  @param size       The size to render the image
+ *  @param priority   The priority of the request, relative to other pending requests
+ *  @param completion The block called on the main queue with the rendered image
+ *
+ *  @return A token that can be used to cancel the request.
+ */
+- (OHRenderRequest*)renderAtSize:(CGSize)size
+                        priority:(OHRenderPriority)priority
+                      completion:(void(^)(UIImage* image))completion;
+
+/**
+ *  Render the `OHVectorImage` as a bitmap image with a size fitting the given size,
+ *  in the background
+ *
+ *  @param size       The bounding box size to render the image in (see `sizeThatFits:`)
+ *  @param completion The block called on the main queue with the rendered image
+ *
+ *  @return A token that can be used to cancel the request.
+ */
+- (OHRenderRequest*)renderAtSizeThatFits:(CGSize)size
+                              completion:(void(^)(UIImage* image))completion;
+
+/**
+ *  Render the `OHVectorImage` as bitmap images at each of the given sizes,
+ *  in the background
+ *
+ *  @param sizes      An array of `NSValue`s wrapping the `CGSize`s to render the image at
+ *  @param priority   The priority of the requests
+ *  @param completion The block called on the main queue once all the images have been
+ *                    rendered, with the images in the same order as `sizes`
+ *                    (`NSNull` for sizes that could not be rendered)
+ *
+ *  @return A token that can be used to cancel all the requests at once.
+ */
+- (OHRenderRequest*)renderAtSizes:(NSArray*)sizes
+                         priority:(OHRenderPriority)priority
+                       completion:(void(^)(NSArray* images))completion;
+
+#pragma mark - Tiled rendering
+
+/**
+ *  The size in pixels of the bitmap rendered by `renderAtSize:` for the given size.
+ *  Tiles rendered by the methods below are expressed in this pixel space.
+ *
+ *  @param size The size to render the image, in points
+ *
+ *  @return The size of the rendered bitmap, in pixels
+ */
+- (CGSize)pixelSizeForSize:(CGSize)size;
+
+/**
+ *  Render only a part of the bitmap that `renderAtSize:` would render, e.g.
+ *  the visible viewport of a very large image.
+ *
+ *  @param size      The size of the whole image, in points
+ *  @param pixelRect The part of the image to render, in pixels (see `pixelSizeForSize:`),
+ *                   with the origin at the top left
+ *
+ *  @return The `UIImage` of the requested part of the image (clipped to the image
+ *          bounds), or `nil` if the rect is empty or the image can't be rendered in tiles.
+ *
+ *  @note Tiled rendering draws the PDF and applies the `tintColor`, `backgroundColor`
+ *        and `shadow` exactly like `renderAtSize:`, so tiles join seamlessly.
+ *        It does not support `prepareContextBlock` nor colors that can't be
+ *        expressed as RGBA (like pattern colors). The rendered tiles are not cached.
+ */
+- (UIImage*)renderTileAtSize:(CGSize)size pixelRect:(CGRect)pixelRect;
+
+/**
+ *  Render the image at the given size tile by tile, in parallel, streaming the
+ *  tiles to a handler instead of rendering the whole bitmap at once.
+ *
+ *  The peak memory used is bounded by the size of a tile (plus the margin needed
+ *  by the shadow) times the number of tiles rendered concurrently, which makes it
+ *  possible to render images too large to fit in memory as a single bitmap.
+ *
+ *  @param size               The size of the whole image, in points
+ *  @param tileSize           The size of the tiles, in pixels
+ *  @param maxConcurrentTiles The maximum number of tiles rendered at the same time.
+ *                            Use 0 for the number of active processors.
+ *  @param handler            The block called for each tile, with the tile image and
+ *                            its rect in pixels (origin at the top left). It is called
+ *                            concurrently on background threads, and the tile image
+ *                            is released once the block returns.
+ *
+ *  @return YES if all the tiles were rendered, NO on failure (see `renderTileAtSize:pixelRect:`).
+ *
+ *  @note This method is synchronous: it returns once all the tiles have been handled.
+ */
+- (BOOL)renderTilesAtSize:(CGSize)size
+                 tileSize:(CGSize)tileSize
+       maxConcurrentTiles:(NSUInteger)maxConcurrentTiles
+                  handler:(void(^)(CGImageRef tile, CGRect pixelRect))handler;
+
+/**
+ *  Render the image at the given size tile by tile, in parallel, directly
+ *  into a buffer allocated by the caller (e.g. a memory-mapped file).
+ *
+ *  @param size        The size of the whole image, in points
+ *  @param buffer      The buffer to render into, of at least `bytesPerRow` times the
+ *                     height returned by `pixelSizeForSize:`. Pixels are written as
+ *                     premultiplied RGBA, 8 bits per component.
+ *  @param bytesPerRow The number of bytes per row of the buffer
+ *  @param tileSize    The size of the tiles, in pixels
+ *
+ *  @return YES if all the tiles were rendered, NO on failure (see `renderTileAtSize:pixelRect:`).
+ */
+- (BOOL)renderAtSize:(CGSize)size
+          intoBuffer:(void*)buffer
+         bytesPerRow:(size_t)bytesPerRow
+            tileSize:(CGSize)tileSize;
+
+#pragma mark - Drawing masks
+
+/**
+ *  Draws an image rendered with `OHVectorImagePixelFormatA8` in the current
+ *  graphics context, tinted with the given color.
+ *
+ *  This lets a single rendered (and cached) mask be drawn in any color, without
+ *  rendering the PDF again. Where UIKit tints images itself (e.g. `UIImageView`
+ *  on iOS 7+), the mask can also be used directly, as it is a template image.
+ *
+ *  @param mask      The mask to draw. Only its alpha channel is used.
+ *  @param rect      The rect to draw the mask in, in the current context
+ *  @param tintColor The color to draw the mask with
+ */
++ (void)drawMask:(UIImage*)mask inRect:(CGRect)rect tintColor:(UIColor*)tintColor;
+
 @end
@@ -25,14 +25,31 @@
 #import "OHVectorImage.h"
 #import "OHPDFDocument.h"
 #import "OHPDFPage.h"
+#import "OHPDFDocumentRegistry.h"
+#import "OHRenderCache.h"
+#import "OHRenderQueue.h"
+#import "OHPixelKernels.h"
+#import "OHShadowBlur.h"
+#import "OHRenderStats.h"
+#import "OHBitmapPool.h"
 
 /***********************************************************************************/
 
+static NSUInteger const kShadowMaskCacheCostLimit = 4 * 1024 * 1024;
+static NSUInteger const kMipmapCacheCostLimit = 16 * 1024 * 1024;
+static NSUInteger const kCoverageLayerCacheCostLimit = 8 * 1024 * 1024;
+static CGFloat const kDefaultMipmapMaxDownsamplingRatio = 2.0;
+
 @interface OHVectorImage()
 - (instancetype)initWithPDFPage:(OHPDFPage*)pdfPage NS_DESIGNATED_INITIALIZER;
 @property(nonatomic, strong) OHPDFPage* pdfPage;
+@property(nonatomic, strong) NSURL* sourceURL;
+/// The lookup table of the `recolorMap` for the pixel kernels, or `nil` if it can't be expressed as RGBA
+@property(nonatomic, strong) NSData* recolorLookupTable;
 @end
 
+static CGImageRef OHCreateImageWithPixelBuffer(OHPixelBuffer buffer);
+
 
 @implementation OHVectorImage
 
@@ -46,13 +63,7 @@
 + (instancetype)imageWithPDFNamed:(NSString*)pdfName
                          inBundle:(NSBundle*)bundleOrNil
 {
-    if (!pdfName) return nil;
-    
-    NSString* basename = [pdfName stringByDeletingPathExtension];
-    NSString* ext = [pdfName pathExtension];
-    if (ext.length == 0) ext = @"pdf";
-    NSURL* url = [(bundleOrNil?:[NSBundle mainBundle]) URLForResource:basename withExtension:ext];
-    return [self imageWithPDFURL:url];
+    return [self imageWithPDFURL:[OHPDFDocumentRegistry URLForPDFNamed:pdfName inBundle:bundleOrNil]];
 }
 
 + (instancetype)imageWithPDFURL:(NSURL*)pdfURL
@@ -60,24 +71,12 @@
     if (!pdfURL) return nil;
     
     static size_t const kDefaultPDFPageIndexForVectorImage = 1; // Use first page by default
-    static NSCache* pdfCache;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        pdfCache = [NSCache new];
-    });
-    
-    OHPDFPage* page = [pdfCache objectForKey:pdfURL];
-    if (!page)
-    {
-        OHPDFDocument* doc = [OHPDFDocument documentWithURL:pdfURL];
-        page = [doc pageAtIndex:kDefaultPDFPageIndexForVectorImage];
-        if (page)
-        {
-            [pdfCache setObject:page forKey:pdfURL];
-        }
-    }
+    OHPDFDocument* doc = [[OHPDFDocumentRegistry sharedRegistry] documentWithURL:pdfURL];
+    OHPDFPage* page = [doc pageAtIndex:kDefaultPDFPageIndexForVectorImage];
     
-    return [self imageWithPDFPage:page];
+    OHVectorImage* image = [self imageWithPDFPage:page];
+    image.sourceURL = pdfURL;
+    return image;
 }
 
 + (instancetype)imageWithPDFPage:(OHPDFPage*)pdfPage
@@ -94,6 +93,8 @@
     {
         _pdfPage = pdfPage;
         _nativeSize = pdfPage.mediaBox.size;
+        _renderCache = [OHRenderCache sharedCache];
+        _mipmapMaxDownsamplingRatio = kDefaultMipmapMaxDownsamplingRatio;
     }
     return self;
 }
@@ -102,15 +103,35 @@
 {
     OHVectorImage* copy = [OHVectorImage imageWithPDFPage:self.pdfPage];
     copy.tintColor = [self.tintColor copy];
+    copy.recolorMap = self.recolorMap;
     copy.backgroundColor = [self.backgroundColor copy];
     copy.shadow = [self.shadow copy];
     copy.insets = self.insets;
     copy.prepareContextBlock = [self.prepareContextBlock copy];
+    copy.renderCache = self.renderCache;
+    copy.pixelFormat = self.pixelFormat;
+    copy.usesMipmaps = self.usesMipmaps;
+    copy.mipmapBucketSizes = self.mipmapBucketSizes;
+    copy.mipmapMaxDownsamplingRatio = self.mipmapMaxDownsamplingRatio;
+    copy.trimToContent = self.trimToContent;
+    copy.screenScale = self.screenScale;
+    copy.sourceURL = self.sourceURL;
     return copy;
 }
 
 #pragma mark - Rendering at a given size
 
+- (CGFloat)effectiveScreenScale
+{
+    return self.screenScale > 0 ? self.screenScale : [UIScreen mainScreen].scale;
+}
+
+- (CGSize)nativeSize
+{
+    CGRect contentBox = self.trimmedContentBox;
+    return CGRectIsNull(contentBox) ? _nativeSize : contentBox.size;
+}
+
 - (CGSize)insetNativeSize
 {
     return (CGSize){
@@ -155,6 +176,10 @@
     CGRect fullRect  = CGRectIntegral( (CGRect){ .origin = CGPointZero, .size = size } );
     CGSize imageSize = fullRect.size; // Extract it back, because CGRectIntegral may have rounded it
 
+    NSString* cacheKey = [self renderCacheKeyForSize:imageSize];
+    UIImage* cachedImage = [self.renderCache imageForKey:cacheKey];
+    if (cachedImage) return cachedImage;
+
     CGSize scale = [self scaleForSize:size];
     UIEdgeInsets scaledInsets = (UIEdgeInsets){
         .top    = self.insets.top    * scale.height,
@@ -163,49 +188,1113 @@
         .right  = self.insets.right  * scale.width
     };
     
-    UIImage* rasterImage = [self generateImageWithSize:imageSize drawingBlock:^(CGContextRef ctx) {
-        if (self.tintColor)
+    UIImage* image = nil;
+    if (self.usesMipmaps)
+    {
+        image = [self renderFromMipmapAtSize:imageSize];
+    }
+    if (!image && !self.prepareContextBlock)
+    {
+        image = [self renderWithPixelKernelsAtSize:imageSize scale:scale insets:scaledInsets];
+    }
+    if (!image)
+    {
+        image = [self renderWithQuartzAtSize:imageSize scale:scale insets:scaledInsets];
+    }
+    if (self.pixelFormat == OHVectorImagePixelFormatA8 && [image respondsToSelector:@selector(imageWithRenderingMode:)])
+    {
+        // Let UIKit tint the mask at draw time (iOS 7+)
+        image = [image imageWithRenderingMode:UIImageRenderingModeAlwaysTemplate];
+    }
+    
+    [self.renderCache setImage:image forKey:cacheKey pdfURL:self.sourceURL];
+    return image;
+}
+
+- (UIImage*)renderAtSizeThatFits:(CGSize)size
+{
+    return [self renderAtSize:[self sizeThatFits:size]];
+}
+
+- (NSArray*)renderAtSizesThatFit:(NSArray*)sizes scales:(NSArray*)scales
+{
+    if (scales.count == 0) scales = @[ @(self.screenScale) ];
+    
+    // Each variant is rendered by its own copy, which shares the PDF page of the receiver
+    NSMutableArray* variants = [NSMutableArray arrayWithCapacity:sizes.count * scales.count];
+    for (NSValue* size in sizes)
+    {
+        for (NSNumber* scale in scales)
+        {
+            OHVectorImage* variant = [self copy];
+            variant.screenScale = scale.doubleValue;
+            [variants addObject:@[ variant, size ]];
+        }
+    }
+    
+    // Compile the display list and measure the content once, instead of
+    // having all the variants wait for the first one to do it
+    OHPDFPage* page = self.pdfPage;
+    (void)page.displayList;
+    if (self.usesContentBox) (void)page.contentBox;
+    
+    NSMutableArray* images = [NSMutableArray arrayWithCapacity:variants.count];
+    for (NSUInteger idx = 0; idx < variants.count; ++idx) [images addObject:[NSNull null]];
+    dispatch_apply(variants.count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+        @autoreleasepool {
+            OHVectorImage* variant = variants[index][0];
+            UIImage* image = [variant renderAtSizeThatFits:[variants[index][1] CGSizeValue]];
+            if (!image) return;
+            @synchronized(images)
+            {
+                images[index] = image;
+            }
+        }
+    });
+    return [images copy];
+}
+
+#pragma mark - Rendering asynchronously
+
+- (OHRenderRequest*)renderAtSize:(CGSize)size
+                      completion:(void(^)(UIImage* image))completion
+{
+    return [self renderAtSize:size priority:OHRenderPriorityNormal completion:completion];
+}
+
+- (OHRenderRequest*)renderAtSize:(CGSize)size
+                        priority:(OHRenderPriority)priority
+                      completion:(void(^)(UIImage* image))completion
+{
+    return [[OHRenderQueue sharedQueue] renderImage:self atSize:size priority:priority completion:completion];
+}
+
+- (OHRenderRequest*)renderAtSizeThatFits:(CGSize)size
+                              completion:(void(^)(UIImage* image))completion
+{
+    return [self renderAtSize:[self sizeThatFits:size] completion:completion];
+}
+
+- (OHRenderRequest*)renderAtSizes:(NSArray*)sizes
+                         priority:(OHRenderPriority)priority
+                       completion:(void(^)(NSArray* images))completion
+{
+    return [[OHRenderQueue sharedQueue] renderImage:self atSizes:sizes priority:priority completion:completion];
+}
+
+#pragma mark - Tiled rendering
+
+- (CGSize)pixelSizeForSize:(CGSize)size
+{
+    CGSize imageSize = CGRectIntegral( (CGRect){ .origin = CGPointZero, .size = size } ).size;
+    CGFloat screenScale = self.effectiveScreenScale;
+    return CGSizeMake(ceil(imageSize.width * screenScale), ceil(imageSize.height * screenScale));
+}
+
+- (UIImage*)renderTileAtSize:(CGSize)size pixelRect:(CGRect)pixelRect
+{
+    __block UIImage* image = nil;
+    CGFloat screenScale = self.effectiveScreenScale;
+    [self renderTileAtSize:size pixelRect:pixelRect sink:^(OHPixelBuffer tile, CGRect tileRect) {
+        CGImageRef cgImage = OHCreateImageWithPixelBuffer(tile);
+        if (!cgImage) return NO;
+        image = [UIImage imageWithCGImage:cgImage scale:screenScale orientation:UIImageOrientationUp];
+        CGImageRelease(cgImage);
+        return YES;
+    }];
+    return image;
+}
+
+- (BOOL)renderTilesAtSize:(CGSize)size
+                 tileSize:(CGSize)tileSize
+       maxConcurrentTiles:(NSUInteger)maxConcurrentTiles
+                  handler:(void(^)(CGImageRef tile, CGRect pixelRect))handler
+{
+    return [self enumerateTilesAtSize:size tileSize:tileSize maxConcurrentTiles:maxConcurrentTiles
+                           usingBlock:^(OHPixelBuffer tile, CGRect tileRect)
+    {
+        CGImageRef cgImage = OHCreateImageWithPixelBuffer(tile);
+        if (!cgImage) return NO;
+        handler(cgImage, tileRect);
+        CGImageRelease(cgImage);
+        return YES;
+    }];
+}
+
+- (BOOL)renderAtSize:(CGSize)size
+          intoBuffer:(void*)buffer
+         bytesPerRow:(size_t)bytesPerRow
+            tileSize:(CGSize)tileSize
+{
+    return [self enumerateTilesAtSize:size tileSize:tileSize maxConcurrentTiles:0
+                           usingBlock:^(OHPixelBuffer tile, CGRect tileRect)
+    {
+        uint8_t* destination = (uint8_t*)buffer + (size_t)tileRect.origin.y * bytesPerRow + (size_t)tileRect.origin.x * 4;
+        for (size_t y = 0; y < tile.height; ++y)
+        {
+            memcpy(destination + y * bytesPerRow, tile.data + y * tile.bytesPerRow, tile.width * 4);
+        }
+        return YES;
+    }];
+}
+
+#pragma mark - Drawing masks
+
++ (void)drawMask:(UIImage*)mask inRect:(CGRect)rect tintColor:(UIColor*)tintColor
+{
+    CGContextRef ctx = UIGraphicsGetCurrentContext();
+    if (!ctx || !mask.CGImage) return;
+    
+    CGContextSaveGState(ctx);
+    // CGContextClipToMask uses the CoreGraphics coordinate system, so flip the rect vertically
+    CGContextTranslateCTM(ctx, 0, CGRectGetMinY(rect) + CGRectGetMaxY(rect));
+    CGContextScaleCTM(ctx, 1, -1);
+    CGContextClipToMask(ctx, rect, mask.CGImage);
+    CGContextSetFillColorWithColor(ctx, tintColor.CGColor);
+    CGContextFillRect(ctx, rect);
+    CGContextRestoreGState(ctx);
+}
+
+#pragma mark - Private Methods
+
+static BOOL OHPixelColorFromUIColor(UIColor* color, OHPixelColor* outColor)
+{
+    CGFloat r, g, b, a;
+    if (![color getRed:&r green:&g blue:&b alpha:&a]) return NO;
+    
+    *outColor = (OHPixelColor){
+        .r = (uint8_t)lround(r * 255),
+        .g = (uint8_t)lround(g * 255),
+        .b = (uint8_t)lround(b * 255),
+        .a = (uint8_t)lround(a * 255)
+    };
+    return YES;
+}
+
+- (void)setRecolorMap:(NSDictionary*)recolorMap
+{
+    _recolorMap = [recolorMap copy];
+    
+    // Compiled once here, as the map is applied on every rendering
+    NSMutableData* table = nil;
+    NSUInteger count = recolorMap.count;
+    if (count > 0)
+    {
+        OHPixelColor* sources = malloc(count * sizeof(OHPixelColor));
+        OHPixelColor* targets = malloc(count * sizeof(OHPixelColor));
+        __block NSUInteger idx = 0;
+        __block BOOL isRGBA = (sources && targets);
+        if (isRGBA)
         {
-            // Generate a mask using the PDF
-            UIImage* mask = [self generateImageWithSize:imageSize drawingBlock:^(CGContextRef ctx) {
-                // - flipped=YES because we will use its CGImage with CGContextClipToMask
-                //   which is in CoreGraphics coordinate system — which is inverted compared
-                //   to the UIKit coordinate system.
-                CGRect insetRect = CGRectIntegral( UIEdgeInsetsInsetRect(fullRect, scaledInsets) );
-                [self.pdfPage drawInContext:ctx rect:insetRect flipped:YES];
+            [recolorMap enumerateKeysAndObjectsUsingBlock:^(UIColor* source, UIColor* target, BOOL* stop) {
+                isRGBA = OHPixelColorFromUIColor(source, &sources[idx]) && OHPixelColorFromUIColor(target, &targets[idx]);
+                ++idx;
+                *stop = !isRGBA;
             }];
-            // Use the mask to generate a tinted image
-            CGContextClipToMask(ctx, fullRect, mask.CGImage);
-            CGContextSetFillColorWithColor(ctx, self.tintColor.CGColor);
-            CGContextFillRect(ctx, fullRect);
+        }
+        if (isRGBA)
+        {
+            table = [NSMutableData dataWithLength:OH_PIXEL_RECOLOR_TABLE_SIZE * sizeof(OHPixelColor)];
+            OHPixelLookupTableFromColorMap(sources, targets, count, table.mutableBytes);
         }
         else
         {
-            // Directly render the image in a bitmap context.
-            // Note: we need to flip the insetRect to match the CoreGraphics orientation
-            CGRect insetRect = CGRectIntegral( UIEdgeInsetsInsetRect(fullRect, (UIEdgeInsets){
-                .top  = scaledInsets.bottom, .bottom = scaledInsets.top,
-                .left = scaledInsets.left,    .right = scaledInsets.right
-            }) );
-            [self.pdfPage drawInContext:ctx rect:insetRect flipped:NO];
+            NSLog(@"[OHPDFImage] The recolorMap is ignored: its colors can't be expressed as RGBA (e.g. pattern colors)");
+        }
+        free(sources);
+        free(targets);
+    }
+    self.recolorLookupTable = table;
+}
+
+/**
+ *  The colors of the vector image, as used by the pixel kernels (straight RGBA).
+ */
+typedef struct {
+    BOOL hasTint, hasBackground, hasShadow;
+    OHPixelColor tint, background, shadow;
+    const OHPixelColor* recolorTable; // NULL if there is no recolorMap, owned by the vector image
+} OHPixelColors;
+
+/**
+ *  Converts the `tintColor`, `recolorMap`, `backgroundColor` and shadow color for the pixel kernels.
+ *
+ *  @return NO if one of the colors can't be expressed as RGBA (e.g. pattern colors),
+ *          in which case Quartz should be used instead.
+ */
+- (BOOL)getPixelColors:(OHPixelColors*)colors
+{
+    *colors = (OHPixelColors){ .hasTint = NO };
+    if (self.tintColor && !(colors->hasTint = OHPixelColorFromUIColor(self.tintColor, &colors->tint))) return NO;
+    if (self.recolorMap.count > 0 && !self.tintColor)
+    {
+        if (!self.recolorLookupTable) return NO;
+        colors->recolorTable = self.recolorLookupTable.bytes;
+    }
+    if (self.backgroundColor && !(colors->hasBackground = OHPixelColorFromUIColor(self.backgroundColor, &colors->background))) return NO;
+    // Like with CGContextSetShadowWithColor, a shadow without a color draws nothing
+    UIColor* shadowUIColor = (UIColor*)self.shadow.shadowColor;
+    if (shadowUIColor && !(colors->hasShadow = OHPixelColorFromUIColor(shadowUIColor, &colors->shadow))) return NO;
+    return YES;
+}
+
+/**
+ *  Draws the PDF in a bitmap context in the CoreGraphics coordinate system,
+ *  whose CTM maps the image (in points) to the pixels of the full rendering.
+ */
+- (void)drawPDFInPixelContext:(CGContextRef)ctx imageSize:(CGSize)imageSize insets:(UIEdgeInsets)scaledInsets
+{
+    CGRect pageRect = [self pageRectForInsetRect:[self pixelContextInsetRectForImageSize:imageSize insets:scaledInsets]
+                                         flipped:NO];
+    OH_RENDER_STATS_BEGIN(rasterStart);
+    [self.pdfPage drawInContext:ctx rect:pageRect flipped:NO];
+    OH_RENDER_STATS_END(OHRenderStageRaster, rasterStart);
+}
+
+/**
+ *  The rect in which the content is drawn by `drawPDFInPixelContext:imageSize:insets:`,
+ *  in points, in the CoreGraphics coordinate system.
+ */
+- (CGRect)pixelContextInsetRectForImageSize:(CGSize)imageSize insets:(UIEdgeInsets)scaledInsets
+{
+    // This context is in the CoreGraphics coordinate system, so flip the insets
+    CGRect fullRect  = (CGRect){ .origin = CGPointZero, .size = imageSize };
+    return CGRectIntegral( UIEdgeInsetsInsetRect(fullRect, (UIEdgeInsets){
+        .top  = scaledInsets.bottom, .bottom = scaledInsets.top,
+        .left = scaledInsets.left,    .right = scaledInsets.right
+    }) );
+}
+
+/**
+ *  The content box of the page if the receiver is trimmed to its content, `CGRectNull` otherwise.
+ */
+- (CGRect)trimmedContentBox
+{
+    if (!self.trimToContent) return CGRectNull;
+    CGRect contentBox = self.pdfPage.contentBox;
+    return CGRectIsEmpty(contentBox) ? CGRectNull : contentBox;
+}
+
+/**
+ *  The rect to pass to `-[OHPDFPage drawInContext:rect:flipped:]` so that the content
+ *  fills `insetRect`: the whole media box, or only the content box when trimming.
+ */
+- (CGRect)pageRectForInsetRect:(CGRect)insetRect flipped:(BOOL)flipped
+{
+    CGRect contentBox = self.trimmedContentBox;
+    if (CGRectIsNull(contentBox)) return insetRect;
+    
+    // The page maps a point p of the PDF to rect.origin + p * scale (before flipping)
+    CGSize mediaSize = self.pdfPage.mediaBox.size;
+    CGFloat sx = insetRect.size.width / contentBox.size.width;
+    CGFloat sy = insetRect.size.height / contentBox.size.height;
+    CGFloat y = flipped ? insetRect.origin.y - sy * (mediaSize.height - CGRectGetMaxY(contentBox))
+                        : insetRect.origin.y - sy * contentBox.origin.y;
+    return CGRectMake(insetRect.origin.x - sx * contentBox.origin.x, y, mediaSize.width * sx, mediaSize.height * sy);
+}
+
+/**
+ *  YES if rendering uses the content box of the page, either to trim it or to restrict
+ *  the pixel kernels to the ink. Pages without display list are measured by rasterizing
+ *  them, which is only worth it if they are trimmed to their content anyway.
+ */
+- (BOOL)usesContentBox
+{
+    OHPDFPage* page = self.pdfPage;
+    BOOL drawsDisplayList = (page.usesDisplayList || !page.pageRef) && page.displayList;
+    return self.trimToContent || drawsDisplayList;
+}
+
+/**
+ *  The rect of the full rendering at the given size, in pixels with the origin at
+ *  the top left, outside of which the PDF doesn't paint anything (possibly empty),
+ *  or `CGRectNull` if it is unknown.
+ *
+ *  The kernels only tint and blur this rect, instead of every pixel of the image.
+ */
+- (CGRect)inkPixelRectForImageSize:(CGSize)imageSize insets:(UIEdgeInsets)scaledInsets
+{
+    if (!self.usesContentBox) return CGRectNull;
+    
+    OHPDFPage* page = self.pdfPage;
+    CGRect contentBox = page.contentBox;
+    if (CGRectIsNull(contentBox)) return CGRectZero;
+    
+    CGFloat screenScale = self.effectiveScreenScale;
+    CGSize mediaSize = page.mediaBox.size;
+    CGRect pageRect = [self pageRectForInsetRect:[self pixelContextInsetRectForImageSize:imageSize insets:scaledInsets]
+                                         flipped:NO];
+    CGFloat sx = pageRect.size.width / mediaSize.width * screenScale;
+    CGFloat sy = pageRect.size.height / mediaSize.height * screenScale;
+    CGFloat pixelHeight = ceil(imageSize.height * screenScale);
+    CGRect inkRect = CGRectMake(pageRect.origin.x * screenScale + contentBox.origin.x * sx,
+                                pixelHeight - pageRect.origin.y * screenScale - CGRectGetMaxY(contentBox) * sy,
+                                contentBox.size.width * sx, contentBox.size.height * sy);
+    // Grow by a pixel to be safe with antialiasing
+    CGRect pixelRect = CGRectMake(0, 0, ceil(imageSize.width * screenScale), pixelHeight);
+    inkRect = CGRectIntersection(CGRectInset(CGRectIntegral(inkRect), -1, -1), pixelRect);
+    return CGRectIsNull(inkRect) ? CGRectZero : inkRect;
+}
+
+/**
+ *  The part of a buffer covered by a rect (in pixels, origin at the top left).
+ */
+static OHPixelBuffer OHPixelBufferRegion(OHPixelBuffer buffer, CGRect rect, size_t bytesPerPixel)
+{
+    if (CGRectIsEmpty(rect)) return (OHPixelBuffer){ .data = buffer.data, .bytesPerRow = buffer.bytesPerRow };
+    return (OHPixelBuffer){
+        .data = buffer.data + (size_t)rect.origin.y * buffer.bytesPerRow + (size_t)rect.origin.x * bytesPerPixel,
+        .width = (size_t)rect.size.width,
+        .height = (size_t)rect.size.height,
+        .bytesPerRow = buffer.bytesPerRow
+    };
+}
+
+/**
+ *  How far, in pixels, the blur of a shadow spreads the alpha of a pixel.
+ */
+static CGFloat OHShadowBlurExtent(CGFloat radius)
+{
+    size_t boxSizes[3];
+    OHBoxBlurSizesForSigma(radius / 2, boxSizes);
+    return boxSizes[0]/2 + boxSizes[1]/2 + boxSizes[2]/2 + 1;
+}
+
+/**
+ *  The rect outside of which the (unshifted) shadow mask of the ink in `inkRect` is zero.
+ */
+static CGRect OHShadowMaskRect(CGRect inkRect, CGFloat radius, CGSize bufferSize)
+{
+    if (CGRectIsEmpty(inkRect)) return CGRectZero;
+    CGFloat extent = OHShadowBlurExtent(radius);
+    CGRect maskRect = CGRectIntersection(CGRectInset(inkRect, -extent, -extent),
+                                         (CGRect){ .origin = CGPointZero, .size = bufferSize });
+    return CGRectIsNull(maskRect) ? CGRectZero : maskRect;
+}
+
+/**
+ *  Computes the blurred alpha of `buffer` into `mask`, only within `maskRect`.
+ *
+ *  @param mask The zero-filled mask to render into, with `buffer.width` bytes per row
+ *
+ *  @return 0 on success, -1 if the scratch memory could not be allocated.
+ */
+static int OHShadowMaskRender(OHPixelBuffer buffer, BOOL alphaOnly, CGRect maskRect, CGFloat radius, uint8_t* mask)
+{
+    OHPixelBuffer region = OHPixelBufferRegion(buffer, maskRect, alphaOnly ? 1 : 4);
+    if (region.width == 0 || region.height == 0) return 0;
+    BOOL isWholeBuffer = (region.width == buffer.width && region.height == buffer.height);
+    uint8_t* regionMask = isWholeBuffer ? mask : OHBitmapPoolAcquire(region.width * region.height, 0);
+    if (!regionMask) return -1;
+    
+    if (alphaOnly)
+    {
+        for (size_t y = 0; y < region.height; ++y)
+        {
+            memcpy(regionMask + y * region.width, region.data + y * region.bytesPerRow, region.width);
+        }
+    }
+    else
+    {
+        OHAlphaMaskExtract(region, regionMask);
+    }
+    int result = OHAlphaMaskBlur(regionMask, region.width, region.height, radius);
+    if (!isWholeBuffer)
+    {
+        // The blur treats the pixels outside of the region as transparent, like the ones outside of the buffer
+        uint8_t* destination = mask + (size_t)maskRect.origin.y * buffer.width + (size_t)maskRect.origin.x;
+        for (size_t y = 0; y < region.height; ++y)
+        {
+            memcpy(destination + y * buffer.width, regionMask + y * region.width, region.width);
+        }
+        OHBitmapPoolRelease(regionMask, 0, region.width * region.height);
+    }
+    return result;
+}
+
+/**
+ *  Clips a bitmap context (before any transform) to a rect in pixels with the origin at the top left.
+ */
+static void OHClipPixelContextToRect(CGContextRef ctx, CGRect rect)
+{
+    size_t height = CGBitmapContextGetHeight(ctx);
+    CGContextClipToRect(ctx, CGRectMake(rect.origin.x, height - CGRectGetMaxY(rect), rect.size.width, rect.size.height));
+}
+
+/**
+ *  Quartz shadow parameters are expressed in device pixels, regardless of the CTM,
+ *  so scale them like the Quartz rendering path does, but not by the screen scale.
+ */
+- (CGFloat)shadowRadiusForScale:(CGSize)scale
+{
+    return self.shadow.shadowBlurRadius * (scale.width+scale.height)/2;
+}
+
+/**
+ *  Applies the recoloring, tint, shadow and background on the pixels of a rendered PDF.
+ *
+ *  @param shadowMask The blurred alpha of the buffer (before tinting), with
+ *                    `buffer.width` bytes per row, or NULL if there is no shadow.
+ *  @param inkRect    The rect of the buffer outside of which nothing was drawn
+ *                    (see `inkPixelRectForImageSize:insets:`)
+ */
+- (void)applyPixelColors:(OHPixelColors)colors toBuffer:(OHPixelBuffer)buffer
+              shadowMask:(const uint8_t*)shadowMask scale:(CGSize)scale inkRect:(CGRect)inkRect
+{
+    OH_RENDER_STATS_BEGIN(compositeStart);
+    if (colors.recolorTable) OHPixelRecolorWithLookupTable(OHPixelBufferRegion(buffer, inkRect, 4), colors.recolorTable);
+    if (colors.hasTint) OHPixelRecolor(OHPixelBufferRegion(buffer, inkRect, 4), OHPixelColorPremultiply(colors.tint));
+    if (shadowMask)
+    {
+        // The mask is computed before tinting, and the shadow is cast by the tinted
+        // image, so account for the tint's alpha in the shadow color.
+        OHPixelColor shadowColor = colors.shadow;
+        if (colors.hasTint) shadowColor.a = (uint8_t)((shadowColor.a * colors.tint.a + 127) / 255);
+        long offsetX = lround(self.shadow.shadowOffset.width  * scale.width);
+        long offsetY = lround(self.shadow.shadowOffset.height * scale.height);
+        CGRect shadowRect = [self shadowPixelRectForInkRect:inkRect buffer:buffer scale:scale];
+        if (!CGRectIsEmpty(shadowRect))
+        {
+            OHPixelShadowUnder(OHPixelBufferRegion(buffer, shadowRect, 4),
+                               shadowMask + (size_t)(shadowRect.origin.y - offsetY) * buffer.width
+                                          + (size_t)(shadowRect.origin.x - offsetX),
+                               buffer.width, 0, 0, OHPixelColorPremultiply(shadowColor));
         }
+    }
+    if (colors.hasBackground) OHPixelFillUnder(buffer, OHPixelColorPremultiply(colors.background));
+    OH_RENDER_STATS_END(OHRenderStageComposite, compositeStart);
+}
+
+/**
+ *  The rect of the buffer in which the shadow of the ink in `inkRect` is cast
+ *  (the non-zero part of the shadow mask, shifted by the shadow offset).
+ */
+- (CGRect)shadowPixelRectForInkRect:(CGRect)inkRect buffer:(OHPixelBuffer)buffer scale:(CGSize)scale
+{
+    CGSize bufferSize = CGSizeMake(buffer.width, buffer.height);
+    CGRect maskRect = OHShadowMaskRect(inkRect, [self shadowRadiusForScale:scale], bufferSize);
+    if (CGRectIsEmpty(maskRect)) return CGRectZero;
+    CGRect shadowRect = CGRectIntersection(CGRectOffset(maskRect, lround(self.shadow.shadowOffset.width  * scale.width),
+                                                        lround(self.shadow.shadowOffset.height * scale.height)),
+                                           (CGRect){ .origin = CGPointZero, .size = bufferSize });
+    return CGRectIsNull(shadowRect) ? CGRectZero : shadowRect;
+}
+
+static CGContextRef OHCreatePixelContextWithData(void* data, size_t width, size_t height, size_t bytesPerRow,
+                                                 OHVectorImagePixelFormat format)
+{
+    if (format == OHVectorImagePixelFormatA8)
+    {
+        return CGBitmapContextCreate(data, width, height, 8, bytesPerRow, NULL, (CGBitmapInfo)kCGImageAlphaOnly);
+    }
+    
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef ctx = NULL;
+    if (format == OHVectorImagePixelFormatRGB555)
+    {
+        ctx = CGBitmapContextCreate(data, width, height, 5, bytesPerRow, colorSpace, (CGBitmapInfo)kCGImageAlphaNoneSkipFirst);
+    }
+    else
+    {
+        ctx = CGBitmapContextCreate(data, width, height, 8, bytesPerRow, colorSpace,
+                                    (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big);
+    }
+    CGColorSpaceRelease(colorSpace);
+    return ctx;
+}
+
+static CGContextRef OHCreatePixelContext(size_t width, size_t height, OHVectorImagePixelFormat format)
+{
+    return OHCreatePixelContextWithData(NULL, width, height, 0, format);
+}
+
+/**
+ *  Creates a bitmap context backed by a zeroed buffer of the bitmap pool, instead of
+ *  a new allocation. Release it using `OHReleasePooledPixelContext`.
+ *
+ *  @note Images must not be created from the context with `CGBitmapContextCreateImage`
+ *        after it is released, as they may share its memory: copy the pixels out instead.
+ */
+static CGContextRef OHCreatePooledPixelContext(size_t width, size_t height, OHVectorImagePixelFormat format)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        [[NSNotificationCenter defaultCenter] addObserverForName:UIApplicationDidReceiveMemoryWarningNotification
+                                                          object:nil queue:nil
+                                                      usingBlock:^(NSNotification* note) { OHBitmapPoolTrim(); }];
+    });
+    
+    size_t bytesPerPixel = (format == OHVectorImagePixelFormatA8) ? 1 : (format == OHVectorImagePixelFormatRGB555) ? 2 : 4;
+    size_t bytesPerRow = (width * bytesPerPixel + 15) & ~(size_t)15;
+    void* data = OHBitmapPoolAcquire(bytesPerRow * height, 1);
+    if (!data) return NULL;
+    CGContextRef ctx = OHCreatePixelContextWithData(data, width, height, bytesPerRow, format);
+    if (!ctx) OHBitmapPoolRelease(data, 0, 0);
+    return ctx;
+}
+
+/**
+ *  Releases a context created by `OHCreatePooledPixelContext` and returns its buffer to the pool.
+ *
+ *  @param dirtyRect The rect in pixels (with the origin at the top left) that was drawn into,
+ *                   which is cleared when the buffer is reused. `CGRectNull` for the whole buffer.
+ */
+static void OHReleasePooledPixelContext(CGContextRef ctx, CGRect dirtyRect)
+{
+    if (!ctx) return;
+    void* data = CGBitmapContextGetData(ctx);
+    size_t bytesPerRow = CGBitmapContextGetBytesPerRow(ctx);
+    size_t height = CGBitmapContextGetHeight(ctx);
+    size_t firstRow = 0, rowCount = height;
+    if (!CGRectIsNull(dirtyRect))
+    {
+        dirtyRect = CGRectIntersection(CGRectIntegral(dirtyRect), CGRectMake(0, 0, CGBitmapContextGetWidth(ctx), height));
+        firstRow = CGRectIsEmpty(dirtyRect) ? 0 : (size_t)dirtyRect.origin.y;
+        rowCount = CGRectIsEmpty(dirtyRect) ? 0 : (size_t)dirtyRect.size.height;
+    }
+    CGContextRelease(ctx);
+    OHBitmapPoolRelease(data, firstRow * bytesPerRow, rowCount * bytesPerRow);
+}
+
+/**
+ *  The rect of a pixel pass that was written to: the ink and its shadow, or the whole buffer with a background.
+ */
+static CGRect OHPixelDirtyRect(CGRect inkRect, CGRect shadowRect, BOOL hasBackground)
+{
+    if (hasBackground) return CGRectNull;
+    if (CGRectIsEmpty(inkRect)) return CGRectIsEmpty(shadowRect) ? CGRectZero : shadowRect;
+    return CGRectIsEmpty(shadowRect) ? inkRect : CGRectUnion(inkRect, shadowRect);
+}
+
+/**
+ *  Converts an image to another pixel format, by drawing it in a bitmap context of that format.
+ *  Only the alpha is kept for A8, and the image is composited over black for RGB555.
+ */
+static CGImageRef OHCreateImageInPixelFormat(CGImageRef image, OHVectorImagePixelFormat format)
+{
+    size_t width = CGImageGetWidth(image), height = CGImageGetHeight(image);
+    CGContextRef ctx = OHCreatePixelContext(width, height, format);
+    if (!ctx) return NULL;
+    CGContextDrawImage(ctx, CGRectMake(0, 0, width, height), image);
+    CGImageRef convertedImage = CGBitmapContextCreateImage(ctx);
+    CGContextRelease(ctx);
+    return convertedImage;
+}
+
+static OHPixelBuffer OHPixelBufferForContext(CGContextRef ctx)
+{
+    return (OHPixelBuffer){
+        .data = CGBitmapContextGetData(ctx),
+        .width = CGBitmapContextGetWidth(ctx),
+        .height = CGBitmapContextGetHeight(ctx),
+        .bytesPerRow = CGBitmapContextGetBytesPerRow(ctx)
+    };
+}
+
+/**
+ *  Returns the coverage layer of the PDF at the given size: the pixels of the PDF
+ *  rasterized with its original colors (before any tint, recoloring, shadow or
+ *  background) inside `inkRect`, with packed rows.
+ *
+ *  Coverage layers only depend on the geometry (page, size, insets and trimming),
+ *  so they are cached and every style of the same geometry is composited from the
+ *  same layer, without rasterizing the PDF again.
+ *
+ *  @return The coverage layer, or `nil` if the geometry can't be identified or the
+ *          layer is too large to be cached (in which case the PDF should be drawn directly).
+ */
+- (NSData*)coverageLayerForSize:(CGSize)imageSize insets:(UIEdgeInsets)scaledInsets inkRect:(CGRect)inkRect
+{
+    static NSCache* coverageLayerCache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        coverageLayerCache = [NSCache new];
+        coverageLayerCache.totalCostLimit = kCoverageLayerCacheCostLimit;
+    });
+    
+    // A layer that doesn't fit in the cache would be rasterized, then copied, again on every call
+    size_t width = (size_t)inkRect.size.width, height = (size_t)inkRect.size.height;
+    if (width * height * 4 > kCoverageLayerCacheCostLimit) return nil;
+    NSString* key = [self geometryCacheKeyForSize:imageSize];
+    if (!key) return nil;
+    NSData* layer = [coverageLayerCache objectForKey:key];
+    if (layer.length == width * height * 4) return layer;
+    
+    // Rasterize only the ink rect (the CoreGraphics origin is at the bottom left of the full rendering)
+    CGFloat screenScale = self.effectiveScreenScale;
+    CGFloat fullHeight = ceil(imageSize.height * screenScale);
+    CGContextRef ctx = OHCreatePooledPixelContext(width, height, OHVectorImagePixelFormatRGBA8888);
+    if (!ctx) return nil;
+    CGContextTranslateCTM(ctx, -inkRect.origin.x, -(fullHeight - CGRectGetMaxY(inkRect)));
+    CGContextScaleCTM(ctx, screenScale, screenScale);
+    [self drawPDFInPixelContext:ctx imageSize:imageSize insets:scaledInsets];
+    
+    OHPixelBuffer buffer = OHPixelBufferForContext(ctx);
+    NSMutableData* pixels = [NSMutableData dataWithLength:width * height * 4];
+    for (size_t y = 0; y < height; ++y)
+    {
+        memcpy((uint8_t*)pixels.mutableBytes + y * width * 4, buffer.data + y * buffer.bytesPerRow, width * 4);
+    }
+    OHReleasePooledPixelContext(ctx, CGRectNull);
+    [coverageLayerCache setObject:pixels forKey:key cost:pixels.length];
+    return pixels;
+}
+
+/**
+ *  Renders the PDF in a bitmap context we own, then applies the tint, shadow and
+ *  background directly on its pixels using the pixel kernels.
+ *
+ *  RGBA passes copy the cached coverage layer of the PDF instead of drawing it, so
+ *  that changing only the colors (tint, `recolorMap`, background, shadow color) does
+ *  not rasterize the PDF again (see `coverageLayerForSize:insets:inkRect:`).
+ *
+ *  A8 images are rendered directly in an alpha-only context. RGB555 images are rendered
+ *  directly in a 16-bit context when there is no tint nor shadow (which need the alpha
+ *  of the PDF), and converted from RGBA otherwise.
+ *
+ *  @return The rendered image, or `nil` if the colors can't be expressed as RGBA
+ *          (e.g. pattern colors), in which case Quartz should be used instead.
+ */
+- (UIImage*)renderWithPixelKernelsAtSize:(CGSize)imageSize scale:(CGSize)scale insets:(UIEdgeInsets)scaledInsets
+{
+    OHPixelColors colors;
+    if (![self getPixelColors:&colors]) return nil;
+    
+    OHVectorImagePixelFormat format = self.pixelFormat;
+    BOOL alphaOnly = (format == OHVectorImagePixelFormatA8);
+    if (alphaOnly)
+    {
+        // The tint is applied at draw time, and a background would only make the mask opaque
+        colors.hasTint = colors.hasBackground = NO;
+        colors.recolorTable = NULL;
+    }
+    BOOL drawsOpaque = (format == OHVectorImagePixelFormatRGB555) && !colors.hasTint && !colors.recolorTable && !colors.hasShadow;
+    OHVectorImagePixelFormat contextFormat = (alphaOnly || drawsOpaque) ? format : OHVectorImagePixelFormatRGBA8888;
+    
+    CGFloat screenScale = self.effectiveScreenScale;
+    size_t width  = (size_t)ceil(imageSize.width * screenScale);
+    size_t height = (size_t)ceil(imageSize.height * screenScale);
+    // RGBA passes are copied out of the context, so their buffers can come from the pool
+    BOOL isPooled = (contextFormat == OHVectorImagePixelFormatRGBA8888);
+    CGContextRef ctx = isPooled ? OHCreatePooledPixelContext(width, height, contextFormat)
+                                : OHCreatePixelContext(width, height, contextFormat);
+    if (!ctx) return nil;
+    
+    if (drawsOpaque && colors.hasBackground)
+    {
+        // Opaque contexts start black, so the background is composited over black
+        CGContextSetFillColorWithColor(ctx, self.backgroundColor.CGColor);
+        CGContextFillRect(ctx, CGRectMake(0, 0, width, height));
+        colors.hasBackground = NO;
+    }
+    
+    // Only the part of the image where the PDF paints needs to be drawn, tinted and blurred
+    CGRect inkRect = [self inkPixelRectForImageSize:imageSize insets:scaledInsets];
+    if (CGRectIsNull(inkRect)) inkRect = CGRectMake(0, 0, width, height);
+    OHPixelBuffer buffer = OHPixelBufferForContext(ctx);
+    NSData* coverageLayer = (isPooled && !CGRectIsEmpty(inkRect))
+                          ? [self coverageLayerForSize:imageSize insets:scaledInsets inkRect:inkRect] : nil;
+    if (coverageLayer)
+    {
+        OHPixelBuffer region = OHPixelBufferRegion(buffer, inkRect, 4);
+        for (size_t y = 0; y < region.height; ++y)
+        {
+            memcpy(region.data + y * region.bytesPerRow, (const uint8_t*)coverageLayer.bytes + y * region.width * 4, region.width * 4);
+        }
+    }
+    else if (!CGRectIsEmpty(inkRect))
+    {
+        OHClipPixelContextToRect(ctx, inkRect);
+        CGContextScaleCTM(ctx, screenScale, screenScale);
+        [self drawPDFInPixelContext:ctx imageSize:imageSize insets:scaledInsets];
+    }
+    
+    NSData* shadowMask = nil;
+    if (colors.hasShadow)
+    {
+        shadowMask = [self shadowMaskForBuffer:buffer alphaOnly:alphaOnly size:imageSize
+                                        radius:[self shadowRadiusForScale:scale] inkRect:inkRect];
+        if (!shadowMask)
+        {
+            if (isPooled) OHReleasePooledPixelContext(ctx, CGRectNull); else CGContextRelease(ctx);
+            return nil;
+        }
+    }
+    CGRect shadowRect = shadowMask ? [self shadowPixelRectForInkRect:inkRect buffer:buffer scale:scale] : CGRectZero;
+    if (alphaOnly)
+    {
+        if (!CGRectIsEmpty(shadowRect))
+        {
+            OH_RENDER_STATS_BEGIN(compositeStart);
+            long offsetX = lround(self.shadow.shadowOffset.width  * scale.width);
+            long offsetY = lround(self.shadow.shadowOffset.height * scale.height);
+            OHPixelBuffer region = OHPixelBufferRegion(buffer, shadowRect, 1);
+            OHPixelAlphaShadowUnder(region.data, region.width, region.height, region.bytesPerRow,
+                                    (const uint8_t*)shadowMask.bytes
+                                        + (size_t)(shadowRect.origin.y - offsetY) * buffer.width
+                                        + (size_t)(shadowRect.origin.x - offsetX),
+                                    buffer.width, 0, 0, colors.shadow.a);
+            OH_RENDER_STATS_END(OHRenderStageComposite, compositeStart);
+        }
+    }
+    else if (!drawsOpaque)
+    {
+        [self applyPixelColors:colors toBuffer:buffer shadowMask:shadowMask.bytes scale:scale inkRect:inkRect];
+    }
+    OHRenderStatsRecordRender(width * height, buffer.bytesPerRow * height + (colors.hasShadow ? width * height : 0));
+    
+    CGImageRef cgImage = NULL;
+    if (!isPooled)
+    {
+        cgImage = CGBitmapContextCreateImage(ctx);
+        CGContextRelease(ctx);
+    }
+    else
+    {
+        if (format == OHVectorImagePixelFormatRGBA8888)
+        {
+            cgImage = OHCreateImageWithPixelBuffer(buffer);
+        }
+        else
+        {
+            // The converted image is drawn in a new context, so the temporary image can share the buffer
+            CGImageRef rgbaImage = CGBitmapContextCreateImage(ctx);
+            cgImage = rgbaImage ? OHCreateImageInPixelFormat(rgbaImage, format) : NULL;
+            CGImageRelease(rgbaImage);
+        }
+        OHReleasePooledPixelContext(ctx, OHPixelDirtyRect(inkRect, shadowRect, colors.hasBackground));
+    }
+    if (!cgImage) return nil;
+    UIImage* image = [UIImage imageWithCGImage:cgImage scale:screenScale orientation:UIImageOrientationUp];
+    CGImageRelease(cgImage);
+    
+    return image;
+}
+
+/**
+ *  Creates an image backed by tightly packed premultiplied RGBA pixels, without copying them.
+ */
+static CGImageRef OHCreateImageWithData(CFDataRef pixels, size_t width, size_t height)
+{
+    CGDataProviderRef provider = CGDataProviderCreateWithCFData(pixels);
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGImageRef image = CGImageCreate(width, height, 8, 32, width * 4, colorSpace,
+                                     (CGBitmapInfo)kCGImageAlphaPremultipliedLast | kCGBitmapByteOrder32Big,
+                                     provider, NULL, false, kCGRenderingIntentDefault);
+    CGColorSpaceRelease(colorSpace);
+    CGDataProviderRelease(provider);
+    return image;
+}
+
+static CGImageRef OHCreateImageWithPixelBuffer(OHPixelBuffer buffer)
+{
+    // Copies the pixels, as the buffer is only valid until the tile is released
+    CFMutableDataRef pixels = CFDataCreateMutable(NULL, (CFIndex)(buffer.width * buffer.height * 4));
+    if (!pixels) return NULL;
+    for (size_t y = 0; y < buffer.height; ++y)
+    {
+        CFDataAppendBytes(pixels, buffer.data + y * buffer.bytesPerRow, (CFIndex)(buffer.width * 4));
+    }
+    CGImageRef image = OHCreateImageWithData(pixels, buffer.width, buffer.height);
+    CFRelease(pixels);
+    return image;
+}
+
+/**
+ *  Renders a tile of the image that `renderAtSize:` would render, using the pixel kernels.
+ *
+ *  The tile is rendered with a margin large enough for the shadow cast by the
+ *  content around the tile, so that tiles join seamlessly.
+ *
+ *  @param size      The size of the whole image, in points
+ *  @param pixelRect The rect of the tile, in pixels, origin at the top left
+ *  @param sink      The block called with the pixels of the tile (only valid during
+ *                   the call) and its actual rect (clipped to the image bounds)
+ *
+ *  @return YES if the tile was rendered and the sink returned YES.
+ */
+- (BOOL)renderTileAtSize:(CGSize)size pixelRect:(CGRect)pixelRect sink:(BOOL(^)(OHPixelBuffer tile, CGRect tileRect))sink
+{
+    OHPixelColors colors;
+    if (self.prepareContextBlock || ![self getPixelColors:&colors]) return NO;
+    if ((size.width <= 0) || (size.height <= 0)) return NO;
+    
+    CGSize imageSize = CGRectIntegral( (CGRect){ .origin = CGPointZero, .size = size } ).size;
+    CGSize scale = [self scaleForSize:size];
+    UIEdgeInsets scaledInsets = (UIEdgeInsets){
+        .top    = self.insets.top    * scale.height,
+        .left   = self.insets.left   * scale.width,
+        .bottom = self.insets.bottom * scale.height,
+        .right  = self.insets.right  * scale.width
+    };
+    CGFloat screenScale = self.effectiveScreenScale;
+    CGSize pixelSize = [self pixelSizeForSize:size];
+    CGRect imageRect = (CGRect){ .origin = CGPointZero, .size = pixelSize };
+    
+    CGRect tileRect = CGRectIntersection(CGRectIntegral(pixelRect), imageRect);
+    if (CGRectIsEmpty(tileRect)) return NO;
+    
+    // The shadow at a pixel depends on the content up to the blur extent (plus the offset) away
+    CGFloat radius = [self shadowRadiusForScale:scale];
+    CGFloat margin = 0;
+    if (colors.hasShadow)
+    {
+        margin = OHShadowBlurExtent(radius)
+               + MAX(fabs(round(self.shadow.shadowOffset.width  * scale.width)),
+                     fabs(round(self.shadow.shadowOffset.height * scale.height)));
+    }
+    CGRect renderRect = CGRectIntersection(CGRectInset(tileRect, -margin, -margin), imageRect);
+    
+    CGContextRef ctx = OHCreatePooledPixelContext((size_t)renderRect.size.width, (size_t)renderRect.size.height,
+                                                  OHVectorImagePixelFormatRGBA8888);
+    if (!ctx) return NO;
+    
+    // The part of the rendered rect where the PDF paints, in the coordinates of the context
+    CGRect inkRect = [self inkPixelRectForImageSize:imageSize insets:scaledInsets];
+    if (CGRectIsNull(inkRect)) inkRect = imageRect;
+    inkRect = CGRectIntersection(inkRect, renderRect);
+    inkRect = CGRectIsNull(inkRect) ? CGRectZero : CGRectOffset(inkRect, -renderRect.origin.x, -renderRect.origin.y);
+    if (!CGRectIsEmpty(inkRect))
+    {
+        OHClipPixelContextToRect(ctx, inkRect);
+        // Move the part of the full rendering covered by renderRect into the context
+        // (the CoreGraphics origin is at the bottom left of the full rendering)
+        CGContextTranslateCTM(ctx, -renderRect.origin.x, -(pixelSize.height - CGRectGetMaxY(renderRect)));
+        CGContextScaleCTM(ctx, screenScale, screenScale);
+        [self drawPDFInPixelContext:ctx imageSize:imageSize insets:scaledInsets];
+    }
+    OHPixelBuffer buffer = OHPixelBufferForContext(ctx);
+    
+    uint8_t* shadowMask = NULL;
+    CGRect maskDirtyRect = CGRectZero, shadowRect = CGRectZero;
+    if (colors.hasShadow)
+    {
+        OH_RENDER_STATS_BEGIN(maskStart);
+        shadowMask = OHBitmapPoolAcquire(buffer.width * buffer.height, 1);
+        CGRect maskRect = OHShadowMaskRect(inkRect, radius, CGSizeMake(buffer.width, buffer.height));
+        if (!shadowMask || OHShadowMaskRender(buffer, NO, maskRect, radius, shadowMask) != 0)
+        {
+            OHBitmapPoolRelease(shadowMask, 0, buffer.width * buffer.height);
+            OHReleasePooledPixelContext(ctx, CGRectNull);
+            return NO;
+        }
+        OH_RENDER_STATS_END(OHRenderStageMask, maskStart);
+        maskDirtyRect = maskRect;
+        shadowRect = [self shadowPixelRectForInkRect:inkRect buffer:buffer scale:scale];
+    }
+    [self applyPixelColors:colors toBuffer:buffer shadowMask:shadowMask scale:scale inkRect:inkRect];
+    if (shadowMask)
+    {
+        OHBitmapPoolRelease(shadowMask, (size_t)maskDirtyRect.origin.y * buffer.width,
+                            CGRectIsEmpty(maskDirtyRect) ? 0 : (size_t)maskDirtyRect.size.height * buffer.width);
+    }
+    OHRenderStatsRecordRender(buffer.width * buffer.height,
+                              buffer.bytesPerRow * buffer.height + (colors.hasShadow ? buffer.width * buffer.height : 0));
+    
+    size_t offsetX = (size_t)(tileRect.origin.x - renderRect.origin.x);
+    size_t offsetY = (size_t)(tileRect.origin.y - renderRect.origin.y);
+    OHPixelBuffer tile = {
+        .data = buffer.data + offsetY * buffer.bytesPerRow + offsetX * 4,
+        .width = (size_t)tileRect.size.width,
+        .height = (size_t)tileRect.size.height,
+        .bytesPerRow = buffer.bytesPerRow
+    };
+    BOOL success = sink(tile, tileRect);
+    OHReleasePooledPixelContext(ctx, OHPixelDirtyRect(inkRect, shadowRect, colors.hasBackground));
+    return success;
+}
+
+/**
+ *  Renders all the tiles of the image concurrently, each one through `renderTileAtSize:pixelRect:sink:`.
+ *  `dispatch_apply` balances the tiles over the worker threads, and a semaphore bounds the number
+ *  of tiles in memory at the same time.
+ */
+- (BOOL)enumerateTilesAtSize:(CGSize)size
+                    tileSize:(CGSize)tileSize
+          maxConcurrentTiles:(NSUInteger)maxConcurrentTiles
+                  usingBlock:(BOOL(^)(OHPixelBuffer tile, CGRect tileRect))block
+{
+    CGSize pixelSize = [self pixelSizeForSize:size];
+    tileSize = CGSizeMake(ceil(tileSize.width), ceil(tileSize.height));
+    if (tileSize.width < 1 || tileSize.height < 1 || pixelSize.width < 1 || pixelSize.height < 1) return NO;
+    
+    size_t columns = (size_t)ceil(pixelSize.width / tileSize.width);
+    size_t rows = (size_t)ceil(pixelSize.height / tileSize.height);
+    if (maxConcurrentTiles == 0) maxConcurrentTiles = [NSProcessInfo processInfo].activeProcessorCount;
+    
+    dispatch_semaphore_t slots = dispatch_semaphore_create((long)maxConcurrentTiles);
+    __block volatile int32_t failed = 0;
+    dispatch_apply(columns * rows, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+        if (failed) return;
+        CGRect tileRect = (CGRect){
+            .origin = CGPointMake((index % columns) * tileSize.width, (index / columns) * tileSize.height),
+            .size = tileSize
+        };
+        dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+        @autoreleasepool {
+            if (![self renderTileAtSize:size pixelRect:tileRect sink:block]) failed = 1;
+        }
+        dispatch_semaphore_signal(slots);
+    });
+#if !OS_OBJECT_USE_OBJC
+    dispatch_release(slots);
+#endif
+    return !failed;
+}
+
+/**
+ *  Returns the size of the mipmap bucket from which to derive the rendering at
+ *  the given (integral) size, or `CGSizeZero` if no bucket is within `mipmapMaxDownsamplingRatio`.
+ */
+- (CGSize)mipmapBucketSizeForSize:(CGSize)imageSize
+{
+    CGFloat requested[2] = { imageSize.width, imageSize.height };
+    CGFloat bucket[2] = { 0, 0 };
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        if (self.mipmapBucketSizes)
+        {
+            for (NSNumber* candidate in self.mipmapBucketSizes)
+            {
+                CGFloat bucketSize = ceil(candidate.doubleValue);
+                if (bucketSize >= requested[axis] && (bucket[axis] == 0 || bucketSize < bucket[axis]))
+                {
+                    bucket[axis] = bucketSize;
+                }
+            }
+        }
+        else
+        {
+            bucket[axis] = exp2(ceil(log2(requested[axis])));
+        }
+        if (bucket[axis] == 0 || bucket[axis] > requested[axis] * self.mipmapMaxDownsamplingRatio) return CGSizeZero;
+    }
+    return CGSizeMake(bucket[0], bucket[1]);
+}
+
+/**
+ *  Returns the size of the mipmap bucket from which `renderAtSize:` derives the rendering
+ *  at the given (integral) size, or `CGSizeZero` if it rasterizes it at that size instead.
+ */
+- (CGSize)mipmapBucketSizeForRenderingAtSize:(CGSize)imageSize
+{
+    if (!self.usesMipmaps || self.prepareContextBlock) return CGSizeZero;
+    if (self.pixelFormat != OHVectorImagePixelFormatRGBA8888) return CGSizeZero;
+    CGSize bucketSize = [self mipmapBucketSizeForSize:imageSize];
+    if (CGSizeEqualToSize(bucketSize, CGSizeZero)) return CGSizeZero;
+    
+    // A mipmap that doesn't fit in the mipmap cache would be rasterized again on every call
+    CGSize bucketPixelSize = [self pixelSizeForSize:bucketSize];
+    if (bucketPixelSize.width * bucketPixelSize.height * 4 > kMipmapCacheCostLimit) return CGSizeZero;
+    return bucketSize;
+}
+
+/**
+ *  Returns the tightly packed RGBA pixels of the receiver rendered at a bucket size,
+ *  rendering them with the pixel kernels if they are not in the mipmap cache yet.
+ *
+ *  @param key The render descriptor of the bucket size, under which the mipmap is cached
+ */
+- (NSData*)mipmapForBucketSize:(CGSize)bucketSize key:(NSString*)key
+{
+    static NSCache* mipmapCache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        mipmapCache = [NSCache new];
+        mipmapCache.totalCostLimit = kMipmapCacheCostLimit;
+    });
+    
+    NSData* mipmap = [mipmapCache objectForKey:key];
+    if (mipmap) return mipmap;
+    
+    __block NSMutableData* pixels = nil;
+    CGSize pixelSize = [self pixelSizeForSize:bucketSize];
+    [self renderTileAtSize:bucketSize pixelRect:(CGRect){ .origin = CGPointZero, .size = pixelSize }
+                      sink:^(OHPixelBuffer tile, CGRect tileRect)
+    {
+        pixels = [NSMutableData dataWithLength:tile.width * tile.height * 4];
+        for (size_t y = 0; y < tile.height; ++y)
+        {
+            memcpy((uint8_t*)pixels.mutableBytes + y * tile.width * 4, tile.data + y * tile.bytesPerRow, tile.width * 4);
+        }
+        return YES;
     }];
+    if (pixels) [mipmapCache setObject:pixels forKey:key cost:pixels.length];
+    return pixels;
+}
+
+/**
+ *  Derives the rendering at the given (integral) size from the mipmap of the nearest
+ *  larger bucket, or returns `nil` if it has to be rasterized at that size instead.
+ */
+- (UIImage*)renderFromMipmapAtSize:(CGSize)imageSize
+{
+    CGSize bucketSize = [self mipmapBucketSizeForRenderingAtSize:imageSize];
+    if (CGSizeEqualToSize(bucketSize, CGSizeZero)) return nil;
+    
+    CGSize bucketPixelSize = [self pixelSizeForSize:bucketSize];
+    NSString* key = [self renderDescriptorForSize:bucketSize];
+    NSData* mipmap = key ? [self mipmapForBucketSize:bucketSize key:key] : nil;
+    if (!mipmap) return nil;
     
-    // Render the final image using prepareContextBlock, backgroundColor and shadow
-    return [self generateImageWithSize:imageSize drawingBlock:^(CGContextRef ctx) {
+    OH_RENDER_STATS_BEGIN(downsampleStart);
+    CGSize pixelSize = [self pixelSizeForSize:imageSize];
+    OHPixelBuffer source = {
+        .data = (uint8_t*)mipmap.bytes,
+        .width = (size_t)bucketPixelSize.width,
+        .height = (size_t)bucketPixelSize.height,
+        .bytesPerRow = (size_t)bucketPixelSize.width * 4
+    };
+    OHPixelBuffer destination = {
+        .width = (size_t)pixelSize.width,
+        .height = (size_t)pixelSize.height,
+        .bytesPerRow = (size_t)pixelSize.width * 4
+    };
+    CFMutableDataRef pixels = CFDataCreateMutable(NULL, (CFIndex)(destination.bytesPerRow * destination.height));
+    if (!pixels) return nil;
+    CFDataSetLength(pixels, (CFIndex)(destination.bytesPerRow * destination.height));
+    destination.data = CFDataGetMutableBytePtr(pixels);
+    CGImageRef cgImage = NULL;
+    if (OHPixelDownsample(source, destination) == 0)
+    {
+        cgImage = OHCreateImageWithData(pixels, destination.width, destination.height);
+    }
+    CFRelease(pixels);
+    if (!cgImage) return nil;
+    OH_RENDER_STATS_END(OHRenderStageDownsample, downsampleStart);
+    OHRenderStatsRecordRender(destination.width * destination.height, destination.bytesPerRow * destination.height);
+    
+    UIImage* image = [UIImage imageWithCGImage:cgImage scale:self.effectiveScreenScale orientation:UIImageOrientationUp];
+    CGImageRelease(cgImage);
+    return image;
+}
+
+/**
+ *  Renders everything in a single UIKit bitmap context, applying the tint, shadow and
+ *  background in place using blend modes instead of using intermediate images.
+ *  Only the `recolorMap`, which has no blend mode equivalent, needs an intermediate image.
+ */
+- (UIImage*)renderWithQuartzAtSize:(CGSize)imageSize scale:(CGSize)scale insets:(UIEdgeInsets)scaledInsets
+{
+    CGRect fullRect = (CGRect){ .origin = CGPointZero, .size = imageSize };
+    // A8 masks are tinted at draw time, and have no background
+    BOOL alphaOnly = (self.pixelFormat == OHVectorImagePixelFormatA8);
+    UIColor* tintColor = alphaOnly ? nil : self.tintColor;
+    UIColor* backgroundColor = alphaOnly ? nil : self.backgroundColor;
+    NSData* recolorTable = (alphaOnly || tintColor || self.recolorMap.count == 0) ? nil : self.recolorLookupTable;
+    // The tint recolors everything in its layer: draw the PDF in its own transparency layer if the
+    // prepareContextBlock may already have drawn in the context, so that only the PDF is tinted
+    BOOL drawsInLayer = self.shadow || (tintColor && self.prepareContextBlock);
+    OH_RENDER_STATS_BEGIN(rasterStart);
+    UIImage* image = [self generateImageWithSize:imageSize drawingBlock:^(CGContextRef ctx) {
         // If the user provided a block to execute before rendering, apply it now
         if (self.prepareContextBlock) self.prepareContextBlock(ctx);
         
-        // If we have a background color, fill the image with it
-        if (self.backgroundColor != nil)
-        {
-            CGContextSetFillColorWithColor(ctx, self.backgroundColor.CGColor);
-            // Add 1 to width and height to fill everything, even the bottom and right borders
-            CGRect rect = CGRectMake(0.0f, 0.0f, size.width+1, size.height+1);
-            CGContextFillRect(ctx, rect);
-        }
+        CGContextSaveGState(ctx);
         
-        // If we have a shadow, apply it now
+        // If we have a shadow, apply it now. The PDF is then drawn (and tinted) in a
+        // transparency layer, so that the shadow is cast by the composited layer as
+        // a whole, and the shadow itself is not tinted.
         if (self.shadow)
         {
             UIColor* shadowColor = (UIColor*)self.shadow.shadowColor;
@@ -217,26 +1306,279 @@
             CGFloat radius = self.shadow.shadowBlurRadius * (scale.width+scale.height)/2;
             CGContextSetShadowWithColor(ctx, offset, radius, shadowColor.CGColor);
         }
+        if (drawsInLayer)
+        {
+            CGContextBeginTransparencyLayer(ctx, NULL);
+        }
+        
+        // - flipped=YES because the context is in the UIKit coordinate system,
+        //   which is inverted compared to the CoreGraphics coordinate system.
+        CGRect insetRect = CGRectIntegral( UIEdgeInsetsInsetRect(fullRect, scaledInsets) );
+        if (recolorTable)
+        {
+            [self drawPDFInContext:ctx imageSize:imageSize insets:scaledInsets recolorTable:recolorTable.bytes];
+        }
+        else
+        {
+            [self.pdfPage drawInContext:ctx rect:[self pageRectForInsetRect:insetRect flipped:YES] flipped:YES];
+        }
         
-        // Finally, draw the rastered image
-        CGContextDrawImage(ctx, fullRect, rasterImage.CGImage);
+        if (tintColor)
+        {
+            // Recolor what has been drawn, keeping only its alpha
+            CGContextSetBlendMode(ctx, kCGBlendModeSourceIn);
+            CGContextSetFillColorWithColor(ctx, tintColor.CGColor);
+            CGContextFillRect(ctx, fullRect);
+        }
+        
+        if (drawsInLayer)
+        {
+            CGContextEndTransparencyLayer(ctx);
+        }
+        
+        CGContextRestoreGState(ctx);
+        
+        // If we have a background color, fill the image with it, behind what has been drawn
+        if (backgroundColor != nil)
+        {
+            CGContextSetBlendMode(ctx, kCGBlendModeDestinationOver);
+            CGContextSetFillColorWithColor(ctx, backgroundColor.CGColor);
+            // Add 1 to width and height to fill everything, even the bottom and right borders
+            CGRect rect = CGRectMake(0.0f, 0.0f, imageSize.width+1, imageSize.height+1);
+            CGContextFillRect(ctx, rect);
+        }
     }];
+    // Quartz applies the tint, shadow and background while drawing, so it's all one stage
+    OH_RENDER_STATS_END(OHRenderStageRaster, rasterStart);
+    if (OHRenderStatsIsEnabled() && image)
+    {
+        uint64_t pixels = (uint64_t)(image.size.width * image.scale) * (uint64_t)(image.size.height * image.scale);
+        // A transparency layer is as large as the image, and so is the intermediate bitmap of recoloring
+        OHRenderStatsRecordRender(pixels, pixels * 4 * (1 + (drawsInLayer ? 1 : 0) + (recolorTable ? 1 : 0)));
+    }
+    
+    if (image && self.pixelFormat != OHVectorImagePixelFormatRGBA8888)
+    {
+        CGImageRef convertedImage = OHCreateImageInPixelFormat(image.CGImage, self.pixelFormat);
+        image = convertedImage ? [UIImage imageWithCGImage:convertedImage scale:image.scale orientation:UIImageOrientationUp] : nil;
+        CGImageRelease(convertedImage);
+    }
+    return image;
 }
 
-- (UIImage*)renderAtSizeThatFits:(CGSize)size
+/**
+ *  Draws the PDF recolored through the lookup table of the `recolorMap` in a context
+ *  of `renderWithQuartzAtSize:scale:insets:` (in points, in the UIKit coordinate system).
+ *  Quartz can't apply the table, so the PDF is drawn in a bitmap of the full rendering,
+ *  recolored by the pixel kernel, and that bitmap is drawn in the context instead.
+ */
+- (void)drawPDFInContext:(CGContextRef)ctx
+               imageSize:(CGSize)imageSize
+                  insets:(UIEdgeInsets)scaledInsets
+            recolorTable:(const OHPixelColor*)recolorTable
 {
-    return [self renderAtSize:[self sizeThatFits:size]];
+    CGFloat screenScale = self.effectiveScreenScale;
+    size_t width  = (size_t)ceil(imageSize.width * screenScale);
+    size_t height = (size_t)ceil(imageSize.height * screenScale);
+    CGContextRef layerContext = OHCreatePixelContext(width, height, OHVectorImagePixelFormatRGBA8888);
+    if (!layerContext) return;
+    CGContextScaleCTM(layerContext, screenScale, screenScale);
+    [self.pdfPage drawInContext:layerContext
+                           rect:[self pageRectForInsetRect:[self pixelContextInsetRectForImageSize:imageSize insets:scaledInsets]
+                                                   flipped:NO]
+                        flipped:NO];
+    OHPixelRecolorWithLookupTable(OHPixelBufferForContext(layerContext), recolorTable);
+    CGImageRef layer = CGBitmapContextCreateImage(layerContext);
+    CGContextRelease(layerContext);
+    if (!layer) return;
+    
+    // Images are drawn in the CoreGraphics coordinate system, so flip the context back
+    CGContextSaveGState(ctx);
+    CGContextTranslateCTM(ctx, 0, height / screenScale);
+    CGContextScaleCTM(ctx, 1, -1);
+    CGContextDrawImage(ctx, CGRectMake(0, 0, width / screenScale, height / screenScale), layer);
+    CGContextRestoreGState(ctx);
+    CGImageRelease(layer);
 }
 
-#pragma mark - Private Methods
+/**
+ *  Returns the component of the cache keys describing a color, or `nil` if the color
+ *  can't be described by value (i.e. for pattern colors, whose only component is their alpha).
+ */
+static NSString* OHCacheKeyComponentForColor(UIColor* color)
+{
+    if (!color) return @"-";
+    
+    CGColorRef cgColor = color.CGColor;
+    CGColorSpaceModel model = CGColorSpaceGetModel(CGColorGetColorSpace(cgColor));
+    if (model == kCGColorSpaceModelPattern) return nil;
+    
+    // The same components mean different colors in different color spaces (e.g. gray+alpha vs. RGB)
+    size_t count = CGColorGetNumberOfComponents(cgColor);
+    const CGFloat* components = CGColorGetComponents(cgColor);
+    NSMutableString* str = [NSMutableString stringWithFormat:@"%d:", (int)model];
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        [str appendFormat:@"%s%.4g", idx ? "," : "", components[idx]];
+    }
+    return str;
+}
+
+static NSString* OHCacheKeyComponentForPixelFormat(OHVectorImagePixelFormat format)
+{
+    switch (format)
+    {
+        case OHVectorImagePixelFormatA8:     return @"|a8";
+        case OHVectorImagePixelFormatRGB555: return @"|rgb555";
+        default:                             return @""; // Keeps the keys of RGBA renderings unchanged
+    }
+}
+
+/**
+ *  Returns the key describing the geometry of the receiver rendered at the given size
+ *  (PDF page, pixel size, insets and trimming), or `nil` if the PDF page can't be identified.
+ */
+- (NSString*)geometryCacheKeyForSize:(CGSize)size
+{
+    if (!self.sourceURL) return nil;
+    
+    // Pages loaded from a vector pack have no CGPDFPageRef, but a sourceURL per image
+    CGPDFPageRef pageRef = self.pdfPage.pageRef;
+    return [NSString stringWithFormat:@"%@#%zu|%gx%g@%g|%@%@",
+            self.sourceURL.absoluteString, pageRef ? CGPDFPageGetPageNumber(pageRef) : 1,
+            size.width, size.height, self.effectiveScreenScale,
+            NSStringFromUIEdgeInsets(self.insets), self.trimToContent ? @"|trim" : @""];
+}
+
+/**
+ *  Returns the key describing the rendering of the receiver at the given size
+ *  with its current properties, or `nil` if the rendering can't be described
+ *  (i.e. if the PDF page can't be identified, a `prepareContextBlock` is used,
+ *  or one of the colors is a pattern).
+ *
+ *  @note This is also used by `OHRenderQueue` to coalesce identical requests.
+ */
+- (NSString*)renderDescriptorForSize:(CGSize)size
+{
+    if (self.prepareContextBlock) return nil;
+    CGSize imageSize = CGRectIntegral( (CGRect){ .origin = CGPointZero, .size = size } ).size;
+    NSString* geometryKey = [self geometryCacheKeyForSize:imageSize];
+    if (!geometryKey) return nil;
+    
+    NSString* shadowKey = @"-";
+    if (self.shadow)
+    {
+        NSString* shadowColorKey = OHCacheKeyComponentForColor((UIColor*)self.shadow.shadowColor);
+        if (!shadowColorKey) return nil;
+        shadowKey = [NSString stringWithFormat:@"%g,%g,%g,%@",
+                     self.shadow.shadowOffset.width, self.shadow.shadowOffset.height,
+                     self.shadow.shadowBlurRadius, shadowColorKey];
+    }
+    
+    // A8 masks don't depend on the tint and background, so one mask serves every tint color
+    BOOL alphaOnly = (self.pixelFormat == OHVectorImagePixelFormatA8);
+    NSString* tintKey = OHCacheKeyComponentForColor(alphaOnly ? nil : self.tintColor);
+    NSString* backgroundKey = OHCacheKeyComponentForColor(alphaOnly ? nil : self.backgroundColor);
+    if (!tintKey || !backgroundKey) return nil;
+    
+    NSString* recolorKey = @""; // Keeps the keys of renderings without recoloring unchanged
+    if (self.recolorMap.count > 0 && !self.tintColor && !alphaOnly)
+    {
+        NSMutableArray* pairs = [NSMutableArray arrayWithCapacity:self.recolorMap.count];
+        __block BOOL describable = YES;
+        [self.recolorMap enumerateKeysAndObjectsUsingBlock:^(UIColor* source, UIColor* target, BOOL* stop) {
+            NSString* sourceKey = OHCacheKeyComponentForColor(source);
+            NSString* targetKey = OHCacheKeyComponentForColor(target);
+            if (!sourceKey || !targetKey)
+            {
+                describable = NO;
+                *stop = YES;
+                return;
+            }
+            [pairs addObject:[NSString stringWithFormat:@"%@>%@", sourceKey, targetKey]];
+        }];
+        if (!describable) return nil;
+        [pairs sortUsingSelector:@selector(compare:)];
+        recolorKey = [@"|recolor:" stringByAppendingString:[pairs componentsJoinedByString:@";"]];
+    }
+    
+    // Renderings downsampled from a mipmap differ slightly from the ones rasterized at their size
+    NSString* mipmapKey = @""; // Keeps the keys of rasterized renderings unchanged
+    CGSize bucketSize = [self mipmapBucketSizeForRenderingAtSize:imageSize];
+    if (!CGSizeEqualToSize(bucketSize, CGSizeZero))
+    {
+        mipmapKey = [NSString stringWithFormat:@"|mipmap:%gx%g", bucketSize.width, bucketSize.height];
+    }
+    return [NSString stringWithFormat:@"%@|%@|%@|%@%@%@%@",
+            geometryKey, tintKey, backgroundKey,
+            shadowKey, recolorKey, OHCacheKeyComponentForPixelFormat(self.pixelFormat), mipmapKey];
+}
+
+/**
+ *  Returns the key under which to cache the rendering of the receiver at the given
+ *  size with its current properties, or `nil` if the rendering can't be cached.
+ */
+- (NSString*)renderCacheKeyForSize:(CGSize)size
+{
+    return self.renderCache ? [self renderDescriptorForSize:size] : nil;
+}
+
+/**
+ *  Returns the blurred shadow mask for the PDF drawn in `buffer`. Shadow masks only
+ *  depend on the geometry and the blur radius, so they are cached and reused when
+ *  only the colors (or the pixel format) change.
+ *
+ *  @param alphaOnly YES if `buffer` is an A8 buffer (one byte per pixel), NO if it is RGBA
+ *  @param inkRect   The rect of the buffer outside of which nothing was drawn
+ */
+- (NSData*)shadowMaskForBuffer:(OHPixelBuffer)buffer alphaOnly:(BOOL)alphaOnly
+                          size:(CGSize)imageSize radius:(CGFloat)radius inkRect:(CGRect)inkRect
+{
+    static NSCache* shadowMaskCache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        shadowMaskCache = [NSCache new];
+        shadowMaskCache.totalCostLimit = kShadowMaskCacheCostLimit;
+    });
+    
+    NSString* geometryKey = [self geometryCacheKeyForSize:imageSize];
+    NSString* key = geometryKey ? [geometryKey stringByAppendingFormat:@"|%g", radius] : nil;
+    NSData* mask = key ? [shadowMaskCache objectForKey:key] : nil;
+    if (!mask)
+    {
+        OH_RENDER_STATS_BEGIN(maskStart);
+        // The mask is zero away from the ink, so only the ink (and its blur) is extracted and blurred
+        NSMutableData* newMask = [NSMutableData dataWithLength:buffer.width * buffer.height];
+        CGRect maskRect = OHShadowMaskRect(inkRect, radius, CGSizeMake(buffer.width, buffer.height));
+        if (OHShadowMaskRender(buffer, alphaOnly, maskRect, radius, newMask.mutableBytes) != 0) return nil;
+        OH_RENDER_STATS_END(OHRenderStageMask, maskStart);
+        mask = newMask;
+        if (key) [shadowMaskCache setObject:mask forKey:key cost:mask.length];
+    }
+    return mask;
+}
 
 - (UIImage*)generateImageWithSize:(CGSize)size
                      drawingBlock:( void(^)(CGContextRef ctx) )drawingBlock
 {
-    UIGraphicsBeginImageContextWithOptions(size, NO, 0.0);
-    drawingBlock( UIGraphicsGetCurrentContext() );
-    UIImage* image = UIGraphicsGetImageFromCurrentImageContext();
-    UIGraphicsEndImageContext();
+    // Same as UIGraphicsBeginImageContextWithOptions, but drawing in a buffer of the bitmap pool
+    CGFloat screenScale = self.effectiveScreenScale;
+    size_t width  = (size_t)ceil(size.width * screenScale);
+    size_t height = (size_t)ceil(size.height * screenScale);
+    CGContextRef ctx = OHCreatePooledPixelContext(width, height, OHVectorImagePixelFormatRGBA8888);
+    if (!ctx) return nil;
+    CGContextTranslateCTM(ctx, 0, height);
+    CGContextScaleCTM(ctx, screenScale, -screenScale);
+    
+    UIGraphicsPushContext(ctx);
+    drawingBlock(ctx);
+    UIGraphicsPopContext();
+    
+    CGImageRef cgImage = OHCreateImageWithPixelBuffer(OHPixelBufferForContext(ctx));
+    OHReleasePooledPixelContext(ctx, CGRectNull);
+    if (!cgImage) return nil;
+    UIImage* image = [UIImage imageWithCGImage:cgImage scale:screenScale orientation:UIImageOrientationUp];
+    CGImageRelease(cgImage);
     
     return image;
 };
@@ -0,0 +1,106 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import <Foundation/Foundation.h>
+@class OHVectorImage;
+
+/***********************************************************************************/
+
+/**
+ *  A vector pack: the vector images of many PDF files, compiled ahead of time
+ *  into a single binary file (see `OHVectorPackFile.h`), so that they can be
+ *  loaded without parsing any PDF.
+ *
+ *  Packs are compiled at build time from a directory of PDFs using the
+ *  `Tools/VectorPackCompiler` command line tool, which runs on any platform.
+ *  At runtime, the pack file is memory-mapped: creating an image by name is a
+ *  hash table lookup followed by decoding its display list, and the images
+ *  that are not used are never read.
+ *
+ *  Images created from a pack behave like images created from their PDF, and
+ *  are always drawn using their display list (see `OHPDFDisplayList`).
+ *  This class is thread-safe.
+ */
+@interface OHVectorPack : NSObject
+
+/**
+ *  The URL of the pack file.
+ */
+@property(nonatomic, strong, readonly) NSURL* URL;
+/**
+ *  The number of vector images in the pack.
+ */
+@property(nonatomic, assign, readonly) NSUInteger count;
+/**
+ *  The names of the vector images in the pack (the names of their PDF files,
+ *  without extension), in the order they were compiled.
+ */
+@property(nonatomic, readonly) NSArray* names;
+
+#pragma mark - Constructor
+
+/**
+ *  Load a vector pack from your bundle.
+ *
+ *  @param packName    The name of the pack file. If it has no extension,
+ *                     the "ohvp" extension is used.
+ *  @param bundleOrNil The bundle in which to search the file. If `nil`,
+ *                     will use the main bundle.
+ *
+ *  @return The vector pack, or `nil` if the file does not exist or is not a valid pack.
+ */
++ (instancetype)packNamed:(NSString*)packName inBundle:(NSBundle*)bundleOrNil;
+
+/**
+ *  Load a vector pack from a file URL, by memory-mapping it.
+ *
+ *  @param url The URL of the pack file
+ *
+ *  @return The vector pack, or `nil` if the file can't be mapped or is not a valid pack.
+ */
++ (instancetype)packWithURL:(NSURL*)url;
+
+#pragma mark - Getting images
+
+/**
+ *  Returns YES if the pack contains a vector image with the given name.
+ */
+- (BOOL)containsImageNamed:(NSString*)name;
+
+/**
+ *  Create a new vector image from the pack.
+ *
+ *  The decoded pages are cached by the pack, so creating the same image
+ *  again only costs the lookup. Each call returns a new `OHVectorImage`
+ *  that can be customized independently.
+ *
+ *  @param name The name of the vector image (the name of its PDF file, without extension)
+ *
+ *  @return The vector image, or `nil` if the pack has no image with this name
+ *          or if its entry is corrupted.
+ */
+- (OHVectorImage*)imageNamed:(NSString*)name;
+
+@end
@@ -0,0 +1,161 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#import "OHVectorPack.h"
+#import "OHVectorPackFile.h"
+#import "OHVectorImage.h"
+#import "OHPDFPage.h"
+#import "OHPDFDisplayList.h"
+#import "OHRenderStats.h"
+
+/***********************************************************************************/
+
+static NSUInteger const kDefaultPageCacheCostLimit = 4 * 1024 * 1024;
+
+@interface OHVectorImage (OHVectorPackPrivate)
+- (void)setSourceURL:(NSURL*)sourceURL;
+@end
+
+static CGRect OHRectFromBox(const float box[4])
+{
+    return CGRectMake(box[0], box[1], box[2], box[3]);
+}
+
+/***********************************************************************************/
+
+@interface OHVectorPack()
+- (instancetype)initWithURL:(NSURL*)url packFile:(OHVectorPackFile*)packFile NS_DESIGNATED_INITIALIZER;
+@property(nonatomic, strong) NSCache* pages;
+@end
+
+@implementation OHVectorPack
+{
+    OHVectorPackFile* _packFile;
+}
+
+#pragma mark - Constructor
+
++ (instancetype)packNamed:(NSString*)packName inBundle:(NSBundle*)bundleOrNil
+{
+    if (!packName) return nil;
+    
+    NSString* basename = [packName stringByDeletingPathExtension];
+    NSString* ext = [packName pathExtension];
+    if (ext.length == 0) ext = @"ohvp";
+    return [self packWithURL:[(bundleOrNil?:[NSBundle mainBundle]) URLForResource:basename withExtension:ext]];
+}
+
++ (instancetype)packWithURL:(NSURL*)url
+{
+    if (!url.isFileURL) return nil;
+    
+    OH_RENDER_STATS_BEGIN(loadStart);
+    OHVectorPackFile* packFile = OHVectorPackFileOpen(url.fileSystemRepresentation);
+    OH_RENDER_STATS_END(OHRenderStageLoad, loadStart);
+    if (!packFile) return nil;
+    
+    return [[self alloc] initWithURL:url packFile:packFile];
+}
+
+- (instancetype)initWithURL:(NSURL*)url packFile:(OHVectorPackFile*)packFile
+{
+    self = [super init];
+    if (self)
+    {
+        _URL = url;
+        _packFile = packFile;
+        _pages = [NSCache new];
+        _pages.totalCostLimit = kDefaultPageCacheCostLimit;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    OHVectorPackFileClose(_packFile);
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)count
+{
+    return OHVectorPackFileGetEntryCount(_packFile);
+}
+
+- (NSArray*)names
+{
+    NSUInteger count = self.count;
+    NSMutableArray* names = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger idx = 0; idx < count; ++idx)
+    {
+        [names addObject:@(OHVectorPackFileGetEntryName(_packFile, idx))];
+    }
+    return [names copy];
+}
+
+#pragma mark - Getting images
+
+- (BOOL)containsImageNamed:(NSString*)name
+{
+    return name && OHVectorPackFileFindEntry(_packFile, name.UTF8String) >= 0;
+}
+
+- (OHVectorImage*)imageNamed:(NSString*)name
+{
+    OHPDFPage* page = [self pageNamed:name];
+    if (!page) return nil;
+    
+    OHVectorImage* image = [OHVectorImage imageWithPDFPage:page];
+    // Identifies the image in the cache keys of its renderings
+    image.sourceURL = [self.URL URLByAppendingPathComponent:name];
+    return image;
+}
+
+/**
+ *  Returns the page of the entry with the given name, decoding it if it is not in the cache.
+ */
+- (OHPDFPage*)pageNamed:(NSString*)name
+{
+    if (!name) return nil;
+    
+    OHPDFPage* page = [self.pages objectForKey:name];
+    if (page) return page;
+    
+    long index = OHVectorPackFileFindEntry(_packFile, name.UTF8String);
+    if (index < 0) return nil;
+    
+    OH_RENDER_STATS_BEGIN(loadStart);
+    float mediaBox[4], cropBox[4];
+    OHVectorPackFileGetEntryBoxes(_packFile, (size_t)index, mediaBox, cropBox);
+    OHPDFDisplayList* displayList = [OHPDFDisplayList displayListWithList:OHVectorPackFileCopyDisplayList(_packFile, (size_t)index)
+                                                                  cropBox:OHRectFromBox(cropBox)];
+    page = [OHPDFPage pageWithDisplayList:displayList mediaBox:OHRectFromBox(mediaBox)];
+    OH_RENDER_STATS_END(OHRenderStageLoad, loadStart);
+    
+    if (page) [self.pages setObject:page forKey:name cost:displayList.byteSize];
+    return page;
+}
+
+@end
@@ -0,0 +1,612 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#if !defined(__APPLE__) && !defined(_POSIX_C_SOURCE)
+  #define _POSIX_C_SOURCE 200112L /* For mmap in strict C99 mode */
+#endif
+#include "OHVectorPackFile.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/***********************************************************************************/
+
+static const uint8_t kPackMagic[4] = { 'O', 'H', 'V', 'P' };
+static const uint32_t kPackVersion = 1;
+
+/* Sizes and field offsets of the header and of the entries */
+enum {
+    kHeaderSize = 32,
+    kHeaderVersion = 4, kHeaderEntryCount = 8, kHeaderTableSize = 12,
+    kHeaderTableOffset = 16, kHeaderEntriesOffset = 20, kHeaderNamesOffset = 24, kHeaderDataOffset = 28,
+    
+    kEntrySize = 60,
+    kEntryHash = 0, kEntryNameOffset = 4, kEntryNameLength = 8, kEntryMediaBox = 12, kEntryCropBox = 28,
+    kEntryQuantum = 44, kEntryDataOffset = 48, kEntryDataSize = 52, kEntryOpCount = 56,
+};
+
+/* Path coordinates are quantized when the quantum, in the page space, is below this fraction of the page */
+static const float kMaxQuantumPerPageSize = 1.0f / 8192;
+
+// MARK: - Encoding helpers
+
+static void OHPutU32(uint8_t* bytes, uint32_t value)
+{
+    bytes[0] = (uint8_t)value;
+    bytes[1] = (uint8_t)(value >> 8);
+    bytes[2] = (uint8_t)(value >> 16);
+    bytes[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t OHGetU32(const uint8_t* bytes)
+{
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void OHPutF32(uint8_t* bytes, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    OHPutU32(bytes, bits);
+}
+
+static float OHGetF32(const uint8_t* bytes)
+{
+    uint32_t bits = OHGetU32(bytes);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/* FNV-1a, which is simple and good enough for short names */
+static uint32_t OHHashName(const char* name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t idx = 0; idx < length; ++idx)
+    {
+        hash = (hash ^ (uint8_t)name[idx]) * 16777619u;
+    }
+    return hash;
+}
+
+static int OHIsPathOperation(OHDisplayListOp op)
+{
+    return op == OHDisplayListOpMoveTo || op == OHDisplayListOpLineTo || op == OHDisplayListOpCurveTo;
+}
+
+/* The number of bytes of the encoded operands of an operation */
+static size_t OHEncodedOperandsSize(OHDisplayListOp op, size_t count, int quantized)
+{
+    switch (op)
+    {
+        case OHDisplayListOpMoveTo:
+        case OHDisplayListOpLineTo:
+        case OHDisplayListOpCurveTo:        return count * (quantized ? 2 : 4);
+        case OHDisplayListOpSetFillColor:
+        case OHDisplayListOpSetStrokeColor: return 4;
+        case OHDisplayListOpSetLineCap:
+        case OHDisplayListOpSetLineJoin:    return 1;
+        case OHDisplayListOpSetDash:        return 2 + (count - 1) * 4; /* Lengths count, phase, lengths */
+        default:                            return count * 4;
+    }
+}
+
+// MARK: - Writer
+
+typedef struct {
+    char* name;
+    uint32_t hash;
+    float mediaBox[4];
+    float cropBox[4];
+    float quantum; /* 0 if the path coordinates are not quantized */
+    uint8_t* data;
+    size_t dataSize;
+    size_t dataCapacity;
+    uint32_t opCount;
+    int failed;
+} OHPackEntry;
+
+struct OHVectorPackWriter {
+    OHPackEntry* entries;
+    size_t count;
+    size_t capacity;
+};
+
+OHVectorPackWriter* OHVectorPackWriterCreate(void)
+{
+    return calloc(1, sizeof(OHVectorPackWriter));
+}
+
+void OHVectorPackWriterRelease(OHVectorPackWriter* writer)
+{
+    if (!writer) return;
+    for (size_t idx = 0; idx < writer->count; ++idx)
+    {
+        free(writer->entries[idx].name);
+        free(writer->entries[idx].data);
+    }
+    free(writer->entries);
+    free(writer);
+}
+
+/* The largest path coordinate, and the largest scale of the CTM applied to path coordinates */
+typedef struct {
+    float maxMagnitude;
+    float maxScale;
+    float scale;
+    float* savedScales;
+    size_t savedCount;
+    size_t savedCapacity;
+    int failed;
+} OHCoordinateExtent;
+
+static void OHMeasureOperation(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    OHCoordinateExtent* extent = info;
+    switch (op)
+    {
+        case OHDisplayListOpMoveTo:
+        case OHDisplayListOpLineTo:
+        case OHDisplayListOpCurveTo:
+            for (size_t idx = 0; idx < count; ++idx) extent->maxMagnitude = fmaxf(extent->maxMagnitude, fabsf(operands[idx]));
+            extent->maxScale = fmaxf(extent->maxScale, extent->scale);
+            break;
+        case OHDisplayListOpConcatCTM:
+            // The length of the longest column bounds how much the matrix can stretch a distance
+            extent->scale *= fmaxf(hypotf(operands[0], operands[1]), hypotf(operands[2], operands[3]));
+            break;
+        case OHDisplayListOpSave:
+            if (extent->savedCount == extent->savedCapacity)
+            {
+                size_t capacity = extent->savedCapacity ? extent->savedCapacity * 2 : 16;
+                float* scales = realloc(extent->savedScales, capacity * sizeof(float));
+                if (!scales) { extent->failed = 1; return; }
+                extent->savedScales = scales;
+                extent->savedCapacity = capacity;
+            }
+            extent->savedScales[extent->savedCount++] = extent->scale;
+            break;
+        case OHDisplayListOpRestore:
+            if (extent->savedCount) extent->scale = extent->savedScales[--extent->savedCount];
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ *  Returns the smallest power of two such that every path coordinate fits in an
+ *  int16 multiple of it, or 0 if this would be too coarse once transformed in the
+ *  page space (e.g. for small details far from the origin).
+ */
+static float OHQuantumForExtent(OHCoordinateExtent extent, const float mediaBox[4])
+{
+    if (extent.maxMagnitude == 0) return 1;
+    int exponent;
+    frexpf(extent.maxMagnitude / 32767, &exponent);
+    float quantum = ldexpf(1, exponent);
+    float pageSize = fmaxf(mediaBox[2], mediaBox[3]);
+    return quantum * extent.maxScale <= pageSize * kMaxQuantumPerPageSize ? quantum : 0;
+}
+
+static void OHEncodeOperation(void* info, OHDisplayListOp op, const float* operands, size_t count)
+{
+    OHPackEntry* entry = info;
+    if (entry->failed) return;
+    if (op == OHDisplayListOpSetDash && count - 2 > UINT16_MAX)
+    {
+        entry->failed = 1;
+        return;
+    }
+    
+    size_t size = 1 + OHEncodedOperandsSize(op, count, entry->quantum != 0);
+    if (entry->dataSize + size > entry->dataCapacity)
+    {
+        size_t capacity = entry->dataCapacity ? entry->dataCapacity * 2 : 256;
+        while (capacity < entry->dataSize + size) capacity *= 2;
+        uint8_t* data = realloc(entry->data, capacity);
+        if (!data)
+        {
+            entry->failed = 1;
+            return;
+        }
+        entry->data = data;
+        entry->dataCapacity = capacity;
+    }
+    
+    uint8_t* bytes = entry->data + entry->dataSize;
+    *bytes++ = (uint8_t)op;
+    switch (op)
+    {
+        case OHDisplayListOpMoveTo:
+        case OHDisplayListOpLineTo:
+        case OHDisplayListOpCurveTo:
+            for (size_t idx = 0; idx < count; ++idx)
+            {
+                if (entry->quantum)
+                {
+                    uint16_t value = (uint16_t)(int16_t)lrintf(operands[idx] / entry->quantum);
+                    *bytes++ = (uint8_t)value;
+                    *bytes++ = (uint8_t)(value >> 8);
+                }
+                else
+                {
+                    OHPutF32(bytes, operands[idx]);
+                    bytes += 4;
+                }
+            }
+            break;
+        case OHDisplayListOpSetFillColor:
+        case OHDisplayListOpSetStrokeColor:
+            for (size_t idx = 0; idx < 4; ++idx)
+            {
+                float value = operands[idx] < 0 ? 0 : (operands[idx] > 1 ? 1 : operands[idx]);
+                *bytes++ = (uint8_t)lrintf(value * 255);
+            }
+            break;
+        case OHDisplayListOpSetLineCap:
+        case OHDisplayListOpSetLineJoin:
+            *bytes++ = (uint8_t)operands[0];
+            break;
+        case OHDisplayListOpSetDash:
+        {
+            uint16_t lengthsCount = (uint16_t)(count - 2);
+            *bytes++ = (uint8_t)lengthsCount;
+            *bytes++ = (uint8_t)(lengthsCount >> 8);
+            for (size_t idx = 1; idx < count; ++idx, bytes += 4) OHPutF32(bytes, operands[idx]);
+            break;
+        }
+        default:
+            for (size_t idx = 0; idx < count; ++idx, bytes += 4) OHPutF32(bytes, operands[idx]);
+            break;
+    }
+    entry->dataSize += size;
+    entry->opCount++;
+}
+
+int OHVectorPackWriterAddEntry(OHVectorPackWriter* writer, const char* name,
+                               const float mediaBox[4], const float cropBox[4], const OHDisplayList* list)
+{
+    size_t nameLength = strlen(name);
+    uint32_t hash = OHHashName(name, nameLength);
+    for (size_t idx = 0; idx < writer->count; ++idx)
+    {
+        if (writer->entries[idx].hash == hash && strcmp(writer->entries[idx].name, name) == 0) return -1;
+    }
+    if (writer->count == writer->capacity)
+    {
+        size_t capacity = writer->capacity ? writer->capacity * 2 : 64;
+        OHPackEntry* entries = realloc(writer->entries, capacity * sizeof(OHPackEntry));
+        if (!entries) return -1;
+        writer->entries = entries;
+        writer->capacity = capacity;
+    }
+    
+    OHPackEntry entry = { .name = malloc(nameLength + 1), .hash = hash };
+    if (!entry.name) return -1;
+    memcpy(entry.name, name, nameLength + 1);
+    memcpy(entry.mediaBox, mediaBox, sizeof(entry.mediaBox));
+    memcpy(entry.cropBox, cropBox, sizeof(entry.cropBox));
+    
+    OHCoordinateExtent extent = { .scale = 1 };
+    OHDisplayListApply(list, &extent, OHMeasureOperation);
+    free(extent.savedScales);
+    entry.quantum = OHQuantumForExtent(extent, mediaBox);
+    OHDisplayListApply(list, &entry, OHEncodeOperation);
+    if (entry.failed || extent.failed)
+    {
+        free(entry.name);
+        free(entry.data);
+        return -1;
+    }
+    writer->entries[writer->count++] = entry;
+    return 0;
+}
+
+size_t OHVectorPackWriterGetEntryCount(const OHVectorPackWriter* writer)
+{
+    return writer->count;
+}
+
+int OHVectorPackWriterWrite(const OHVectorPackWriter* writer, FILE* file)
+{
+    // A load factor of 1/2 at most keeps the probe sequences short
+    uint32_t tableSize = 1;
+    while (tableSize < 2 * writer->count) tableSize *= 2;
+    
+    uint64_t namesSize = 0, dataSize = 0;
+    for (size_t idx = 0; idx < writer->count; ++idx)
+    {
+        namesSize += strlen(writer->entries[idx].name) + 1;
+        dataSize += writer->entries[idx].dataSize;
+    }
+    uint64_t tableOffset = kHeaderSize;
+    uint64_t entriesOffset = tableOffset + (uint64_t)tableSize * 4;
+    uint64_t namesOffset = entriesOffset + (uint64_t)writer->count * kEntrySize;
+    uint64_t dataOffset = namesOffset + namesSize;
+    if (dataOffset + dataSize > UINT32_MAX) return -1;
+    
+    // Everything but the display lists is small, so build it in memory
+    uint8_t* index = calloc(1, (size_t)dataOffset);
+    if (!index) return -1;
+    memcpy(index, kPackMagic, sizeof(kPackMagic));
+    OHPutU32(index + kHeaderVersion, kPackVersion);
+    OHPutU32(index + kHeaderEntryCount, (uint32_t)writer->count);
+    OHPutU32(index + kHeaderTableSize, tableSize);
+    OHPutU32(index + kHeaderTableOffset, (uint32_t)tableOffset);
+    OHPutU32(index + kHeaderEntriesOffset, (uint32_t)entriesOffset);
+    OHPutU32(index + kHeaderNamesOffset, (uint32_t)namesOffset);
+    OHPutU32(index + kHeaderDataOffset, (uint32_t)dataOffset);
+    
+    uint32_t nameOffset = 0, entryDataOffset = (uint32_t)dataOffset;
+    for (size_t idx = 0; idx < writer->count; ++idx)
+    {
+        const OHPackEntry* entry = &writer->entries[idx];
+        uint32_t slot = entry->hash & (tableSize - 1);
+        while (OHGetU32(index + tableOffset + slot * 4) != 0) slot = (slot + 1) & (tableSize - 1);
+        OHPutU32(index + tableOffset + slot * 4, (uint32_t)idx + 1);
+        
+        uint8_t* fields = index + entriesOffset + idx * kEntrySize;
+        size_t nameLength = strlen(entry->name);
+        OHPutU32(fields + kEntryHash, entry->hash);
+        OHPutU32(fields + kEntryNameOffset, nameOffset);
+        OHPutU32(fields + kEntryNameLength, (uint32_t)nameLength);
+        for (int box = 0; box < 4; ++box)
+        {
+            OHPutF32(fields + kEntryMediaBox + box * 4, entry->mediaBox[box]);
+            OHPutF32(fields + kEntryCropBox + box * 4, entry->cropBox[box]);
+        }
+        OHPutF32(fields + kEntryQuantum, entry->quantum);
+        OHPutU32(fields + kEntryDataOffset, entryDataOffset);
+        OHPutU32(fields + kEntryDataSize, (uint32_t)entry->dataSize);
+        OHPutU32(fields + kEntryOpCount, entry->opCount);
+        
+        memcpy(index + namesOffset + nameOffset, entry->name, nameLength + 1);
+        nameOffset += (uint32_t)nameLength + 1;
+        entryDataOffset += (uint32_t)entry->dataSize;
+    }
+    
+    int failed = fwrite(index, 1, (size_t)dataOffset, file) != dataOffset;
+    free(index);
+    for (size_t idx = 0; idx < writer->count && !failed; ++idx)
+    {
+        const OHPackEntry* entry = &writer->entries[idx];
+        failed = entry->dataSize && fwrite(entry->data, 1, entry->dataSize, file) != entry->dataSize;
+    }
+    return failed || fflush(file) != 0 ? -1 : 0;
+}
+
+// MARK: - Reader
+
+struct OHVectorPackFile {
+    const uint8_t* bytes;
+    size_t length;
+    size_t mappedLength; /* 0 if the bytes are not mapped by the pack */
+    uint32_t entryCount;
+    uint32_t tableSize;
+    const uint8_t* table;
+    const uint8_t* entries;
+    const uint8_t* names;
+};
+
+OHVectorPackFile* OHVectorPackFileOpenWithBytes(const void* bytes, size_t length)
+{
+    const uint8_t* header = bytes;
+    if (length < kHeaderSize || memcmp(header, kPackMagic, sizeof(kPackMagic)) != 0
+        || OHGetU32(header + kHeaderVersion) != kPackVersion) return NULL;
+    
+    uint32_t entryCount = OHGetU32(header + kHeaderEntryCount);
+    uint32_t tableSize = OHGetU32(header + kHeaderTableSize);
+    uint64_t tableOffset = OHGetU32(header + kHeaderTableOffset);
+    uint64_t entriesOffset = OHGetU32(header + kHeaderEntriesOffset);
+    uint64_t namesOffset = OHGetU32(header + kHeaderNamesOffset);
+    uint64_t dataOffset = OHGetU32(header + kHeaderDataOffset);
+    if (tableSize == 0 || (tableSize & (tableSize - 1)) != 0 || tableSize < entryCount
+        || tableOffset + (uint64_t)tableSize * 4 > length
+        || entriesOffset + (uint64_t)entryCount * kEntrySize > length
+        || namesOffset > dataOffset || dataOffset > length) return NULL;
+    
+    // Validate the bounds of every entry once, so that lookups and decoding can trust them
+    for (uint32_t idx = 0; idx < tableSize; ++idx)
+    {
+        if (OHGetU32(header + tableOffset + idx * 4) > entryCount) return NULL;
+    }
+    for (uint32_t idx = 0; idx < entryCount; ++idx)
+    {
+        const uint8_t* entry = header + entriesOffset + (uint64_t)idx * kEntrySize;
+        uint64_t nameEnd = namesOffset + OHGetU32(entry + kEntryNameOffset) + OHGetU32(entry + kEntryNameLength);
+        uint64_t dataEnd = (uint64_t)OHGetU32(entry + kEntryDataOffset) + OHGetU32(entry + kEntryDataSize);
+        if (nameEnd >= dataOffset || header[nameEnd] != '\0' || dataEnd > length) return NULL;
+    }
+    
+    OHVectorPackFile* pack = calloc(1, sizeof(OHVectorPackFile));
+    if (!pack) return NULL;
+    pack->bytes = header;
+    pack->length = length;
+    pack->entryCount = entryCount;
+    pack->tableSize = tableSize;
+    pack->table = header + tableOffset;
+    pack->entries = header + entriesOffset;
+    pack->names = header + namesOffset;
+    return pack;
+}
+
+OHVectorPackFile* OHVectorPackFileOpen(const char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)info.st_size;
+    void* bytes = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bytes == MAP_FAILED) return NULL;
+    
+    OHVectorPackFile* pack = OHVectorPackFileOpenWithBytes(bytes, length);
+    if (!pack)
+    {
+        munmap(bytes, length);
+        return NULL;
+    }
+    pack->mappedLength = length;
+    return pack;
+}
+
+void OHVectorPackFileClose(OHVectorPackFile* pack)
+{
+    if (!pack) return;
+    if (pack->mappedLength) munmap((void*)pack->bytes, pack->mappedLength);
+    free(pack);
+}
+
+size_t OHVectorPackFileGetEntryCount(const OHVectorPackFile* pack)
+{
+    return pack->entryCount;
+}
+
+long OHVectorPackFileFindEntry(const OHVectorPackFile* pack, const char* name)
+{
+    size_t nameLength = strlen(name);
+    uint32_t hash = OHHashName(name, nameLength);
+    uint32_t mask = pack->tableSize - 1;
+    for (uint32_t probe = 0, slot = hash & mask; probe < pack->tableSize; ++probe, slot = (slot + 1) & mask)
+    {
+        uint32_t value = OHGetU32(pack->table + slot * 4);
+        if (value == 0) break;
+        const uint8_t* entry = pack->entries + (size_t)(value - 1) * kEntrySize;
+        if (OHGetU32(entry + kEntryHash) == hash && OHGetU32(entry + kEntryNameLength) == nameLength
+            && memcmp(pack->names + OHGetU32(entry + kEntryNameOffset), name, nameLength) == 0)
+        {
+            return (long)(value - 1);
+        }
+    }
+    return -1;
+}
+
+const char* OHVectorPackFileGetEntryName(const OHVectorPackFile* pack, size_t index)
+{
+    if (index >= pack->entryCount) return NULL;
+    return (const char*)pack->names + OHGetU32(pack->entries + index * kEntrySize + kEntryNameOffset);
+}
+
+void OHVectorPackFileGetEntryBoxes(const OHVectorPackFile* pack, size_t index, float mediaBox[4], float cropBox[4])
+{
+    if (index >= pack->entryCount) return;
+    const uint8_t* entry = pack->entries + index * kEntrySize;
+    for (int box = 0; box < 4; ++box)
+    {
+        if (mediaBox) mediaBox[box] = OHGetF32(entry + kEntryMediaBox + box * 4);
+        if (cropBox) cropBox[box] = OHGetF32(entry + kEntryCropBox + box * 4);
+    }
+}
+
+OHDisplayList* OHVectorPackFileCopyDisplayList(const OHVectorPackFile* pack, size_t index)
+{
+    if (index >= pack->entryCount) return NULL;
+    const uint8_t* entry = pack->entries + index * kEntrySize;
+    const float quantum = OHGetF32(entry + kEntryQuantum);
+    const uint8_t* bytes = pack->bytes + OHGetU32(entry + kEntryDataOffset);
+    const uint8_t* end = bytes + OHGetU32(entry + kEntryDataSize);
+    const uint32_t opCount = OHGetU32(entry + kEntryOpCount);
+    
+    OHDisplayList* list = OHDisplayListCreate();
+    float fixedOperands[6];
+    float* operands = fixedOperands;
+    int failed = !list;
+    for (uint32_t idx = 0; idx < opCount && !failed; ++idx)
+    {
+        if (bytes >= end || *bytes >= OHDisplayListOpCount)
+        {
+            failed = 1;
+            break;
+        }
+        OHDisplayListOp op = (OHDisplayListOp)*bytes++;
+        int fixedCount = OHDisplayListGetOperandCount(op);
+        size_t count = (size_t)fixedCount;
+        if (fixedCount < 0)
+        {
+            // Dash: the lengths count, then the phase and the lengths
+            if (end - bytes < 2) { failed = 1; break; }
+            count = (size_t)(bytes[0] | bytes[1] << 8) + 2;
+            bytes += 2;
+            operands = malloc(count * sizeof(float));
+            if (!operands) { failed = 1; break; }
+            operands[0] = (float)(count - 2);
+        }
+        if ((size_t)(end - bytes) < OHEncodedOperandsSize(op, count, quantum != 0) - (fixedCount < 0 ? 2 : 0))
+        {
+            failed = 1;
+        }
+        else if (OHIsPathOperation(op))
+        {
+            for (size_t k = 0; k < count; ++k)
+            {
+                if (quantum)
+                {
+                    operands[k] = (int16_t)(bytes[0] | bytes[1] << 8) * quantum;
+                    bytes += 2;
+                }
+                else
+                {
+                    operands[k] = OHGetF32(bytes);
+                    bytes += 4;
+                }
+            }
+        }
+        else if (op == OHDisplayListOpSetFillColor || op == OHDisplayListOpSetStrokeColor)
+        {
+            for (size_t k = 0; k < 4; ++k) operands[k] = *bytes++ / 255.0f;
+        }
+        else if (op == OHDisplayListOpSetLineCap || op == OHDisplayListOpSetLineJoin)
+        {
+            operands[0] = *bytes++;
+        }
+        else
+        {
+            for (size_t k = (fixedCount < 0 ? 1 : 0); k < count; ++k, bytes += 4) operands[k] = OHGetF32(bytes);
+        }
+        
+        if (!failed && OHDisplayListAppend(list, op, operands, count) != 0) failed = 1;
+        if (operands != fixedOperands)
+        {
+            free(operands);
+            operands = fixedOperands;
+        }
+    }
+    if (failed || bytes != end)
+    {
+        OHDisplayListRelease(list);
+        return NULL;
+    }
+    return list;
+}
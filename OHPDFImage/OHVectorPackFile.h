@@ -0,0 +1,161 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHPDFImage_OHVectorPackFile_h
+#define OHPDFImage_OHVectorPackFile_h
+
+#include <stdio.h>
+#include "OHDisplayList.h"
+
+/***********************************************************************************/
+
+/*
+ *  A vector pack: a single binary file containing the display lists of many
+ *  vector images (e.g. all the icons of an app), indexed by name, so that they
+ *  can be loaded without parsing any PDF.
+ *
+ *  Packs are compiled ahead of time by `OHVectorPackWriter` (see the
+ *  `Tools/VectorPackCompiler` command line tool, which runs on any platform),
+ *  and loaded at runtime by memory-mapping the file: finding an entry is a
+ *  single hash table lookup, and only the entries actually used are read.
+ *
+ *  All the integers are little endian. A pack is made of:
+ *  - A header: the "OHVP" magic, the format version, the number of entries,
+ *    the size of the hash table (a power of two) and the offsets of the sections;
+ *  - A hash table of (entry index + 1), 0 for empty slots, using the FNV-1a
+ *    hash of the names and linear probing;
+ *  - The entries, with the hash, name, media box, crop box, coordinate quantum
+ *    and location of the encoded display list of each vector image;
+ *  - The NUL-terminated names;
+ *  - The encoded display lists: each operation is a byte followed by its
+ *    operands. Colors are quantized to 8 bits, and path coordinates to 16-bit
+ *    multiples of the entry's quantum (a power of two chosen from the extent of
+ *    the coordinates), or kept as 32-bit floats when that would lose precision.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MARK: - Writer
+
+typedef struct OHVectorPackWriter OHVectorPackWriter;
+
+/**
+ *  Creates an empty pack writer. Release it using `OHVectorPackWriterRelease`.
+ */
+OHVectorPackWriter* OHVectorPackWriterCreate(void);
+
+/**
+ *  Releases a pack writer and the entries added to it.
+ */
+void OHVectorPackWriterRelease(OHVectorPackWriter* writer);
+
+/**
+ *  Encodes a display list and adds it to the pack.
+ *
+ *  @param writer   The pack writer
+ *  @param name     The name of the entry, used to find it at runtime (e.g. "check")
+ *  @param mediaBox The media box of the page (x, y, width, height)
+ *  @param cropBox  The crop box of the page (x, y, width, height), used to clip the content
+ *  @param list     The display list of the page (see `OHDisplayListBuilder`)
+ *
+ *  @return 0 on success, -1 if an entry with the same name was already added
+ *          or on allocation failure.
+ */
+int OHVectorPackWriterAddEntry(OHVectorPackWriter* writer, const char* name,
+                               const float mediaBox[4], const float cropBox[4], const OHDisplayList* list);
+
+/**
+ *  The number of entries added to the pack.
+ */
+size_t OHVectorPackWriterGetEntryCount(const OHVectorPackWriter* writer);
+
+/**
+ *  Writes the pack to a file.
+ *
+ *  @return 0 on success, -1 on I/O error or if the pack would exceed 4GB.
+ */
+int OHVectorPackWriterWrite(const OHVectorPackWriter* writer, FILE* file);
+
+// MARK: - Reader
+
+typedef struct OHVectorPackFile OHVectorPackFile;
+
+/**
+ *  Opens a pack by memory-mapping it. The headers and bounds of the pack are
+ *  validated, but the display lists are only read when decoded.
+ *
+ *  @return The pack, to close using `OHVectorPackFileClose`,
+ *          or NULL if the file can't be mapped or is not a valid pack.
+ */
+OHVectorPackFile* OHVectorPackFileOpen(const char* path);
+
+/**
+ *  Opens a pack from bytes already in memory, without copying them.
+ *  The bytes must stay valid until the pack is closed.
+ */
+OHVectorPackFile* OHVectorPackFileOpenWithBytes(const void* bytes, size_t length);
+
+/**
+ *  Closes a pack, unmapping its file if it was opened with `OHVectorPackFileOpen`.
+ */
+void OHVectorPackFileClose(OHVectorPackFile* pack);
+
+/**
+ *  The number of entries in the pack.
+ */
+size_t OHVectorPackFileGetEntryCount(const OHVectorPackFile* pack);
+
+/**
+ *  Finds an entry by name, using the hash table of the pack.
+ *
+ *  @return The index of the entry, or -1 if the pack has no entry with this name.
+ */
+long OHVectorPackFileFindEntry(const OHVectorPackFile* pack, const char* name);
+
+/**
+ *  The name of the entry at the given index (pointing in the pack, valid until it is closed).
+ */
+const char* OHVectorPackFileGetEntryName(const OHVectorPackFile* pack, size_t index);
+
+/**
+ *  Gets the media box and crop box (x, y, width, height) of the entry at the given index.
+ */
+void OHVectorPackFileGetEntryBoxes(const OHVectorPackFile* pack, size_t index, float mediaBox[4], float cropBox[4]);
+
+/**
+ *  Decodes the display list of the entry at the given index.
+ *
+ *  @return The display list, owned by the caller, or NULL if the entry is
+ *          corrupted or on allocation failure.
+ */
+OHDisplayList* OHVectorPackFileCopyDisplayList(const OHVectorPackFile* pack, size_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
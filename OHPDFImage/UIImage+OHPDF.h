@@ -73,4 +73,28 @@
 + (instancetype)imageWithPDFNamed:(NSString*)pdfName
                          inBundle:(NSBundle*)bundleOrNil
                         fitInSize:(CGSize)size;
+
+/**
+ *  Returns the UIImages built from loading the first page of the PDF file
+ *  with the given name in the given bundle and rendering it at each of the
+ *  given sizes and scales, e.g. the 1x, 2x and 3x variants of an icon.
+ *
+ *  @param pdfName     The name of the PDF file in the bundle
+ *  @param bundleOrNil The bundle in which to search the image in. If nil, will use the main bundle.
+ *  @param sizes       An array of `NSValue`s wrapping the bounding box sizes in which
+ *                     to render the image, keeping its aspect ratio
+ *  @param scales      An array of `NSNumber`s wrapping the scales at which to render each size.
+ *                     If nil or empty, the images are rendered at the scale of the main screen.
+ *
+ *  @return The UIImages, in request order: the first size at each scale, then the second size
+ *          at each scale, and so on (`NSNull` for the images that could not be rendered),
+ *          or nil if the PDF file could not be loaded.
+ *
+ *  @note The PDF is only loaded once, and the images are rendered concurrently
+ *        (see `-[OHVectorImage renderAtSizesThatFit:scales:]`).
+ */
++ (NSArray*)imagesWithPDFNamed:(NSString*)pdfName
+                      inBundle:(NSBundle*)bundleOrNil
+                    fitInSizes:(NSArray*)sizes
+                        scales:(NSArray*)scales;
 @end
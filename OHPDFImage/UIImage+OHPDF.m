@@ -43,4 +43,13 @@
     return [vImage renderAtSizeThatFits:size];
 }
 
++ (NSArray*)imagesWithPDFNamed:(NSString*)pdfName
+                      inBundle:(NSBundle*)bundleOrNil
+                    fitInSizes:(NSArray*)sizes
+                        scales:(NSArray*)scales
+{
+    OHVectorImage* vImage = [OHVectorImage imageWithPDFNamed:pdfName inBundle:bundleOrNil];
+    return [vImage renderAtSizesThatFit:sizes scales:scales];
+}
+
 @end
@@ -0,0 +1,825 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#include "OHPDFParser.h"
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+/***********************************************************************************/
+
+/* Deeper nesting is certainly a corrupted (or malicious) file */
+static const int kMaxNestingDepth = 64;
+/* Object numbers above this are certainly garbage, and would need a huge table */
+static const unsigned kMaxObjectNumber = 8 * 1024 * 1024;
+
+// MARK: - Arena
+
+/* All the objects of a file are allocated from an arena, and released at once with it */
+typedef struct OHArenaBlock {
+    struct OHArenaBlock* next;
+    size_t used;
+    size_t size;
+} OHArenaBlock;
+
+typedef struct {
+    OHArenaBlock* blocks;
+} OHArena;
+
+static const size_t kArenaBlockSize = 64 * 1024;
+static const size_t kArenaHeaderSize = (sizeof(OHArenaBlock) + 15) & ~(size_t)15;
+
+static void* OHArenaAlloc(OHArena* arena, size_t size)
+{
+    size = (size + 15) & ~(size_t)15;
+    OHArenaBlock* block = arena->blocks;
+    if (!block || block->size - block->used < size)
+    {
+        size_t blockSize = size > kArenaBlockSize ? size : kArenaBlockSize;
+        block = malloc(kArenaHeaderSize + blockSize);
+        if (!block) return NULL;
+        block->used = 0;
+        block->size = blockSize;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+    void* pointer = (uint8_t*)block + kArenaHeaderSize + block->used;
+    block->used += size;
+    return pointer;
+}
+
+static void OHArenaRelease(OHArena* arena)
+{
+    while (arena->blocks)
+    {
+        OHArenaBlock* next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+}
+
+// MARK: - Lexer
+
+typedef struct {
+    const uint8_t* cursor;
+    const uint8_t* end;
+    OHArena* arena;
+} OHLexer;
+
+static int OHIsWhitespace(uint8_t c)
+{
+    return c == 0 || c == '\t' || c == '\n' || c == '\f' || c == '\r' || c == ' ';
+}
+
+static int OHIsDelimiter(uint8_t c)
+{
+    return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']'
+        || c == '{' || c == '}' || c == '/' || c == '%';
+}
+
+static int OHIsRegular(uint8_t c)
+{
+    return !OHIsWhitespace(c) && !OHIsDelimiter(c);
+}
+
+static void OHSkipWhitespace(OHLexer* lexer)
+{
+    while (lexer->cursor < lexer->end)
+    {
+        if (*lexer->cursor == '%')
+        {
+            while (lexer->cursor < lexer->end && *lexer->cursor != '\n' && *lexer->cursor != '\r') lexer->cursor++;
+        }
+        else if (OHIsWhitespace(*lexer->cursor))
+        {
+            lexer->cursor++;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+static int OHHexValue(uint8_t c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Stores a copy of bytes as a NUL-terminated string of the given type */
+static int OHMakeString(OHLexer* lexer, OHPDFObject* object, OHPDFObjectType type, const uint8_t* bytes, size_t length)
+{
+    char* copy = OHArenaAlloc(lexer->arena, length + 1);
+    if (!copy) return -1;
+    if (length) memcpy(copy, bytes, length);
+    copy[length] = '\0';
+    object->type = type;
+    object->value.string.bytes = copy;
+    object->value.string.length = length;
+    return 1;
+}
+
+/* A growable scratch buffer, for the objects whose size is not known in advance */
+typedef struct {
+    uint8_t* bytes;
+    size_t length;
+    size_t capacity;
+} OHScratch;
+
+static int OHScratchAppend(OHScratch* scratch, const void* bytes, size_t length)
+{
+    if (scratch->length + length > scratch->capacity)
+    {
+        size_t capacity = scratch->capacity ? scratch->capacity * 2 : 64;
+        while (capacity < scratch->length + length) capacity *= 2;
+        uint8_t* newBytes = realloc(scratch->bytes, capacity);
+        if (!newBytes) return -1;
+        scratch->bytes = newBytes;
+        scratch->capacity = capacity;
+    }
+    memcpy(scratch->bytes + scratch->length, bytes, length);
+    scratch->length += length;
+    return 0;
+}
+
+static int OHParseName(OHLexer* lexer, OHPDFObject* object)
+{
+    OHScratch name = { NULL, 0, 0 };
+    lexer->cursor++; // '/'
+    while (lexer->cursor < lexer->end && OHIsRegular(*lexer->cursor))
+    {
+        uint8_t c = *lexer->cursor++;
+        if (c == '#' && lexer->end - lexer->cursor >= 2
+            && OHHexValue(lexer->cursor[0]) >= 0 && OHHexValue(lexer->cursor[1]) >= 0)
+        {
+            c = (uint8_t)(OHHexValue(lexer->cursor[0]) << 4 | OHHexValue(lexer->cursor[1]));
+            lexer->cursor += 2;
+        }
+        if (OHScratchAppend(&name, &c, 1) != 0) { free(name.bytes); return -1; }
+    }
+    int result = OHMakeString(lexer, object, OHPDFObjectTypeName, name.bytes, name.length);
+    free(name.bytes);
+    return result;
+}
+
+static int OHParseLiteralString(OHLexer* lexer, OHPDFObject* object)
+{
+    OHScratch string = { NULL, 0, 0 };
+    int nesting = 1, failed = 0;
+    lexer->cursor++; // '('
+    while (!failed)
+    {
+        if (lexer->cursor >= lexer->end) { failed = 1; break; }
+        uint8_t c = *lexer->cursor++;
+        if (c == '(') nesting++;
+        else if (c == ')' && --nesting == 0) break;
+        else if (c == '\\' && lexer->cursor < lexer->end)
+        {
+            c = *lexer->cursor++;
+            switch (c)
+            {
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case '\r':
+                    if (lexer->cursor < lexer->end && *lexer->cursor == '\n') lexer->cursor++;
+                    continue; // Line continuation
+                case '\n':
+                    continue;
+                default:
+                    if (c >= '0' && c <= '7')
+                    {
+                        unsigned value = c - '0';
+                        for (int digits = 1; digits < 3 && lexer->cursor < lexer->end
+                             && *lexer->cursor >= '0' && *lexer->cursor <= '7'; ++digits)
+                        {
+                            value = value * 8 + (unsigned)(*lexer->cursor++ - '0');
+                        }
+                        c = (uint8_t)value;
+                    }
+                    break;
+            }
+        }
+        failed = OHScratchAppend(&string, &c, 1) != 0;
+    }
+    int result = failed ? -1 : OHMakeString(lexer, object, OHPDFObjectTypeString, string.bytes, string.length);
+    free(string.bytes);
+    return result;
+}
+
+static int OHParseHexString(OHLexer* lexer, OHPDFObject* object)
+{
+    OHScratch string = { NULL, 0, 0 };
+    int high = -1, failed = 0;
+    lexer->cursor++; // '<'
+    while (!failed)
+    {
+        if (lexer->cursor >= lexer->end) { failed = 1; break; }
+        uint8_t c = *lexer->cursor++;
+        if (c == '>') break;
+        if (OHIsWhitespace(c)) continue;
+        int value = OHHexValue(c);
+        if (value < 0) { failed = 1; break; }
+        if (high < 0)
+        {
+            high = value;
+        }
+        else
+        {
+            uint8_t byte = (uint8_t)(high << 4 | value);
+            failed = OHScratchAppend(&string, &byte, 1) != 0;
+            high = -1;
+        }
+    }
+    if (!failed && high >= 0)
+    {
+        // An odd number of digits: the last one is followed by an implicit 0
+        uint8_t byte = (uint8_t)(high << 4);
+        failed = OHScratchAppend(&string, &byte, 1) != 0;
+    }
+    int result = failed ? -1 : OHMakeString(lexer, object, OHPDFObjectTypeString, string.bytes, string.length);
+    free(string.bytes);
+    return result;
+}
+
+/* Parses a number, without exponent like PDF numbers. Sets *isInteger if it has no decimal part. */
+static int OHParseNumber(OHLexer* lexer, double* number, int* isInteger)
+{
+    double sign = 1, value = 0, scale = 0;
+    int digits = 0;
+    if (lexer->cursor < lexer->end && (*lexer->cursor == '-' || *lexer->cursor == '+'))
+    {
+        if (*lexer->cursor == '-') sign = -1;
+        lexer->cursor++;
+    }
+    for (; lexer->cursor < lexer->end; lexer->cursor++)
+    {
+        uint8_t c = *lexer->cursor;
+        if (c >= '0' && c <= '9')
+        {
+            if (scale) { value += (c - '0') * scale; scale /= 10; }
+            else value = value * 10 + (c - '0');
+            digits++;
+        }
+        else if (c == '.' && !scale) scale = 0.1;
+        else break;
+    }
+    *number = sign * value;
+    *isInteger = !scale;
+    return digits ? 1 : -1;
+}
+
+static int OHParseObjectAtDepth(OHLexer* lexer, OHPDFObject* object, int depth);
+
+/* Parses the items of an array or the key/value pairs of a dictionary, until the closing delimiter */
+static int OHParseContainer(OHLexer* lexer, OHPDFObject* object, int dictionary, int depth)
+{
+    OHScratch values = { NULL, 0, 0 }, keys = { NULL, 0, 0 };
+    int result = -1;
+    lexer->cursor += dictionary ? 2 : 1;
+    while (1)
+    {
+        OHSkipWhitespace(lexer);
+        if (lexer->cursor >= lexer->end) break;
+        if (!dictionary && *lexer->cursor == ']')
+        {
+            lexer->cursor++;
+            result = 1;
+            break;
+        }
+        if (dictionary && *lexer->cursor == '>')
+        {
+            if (lexer->end - lexer->cursor >= 2 && lexer->cursor[1] == '>')
+            {
+                lexer->cursor += 2;
+                result = 1;
+            }
+            break;
+        }
+        OHPDFObject key, value;
+        if (dictionary)
+        {
+            if (OHParseObjectAtDepth(lexer, &key, depth + 1) != 1 || key.type != OHPDFObjectTypeName) break;
+            if (OHScratchAppend(&keys, &key.value.string.bytes, sizeof(const char*)) != 0) break;
+        }
+        if (OHParseObjectAtDepth(lexer, &value, depth + 1) != 1) break;
+        if (OHScratchAppend(&values, &value, sizeof(OHPDFObject)) != 0) break;
+    }
+    
+    size_t count = values.length / sizeof(OHPDFObject);
+    if (result == 1 && dictionary && keys.length / sizeof(const char*) != count) result = -1;
+    if (result == 1)
+    {
+        OHPDFObject* items = OHArenaAlloc(lexer->arena, values.length + 1);
+        const char** names = dictionary ? OHArenaAlloc(lexer->arena, keys.length + 1) : NULL;
+        if (!items || (dictionary && !names))
+        {
+            result = -1;
+        }
+        else if (dictionary)
+        {
+            if (count) memcpy(items, values.bytes, values.length);
+            if (count) memcpy(names, keys.bytes, keys.length);
+            object->type = OHPDFObjectTypeDictionary;
+            object->value.dictionary.keys = names;
+            object->value.dictionary.values = items;
+            object->value.dictionary.count = count;
+        }
+        else
+        {
+            if (count) memcpy(items, values.bytes, values.length);
+            object->type = OHPDFObjectTypeArray;
+            object->value.array.items = items;
+            object->value.array.count = count;
+        }
+    }
+    free(values.bytes);
+    free(keys.bytes);
+    return result;
+}
+
+/* Returns 1 if the lexer is at the given keyword (followed by a non-regular character) */
+static int OHIsAtKeyword(const OHLexer* lexer, const char* keyword)
+{
+    size_t length = strlen(keyword);
+    return (size_t)(lexer->end - lexer->cursor) >= length && memcmp(lexer->cursor, keyword, length) == 0
+        && (lexer->cursor + length == lexer->end || !OHIsRegular(lexer->cursor[length]));
+}
+
+static int OHParseObjectAtDepth(OHLexer* lexer, OHPDFObject* object, int depth)
+{
+    OHSkipWhitespace(lexer);
+    if (lexer->cursor >= lexer->end) return 0;
+    if (depth > kMaxNestingDepth) return -1;
+    
+    uint8_t c = *lexer->cursor;
+    if (c == '/') return OHParseName(lexer, object);
+    if (c == '(') return OHParseLiteralString(lexer, object);
+    if (c == '[') return OHParseContainer(lexer, object, 0, depth);
+    if (c == '<')
+    {
+        if (lexer->end - lexer->cursor >= 2 && lexer->cursor[1] == '<') return OHParseContainer(lexer, object, 1, depth);
+        return OHParseHexString(lexer, object);
+    }
+    if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.')
+    {
+        double number;
+        int isInteger;
+        if (OHParseNumber(lexer, &number, &isInteger) != 1) return -1;
+        object->type = OHPDFObjectTypeNumber;
+        object->value.number = number;
+        
+        // "number generation R" is a reference
+        const uint8_t* mark = lexer->cursor;
+        if (isInteger && number >= 0)
+        {
+            OHSkipWhitespace(lexer);
+            double generation;
+            int generationIsInteger;
+            if (lexer->cursor < lexer->end && *lexer->cursor >= '0' && *lexer->cursor <= '9'
+                && OHParseNumber(lexer, &generation, &generationIsInteger) == 1 && generationIsInteger)
+            {
+                OHSkipWhitespace(lexer);
+                if (OHIsAtKeyword(lexer, "R"))
+                {
+                    lexer->cursor++;
+                    object->type = OHPDFObjectTypeReference;
+                    object->value.reference.number = number > kMaxObjectNumber ? kMaxObjectNumber : (unsigned)number;
+                    object->value.reference.generation = (unsigned)generation;
+                    return 1;
+                }
+            }
+        }
+        lexer->cursor = mark;
+        return 1;
+    }
+    if (OHIsRegular(c))
+    {
+        const uint8_t* start = lexer->cursor;
+        while (lexer->cursor < lexer->end && OHIsRegular(*lexer->cursor)) lexer->cursor++;
+        size_t length = (size_t)(lexer->cursor - start);
+        if (length == 4 && memcmp(start, "true", 4) == 0) { object->type = OHPDFObjectTypeBoolean; object->value.boolean = 1; return 1; }
+        if (length == 5 && memcmp(start, "false", 5) == 0) { object->type = OHPDFObjectTypeBoolean; object->value.boolean = 0; return 1; }
+        if (length == 4 && memcmp(start, "null", 4) == 0) { object->type = OHPDFObjectTypeNull; return 1; }
+        return OHMakeString(lexer, object, OHPDFObjectTypeOperator, start, length);
+    }
+    // A stray closing delimiter
+    return -1;
+}
+
+static int OHIsOperator(const OHPDFObject* object, const char* name)
+{
+    return object->type == OHPDFObjectTypeOperator && strcmp(object->value.string.bytes, name) == 0;
+}
+
+// MARK: - File
+
+struct OHPDFFile {
+    OHArena arena;
+    OHPDFObject* objects;  /* Indexed by object number */
+    uint8_t* defined;
+    unsigned objectCapacity;
+    OHPDFObject catalogReference;
+};
+
+static const OHPDFObject kNullObject = { OHPDFObjectTypeNull, { 0 } };
+
+static int OHDefineObject(OHPDFFile* file, unsigned number, const OHPDFObject* object, int replace)
+{
+    if (number == 0 || number >= kMaxObjectNumber) return 0;
+    if (number >= file->objectCapacity)
+    {
+        unsigned capacity = file->objectCapacity ? file->objectCapacity : 64;
+        while (capacity <= number) capacity *= 2;
+        OHPDFObject* objects = realloc(file->objects, capacity * sizeof(OHPDFObject));
+        if (!objects) return -1;
+        file->objects = objects;
+        uint8_t* defined = realloc(file->defined, capacity);
+        if (!defined) return -1;
+        memset(defined + file->objectCapacity, 0, capacity - file->objectCapacity);
+        file->defined = defined;
+        file->objectCapacity = capacity;
+    }
+    if (replace || !file->defined[number])
+    {
+        file->objects[number] = *object;
+        file->defined[number] = 1;
+    }
+    return 0;
+}
+
+/* Reads the data of a stream whose `stream` keyword was just parsed, and moves past `endstream` */
+static void OHReadStreamData(OHLexer* lexer, OHPDFObject* object)
+{
+    // The data starts after the end of line following the keyword
+    if (lexer->cursor < lexer->end && *lexer->cursor == '\r') lexer->cursor++;
+    if (lexer->cursor < lexer->end && *lexer->cursor == '\n') lexer->cursor++;
+    const uint8_t* start = lexer->cursor;
+    
+    OHPDFObject* dictionary = OHArenaAlloc(lexer->arena, sizeof(OHPDFObject));
+    if (!dictionary) return;
+    *dictionary = *object;
+    object->type = OHPDFObjectTypeStream;
+    object->value.stream.dictionary = dictionary;
+    object->value.stream.data = start;
+    object->value.stream.length = 0;
+    
+    // Trust a direct /Length if `endstream` follows it, else look for `endstream`
+    for (size_t idx = 0; idx < dictionary->value.dictionary.count; ++idx)
+    {
+        const OHPDFObject* length = &dictionary->value.dictionary.values[idx];
+        if (strcmp(dictionary->value.dictionary.keys[idx], "Length") != 0 || length->type != OHPDFObjectTypeNumber) continue;
+        if (length->value.number >= 0 && length->value.number <= (double)(lexer->end - start))
+        {
+            lexer->cursor = start + (size_t)length->value.number;
+            OHSkipWhitespace(lexer);
+            if (OHIsAtKeyword(lexer, "endstream"))
+            {
+                object->value.stream.length = (size_t)length->value.number;
+                lexer->cursor += strlen("endstream");
+                return;
+            }
+        }
+    }
+    static const char kEndStream[] = "endstream";
+    const uint8_t* end = start;
+    while ((size_t)(lexer->end - end) >= sizeof(kEndStream) - 1 && memcmp(end, kEndStream, sizeof(kEndStream) - 1) != 0) end++;
+    if ((size_t)(lexer->end - end) < sizeof(kEndStream) - 1)
+    {
+        lexer->cursor = lexer->end;
+        return;
+    }
+    lexer->cursor = end + sizeof(kEndStream) - 1;
+    // The end of line before `endstream` is not part of the data
+    if (end > start && end[-1] == '\n') end--;
+    if (end > start && end[-1] == '\r') end--;
+    object->value.stream.length = (size_t)(end - start);
+}
+
+/* Scans the whole file for object definitions and trailers */
+static int OHScanObjects(OHPDFFile* file, const uint8_t* bytes, size_t length)
+{
+    OHLexer lexer = { bytes, bytes + length, &file->arena };
+    OHPDFObject previous[2] = { kNullObject, kNullObject };
+    while (lexer.cursor < lexer.end)
+    {
+        OHPDFObject object;
+        int result = OHParseObjectAtDepth(&lexer, &object, 0);
+        if (result == 0) break;
+        if (result < 0)
+        {
+            // Garbage between objects: resynchronize on the next byte
+            if (lexer.cursor < lexer.end) lexer.cursor++;
+            previous[0] = previous[1] = kNullObject;
+            continue;
+        }
+        
+        if (OHIsOperator(&object, "obj") && previous[0].type == OHPDFObjectTypeNumber && previous[1].type == OHPDFObjectTypeNumber)
+        {
+            double number = previous[0].value.number;
+            OHPDFObject value;
+            if (OHParseObjectAtDepth(&lexer, &value, 0) != 1) continue;
+            const uint8_t* mark = lexer.cursor;
+            OHPDFObject next;
+            if (OHParseObjectAtDepth(&lexer, &next, 0) == 1 && OHIsOperator(&next, "stream")
+                && value.type == OHPDFObjectTypeDictionary)
+            {
+                OHReadStreamData(&lexer, &value);
+            }
+            else
+            {
+                lexer.cursor = mark;
+            }
+            if (number >= 0 && OHDefineObject(file, (unsigned)number, &value, 1) != 0) return -1;
+            
+            // Cross-reference streams replace the trailer since PDF 1.5
+            const OHPDFObject* root = value.type == OHPDFObjectTypeStream
+                                    ? OHPDFFileGetValue(NULL, value.value.stream.dictionary, "Root") : NULL;
+            if (root && root->type == OHPDFObjectTypeReference) file->catalogReference = *root;
+            previous[0] = previous[1] = kNullObject;
+        }
+        else if (OHIsOperator(&object, "trailer"))
+        {
+            OHPDFObject trailer;
+            if (OHParseObjectAtDepth(&lexer, &trailer, 0) == 1)
+            {
+                const OHPDFObject* root = OHPDFFileGetValue(NULL, &trailer, "Root");
+                if (root && root->type == OHPDFObjectTypeReference) file->catalogReference = *root;
+            }
+            previous[0] = previous[1] = kNullObject;
+        }
+        else
+        {
+            previous[0] = previous[1];
+            previous[1] = object;
+        }
+    }
+    return 0;
+}
+
+static int OHIsName(const OHPDFObject* object, const char* name)
+{
+    return object && object->type == OHPDFObjectTypeName && strcmp(object->value.string.bytes, name) == 0;
+}
+
+/* Defines the objects stored in object streams, unless they are also defined directly */
+static int OHReadObjectStreams(OHPDFFile* file)
+{
+    for (unsigned number = 1; number < file->objectCapacity; ++number)
+    {
+        if (!file->defined[number]) continue;
+        const OHPDFObject* stream = &file->objects[number];
+        if (stream->type != OHPDFObjectTypeStream || !OHIsName(OHPDFFileGetValue(file, stream, "Type"), "ObjStm")) continue;
+        const OHPDFObject* count = OHPDFFileGetValue(file, stream, "N");
+        const OHPDFObject* first = OHPDFFileGetValue(file, stream, "First");
+        if (!count || !first || count->type != OHPDFObjectTypeNumber || first->type != OHPDFObjectTypeNumber) continue;
+        
+        size_t length;
+        uint8_t* data = OHPDFFileCopyStreamData(file, stream, &length);
+        if (!data) continue;
+        OHLexer header = { data, data + length, &file->arena };
+        for (double idx = 0; idx < count->value.number; ++idx)
+        {
+            OHPDFObject objectNumber, offset, object;
+            if (OHParseObjectAtDepth(&header, &objectNumber, 0) != 1 || OHParseObjectAtDepth(&header, &offset, 0) != 1
+                || objectNumber.type != OHPDFObjectTypeNumber || offset.type != OHPDFObjectTypeNumber
+                || objectNumber.value.number < 0 || offset.value.number < 0
+                || first->value.number + offset.value.number >= (double)length) break;
+            OHLexer lexer = { data + (size_t)(first->value.number + offset.value.number), data + length, &file->arena };
+            if (OHParseObjectAtDepth(&lexer, &object, 0) != 1 || object.type == OHPDFObjectTypeOperator) continue;
+            if (OHDefineObject(file, (unsigned)objectNumber.value.number, &object, 0) != 0)
+            {
+                free(data);
+                return -1;
+            }
+        }
+        free(data);
+    }
+    return 0;
+}
+
+OHPDFFile* OHPDFFileCreate(const uint8_t* bytes, size_t length)
+{
+    OHPDFFile* file = calloc(1, sizeof(OHPDFFile));
+    if (!file) return NULL;
+    if (OHScanObjects(file, bytes, length) != 0 || OHReadObjectStreams(file) != 0)
+    {
+        OHPDFFileRelease(file);
+        return NULL;
+    }
+    
+    // Fall back on any catalog if no trailer was found
+    if (file->catalogReference.type != OHPDFObjectTypeReference)
+    {
+        for (unsigned number = 1; number < file->objectCapacity; ++number)
+        {
+            if (file->defined[number] && OHIsName(OHPDFFileGetValue(file, &file->objects[number], "Type"), "Catalog"))
+            {
+                file->catalogReference.type = OHPDFObjectTypeReference;
+                file->catalogReference.value.reference.number = number;
+                break;
+            }
+        }
+    }
+    if (OHPDFFileResolve(file, &file->catalogReference)->type != OHPDFObjectTypeDictionary)
+    {
+        OHPDFFileRelease(file);
+        return NULL;
+    }
+    return file;
+}
+
+void OHPDFFileRelease(OHPDFFile* file)
+{
+    if (!file) return;
+    OHArenaRelease(&file->arena);
+    free(file->objects);
+    free(file->defined);
+    free(file);
+}
+
+const OHPDFObject* OHPDFFileResolve(const OHPDFFile* file, const OHPDFObject* object)
+{
+    for (int depth = 0; object && object->type == OHPDFObjectTypeReference; ++depth)
+    {
+        unsigned number = object->value.reference.number;
+        if (!file || depth > kMaxNestingDepth || number >= file->objectCapacity || !file->defined[number]) return &kNullObject;
+        object = &file->objects[number];
+    }
+    return object;
+}
+
+const OHPDFObject* OHPDFFileGetValue(const OHPDFFile* file, const OHPDFObject* dictionary, const char* key)
+{
+    dictionary = OHPDFFileResolve(file, dictionary);
+    if (dictionary && dictionary->type == OHPDFObjectTypeStream) dictionary = dictionary->value.stream.dictionary;
+    if (!dictionary || dictionary->type != OHPDFObjectTypeDictionary) return NULL;
+    for (size_t idx = 0; idx < dictionary->value.dictionary.count; ++idx)
+    {
+        if (strcmp(dictionary->value.dictionary.keys[idx], key) == 0)
+        {
+            return OHPDFFileResolve(file, &dictionary->value.dictionary.values[idx]);
+        }
+    }
+    return NULL;
+}
+
+static const char* const kInheritedKeys[3] = { "Resources", "MediaBox", "CropBox" };
+
+static const OHPDFObject* OHFindFirstPage(const OHPDFFile* file, const OHPDFObject* node,
+                                          const OHPDFObject* inherited[3], int depth)
+{
+    node = OHPDFFileResolve(file, node);
+    if (node->type != OHPDFObjectTypeDictionary || depth > kMaxNestingDepth) return NULL;
+    for (int idx = 0; idx < 3; ++idx)
+    {
+        const OHPDFObject* value = OHPDFFileGetValue(file, node, kInheritedKeys[idx]);
+        if (value) inherited[idx] = value;
+    }
+    const OHPDFObject* kids = OHPDFFileGetValue(file, node, "Kids");
+    if (OHIsName(OHPDFFileGetValue(file, node, "Type"), "Page") || !kids || kids->type != OHPDFObjectTypeArray) return node;
+    
+    for (size_t idx = 0; idx < kids->value.array.count; ++idx)
+    {
+        const OHPDFObject* kidInherited[3] = { inherited[0], inherited[1], inherited[2] };
+        const OHPDFObject* page = OHFindFirstPage(file, &kids->value.array.items[idx], kidInherited, depth + 1);
+        if (page)
+        {
+            memcpy(inherited, kidInherited, sizeof(kidInherited));
+            return page;
+        }
+    }
+    return NULL;
+}
+
+const OHPDFObject* OHPDFFileGetFirstPage(const OHPDFFile* file, const OHPDFObject* inherited[3])
+{
+    inherited[0] = inherited[1] = inherited[2] = NULL;
+    const OHPDFObject* pages = OHPDFFileGetValue(file, &file->catalogReference, "Pages");
+    return pages ? OHFindFirstPage(file, pages, inherited, 0) : NULL;
+}
+
+static uint8_t* OHInflate(const uint8_t* bytes, size_t length, size_t* outLength)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) return NULL;
+    
+    size_t capacity = length * 4 + 256, used = 0;
+    uint8_t* output = malloc(capacity);
+    stream.next_in = (Bytef*)bytes;
+    stream.avail_in = (uInt)length;
+    int status = Z_OK;
+    while (output && status == Z_OK)
+    {
+        if (used == capacity)
+        {
+            uint8_t* grown = realloc(output, capacity * 2);
+            if (!grown) { free(output); output = NULL; break; }
+            output = grown;
+            capacity *= 2;
+        }
+        stream.next_out = output + used;
+        stream.avail_out = (uInt)(capacity - used);
+        status = inflate(&stream, Z_NO_FLUSH);
+        used = capacity - stream.avail_out;
+        // Some producers omit the end of the zlib stream: accept the data once the input is consumed
+        if (status == Z_BUF_ERROR && stream.avail_in == 0) status = Z_STREAM_END;
+    }
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END)
+    {
+        free(output);
+        return NULL;
+    }
+    *outLength = used;
+    return output;
+}
+
+uint8_t* OHPDFFileCopyStreamData(const OHPDFFile* file, const OHPDFObject* stream, size_t* length)
+{
+    stream = OHPDFFileResolve(file, stream);
+    if (stream->type != OHPDFObjectTypeStream) return NULL;
+    
+    const OHPDFObject* filter = OHPDFFileGetValue(file, stream, "Filter");
+    if (filter && filter->type == OHPDFObjectTypeArray)
+    {
+        if (filter->value.array.count > 1) return NULL;
+        filter = filter->value.array.count ? OHPDFFileResolve(file, &filter->value.array.items[0]) : NULL;
+    }
+    const OHPDFObject* parameters = OHPDFFileGetValue(file, stream, "DecodeParms");
+    if (parameters && parameters->type == OHPDFObjectTypeArray)
+    {
+        parameters = parameters->value.array.count ? OHPDFFileResolve(file, &parameters->value.array.items[0]) : NULL;
+    }
+    const OHPDFObject* predictor = parameters ? OHPDFFileGetValue(file, parameters, "Predictor") : NULL;
+    
+    if (!filter || filter->type == OHPDFObjectTypeNull)
+    {
+        uint8_t* data = malloc(stream->value.stream.length + 1);
+        if (!data) return NULL;
+        memcpy(data, stream->value.stream.data, stream->value.stream.length);
+        *length = stream->value.stream.length;
+        return data;
+    }
+    if ((OHIsName(filter, "FlateDecode") || OHIsName(filter, "Fl"))
+        && (!predictor || (predictor->type == OHPDFObjectTypeNumber && predictor->value.number <= 1)))
+    {
+        return OHInflate(stream->value.stream.data, stream->value.stream.length, length);
+    }
+    return NULL;
+}
+
+// MARK: - Content streams
+
+struct OHPDFContentParser {
+    OHArena arena;
+    OHLexer lexer;
+};
+
+OHPDFContentParser* OHPDFContentParserCreate(const uint8_t* bytes, size_t length)
+{
+    OHPDFContentParser* parser = calloc(1, sizeof(OHPDFContentParser));
+    if (!parser) return NULL;
+    parser->lexer = (OHLexer){ bytes, bytes + length, &parser->arena };
+    return parser;
+}
+
+void OHPDFContentParserRelease(OHPDFContentParser* parser)
+{
+    if (!parser) return;
+    OHArenaRelease(&parser->arena);
+    free(parser);
+}
+
+int OHPDFContentParserNext(OHPDFContentParser* parser, OHPDFObject* object)
+{
+    return OHParseObjectAtDepth(&parser->lexer, object, 0);
+}
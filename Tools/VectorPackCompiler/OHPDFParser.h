@@ -0,0 +1,140 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+#ifndef OHVectorPackCompiler_OHPDFParser_h
+#define OHVectorPackCompiler_OHPDFParser_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/***********************************************************************************/
+
+/*
+ *  A minimal, portable PDF parser: just enough of the PDF object model to find
+ *  the first page of a document, its boxes and resources, and to decode its
+ *  content streams, so that `OHVectorPackCompiler` can run without CoreGraphics.
+ *
+ *  The parser doesn't rely on the cross-reference table: it scans the whole file
+ *  for `N G obj` definitions (the last definition of an object wins), then reads
+ *  the objects of the object streams (`/Type /ObjStm`). Only the `FlateDecode`
+ *  filter (without predictor) is supported, which is what vector icons use.
+ *
+ *  All the objects belong to the file and are released with it.
+ */
+
+typedef enum {
+    OHPDFObjectTypeNull,
+    OHPDFObjectTypeBoolean,
+    OHPDFObjectTypeNumber,
+    OHPDFObjectTypeName,
+    OHPDFObjectTypeString,
+    OHPDFObjectTypeArray,
+    OHPDFObjectTypeDictionary,
+    OHPDFObjectTypeReference,
+    OHPDFObjectTypeStream,
+    OHPDFObjectTypeOperator,    /* A bare keyword: the operators of content streams */
+} OHPDFObjectType;
+
+typedef struct OHPDFObject OHPDFObject;
+
+struct OHPDFObject {
+    OHPDFObjectType type;
+    union {
+        int boolean;
+        double number;
+        struct { const char* bytes; size_t length; } string;            /* Name, string and operator (NUL-terminated) */
+        struct { OHPDFObject* items; size_t count; } array;
+        struct { const char** keys; OHPDFObject* values; size_t count; } dictionary;
+        struct { unsigned number; unsigned generation; } reference;
+        struct { OHPDFObject* dictionary; const uint8_t* data; size_t length; } stream; /* Raw (encoded) data */
+    } value;
+};
+
+typedef struct OHPDFFile OHPDFFile;
+
+/**
+ *  Parses a PDF file. The bytes must stay valid until the file is released.
+ *
+ *  @return The file, or NULL if no document catalog was found or on allocation failure.
+ */
+OHPDFFile* OHPDFFileCreate(const uint8_t* bytes, size_t length);
+
+/**
+ *  Releases a file and all its objects.
+ */
+void OHPDFFileRelease(OHPDFFile* file);
+
+/**
+ *  Follows an indirect reference (recursively). Returns the object itself if it is
+ *  not a reference, or a null object if the referenced object doesn't exist.
+ */
+const OHPDFObject* OHPDFFileResolve(const OHPDFFile* file, const OHPDFObject* object);
+
+/**
+ *  Returns the value of a key of a dictionary (or of the dictionary of a stream),
+ *  resolved, or NULL if the object is not a dictionary or has no such key.
+ */
+const OHPDFObject* OHPDFFileGetValue(const OHPDFFile* file, const OHPDFObject* dictionary, const char* key);
+
+/**
+ *  Returns the dictionary of the first page of the document, or NULL if there is none.
+ *
+ *  @param inherited An array receiving the page attributes inherited from the page tree,
+ *                   for the keys "Resources", "MediaBox" and "CropBox" in this order
+ *                   (NULL entries for missing attributes).
+ */
+const OHPDFObject* OHPDFFileGetFirstPage(const OHPDFFile* file, const OHPDFObject* inherited[3]);
+
+/**
+ *  Decodes the data of a stream.
+ *
+ *  @return The decoded bytes (to free using `free`), or NULL if a filter is not supported
+ *          or the data is corrupted. `*length` receives the length of the decoded data.
+ */
+uint8_t* OHPDFFileCopyStreamData(const OHPDFFile* file, const OHPDFObject* stream, size_t* length);
+
+// MARK: - Content streams
+
+typedef struct OHPDFContentParser OHPDFContentParser;
+
+/**
+ *  Creates a parser reading the objects and operators of decoded content stream bytes,
+ *  which must stay valid until the parser is released.
+ */
+OHPDFContentParser* OHPDFContentParserCreate(const uint8_t* bytes, size_t length);
+
+/**
+ *  Releases a content parser and the objects it returned.
+ */
+void OHPDFContentParserRelease(OHPDFContentParser* parser);
+
+/**
+ *  Reads the next object (an operand, or an object of type `OHPDFObjectTypeOperator`).
+ *
+ *  @return 1 if an object was read, 0 at the end of the content, -1 on syntax error.
+ */
+int OHPDFContentParserNext(OHPDFContentParser* parser, OHPDFObject* object);
+
+#endif
@@ -0,0 +1,541 @@
+/***********************************************************************************
+ *
+ * Copyright (c) 2014 Olivier Halligon
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ***********************************************************************************/
+
+
+/*
+ *  Compiles a directory of vector PDFs (e.g. the icons of an app) into a single
+ *  vector pack (see `OHVectorPackFile.h`), that `OHVectorPack` loads at runtime
+ *  without parsing any PDF. It only needs a C99 compiler and zlib, so it can run
+ *  on any build machine, e.g. on Linux as part of an asset pipeline:
+ *
+ *      cc -std=c99 -O2 -I../../OHPDFImage -o OHVectorPackCompiler \
+ *         OHVectorPackCompiler.c OHPDFParser.c ../../OHPDFImage/OHDisplayList.c \
+ *         ../../OHPDFImage/OHVectorPackFile.c -lz -lm
+ *      ./OHVectorPackCompiler Icons/ Icons.ohvp
+ *
+ *  Options:
+ *      --strict    Fail if any PDF can't be compiled, instead of skipping it
+ *
+ *  Each `<name>.pdf` file of the input directory becomes the `<name>` entry of
+ *  the pack. Like `OHPDFDisplayList`, only the vector content of the first page
+ *  is supported: PDFs using text, images, shadings, patterns, XObjects, soft masks
+ *  or blend modes are skipped with a warning, and must be loaded as PDFs instead.
+ */
+
+#if !defined(__APPLE__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "OHPDFParser.h"
+#include "OHDisplayList.h"
+#include "OHVectorPackFile.h"
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+/***********************************************************************************/
+
+static const char kPDFExtension[] = ".pdf";
+/* More operands than this before an operator is not a valid content stream */
+enum { kMaxOperands = 64 };
+
+static void OHPrintUsage(const char* program)
+{
+    fprintf(stderr, "usage: %s [--strict] <input directory> <output pack>\n", program);
+}
+
+// MARK: - Content stream interpretation
+
+/* The operators with only numeric operands, handled by OHDisplayListBuilder */
+static const char* const kNumericOperators[] = {
+    "q", "Q", "cm", "w", "J", "j", "M", "ri", "i",
+    "m", "l", "c", "v", "y", "h", "re",
+    "S", "s", "f", "F", "f*", "B", "B*", "b", "b*", "n", "W", "W*",
+    "g", "G", "rg", "RG", "k", "K", "sc", "scn", "SC", "SCN",
+};
+
+/* Content the display list can't represent: text, XObjects, shadings, inline images, Type3 glyphs */
+static const char* const kUnsupportedOperators[] = {
+    "BT", "Do", "sh", "BI", "ID", "EI", "d0", "d1",
+};
+
+static int OHIsOneOf(const char* op, const char* const* list, size_t count)
+{
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+        if (strcmp(op, list[idx]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int OHIsName(const OHPDFObject* object, const char* name)
+{
+    return object && object->type == OHPDFObjectTypeName && strcmp(object->value.string.bytes, name) == 0;
+}
+
+static const OHPDFObject* OHGetResource(const OHPDFFile* file, const OHPDFObject* resources,
+                                        const char* category, const char* name)
+{
+    const OHPDFObject* dictionary = resources ? OHPDFFileGetValue(file, resources, category) : NULL;
+    return dictionary ? OHPDFFileGetValue(file, dictionary, name) : NULL;
+}
+
+/**
+ *  Returns the number of components of a color space (name or array),
+ *  or 0 if the display list does not support it (Pattern, Indexed, Lab, …).
+ */
+static int OHColorSpaceComponents(const OHPDFFile* file, const OHPDFObject* resources,
+                                  const OHPDFObject* colorSpace, int depth)
+{
+    colorSpace = OHPDFFileResolve(file, colorSpace);
+    if (colorSpace->type == OHPDFObjectTypeName)
+    {
+        const char* name = colorSpace->value.string.bytes;
+        if (strcmp(name, "DeviceGray") == 0 || strcmp(name, "G") == 0) return 1;
+        if (strcmp(name, "DeviceRGB") == 0 || strcmp(name, "RGB") == 0) return 3;
+        if (strcmp(name, "DeviceCMYK") == 0 || strcmp(name, "CMYK") == 0) return 4;
+        // Named color space from the page resources
+        const OHPDFObject* resource = depth == 0 ? OHGetResource(file, resources, "ColorSpace", name) : NULL;
+        return resource ? OHColorSpaceComponents(file, resources, resource, depth+1) : 0;
+    }
+    if (colorSpace->type == OHPDFObjectTypeArray && colorSpace->value.array.count > 0)
+    {
+        const OHPDFObject* family = OHPDFFileResolve(file, &colorSpace->value.array.items[0]);
+        if (OHIsName(family, "CalGray")) return 1;
+        if (OHIsName(family, "CalRGB")) return 3;
+        if (OHIsName(family, "ICCBased") && colorSpace->value.array.count > 1)
+        {
+            const OHPDFObject* components = OHPDFFileGetValue(file, &colorSpace->value.array.items[1], "N");
+            if (components && components->type == OHPDFObjectTypeNumber
+                && (components->value.number == 1 || components->value.number == 3 || components->value.number == 4))
+            {
+                return (int)components->value.number;
+            }
+        }
+    }
+    return 0;
+}
+
+static void OHApplyExtGState(OHDisplayListBuilder* builder, const OHPDFFile* file, const OHPDFObject* extGState)
+{
+    if (!extGState || extGState->type != OHPDFObjectTypeDictionary)
+    {
+        OHDisplayListBuilderMarkUnsupported(builder);
+        return;
+    }
+    
+    // Soft masks and blend modes other than Normal can't be represented
+    const OHPDFObject* value = OHPDFFileGetValue(file, extGState, "SMask");
+    if (value && !OHIsName(value, "None")) OHDisplayListBuilderMarkUnsupported(builder);
+    value = OHPDFFileGetValue(file, extGState, "BM");
+    if (value && !OHIsName(value, "Normal") && !OHIsName(value, "Compatible")) OHDisplayListBuilderMarkUnsupported(builder);
+    
+    value = OHPDFFileGetValue(file, extGState, "ca");
+    if (value && value->type == OHPDFObjectTypeNumber) OHDisplayListBuilderSetAlpha(builder, 0, value->value.number);
+    value = OHPDFFileGetValue(file, extGState, "CA");
+    if (value && value->type == OHPDFObjectTypeNumber) OHDisplayListBuilderSetAlpha(builder, 1, value->value.number);
+    value = OHPDFFileGetValue(file, extGState, "LW");
+    if (value && value->type == OHPDFObjectTypeNumber)
+    {
+        double lineWidth = value->value.number;
+        OHDisplayListBuilderApplyOperator(builder, "w", &lineWidth, 1);
+    }
+}
+
+static void OHApplyDash(OHDisplayListBuilder* builder, const OHPDFFile* file, const OHPDFObject* operands, size_t count)
+{
+    if (count < 2 || operands[count-2].type != OHPDFObjectTypeArray || operands[count-1].type != OHPDFObjectTypeNumber)
+    {
+        OHDisplayListBuilderMarkUnsupported(builder);
+        return;
+    }
+    const OHPDFObject* array = &operands[count-2];
+    size_t lengthsCount = array->value.array.count;
+    double* lengths = malloc((lengthsCount > 0 ? lengthsCount : 1) * sizeof(double));
+    if (!lengths)
+    {
+        OHDisplayListBuilderMarkUnsupported(builder);
+        return;
+    }
+    for (size_t idx = 0; idx < lengthsCount; ++idx)
+    {
+        const OHPDFObject* length = OHPDFFileResolve(file, &array->value.array.items[idx]);
+        lengths[idx] = length->type == OHPDFObjectTypeNumber ? length->value.number : 0;
+    }
+    OHDisplayListBuilderSetDash(builder, lengths, lengthsCount, operands[count-1].value.number);
+    free(lengths);
+}
+
+static void OHApplyNumericOperator(OHDisplayListBuilder* builder, const char* op, const OHPDFObject* operands, size_t count)
+{
+    int expected = OHDisplayListBuilderOperandCount(builder, op);
+    double values[6];
+    if (expected < 0 || expected > 6 || (size_t)expected > count)
+    {
+        OHDisplayListBuilderMarkUnsupported(builder);
+        return;
+    }
+    // The operands are the last ones on the stack
+    for (int idx = 0; idx < expected; ++idx)
+    {
+        const OHPDFObject* operand = &operands[count - (size_t)expected + (size_t)idx];
+        if (operand->type != OHPDFObjectTypeNumber)
+        {
+            // e.g. `scn` with a pattern name
+            OHDisplayListBuilderMarkUnsupported(builder);
+            return;
+        }
+        values[idx] = operand->value.number;
+    }
+    OHDisplayListBuilderApplyOperator(builder, op, values, (size_t)expected);
+}
+
+/**
+ *  Interprets a content stream, the same way `OHPDFDisplayList` does using CGPDFScanner.
+ *
+ *  @return 0 on success, -1 on syntax error.
+ */
+static int OHInterpretContent(OHDisplayListBuilder* builder, const OHPDFFile* file, const OHPDFObject* resources,
+                              const uint8_t* bytes, size_t length)
+{
+    OHPDFContentParser* parser = OHPDFContentParserCreate(bytes, length);
+    if (!parser) return -1;
+    
+    OHPDFObject operands[kMaxOperands];
+    size_t count = 0;
+    int result;
+    OHPDFObject object;
+    while ((result = OHPDFContentParserNext(parser, &object)) == 1 && !OHDisplayListBuilderFailed(builder))
+    {
+        if (object.type != OHPDFObjectTypeOperator)
+        {
+            if (count == kMaxOperands)
+            {
+                result = -1;
+                break;
+            }
+            operands[count++] = object;
+            continue;
+        }
+        
+        const char* op = object.value.string.bytes;
+        if (OHIsOneOf(op, kNumericOperators, sizeof(kNumericOperators) / sizeof(kNumericOperators[0])))
+        {
+            OHApplyNumericOperator(builder, op, operands, count);
+        }
+        else if (strcmp(op, "cs") == 0 || strcmp(op, "CS") == 0)
+        {
+            int components = count > 0 ? OHColorSpaceComponents(file, resources, &operands[count-1], 0) : 0;
+            OHDisplayListBuilderSetColorSpace(builder, op[0] == 'C', components);
+        }
+        else if (strcmp(op, "gs") == 0)
+        {
+            const OHPDFObject* extGState = count > 0 && operands[count-1].type == OHPDFObjectTypeName
+                                         ? OHGetResource(file, resources, "ExtGState", operands[count-1].value.string.bytes) : NULL;
+            OHApplyExtGState(builder, file, extGState);
+        }
+        else if (strcmp(op, "d") == 0)
+        {
+            OHApplyDash(builder, file, operands, count);
+        }
+        else if (OHIsOneOf(op, kUnsupportedOperators, sizeof(kUnsupportedOperators) / sizeof(kUnsupportedOperators[0])))
+        {
+            OHDisplayListBuilderMarkUnsupported(builder);
+        }
+        // Other operators (marked content, compatibility sections…) don't affect the rendering
+        count = 0;
+    }
+    OHPDFContentParserRelease(parser);
+    return result < 0 ? -1 : 0;
+}
+
+// MARK: - Pages
+
+/* Reads a rectangle array as (x, y, width, height), normalized like CGRectStandardize */
+static int OHGetBox(const OHPDFFile* file, const OHPDFObject* array, float box[4])
+{
+    if (!array || array->type != OHPDFObjectTypeArray || array->value.array.count != 4) return -1;
+    double values[4];
+    for (int idx = 0; idx < 4; ++idx)
+    {
+        const OHPDFObject* value = OHPDFFileResolve(file, &array->value.array.items[idx]);
+        if (value->type != OHPDFObjectTypeNumber) return -1;
+        values[idx] = value->value.number;
+    }
+    box[0] = (float)(values[0] < values[2] ? values[0] : values[2]);
+    box[1] = (float)(values[1] < values[3] ? values[1] : values[3]);
+    box[2] = (float)(values[0] < values[2] ? values[2] - values[0] : values[0] - values[2]);
+    box[3] = (float)(values[1] < values[3] ? values[3] - values[1] : values[1] - values[3]);
+    return 0;
+}
+
+/* Concatenates the content streams of a page, separated by whitespace */
+static uint8_t* OHCopyPageContent(const OHPDFFile* file, const OHPDFObject* page, size_t* length)
+{
+    const OHPDFObject* contents = OHPDFFileGetValue(file, page, "Contents");
+    const OHPDFObject* streams = contents;
+    size_t streamsCount = 1;
+    if (!contents)
+    {
+        streamsCount = 0;
+    }
+    else if (contents->type == OHPDFObjectTypeArray)
+    {
+        streams = contents->value.array.items;
+        streamsCount = contents->value.array.count;
+    }
+    
+    uint8_t* content = malloc(1);
+    *length = 0;
+    for (size_t idx = 0; idx < streamsCount && content; ++idx)
+    {
+        size_t streamLength;
+        uint8_t* data = OHPDFFileCopyStreamData(file, &streams[idx], &streamLength);
+        uint8_t* grown = data ? realloc(content, *length + streamLength + 1) : NULL;
+        if (!grown)
+        {
+            free(data);
+            free(content);
+            return NULL;
+        }
+        content = grown;
+        memcpy(content + *length, data, streamLength);
+        content[*length + streamLength] = '\n';
+        *length += streamLength + 1;
+        free(data);
+    }
+    return content;
+}
+
+/**
+ *  Compiles the first page of a PDF file and adds it to the pack.
+ *
+ *  @return 0 on success, -1 with a reason if the PDF can't be compiled.
+ */
+static int OHAddPDFFile(OHVectorPackWriter* writer, const char* path, const char* name, const char** reason)
+{
+    *reason = "can't read the file";
+    FILE* input = fopen(path, "rb");
+    if (!input) return -1;
+    uint8_t* bytes = NULL;
+    size_t length = 0, capacity = 0;
+    int failed = 0;
+    while (!failed)
+    {
+        if (length == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64 * 1024;
+            uint8_t* grown = realloc(bytes, capacity);
+            if (!grown) failed = 1;
+            else bytes = grown;
+        }
+        size_t read = failed ? 0 : fread(bytes + length, 1, capacity - length, input);
+        if (read == 0) break;
+        length += read;
+    }
+    failed = failed || ferror(input);
+    fclose(input);
+    if (failed)
+    {
+        free(bytes);
+        return -1;
+    }
+    
+    int status = -1;
+    OHPDFFile* file = OHPDFFileCreate(bytes, length);
+    const OHPDFObject* inherited[3];
+    const OHPDFObject* page = file ? OHPDFFileGetFirstPage(file, inherited) : NULL;
+    float mediaBox[4], cropBox[4];
+    *reason = "not a PDF file, or a PDF file without pages";
+    if (page && OHGetBox(file, inherited[1], mediaBox) != 0)
+    {
+        *reason = "invalid media box";
+    }
+    else if (page)
+    {
+        // The crop box defaults to the media box, and is clipped to it
+        if (OHGetBox(file, inherited[2], cropBox) != 0) memcpy(cropBox, mediaBox, sizeof(cropBox));
+        float minX = cropBox[0] > mediaBox[0] ? cropBox[0] : mediaBox[0];
+        float minY = cropBox[1] > mediaBox[1] ? cropBox[1] : mediaBox[1];
+        float maxX = cropBox[0] + cropBox[2] < mediaBox[0] + mediaBox[2] ? cropBox[0] + cropBox[2] : mediaBox[0] + mediaBox[2];
+        float maxY = cropBox[1] + cropBox[3] < mediaBox[1] + mediaBox[3] ? cropBox[1] + cropBox[3] : mediaBox[1] + mediaBox[3];
+        cropBox[0] = minX;
+        cropBox[1] = minY;
+        cropBox[2] = maxX > minX ? maxX - minX : 0;
+        cropBox[3] = maxY > minY ? maxY - minY : 0;
+        
+        size_t contentLength;
+        uint8_t* content = OHCopyPageContent(file, page, &contentLength);
+        OHDisplayListBuilder* builder = OHDisplayListBuilderCreate();
+        *reason = "unsupported stream filter";
+        if (content && builder)
+        {
+            *reason = "syntax error in the content stream";
+            if (OHInterpretContent(builder, file, inherited[0], content, contentLength) == 0)
+            {
+                OHDisplayList* list = OHDisplayListBuilderCopyDisplayList(builder);
+                *reason = "unsupported content (text, images, shadings, soft masks…)";
+                if (list)
+                {
+                    *reason = "duplicate name";
+                    status = OHVectorPackWriterAddEntry(writer, name, mediaBox, cropBox, list);
+                    OHDisplayListRelease(list);
+                }
+            }
+        }
+        OHDisplayListBuilderRelease(builder);
+        free(content);
+    }
+    OHPDFFileRelease(file);
+    free(bytes);
+    return status;
+}
+
+// MARK: - Main
+
+static int OHCompareStrings(const void* lhs, const void* rhs)
+{
+    return strcmp(*(char* const*)lhs, *(char* const*)rhs);
+}
+
+/* Lists the PDF files of a directory, sorted so that the pack is reproducible */
+static char** OHCopyPDFFileNames(const char* directoryPath, size_t* count)
+{
+    DIR* directory = opendir(directoryPath);
+    if (!directory) return NULL;
+    char** names = NULL;
+    size_t capacity = 0;
+    *count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(directory)))
+    {
+        size_t length = strlen(entry->d_name);
+        if (length <= strlen(kPDFExtension) || entry->d_name[0] == '.'
+            || strcmp(entry->d_name + length - strlen(kPDFExtension), kPDFExtension) != 0) continue;
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            char** grown = realloc(names, capacity * sizeof(char*));
+            if (!grown) break;
+            names = grown;
+        }
+        names[*count] = malloc(length + 1);
+        if (!names[*count]) break;
+        memcpy(names[*count], entry->d_name, length + 1);
+        (*count)++;
+    }
+    closedir(directory);
+    if (names) qsort(names, *count, sizeof(char*), OHCompareStrings);
+    return names ? names : calloc(1, sizeof(char*));
+}
+
+int main(int argc, char* argv[])
+{
+    const char* inputPath = NULL;
+    const char* outputPath = NULL;
+    int strict = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--strict")) strict = 1;
+        else if (!inputPath) inputPath = argv[i];
+        else if (!outputPath) outputPath = argv[i];
+        else
+        {
+            OHPrintUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (!inputPath || !outputPath)
+    {
+        OHPrintUsage(argv[0]);
+        return 2;
+    }
+    
+    size_t fileCount = 0;
+    char** fileNames = OHCopyPDFFileNames(inputPath, &fileCount);
+    if (!fileNames)
+    {
+        perror(inputPath);
+        return 1;
+    }
+    OHVectorPackWriter* writer = OHVectorPackWriterCreate();
+    if (!writer)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    
+    size_t skipped = 0;
+    for (size_t idx = 0; idx < fileCount; ++idx)
+    {
+        size_t nameLength = strlen(fileNames[idx]) - strlen(kPDFExtension);
+        char* path = malloc(strlen(inputPath) + strlen(fileNames[idx]) + 2);
+        char* name = malloc(nameLength + 1);
+        const char* reason = "out of memory";
+        if (path && name)
+        {
+            sprintf(path, "%s/%s", inputPath, fileNames[idx]);
+            memcpy(name, fileNames[idx], nameLength);
+            name[nameLength] = '\0';
+        }
+        if (!path || !name || OHAddPDFFile(writer, path, name, &reason) != 0)
+        {
+            fprintf(stderr, "warning: skipping %s: %s\n", fileNames[idx], reason);
+            skipped++;
+        }
+        free(path);
+        free(name);
+        free(fileNames[idx]);
+    }
+    free(fileNames);
+    
+    int status = 0;
+    if (strict && skipped > 0)
+    {
+        fprintf(stderr, "error: %lu PDF file(s) could not be compiled\n", (unsigned long)skipped);
+        status = 1;
+    }
+    else
+    {
+        FILE* output = fopen(outputPath, "wb");
+        if (!output || OHVectorPackWriterWrite(writer, output) != 0)
+        {
+            perror(outputPath);
+            status = 1;
+        }
+        long size = output ? ftell(output) : 0;
+        if (output && fclose(output) != 0 && status == 0)
+        {
+            perror(outputPath);
+            status = 1;
+        }
+        if (status == 0)
+        {
+            fprintf(stderr, "Compiled %lu vector image(s) into %s (%ld bytes), %lu skipped\n",
+                    (unsigned long)OHVectorPackWriterGetEntryCount(writer), outputPath, size, (unsigned long)skipped);
+        }
+    }
+    OHVectorPackWriterRelease(writer);
+    return status;
+}